@@ -197,7 +197,12 @@ HttpConnection::setPage(const Data& pPage,int response,const Mime& pType)
    mTxBuffer += "Content-Type: "  ;
    mTxBuffer += pType.type() ;
    mTxBuffer +="/"  ;
-   mTxBuffer += pType.subType() ; mTxBuffer += Symbols::CRLF;
+   mTxBuffer += pType.subType() ;
+   {
+      DataStream s(mTxBuffer);
+      pType.encodeParameters(s);
+   }
+   mTxBuffer += Symbols::CRLF;
    
    mTxBuffer += Symbols::CRLF;
    
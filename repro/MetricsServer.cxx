@@ -0,0 +1,549 @@
+#include "rutil/ResipAssert.h"
+#include <algorithm>
+#include <vector>
+
+#include "resip/stack/SipStack.hxx"
+#include "resip/stack/MethodTypes.hxx"
+#include "resip/stack/UnknownParameterType.hxx"
+#include "rutil/CongestionManager.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/LatencyHistogram.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/ParseBuffer.hxx"
+#include "rutil/Timer.hxx"
+
+#include "repro/ReproVersion.hxx"
+#include "repro/MetricsServer.hxx"
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::REPRO
+
+// A scrape only asks the stack for new statistics when the ones it has are
+// older than this, so several scrapers do not make the stack poll for each.
+static const UInt64 MinPollIntervalMs = 1000;
+// How long a scrape waits for the stack to answer before using what it has.
+static const unsigned int PollWaitMs = 250;
+
+namespace
+{
+
+// Histogram bucket bounds, in microseconds and as the le label
+struct BucketBound
+{
+   UInt64 micros;
+   const char* le;
+};
+
+const BucketBound LatencyBuckets[] =
+{
+   { 500, "0.0005" },
+   { 1000, "0.001" },
+   { 2500, "0.0025" },
+   { 5000, "0.005" },
+   { 10000, "0.01" },
+   { 25000, "0.025" },
+   { 50000, "0.05" },
+   { 100000, "0.1" },
+   { 250000, "0.25" },
+   { 500000, "0.5" },
+   { 1000000, "1.0" },
+   { 2500000, "2.5" },
+   { 5000000, "5.0" },
+   { 10000000, "10.0" }
+};
+
+// What a FifoCollector copies out of each fifo
+struct FifoState
+{
+   Data description;
+   unsigned int role;
+   size_t depth;
+   time_t timeDepthSecs;
+   time_t expectedWaitMs;
+   time_t averageServiceUs;
+   CongestionManager::RejectionBehavior behavior;
+};
+
+class FifoCollector : public CongestionManager::FifoVisitor
+{
+   public:
+      FifoCollector(vector<FifoState>& fifos) : mFifos(fifos) {}
+
+      virtual void visit(const FifoStatsInterface& fifo,
+                         CongestionManager::RejectionBehavior behavior)
+      {
+         FifoState state;
+         state.description = fifo.getDescription();
+         state.role = fifo.getRole();
+         state.depth = fifo.getCountDepth();
+         state.timeDepthSecs = fifo.getTimeDepth();
+         state.expectedWaitMs = fifo.expectedWaitTimeMilliSec();
+         state.averageServiceUs = fifo.averageServiceTimeMicroSec();
+         state.behavior = behavior;
+         mFifos.push_back(state);
+      }
+
+   private:
+      vector<FifoState>& mFifos;
+};
+
+// Writes microseconds as decimal seconds, without rounding
+void
+encodeSeconds(DataStream& s, UInt64 micros)
+{
+   Data fraction(micros % 1000000);
+   s << micros / 1000000 << '.';
+   for(Data::size_type i = fraction.size(); i < 6; ++i)
+   {
+      s << '0';
+   }
+   s << fraction;
+}
+
+// Escapes a label value as the text format requires
+Data
+escapeLabel(const Data& value)
+{
+   Data escaped(value.size(), Data::Preallocate);
+   for(Data::size_type i = 0; i < value.size(); ++i)
+   {
+      switch(value[i])
+      {
+         case '\\':
+            escaped += "\\\\";
+            break;
+         case '"':
+            escaped += "\\\"";
+            break;
+         case '\n':
+            escaped += "\\n";
+            break;
+         default:
+            escaped += value[i];
+            break;
+      }
+   }
+   return escaped;
+}
+
+void
+encodeFamily(DataStream& s, const char* name, const char* type, const char* unit, const char* help)
+{
+   s << "# TYPE " << name << ' ' << type << '\n';
+   if(unit)
+   {
+      s << "# UNIT " << name << ' ' << unit << '\n';
+   }
+   s << "# HELP " << name << ' ' << help << '\n';
+}
+
+template<typename T>
+void
+encodeGauge(DataStream& s, const char* name, const char* unit, const char* help, T value)
+{
+   encodeFamily(s, name, "gauge", unit, help);
+   s << name << ' ' << value << '\n';
+}
+
+template<typename T>
+void
+encodeCounter(DataStream& s, const char* name, const char* help, T value)
+{
+   encodeFamily(s, name, "counter", 0, help);
+   s << name << "_total " << value << '\n';
+}
+
+void
+encodeMethodCounter(DataStream& s, const char* name, const char* help, 
+                    const unsigned int (&byMethod)[MAX_METHODS])
+{
+   encodeFamily(s, name, "counter", 0, help);
+   for(int m = 0; m < MAX_METHODS; ++m)
+   {
+      if(byMethod[m])
+      {
+         s << name << "_total{method=\"" << getMethodName(MethodTypes(m)) << "\"} " 
+           << byMethod[m] << '\n';
+      }
+   }
+}
+
+// Sums the per code counts into 1xx to 6xx
+void
+encodeResponseCounter(DataStream& s, const char* name, const char* help, 
+                      const unsigned int (&byMethodByCode)[MAX_METHODS][StatisticsMessage::Payload::MaxCode])
+{
+   encodeFamily(s, name, "counter", 0, help);
+   for(int m = 0; m < MAX_METHODS; ++m)
+   {
+      for(int codeClass = 1; codeClass * 100 < StatisticsMessage::Payload::MaxCode; ++codeClass)
+      {
+         UInt64 sum = 0;
+         for(int code = codeClass * 100; code < (codeClass + 1) * 100; ++code)
+         {
+            sum += byMethodByCode[m][code];
+         }
+         if(sum)
+         {
+            s << name << "_total{method=\"" << getMethodName(MethodTypes(m)) 
+              << "\",code=\"" << codeClass << "xx\"} " << sum << '\n';
+         }
+      }
+   }
+}
+
+// Histogram samples from a microsecond LatencyHistogram. Bucket counts are
+// those of the histogram's own buckets lying wholly under each bound, so
+// they can be a little low near a bound.
+void
+encodeHistogramSamples(DataStream& s, const char* name, const Data& labels, 
+                       const LatencyHistogram& histogram)
+{
+   const UInt64 count = histogram.count();
+   const Data separator(labels.empty() ? "" : ",");
+   for(size_t i = 0; i < sizeof(LatencyBuckets) / sizeof(LatencyBuckets[0]); ++i)
+   {
+      s << name << "_bucket{" << labels << separator << "le=\"" << LatencyBuckets[i].le << "\"} "
+        << min(histogram.countAtOrBelow(LatencyBuckets[i].micros), count) << '\n';
+   }
+   s << name << "_bucket{" << labels << separator << "le=\"+Inf\"} " << count << '\n';
+   if(labels.empty())
+   {
+      s << name << "_count " << count << '\n';
+      s << name << "_sum ";
+   }
+   else
+   {
+      s << name << "_count{" << labels << "} " << count << '\n';
+      s << name << "_sum{" << labels << "} ";
+   }
+   encodeSeconds(s, histogram.sum());
+   s << '\n';
+}
+
+const char*
+rejectionBehaviorName(CongestionManager::RejectionBehavior behavior)
+{
+   switch(behavior)
+   {
+      case CongestionManager::NORMAL:
+         return "normal";
+      case CongestionManager::REJECTING_NEW_WORK:
+         return "rejecting_new_work";
+      case CongestionManager::REJECTING_NON_ESSENTIAL:
+         return "rejecting_non_essential";
+   }
+   return "unknown";
+}
+
+}
+
+MetricsServer::MetricsServer(SipStack& stack,
+                             CongestionManager* congestionManager,
+                             const Data& realm,
+                             int port,
+                             IpVersion version,
+                             const Data& ipAddr) :
+   HttpBase(port, version, realm, ipAddr),
+   mStack(stack),
+   mCongestionManager(congestionManager),
+   mStatisticsTime(0),
+   mLastPoll(0),
+   mPollPending(false)
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+}
+
+bool
+MetricsServer::handleStatisticsMessage(StatisticsMessage& statsMessage)
+{
+   // Copy before taking the lock, so a scrape that is rendering the last
+   // copy never holds up the thread that calls us.
+   std::shared_ptr<StatisticsMessage::Payload> stats = std::make_shared<StatisticsMessage::Payload>();
+   statsMessage.loadOut(*stats);
+   {
+      Lock lock(mStatisticsMutex);
+      mStatistics = stats;
+      mStatisticsTime = Timer::getTimeMs();
+   }
+   mStatisticsUpdated.broadcast();
+   // the periodic poll never answers a scrape's request
+   return statsMessage.isRequested() && mPollPending.exchange(false);
+}
+
+MetricsServer::PayloadPtr
+MetricsServer::getStatistics(UInt64& ageMs)
+{
+   UInt64 now = Timer::getTimeMs();
+   bool poll = false;
+   {
+      Lock lock(mStatisticsMutex);
+      poll = now - mStatisticsTime >= MinPollIntervalMs && now - mLastPoll >= MinPollIntervalMs;
+   }
+
+   if(poll)
+   {
+      mLastPoll = now;
+      mPollPending = true;
+      if(!mStack.pollStatistics())
+      {
+         // statistics are not enabled; serve whatever we have
+         mPollPending = false;
+         poll = false;
+      }
+   }
+
+   Lock lock(mStatisticsMutex);
+   if(poll)
+   {
+      UInt64 deadline = now + PollWaitMs;
+      while(mStatisticsTime < now)
+      {
+         UInt64 current = Timer::getTimeMs();
+         if(current >= deadline || 
+            !mStatisticsUpdated.wait(mStatisticsMutex, (unsigned int)(deadline - current)))
+         {
+            DebugLog(<< "MetricsServer: no statistics from the stack within " << PollWaitMs << "ms");
+            break;
+         }
+      }
+   }
+   ageMs = mStatistics ? Timer::getTimeMs() - mStatisticsTime : 0;
+   return mStatistics;
+}
+
+void 
+MetricsServer::buildPage( const Data& uri,
+                          int pageNumber, 
+                          const resip::Data& pUser,
+                          const resip::Data& pPassword )
+{
+   ParseBuffer pb(uri);
+   const char* anchor = pb.skipChar('/');
+   pb.skipToChar('?');
+   Data pageName;
+   pb.data(pageName, anchor);
+
+   if(pageName != Data("metrics"))
+   {
+      setPage(resip::Data::Empty, pageNumber, 404);
+      return;
+   }
+
+   Mime type("application", "openmetrics-text");
+   type.param(UnknownParameterType("version")) = "1.0.0";
+   type.param(p_charset) = "utf-8";
+   setPage(buildMetricsPage(), pageNumber, 200, type);
+}
+
+Data
+MetricsServer::buildMetricsPage()
+{
+   UInt64 ageMs = 0;
+   PayloadPtr stats = getStatistics(ageMs);
+
+   Data page;
+   {
+      DataStream s(page);
+      if(stats)
+      {
+         buildStackMetrics(s, *stats, ageMs);
+      }
+      buildFifoMetrics(s);
+
+      encodeFamily(s, "repro_build", "info", 0, "repro version");
+      s << "repro_build_info{version=\"" << escapeLabel(Data(VersionUtils::instance().releaseVersion())) << "\"} 1\n";
+      s << "# EOF\n";
+      s.flush();
+   }
+   return page;
+}
+
+void
+MetricsServer::buildStackMetrics(DataStream& s, 
+                                 const StatisticsMessage::Payload& stats,
+                                 UInt64 ageMs)
+{
+   encodeFamily(s, "resip_statistics_age_seconds", "gauge", "seconds", 
+                "Time since the stack produced the statistics below");
+   s << "resip_statistics_age_seconds ";
+   encodeSeconds(s, ageMs * 1000);
+   s << '\n';
+
+   encodeGauge(s, "resip_tu_fifo_size", 0, "Messages waiting for the transaction users", stats.tuFifoSize);
+   encodeGauge(s, "resip_transport_fifo_size", 0, "Messages waiting in the transports, summed", stats.transportFifoSizeSum);
+   encodeGauge(s, "resip_transaction_fifo_size", 0, "Messages waiting for the transaction layer", stats.transactionFifoSize);
+   encodeGauge(s, "resip_active_timers", 0, "Transaction timers pending", stats.activeTimers);
+   encodeGauge(s, "resip_client_transactions", 0, "Client transactions in progress", stats.activeClientTransactions);
+   encodeGauge(s, "resip_server_transactions", 0, "Server transactions in progress", stats.activeServerTransactions);
+   encodeGauge(s, "resip_open_connections", 0, "Open stream transport connections", stats.openTcpConnections);
+   encodeGauge(s, "resip_connection_buffer_bytes", "bytes", "Receive buffers held by open connections", stats.connectionBufferBytes);
+
+   encodeCounter(s, "resip_connection_writes", "Stream writes that sent something", stats.connectionWrites);
+   encodeCounter(s, "resip_connection_messages_written", "Messages completed by stream writes", stats.connectionMessagesWritten);
+
+   encodeFamily(s, "resip_tls_handshakes", "counter", 0, "Completed TLS handshakes");
+   s << "resip_tls_handshakes_total{type=\"full\"} " << stats.tlsFullHandshakes << '\n';
+   s << "resip_tls_handshakes_total{type=\"resumed\"} " << stats.tlsResumedHandshakes << '\n';
+
+   encodeFamily(s, "resip_dns_cache_lookups", "counter", 0, "DNS cache lookups by outcome");
+   s << "resip_dns_cache_lookups_total{result=\"hit\"} " << stats.dnsCacheHits << '\n';
+   s << "resip_dns_cache_lookups_total{result=\"miss\"} " << stats.dnsCacheMisses << '\n';
+   s << "resip_dns_cache_lookups_total{result=\"stale\"} " << stats.dnsCacheStaleHits << '\n';
+   encodeCounter(s, "resip_dns_prefetches", "DNS records refreshed ahead of expiry", stats.dnsPrefetches);
+
+   encodeMethodCounter(s, "resip_requests_sent", "Requests sent, including retransmissions", stats.requestsSentByMethod);
+   encodeMethodCounter(s, "resip_requests_retransmitted", "Request retransmissions", stats.requestsRetransmittedByMethod);
+   encodeMethodCounter(s, "resip_requests_received", "Requests received", stats.requestsReceivedByMethod);
+   encodeResponseCounter(s, "resip_responses_sent", "Responses sent, including retransmissions", stats.responsesSentByMethodByCode);
+   encodeResponseCounter(s, "resip_responses_retransmitted", "Response retransmissions", stats.responsesRetransmittedByMethodByCode);
+   encodeResponseCounter(s, "resip_responses_received", "Responses received", stats.responsesReceivedByMethodByCode);
+
+   encodeFamily(s, "resip_transaction_setup_seconds", "histogram", "seconds", 
+                "Time from creating a client transaction to its first response");
+   encodeHistogramSamples(s, "resip_transaction_setup_seconds", Data::Empty, stats.transactionSetupTime);
+
+   encodeFamily(s, "resip_response_time_seconds", "histogram", "seconds", 
+                "Time from creating a client transaction to its final response");
+   for(int m = 0; m < MAX_METHODS; ++m)
+   {
+      if(stats.responseTimeByMethod[m].count())
+      {
+         encodeHistogramSamples(s, "resip_response_time_seconds", 
+                                "method=\"" + getMethodName(MethodTypes(m)) + "\"",
+                                stats.responseTimeByMethod[m]);
+      }
+   }
+
+   encodeFamily(s, "resip_fifo_dwell_seconds", "histogram", "seconds", 
+                "Time from reading a message off the wire to the transaction layer taking it");
+   encodeHistogramSamples(s, "resip_fifo_dwell_seconds", Data::Empty, stats.fifoDwellTime);
+}
+
+void
+MetricsServer::buildFifoMetrics(DataStream& s)
+{
+   if(!mCongestionManager)
+   {
+      return;
+   }
+
+   vector<FifoState> fifos;
+   FifoCollector collector(fifos);
+   mCongestionManager->visitFifos(collector);
+
+   vector<Data> labels;
+   labels.reserve(fifos.size());
+   for(vector<FifoState>::const_iterator i = fifos.begin(); i != fifos.end(); ++i)
+   {
+      labels.push_back("fifo=\"" + escapeLabel(i->description) + "\",role=\"" + Data(i->role) + "\"");
+   }
+
+   encodeFamily(s, "resip_fifo_depth", "gauge", 0, "Messages in each congestion managed fifo");
+   for(size_t i = 0; i < fifos.size(); ++i)
+   {
+      s << "resip_fifo_depth{" << labels[i] << "} " << fifos[i].depth << '\n';
+   }
+
+   encodeFamily(s, "resip_fifo_time_depth_seconds", "gauge", "seconds", 
+                "Age difference between the oldest and youngest message in each fifo");
+   for(size_t i = 0; i < fifos.size(); ++i)
+   {
+      s << "resip_fifo_time_depth_seconds{" << labels[i] << "} " << fifos[i].timeDepthSecs << '\n';
+   }
+
+   encodeFamily(s, "resip_fifo_expected_wait_seconds", "gauge", "seconds", 
+                "Expected time to service everything in each fifo");
+   for(size_t i = 0; i < fifos.size(); ++i)
+   {
+      s << "resip_fifo_expected_wait_seconds{" << labels[i] << "} ";
+      encodeSeconds(s, UInt64(fifos[i].expectedWaitMs) * 1000);
+      s << '\n';
+   }
+
+   encodeFamily(s, "resip_fifo_average_service_seconds", "gauge", "seconds", 
+                "Average time to service one message from each fifo");
+   for(size_t i = 0; i < fifos.size(); ++i)
+   {
+      s << "resip_fifo_average_service_seconds{" << labels[i] << "} ";
+      encodeSeconds(s, UInt64(fifos[i].averageServiceUs));
+      s << '\n';
+   }
+
+   static const CongestionManager::RejectionBehavior behaviors[] = 
+   {
+      CongestionManager::NORMAL,
+      CongestionManager::REJECTING_NEW_WORK,
+      CongestionManager::REJECTING_NON_ESSENTIAL
+   };
+   encodeFamily(s, "resip_fifo_congestion_state", "stateset", 0, 
+                "What the congestion manager is rejecting on behalf of each fifo");
+   for(size_t i = 0; i < fifos.size(); ++i)
+   {
+      for(size_t b = 0; b < sizeof(behaviors) / sizeof(behaviors[0]); ++b)
+      {
+         s << "resip_fifo_congestion_state{" << labels[i] 
+           << ",resip_fifo_congestion_state=\"" << rejectionBehaviorName(behaviors[b]) << "\"} "
+           << (fifos[i].behavior == behaviors[b] ? 1 : 0) << '\n';
+      }
+   }
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
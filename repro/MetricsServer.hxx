@@ -0,0 +1,130 @@
+#if !defined(REPRO_METRICSSERVER_HXX)
+#define REPRO_METRICSSERVER_HXX 
+
+#include <atomic>
+#include <memory>
+
+#include "rutil/Data.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/Condition.hxx"
+#include "rutil/TransportType.hxx"
+#include "resip/stack/StatisticsMessage.hxx"
+#include "repro/HttpBase.hxx"
+
+namespace resip
+{
+class SipStack;
+class CongestionManager;
+class DataStream;
+}
+
+namespace repro
+{
+
+/**
+   Serves the stack statistics, and the state of the fifos watched by the
+   congestion manager, as an OpenMetrics text page at /metrics for
+   Prometheus and compatible scrapers.
+
+   The page is rendered on the thread that calls process(), from a copy of
+   the last StatisticsMessage the stack produced; a scrape asks the stack
+   for a fresh one and waits briefly for it, but never touches the
+   transaction layer's state directly.
+*/
+class MetricsServer : public HttpBase
+{
+   public:
+      MetricsServer(resip::SipStack& stack,
+                    resip::CongestionManager* congestionManager,
+                    const resip::Data& realm,
+                    int port=9090,
+                    resip::IpVersion version=resip::V4,
+                    const resip::Data& ipAddr = resip::Data::Empty);
+      virtual ~MetricsServer();
+
+      /** Takes a copy of the statistics for the next scrape. Called from the
+          stack's external statistics handler. Returns true if the message
+          answers a poll this server asked for, in which case it need not be
+          handled any further; periodic polls always return false. */
+      bool handleStatisticsMessage(resip::StatisticsMessage& statsMessage);
+
+   protected:
+      virtual void buildPage( const resip::Data& uri, 
+                              int pageNumber,
+                              const resip::Data& user,
+                              const resip::Data& password);
+
+   private:
+      typedef std::shared_ptr<const resip::StatisticsMessage::Payload> PayloadPtr;
+
+      PayloadPtr getStatistics(UInt64& ageMs);
+      resip::Data buildMetricsPage();
+      void buildStackMetrics(resip::DataStream& s, 
+                             const resip::StatisticsMessage::Payload& stats,
+                             UInt64 ageMs);
+      void buildFifoMetrics(resip::DataStream& s);
+
+      resip::SipStack& mStack;
+      resip::CongestionManager* mCongestionManager;
+
+      resip::Mutex mStatisticsMutex;
+      resip::Condition mStatisticsUpdated;
+      PayloadPtr mStatistics;
+      UInt64 mStatisticsTime; // when mStatistics arrived, ms
+      UInt64 mLastPoll; // only used by the thread calling process()
+      std::atomic<bool> mPollPending;
+};
+
+}
+
+#endif  
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -62,6 +62,8 @@
 #include "repro/ReproVersion.hxx"
 #include "repro/WebAdmin.hxx"
 #include "repro/WebAdminThread.hxx"
+#include "repro/MetricsServer.hxx"
+#include "repro/MetricsServerThread.hxx"
 #include "repro/Registrar.hxx"
 #include "repro/ReproAuthenticatorFactory.hxx"
 #include "repro/ReproServerAuthManager.hxx"
@@ -92,6 +94,7 @@
 #if defined(USE_SSL)
 #include "repro/stateAgents/CertServer.hxx"
 #include "resip/stack/ssl/Security.hxx"
+#include "resip/stack/ssl/TlsBaseTransport.hxx"
 #define DEFAULT_TLS_METHOD SecurityTypes::SSLv23
 #endif
 
@@ -251,6 +254,7 @@ ReproRunner::ReproRunner()
    , mBaboons(0)
    , mProxy(0)
    , mWebAdminThread(0)
+   , mMetricsServerThread(0)
    , mRegistrar(0)
    , mPresenceServer(0)
    , mDum(0)
@@ -377,6 +381,9 @@ ReproRunner::run(int argc, char** argv)
       return false;
    }
 
+   // Create the metrics exporter and its thread, if configured
+   createMetricsServer();
+
    // Create reg sync components if required
    createRegSync();
 
@@ -403,6 +410,10 @@ ReproRunner::run(int argc, char** argv)
    {
       mWebAdminThread->run();
    }
+   if(mMetricsServerThread)
+   {
+      mMetricsServerThread->run();
+   }
    if(!mRestarting && mCommandServerThread)
    {
       mCommandServerThread->run();
@@ -435,6 +446,10 @@ ReproRunner::shutdown()
    {
       mWebAdminThread->shutdown();
    }
+   if(mMetricsServerThread)
+   {
+      mMetricsServerThread->shutdown();
+   }
    if(mDumThread)
    {
       mDumThread->shutdown();
@@ -465,10 +480,21 @@ ReproRunner::shutdown()
       mSipStack->shutdownAndJoinThreads();
    }
    mStackThread->join();
+
+   // Keep what we resolved for the next run, see loadDnsSnapshot below
+   Data dnsSnapshotFile = mProxyConfig->getConfigData("DNSSnapshotFile", "");
+   if(!dnsSnapshotFile.empty())
+   {
+      mSipStack->saveDnsSnapshot(dnsSnapshotFile);
+   }
    if(mWebAdminThread) 
    {
       mWebAdminThread->join();
    }
+   if(mMetricsServerThread)
+   {
+      mMetricsServerThread->join();
+   }
    if(mDumThread)
    {
       mDumThread->join();
@@ -564,6 +590,12 @@ ReproRunner::cleanupObjects()
       delete (*it);
    }
    mWebAdminList.clear();
+   delete mMetricsServerThread; mMetricsServerThread = 0;
+   for(std::list<MetricsServer*>::iterator it = mMetricsServerList.begin(); it != mMetricsServerList.end(); it++)
+   {
+      delete (*it);
+   }
+   mMetricsServerList.clear();
    delete mProxy; mProxy = 0;
    delete mBaboons; mBaboons = 0;
    delete mLemurs; mLemurs = 0;
@@ -688,6 +720,10 @@ ReproRunner::createSipStack()
    // Set TCP Connect timeout 
    resip::Timer::TcpConnectTimeout = mProxyConfig->getConfigUnsignedLong("TCPConnectTimeout", 10000);  // Default to 10 seconds
 
+   // Let producers add to the stack's and TUs' fifos without locking; this
+   // must be decided before any fifos are created
+   FifoConfig::setLockFreeDefault(mProxyConfig->getConfigBool("LockFreeFifos", false));
+
    // Set DNS Greylist Duration
    resip::TransactionState::DnsGreylistDurationMs = mProxyConfig->getConfigUnsignedLong("DNSGreylistDuration", 1800000);  // Default to 30mins
 
@@ -707,6 +743,13 @@ ReproRunner::createSipStack()
          "OpenSSLCTXSetOptions", BaseSecurity::OpenSSLCTXSetOptions);
    setOpenSSLCTXOptionsFromConfig(
          "OpenSSLCTXClearOptions", BaseSecurity::OpenSSLCTXClearOptions);
+   BaseSecurity::TlsSessionCacheSize = mProxyConfig->getConfigUnsignedLong("TLSSessionCacheSize", BaseSecurity::TlsSessionCacheSize);
+   BaseSecurity::TlsSessionLifetime = mProxyConfig->getConfigUnsignedLong("TLSSessionLifetime", BaseSecurity::TlsSessionLifetime);
+   BaseSecurity::TlsSessionTickets = mProxyConfig->getConfigBool("TLSSessionTickets", BaseSecurity::TlsSessionTickets);
+   BaseSecurity::TlsTicketKeyRotation = mProxyConfig->getConfigUnsignedLong("TLSTicketKeyRotation", BaseSecurity::TlsTicketKeyRotation);
+   BaseSecurity::TlsClientSessionCacheSize = mProxyConfig->getConfigUnsignedLong("TLSClientSessionCacheSize", BaseSecurity::TlsClientSessionCacheSize);
+   TlsBaseTransport::HandshakeThreads = mProxyConfig->getConfigUnsignedLong("TLSHandshakeThreads", TlsBaseTransport::HandshakeThreads);
+   TlsBaseTransport::MaxPendingHandshakes = mProxyConfig->getConfigUnsignedLong("TLSMaxPendingHandshakes", TlsBaseTransport::MaxPendingHandshakes);
    Security::CipherList cipherList = Security::StrongestSuite;
    Data ciphers = mProxyConfig->getConfigData("OpenSSLCipherList", Data::Empty);
    if(!ciphers.empty())
@@ -777,13 +820,18 @@ ReproRunner::createSipStack()
 
    // Create the SipStack Object
    resip_assert(!mSipStack);
-   mSipStack = new SipStack(security,
-                            dnsServers,
-                            mAsyncProcessHandler,
-                            /*stateless*/false,
-                            /*socketFunc*/0,
-                            compression,
-                            mFdPollGrp);
+   SipStackOptions options;
+   options.mSecurity = security;
+   options.mExtraNameserverList = &dnsServers;
+   options.mAsyncProcessHandler = mAsyncProcessHandler;
+   options.mCompression = compression;
+   options.mPollGrp = mFdPollGrp;
+   // Only useful with ThreadedStack, where each shard gets its own thread
+   options.mTransactionControllerShards = mProxyConfig->getConfigUnsignedLong("TransactionControllerShards", 1);
+   options.mGatheredEncoding = mProxyConfig->getConfigBool("GatheredEncoding", false);
+   // Each DNS shard gets its own resolver channel and DnsThread, sharing one cache
+   options.mDnsShards = mProxyConfig->getConfigUnsignedLong("DNSShards", 1);
+   mSipStack = new SipStack(options);
 
    // Set any enum suffixes from configuration
    std::vector<Data> enumSuffixes;
@@ -806,6 +854,23 @@ ReproRunner::createSipStack()
       mSipStack->setEnumDomains(enumDomains);
    }
 
+   // Refresh popular DNS cache entries before they expire, and/or serve
+   // expired ones while they are being refreshed
+   int dnsPrefetchWindow = mProxyConfig->getConfigInt("DNSPrefetchWindow", 0);
+   int dnsStaleGracePeriod = mProxyConfig->getConfigInt("DNSStaleGracePeriod", 0);
+   if (dnsPrefetchWindow > 0 || dnsStaleGracePeriod > 0)
+   {
+      mSipStack->getDnsStub().setDnsCachePrefetch(dnsPrefetchWindow, dnsStaleGracePeriod);
+   }
+
+   // Start with the DNS cache, vips and blacklists the last run saved, so the
+   // first requests after a restart do not all wait on resolution
+   Data dnsSnapshotFile = mProxyConfig->getConfigData("DNSSnapshotFile", "");
+   if (!dnsSnapshotFile.empty())
+   {
+      mSipStack->loadDnsSnapshot(dnsSnapshotFile);
+   }
+
    // Add External Stats handler
    mSipStack->setExternalStatsHandler(this);
 
@@ -816,7 +881,10 @@ ReproRunner::createSipStack()
    {
       int capturePort = mProxyConfig->getConfigInt("CapturePort", 9060);
       int captureAgentID = mProxyConfig->getConfigInt("CaptureAgentID", 2001);
-      auto agent = std::make_shared<HepAgent>(captureHost, capturePort, captureAgentID);
+      unsigned int captureQueueSize = mProxyConfig->getConfigUnsignedLong("CaptureQueueSize", HepAgent::DefaultMaxQueued);
+      auto agent = std::make_shared<HepAgent>(captureHost, capturePort, captureAgentID, captureQueueSize);
+      agent->setSampling(mProxyConfig->getConfigUnsignedLong("CaptureSampling", 1));
+      agent->setRateLimit(mProxyConfig->getConfigUnsignedLong("CaptureRateLimit", 0));
       mSipStack->setTransportSipMessageLoggingHandler(std::make_shared<HEPSipMessageLoggingHandler>(agent));
    }
    else if(mProxyConfig->getConfigBool("EnableSipMessageLogging", false))
@@ -866,6 +934,7 @@ ReproRunner::createSipStack()
       }
       ConnectionManager::EnableAgressiveGc = true;
    }
+   ConnectionManager::PoolReceiveBuffers = mProxyConfig->getConfigBool("TCPPoolReceiveBuffers", false);
 
    // Decide whether or not to add rport to the Via header
    InteropHelper::setRportEnabled(mProxyConfig->getConfigBool("AddViaRport", true));
@@ -1414,6 +1483,70 @@ ReproRunner::createWebAdmin()
    return false;
 }
 
+void
+ReproRunner::createMetricsServer()
+{
+   resip_assert(mMetricsServerList.empty());
+   resip_assert(!mMetricsServerThread);
+
+   std::vector<resip::Data> metricsBindAddresses;
+   mProxyConfig->getConfigValue("MetricsBindAddress", metricsBindAddresses);
+   int metricsPort = mProxyConfig->getConfigInt("MetricsPort", 0);
+
+   if(metricsPort != 0)
+   {
+      if(metricsBindAddresses.empty())
+      {
+          if(mUseV4)
+          {
+             metricsBindAddresses.push_back("0.0.0.0");
+          }
+          if(mUseV6)
+          {
+             metricsBindAddresses.push_back("::");
+          }
+      }
+
+      for(std::vector<resip::Data>::iterator it = metricsBindAddresses.begin(); it != metricsBindAddresses.end(); it++)
+      {
+         if(mUseV4 && DnsUtil::isIpV4Address(*it))
+         {
+            MetricsServer* metricsServerV4 = new MetricsServer(*mSipStack, mCongestionManager, mHttpRealm, metricsPort, V4, *it);
+
+            if(metricsServerV4->isSane())
+            {
+               mMetricsServerList.push_back(metricsServerV4);
+            }
+            else
+            {
+               CritLog(<<"Failed to start MetricsServerV4");
+               delete metricsServerV4;
+            }
+         }
+
+         if(mUseV6 && DnsUtil::isIpV6Address(*it))
+         {
+            MetricsServer* metricsServerV6 = new MetricsServer(*mSipStack, mCongestionManager, mHttpRealm, metricsPort, V6, *it);
+
+            if(metricsServerV6->isSane())
+            {
+               mMetricsServerList.push_back(metricsServerV6);
+            }
+            else
+            {
+               CritLog(<<"Failed to start MetricsServerV6");
+               delete metricsServerV6;
+            }
+         }
+      }
+
+      if(!mMetricsServerList.empty())
+      {
+         mMetricsServerThread = new MetricsServerThread(mMetricsServerList);
+      }
+   }
+}
+
 void
 ReproRunner::createRegSync()
 {
@@ -1664,6 +1797,8 @@ ReproRunner::addTransports(bool& allTransportsSpecifyRecordRoute)
          // Transport1TlsClientVerification = None
          // Transport1RecordRouteUri = sip:sipdomain.com;transport=TLS
          // Transport1RcvBufLen = 2000
+         // Transport1BatchDepth = 16
+         // Transport1Shards = 4
 
          allTransportsSpecifyRecordRoute = true;
 
@@ -1712,6 +1847,8 @@ ReproRunner::addTransports(bool& allTransportsSpecifyRecordRoute)
                Data tlsPrivateKey = tc.getConfigData("TlsPrivateKey", Data::Empty);
                Data tlsPrivateKeyPassPhrase = tc.getConfigData("TlsPrivateKeyPassPhrase", Data::Empty);
                SecurityTypes::TlsClientVerificationMode cvm = tc.getConfigClientVerificationMode("TlsClientVerification", SecurityTypes::None);
+               unsigned int numShards = tc.getConfigUnsignedLong("Shards", 1);
+               unsigned int batchDepth = tc.getConfigUnsignedLong("BatchDepth", 1);
                SecurityTypes::SSLType sslType = SecurityTypes::NoSSL;
 #ifdef USE_SSL
                sslType = tc.getConfigSSLType("TlsConnectionMethod", DEFAULT_TLS_METHOD);
@@ -1747,7 +1884,10 @@ ReproRunner::addTransports(bool& allTransportsSpecifyRecordRoute)
                                  tlsCertificate, tlsPrivateKey,
                                  cvm,          // tls client verification mode
                                  useEmailAsSIP,
-                                 basicWsConnectionValidator, wsCookieContextFactory);
+                                 basicWsConnectionValidator, wsCookieContextFactory,
+                                 Data::Empty,  // netns
+                                 numShards,
+                                 batchDepth);
 
                if (t)
                {
@@ -2045,7 +2185,17 @@ ReproRunner::operator()(resip::StatisticsMessage &statsMessage)
    {
        (*it)->handleStatisticsMessage(statsMessage);
    }
-   return true;
+
+   // Statistics polled for by a metrics scrape are not logged
+   bool polledForMetrics = false;
+   for(std::list<MetricsServer*>::iterator it = mMetricsServerList.begin(); it != mMetricsServerList.end(); it++)
+   {
+       if((*it)->handleStatisticsMessage(statsMessage))
+       {
+          polledForMetrics = true;
+       }
+   }
+   return !polledForMetrics;
 }
 
 /* ====================================================================
@@ -35,6 +35,8 @@ class ProcessorChain;
 class Proxy;
 class WebAdmin;
 class WebAdminThread;
+class MetricsServer;
+class MetricsServerThread;
 class Registrar;
 class CertServer;
 class RegSyncClient;
@@ -73,6 +75,7 @@ protected:
    virtual bool createProxy();
    virtual void populateRegistrations();
    virtual bool createWebAdmin();
+   virtual void createMetricsServer();
    virtual void createAuthenticatorFactory();
    virtual void createDialogUsageManager();
    virtual void createRegSync();
@@ -113,6 +116,8 @@ protected:
    Proxy* mProxy;
    std::list<WebAdmin*> mWebAdminList;
    WebAdminThread* mWebAdminThread;
+   std::list<MetricsServer*> mMetricsServerList;
+   MetricsServerThread* mMetricsServerThread;
    Registrar* mRegistrar;
    PresenceServer* mPresenceServer;
    resip::DialogUsageManager* mDum;
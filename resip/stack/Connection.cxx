@@ -37,9 +37,11 @@ Connection::Connection(Transport* transport,const Tuple& who, Socket socket,
    : ConnectionBase(transport,who,compression),
      mFirstWriteAfterConnectedPending(false),
      mInWritable(false),
+     mPollingSuspended(false),
      mFlowTimerEnabled(false),
      mPollItemHandle(0),
-     mIsServer(isServer)
+     mIsServer(isServer),
+     mReceiveBufferBytes(0)
 {
    mWho.mFlowKey=(FlowKey)socket;
    InfoLog (<< "Connection::Connection: new connection created to who: " << mWho << ", is server = " << mIsServer);
@@ -64,6 +66,11 @@ Connection::~Connection()
       // remove first then close, since conn manager may need socket
       closeSocket(mWho.mFlowKey);
    }
+   if(ConnectionBase::transport())
+   {
+      releaseReceiveBuffer();
+      getConnectionManager().adjustReceiveBufferBytes(-(Int64)mReceiveBufferBytes);
+   }
 }
 
 void
@@ -142,6 +149,12 @@ Connection::performWrite()
 
    const Data& sigcompId = mOutstandingSends.front()->sigcompId;
 
+   if(mSendingTransmissionFormat != Uncompressed)
+   {
+      // only plain writes know how to send a gathered message
+      mOutstandingSends.front()->flatten();
+   }
+
    if(mSendingTransmissionFormat == Unknown)
    {
       if (sigcompId.size() > 0 && mCompression.isEnabled())
@@ -259,6 +272,16 @@ Connection::performWrite()
       }
    }
 
+#ifndef WIN32
+   // Plain TCP and TLS need nothing done to a message before it goes out,
+   // so whatever else is queued behind this one can go with it.
+   if (mSendingTransmissionFormat == Uncompressed &&
+       (mOutstandingSends.size() > 1 || mOutstandingSends.front()->isGathered()))
+   {
+      return performGatheredWrite();
+   }
+#endif
+
    const Data& data = mOutstandingSends.front()->data;
    int nBytes = write(data.data() + mSendPos,int(data.size() - mSendPos));
 
@@ -285,11 +308,111 @@ Connection::performWrite()
       {
          mSendPos = 0;
          removeFrontOutstandingSend();
+         getConnectionManager().countWrite(1);
+      }
+      else
+      {
+         getConnectionManager().countWrite(0);
       }
       return bytesWritten;
    }
 }
 
+#ifndef WIN32
+int
+Connection::performGatheredWrite()
+{
+   struct iovec iov[MaxGatheredBuffers];
+   int count = 0;
+   size_t skip = mSendPos;
+
+   for (std::list<SendData*>::const_iterator it = mOutstandingSends.begin();
+        it != mOutstandingSends.end(); ++it)
+   {
+      const SendData& send = **it;
+      if (send.command != SendData::NoCommand)
+      {
+         // performWrite() must see it at the front
+         break;
+      }
+
+      size_t pieces = send.isGathered() ? send.pieces.size() : 1;
+      if (count + pieces > (size_t)MaxGatheredBuffers)
+      {
+         // a message's pieces never exceed SendData::MaxPieces, so the
+         // front message always fits
+         resip_assert(count > 0);
+         break;
+      }
+
+      if (!send.isGathered())
+      {
+         if (skip >= send.data.size())
+         {
+            skip -= send.data.size();
+            continue;
+         }
+         iov[count].iov_base = (void*)(send.data.data() + skip);
+         iov[count].iov_len = send.data.size() - skip;
+         ++count;
+         skip = 0;
+         continue;
+      }
+
+      for (std::vector<SendData::Piece>::const_iterator i = send.pieces.begin();
+           i != send.pieces.end(); ++i)
+      {
+         if (skip >= i->length)
+         {
+            skip -= i->length;
+            continue;
+         }
+         iov[count].iov_base = (void*)(send.pieceData(*i) + skip);
+         iov[count].iov_len = i->length - skip;
+         ++count;
+         skip = 0;
+      }
+   }
+   resip_assert(count > 0);
+
+   int nBytes = writeGathered(iov, count);
+   if (nBytes < 0)
+   {
+      InfoLog(<< "Write failed on socket: " << this->getSocket() << ", closing connection");
+      return -1;
+   }
+   else if (nBytes == 0)
+   {
+      return 0;
+   }
+
+   // retire every message the write finished
+   size_t written = mSendPos + (size_t)nBytes;
+   unsigned int completed = 0;
+   while (!mOutstandingSends.empty() &&
+          mOutstandingSends.front()->command == SendData::NoCommand)
+   {
+      size_t size = mOutstandingSends.front()->size();
+      if (written < size)
+      {
+         break;
+      }
+      written -= size;
+      removeFrontOutstandingSend();
+      ++completed;
+   }
+   mSendPos = (Data::size_type)written;
+   getConnectionManager().countWrite(completed);
+   return nBytes;
+}
+
+int
+Connection::writeGathered(const struct iovec* iov, int /* count */)
+{
+   return write((const char*)iov[0].iov_base, (int)iov[0].iov_len);
+}
+#endif
+
 
 bool 
 Connection::performWrites(unsigned int max)
@@ -319,6 +442,26 @@ Connection::ensureWritable()
    }
 }
 
+void
+Connection::suspendPolling()
+{
+   if(!mPollingSuspended)
+   {
+      getConnectionManager().suspendPolling(this);
+      mPollingSuspended = true;
+   }
+}
+
+void
+Connection::resumePolling()
+{
+   if(mPollingSuspended)
+   {
+      mPollingSuspended = false;
+      getConnectionManager().resumePolling(this);
+   }
+}
+
 ConnectionManager&
 Connection::getConnectionManager() const
 {
@@ -337,6 +480,10 @@ resip::operator<<(EncodeStream& strm, const resip::Connection& c)
 int
 Connection::read()
 {
+   if (ConnectionManager::PoolReceiveBuffers)
+   {
+      expandReceiveBuffer();
+   }
    std::pair<char*, size_t> writePair = getWriteBuffer();
    size_t bytesToRead = resipMin(writePair.second, 
                                  static_cast<size_t>(Connection::ChunkSize));
@@ -439,9 +586,49 @@ Connection::performReads(unsigned int max)
       delete this;
       return false;
    }
+   if (bytesRead == 0 && ConnectionManager::PoolReceiveBuffers)
+   {
+      // socket drained; don't hold a buffer until the next message arrives
+      trimReceiveBuffer();
+   }
+   updateReceiveBufferBytes();
    return true;
 }
 
+char*
+Connection::allocateReceiveBuffer()
+{
+   if (ConnectionManager::PoolReceiveBuffers && ConnectionBase::transport())
+   {
+      return getConnectionManager().takeReceiveBuffer();
+   }
+   return ConnectionBase::allocateReceiveBuffer();
+}
+
+void
+Connection::freeReceiveBuffer(char* buffer)
+{
+   if (ConnectionManager::PoolReceiveBuffers && ConnectionBase::transport())
+   {
+      getConnectionManager().releaseReceiveBuffer(buffer);
+   }
+   else
+   {
+      ConnectionBase::freeReceiveBuffer(buffer);
+   }
+}
+
+void
+Connection::updateReceiveBufferBytes()
+{
+   size_t size = getReceiveBufferSize();
+   if (size != mReceiveBufferBytes && ConnectionBase::transport())
+   {
+      getConnectionManager().adjustReceiveBufferBytes((Int64)size - (Int64)mReceiveBufferBytes);
+      mReceiveBufferBytes = size;
+   }
+}
+
 void
 Connection::enableFlowTimer()
 {
@@ -2,6 +2,9 @@
 #define RESIP_Connection_hxx
 
 #include <list>
+#ifndef WIN32
+#include <sys/uio.h>
+#endif
 
 #include "resip/stack/ConnectionBase.hxx"
 //#include "rutil/Fifo.hxx"
@@ -109,18 +112,44 @@ class Connection : public ConnectionBase,
       virtual int read(char* /* buffer */, const int /* count */) { return 0; }
       /// pure virtual, but need concrete Connection for book-ends of lists
       virtual int write(const char* /* buffer */, const int /* count */) { return 0; }
+#ifndef WIN32
+      /** Writes the count buffers in order, as a write() of their
+          concatenation would, and returns as write() does. Used to send
+          several queued messages with one system call; by default only
+          the first buffer is written. */
+      virtual int writeGathered(const struct iovec* iov, int count);
+#endif
       virtual void onDoubleCRLF();
       virtual void onSingleCRLF();
 
+      /// drawn from the ConnectionManager if ConnectionManager::PoolReceiveBuffers
+      virtual char* allocateReceiveBuffer();
+      virtual void freeReceiveBuffer(char* buffer);
+
       /* callback method of FdPollItemIf */
       virtual void processPollEvent(FdPollEventMask mask);
 
       virtual void invokeAfterSocketCreationFunc() const;
 
+      /** Stop watching the socket until resumePolling(), while something
+          other than the transport thread is working on the connection.
+          Writes requested meanwhile are remembered and picked up on resume. */
+      void suspendPolling();
+      void resumePolling();
+      bool isPollingSuspended() const { return mPollingSuspended; }
+
    private:
       ConnectionManager& getConnectionManager() const;
       void removeFrontOutstandingSend();
+#ifndef WIN32
+      /// most buffers handed to one writeGathered()
+      enum { MaxGatheredBuffers = 64 };
+      int performGatheredWrite();
+#endif
+      /// bring the ConnectionManager's receive buffer byte count up to date
+      void updateReceiveBufferBytes();
       bool mInWritable;
+      bool mPollingSuspended;
       bool mFlowTimerEnabled;
       FdPollItemHandle mPollItemHandle;
       
@@ -131,6 +160,8 @@ class Connection : public ConnectionBase,
       Connection(const Connection&);
       Connection& operator=(const Connection&);
       bool mIsServer;
+      /// receive buffer size last added to the ConnectionManager's count
+      size_t mReceiveBufferBytes;
 };
 
 EncodeStream& 
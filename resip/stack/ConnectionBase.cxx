@@ -5,6 +5,7 @@
 #include <memory>
 
 #include "rutil/Logger.hxx"
+#include "rutil/DeferredLog.hxx"
 #include "resip/stack/ConnectionBase.hxx"
 #include "resip/stack/WsConnectionBase.hxx"
 #include "resip/stack/SipMessage.hxx"
@@ -153,8 +154,7 @@ ConnectionBase::preparseNewBytes(int bytesRead)
             }
             else
             {
-               delete [] mBuffer;
-               mBuffer = 0;
+               releaseReceiveBuffer();
                return true;
             }
          }
@@ -170,8 +170,7 @@ ConnectionBase::preparseNewBytes(int bytesRead)
             }
             else
             {
-               delete [] mBuffer;
-               mBuffer = 0;
+               releaseReceiveBuffer();
                return true;
             }
          }
@@ -179,7 +178,7 @@ ConnectionBase::preparseNewBytes(int bytesRead)
          resip_assert(mTransport);
          mMessage = new SipMessage(&mTransport->getTuple());
          
-         DebugLog(<< "ConnectionBase::process setting source " << mWho);
+         DeferredDebugLog("ConnectionBase::process setting source {}", mWho);
          mMessage->setSource(mWho);
          mMessage->setTlsDomain(mTransport->tlsDomain());
 
@@ -271,7 +270,7 @@ ConnectionBase::preparseNewBytes(int bytesRead)
             return true;
          }
 
-         mMessage->addBuffer(mBuffer);
+         mMessage->addBuffer(mBuffer, mBufferSize);
          mBuffer=0;
 
          if (scanChunkResult == MsgHeaderScanner::scrNextChunk)
@@ -476,7 +475,7 @@ ConnectionBase::preparseNewBytes(int bytesRead)
             int overHang = mBufferPos - (int)contentLength;
             char *overHangStart = mBuffer + contentLength;
 
-            mMessage->addBuffer(mBuffer);
+            mMessage->addBuffer(mBuffer, mBufferSize);
             mMessage->setBody(mBuffer, (UInt32)contentLength);
             mConnState = NewMessage;
             mBuffer = 0;
@@ -554,7 +553,7 @@ ConnectionBase::preparseNewBytes(int bytesRead)
             char* newBuffer = 0;
             try
             {
-               newBuffer=new char[newSize];
+               newBuffer=MsgHeaderScanner::allocateBuffer((int)newSize);
             }
             catch(std::bad_alloc&)
             {
@@ -819,6 +818,8 @@ ConnectionBase::wsProcessData(int bytesRead)
          // sending a keep alive reply now
          StackLog(<<"got a SIP ping embedded in WebSocket frame, replying");
          onDoubleCRLF();
+         // the buffer is borrowed and no SipMessage takes it over
+         delete [] msg->data();
          msg = mWsFrameExtractor.processBytes(0, 0, dropConnection);
          continue;
       }
@@ -850,7 +851,7 @@ ConnectionBase::wsProcessData(int bytesRead)
       Data::size_type msg_len = msg->size();
       // cast permitted, as it is borrowed:
       char *sipBuffer = (char *)msg->data();
-      mMessage->addBuffer(sipBuffer);
+      mMessage->addBuffer(sipBuffer, msg_len);
       mMsgHeaderScanner.prepareForMessage(mMessage);
       char *unprocessedCharPtr;
       if (mMsgHeaderScanner.scanChunk(sipBuffer,
@@ -936,7 +937,7 @@ ConnectionBase::decompressNewBytes(int bytesRead)
 
     char *sipBuffer = new char[bytesUncompressed];
     memmove(sipBuffer, uncompressed, bytesUncompressed);
-    mMessage->addBuffer(sipBuffer);
+    mMessage->addBuffer(sipBuffer, bytesUncompressed);
     mMsgHeaderScanner.prepareForMessage(mMessage);
     char *unprocessedCharPtr;
     if (mMsgHeaderScanner.scanChunk(sipBuffer,
@@ -1046,11 +1047,18 @@ ConnectionBase::getWriteBuffer()
       {
          DebugLog (<< "Creating buffer for " << *this);
 
-         mBuffer = MsgHeaderScanner::allocateBuffer(ConnectionBase::ChunkSize);
+         mBuffer = allocateReceiveBuffer();
          mBufferSize = ConnectionBase::ChunkSize;
       }
       mBufferPos = 0;
    }
+   else if (!mBuffer)
+   {
+      // released by trimReceiveBuffer() while between messages
+      mBuffer = allocateReceiveBuffer();
+      mBufferSize = ConnectionBase::ChunkSize;
+      mBufferPos = 0;
+   }
    return getCurrentWriteBuffer();
 }
 
@@ -1083,6 +1091,75 @@ ConnectionBase::getWriteBufferForExtraBytes(int bytesRead, int extraBytes)
    }
 }
             
+char*
+ConnectionBase::allocateReceiveBuffer()
+{
+   return MsgHeaderScanner::allocateBuffer(ConnectionBase::ChunkSize);
+}
+
+void
+ConnectionBase::freeReceiveBuffer(char* buffer)
+{
+   delete [] buffer;
+}
+
+void
+ConnectionBase::expandReceiveBuffer()
+{
+   if (mBuffer && mBufferPos == mBufferSize)
+   {
+      size_t size = mBufferPos + ConnectionBase::ChunkSize;
+      char* buffer = MsgHeaderScanner::allocateBuffer((int)size);
+      memcpy(buffer, mBuffer, mBufferPos);
+      delete [] mBuffer;
+      mBuffer = buffer;
+      mBufferSize = size;
+   }
+}
+
+void
+ConnectionBase::trimReceiveBuffer()
+{
+   if (!mBuffer || mReceivingTransmissionFormat == Compressed)
+   {
+      return;
+   }
+
+   // Between messages the buffer holds nothing (any overhang has already
+   // been moved into a new buffer by preparseNewBytes()); in the other
+   // states it holds mBufferPos bytes of a message still being received.
+   if (mConnState == NewMessage || mBufferPos == 0)
+   {
+      releaseReceiveBuffer();
+   }
+   else if (mBufferSize - mBufferPos >= ConnectionBase::ChunkSize/2)
+   {
+      char* buffer = MsgHeaderScanner::allocateBuffer((int)mBufferPos);
+      memcpy(buffer, mBuffer, mBufferPos);
+      releaseReceiveBuffer();
+      mBuffer = buffer;
+      mBufferSize = mBufferPos;
+   }
+}
+
+void
+ConnectionBase::releaseReceiveBuffer()
+{
+   if (!mBuffer)
+   {
+      return;
+   }
+   if (mBufferSize == ConnectionBase::ChunkSize)
+   {
+      freeReceiveBuffer(mBuffer);
+   }
+   else
+   {
+      delete [] mBuffer;
+   }
+   mBuffer = 0;
+}
+
 void 
 ConnectionBase::setBuffer(char* bytes, int count)
 {
@@ -84,6 +84,18 @@ class ConnectionBase
       std::pair<char*, size_t> getWriteBuffer();
       std::pair<char*, size_t> getCurrentWriteBuffer();
       char* getWriteBufferForExtraBytes(int bytesRead, int extraBytes);
+
+      /// source and sink of empty ChunkSize receive buffers
+      virtual char* allocateReceiveBuffer();
+      virtual void freeReceiveBuffer(char* buffer);
+      /// grow a trimmed receive buffer so there is room to read into
+      void expandReceiveBuffer();
+      /** once the socket is drained: give back an empty receive buffer, or
+          trim one holding part of a message to the bytes received */
+      void trimReceiveBuffer();
+      /// give back the receive buffer, whatever it holds
+      void releaseReceiveBuffer();
+      size_t getReceiveBufferSize() const { return mBuffer ? mBufferSize : 0; }
       
       // for avoiding copies in external transports--not used in core resip
       void setBuffer(char* bytes, int count);
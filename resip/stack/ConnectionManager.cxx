@@ -22,6 +22,8 @@ using namespace std;
 UInt64 ConnectionManager::MinimumGcAge = 1;  // in milliseconds
 UInt64 ConnectionManager::MinimumGcHeadroom = 0;
 bool ConnectionManager::EnableAgressiveGc = false;
+bool ConnectionManager::PoolReceiveBuffers = false;
+unsigned int ConnectionManager::MaxPooledReceiveBuffers = 1024;
 
 ConnectionManager::ConnectionManager() : 
    mHead(0,Tuple(),0,Compression::Disabled, false),
@@ -29,7 +31,11 @@ ConnectionManager::ConnectionManager() :
    mReadHead(ConnectionReadList::makeList(&mHead)),
    mLRUHead(ConnectionLruList::makeList(&mHead)),
    mFlowTimerLRUHead(FlowTimerLruList::makeList(&mHead)),
-   mPollGrp(0)
+   mPollGrp(0),
+   mConnectionCount(0),
+   mReceiveBufferBytes(0),
+   mWrites(0),
+   mMessagesWritten(0)
 {
    DebugLog(<<"ConnectionManager::ConnectionManager() called ");
 }
@@ -41,6 +47,10 @@ ConnectionManager::~ConnectionManager()
    resip_assert(mWriteHead->empty());
    resip_assert(mLRUHead->empty());
    resip_assert(mFlowTimerLRUHead->empty());
+   for(std::vector<char*>::iterator i = mFreeReceiveBuffers.begin(); i != mFreeReceiveBuffers.end(); ++i)
+   {
+      delete [] *i;
+   }
 }
 
 void 
@@ -155,6 +165,11 @@ ConnectionManager::buildFdSet(FdSet& fdset)
 void
 ConnectionManager::addToWritable(Connection* conn)
 {
+   if ( conn->mPollingSuspended )
+   {
+      // resumePolling() looks at mInWritable
+      return;
+   }
    if ( mPollGrp ) 
    {
       mPollGrp->modPollItem(conn->mPollItemHandle, FPEM_Read|FPEM_Write|FPEM_Error);
@@ -168,6 +183,10 @@ ConnectionManager::addToWritable(Connection* conn)
 void
 ConnectionManager::removeFromWritable(Connection* conn)
 {
+   if ( conn->mPollingSuspended )
+   {
+      return;
+   }
    if ( mPollGrp ) 
    {
       mPollGrp->modPollItem(conn->mPollItemHandle, FPEM_Read|FPEM_Error);
@@ -179,6 +198,40 @@ ConnectionManager::removeFromWritable(Connection* conn)
    }
 }
 
+void
+ConnectionManager::suspendPolling(Connection* conn)
+{
+   if ( mPollGrp )
+   {
+      mPollGrp->delPollItem(conn->mPollItemHandle);
+      conn->mPollItemHandle = 0;
+   }
+   else
+   {
+      conn->ConnectionReadList::remove();
+      conn->ConnectionWriteList::remove();
+   }
+}
+
+void
+ConnectionManager::resumePolling(Connection* conn)
+{
+   if ( mPollGrp )
+   {
+      conn->mPollItemHandle = mPollGrp->addPollItem(conn->getSocket(),
+         conn->mInWritable ? FPEM_Read|FPEM_Write|FPEM_Error : FPEM_Read|FPEM_Error,
+         conn);
+   }
+   else
+   {
+      mReadHead->push_back(conn);
+      if ( conn->mInWritable )
+      {
+         mWriteHead->push_back(conn);
+      }
+   }
+}
+
 void
 ConnectionManager::addConnection(Connection* connection)
 {
@@ -199,6 +252,7 @@ ConnectionManager::addConnection(Connection* connection)
       mReadHead->push_back(connection);
    }
    mLRUHead->push_back(connection);
+   ++mConnectionCount;
 
    // Garbage collect old connections if agressive is enabled
    if(EnableAgressiveGc)
@@ -218,14 +272,17 @@ ConnectionManager::removeConnection(Connection* connection)
 
    mIdMap.erase(connection->mWho.mFlowKey);
    mAddrMap.erase(connection->mWho);
+   --mConnectionCount;
 
    if ( mPollGrp ) 
    {
-      mPollGrp->delPollItem(connection->mPollItemHandle);
+      if ( !connection->mPollingSuspended )
+      {
+         mPollGrp->delPollItem(connection->mPollItemHandle);
+      }
    }
    else
    {
-      resip_assert(!mReadHead->empty());
       connection->ConnectionReadList::remove();
       connection->ConnectionWriteList::remove();
       if(connection->isFlowTimerEnabled())
@@ -390,6 +447,33 @@ ConnectionManager::moveToFlowTimerLru(Connection *connection)
    mFlowTimerLRUHead->push_back(connection);
 }
 
+char*
+ConnectionManager::takeReceiveBuffer()
+{
+   if(mFreeReceiveBuffers.empty())
+   {
+      return MsgHeaderScanner::allocateBuffer(Connection::ChunkSize);
+   }
+   char* buffer = mFreeReceiveBuffers.back();
+   mFreeReceiveBuffers.pop_back();
+   mReceiveBufferBytes -= Connection::ChunkSize;
+   return buffer;
+}
+
+void
+ConnectionManager::releaseReceiveBuffer(char* buffer)
+{
+   if(mFreeReceiveBuffers.size() < MaxPooledReceiveBuffers)
+   {
+      mFreeReceiveBuffers.push_back(buffer);
+      mReceiveBufferBytes += Connection::ChunkSize;
+   }
+   else
+   {
+      delete [] buffer;
+   }
+}
+
 void
 ConnectionManager::process(FdSet& fdset)
 {
@@ -2,6 +2,8 @@
 #define RESIP_ConnectionMgr_hxx 
 
 #include <map>
+#include <vector>
+#include <atomic>
 #include "rutil/HashMap.hxx"
 #include "resip/stack/Connection.hxx"
 
@@ -34,6 +36,15 @@ class ConnectionManager
           perform garbage collection on every new connection.  If disabled
           then garbage collection is only performed if we run out of Fd's */
       static bool EnableAgressiveGc;
+      /** Release the receive buffer of a connection once its socket has
+          been drained, instead of keeping a ChunkSize buffer per connection
+          for its lifetime.  Empty buffers go back to a free list owned by
+          the ConnectionManager; a connection holding part of a message
+          keeps a buffer trimmed to the bytes received so far.  Intended for
+          servers holding many mostly idle flows. */
+      static bool PoolReceiveBuffers;
+      /// maximum number of ChunkSize buffers kept on the free list
+      static unsigned int MaxPooledReceiveBuffers;
 
       ConnectionManager();
       ~ConnectionManager();
@@ -49,12 +60,30 @@ class ConnectionManager
 
       virtual void invokeAfterSocketCreationFunc() const;
 
+      /// may be called from any thread
+      unsigned int getConnectionCount() const { return mConnectionCount; }
+      /** bytes held in receive buffers, by connections and the free list;
+          may be called from any thread */
+      UInt64 getReceiveBufferBytes() const { return mReceiveBufferBytes; }
+      /** writes that sent something, and the messages they completed; the
+          ratio is how well queued messages are being coalesced. May be
+          called from any thread */
+      UInt64 getWrites() const { return mWrites; }
+      UInt64 getMessagesWritten() const { return mMessagesWritten; }
+
    private:
       void addToWritable(Connection* conn); // add the specified conn to end
       void removeFromWritable(Connection* conn); // remove the current mWriteMark
+      /// take conn off the read and write lists (or the FdPollGrp) for now
+      void suspendPolling(Connection* conn);
+      /// watch conn again, for writing too if it is writable
+      void resumePolling(Connection* conn);
 
-      typedef std::map<Tuple, Connection*> AddrMap;
-      typedef std::map<Socket, Connection*> IdMap;
+      // Hashed rather than ordered: a proxy may hold hundreds of thousands of
+      // client flows, and nothing walks these in order. Tuple's hash covers
+      // exactly what Tuple::operator== compares.
+      typedef HashMap<Tuple, Connection*> AddrMap;
+      typedef HashMap<Socket, Connection*> IdMap;
 
       void addConnection(Connection* connection);
       void removeConnection(Connection* connection);
@@ -68,6 +97,16 @@ class ConnectionManager
       /// move to youngest 
       void touch(Connection* connection);
       void moveToFlowTimerLru(Connection *connection);
+
+      /// receive buffer free list, see PoolReceiveBuffers
+      char* takeReceiveBuffer();
+      void releaseReceiveBuffer(char* buffer);
+      void adjustReceiveBufferBytes(Int64 delta) { mReceiveBufferBytes += delta; }
+      void countWrite(unsigned int messages)
+      {
+         ++mWrites;
+         mMessagesWritten += messages;
+      }
       
       AddrMap mAddrMap;
       IdMap mIdMap;
@@ -86,6 +125,13 @@ class ConnectionManager
 
       /// collection for epoll
       FdPollGrp* mPollGrp;
+
+      /// ChunkSize receive buffers not owned by any connection
+      std::vector<char*> mFreeReceiveBuffers;
+      std::atomic<unsigned int> mConnectionCount;
+      std::atomic<UInt64> mReceiveBufferBytes;
+      std::atomic<UInt64> mWrites;
+      std::atomic<UInt64> mMessagesWritten;
       //<<---------------------------------
 
       friend class TcpBaseTransport;
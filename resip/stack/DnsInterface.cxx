@@ -20,6 +20,7 @@
 
 #include "rutil/dns/DnsStub.hxx"
 #include "rutil/dns/RRVip.hxx"
+#include "rutil/dns/DnsSnapshot.hxx"
 #include "resip/stack/DnsInterface.hxx"
 #include "rutil/dns/DnsHandler.hxx"
 #include "resip/stack/DnsResult.hxx"
@@ -34,8 +35,10 @@ using namespace resip;
 
 DnsInterface::DnsInterface(DnsStub& dnsStub, bool useDnsVip) : 
    mUdpOnlyOnNumeric(false),
-   mDnsStub(dnsStub)
+   mDnsStub(dnsStub),
+   mUseDnsVip(useDnsVip)
 {
+   mDnsShards.push_back(&mDnsStub);
    if (useDnsVip)
    {
       mDnsStub.setResultTransform(&mVip);
@@ -189,6 +192,60 @@ DnsInterface::lookup(DnsResult* res, const Uri& uri)
    res->lookup(uri);
 }
 
+void
+DnsInterface::addDnsShard(DnsStub& dnsStub)
+{
+   mDnsShards.push_back(&dnsStub);
+   if (mUseDnsVip)
+   {
+      dnsStub.setResultTransform(&mVip);
+   }
+}
+
+DnsStub&
+DnsInterface::getDnsStub(const Data& target)
+{
+   if (mDnsShards.size() == 1)
+   {
+      return mDnsStub;
+   }
+   return *mDnsShards[target.caseInsensitiveTokenHash() % mDnsShards.size()];
+}
+
+bool
+DnsInterface::saveDnsSnapshot(const Data& filename)
+{
+   DnsSnapshotWriter writer;
+   mDnsStub.encodeCacheSnapshot(writer);
+   mVip.encodeSnapshot(writer);
+   mMarkManager.encodeSnapshot(writer);
+   if (!writer.save(filename))
+   {
+      return false;
+   }
+   InfoLog(<< "Saved DNS snapshot to " << filename << " (" << writer.snapshot().size() << " bytes)");
+   return true;
+}
+
+bool
+DnsInterface::loadDnsSnapshot(const Data& filename)
+{
+   DnsSnapshotReader reader;
+   if (!reader.load(filename))
+   {
+      return false;
+   }
+   int loaded = mDnsStub.decodeCacheSnapshot(reader);
+   if (!reader.ok() || !mVip.decodeSnapshot(reader) || !mMarkManager.decodeSnapshot(reader))
+   {
+      WarningLog(<< "DNS snapshot " << filename << " is truncated or corrupt, loaded what could be read");
+      return false;
+   }
+   InfoLog(<< "Loaded " << loaded << " DNS cache entries from " << filename
+           << ", saved " << reader.age() << " secs ago");
+   return true;
+}
+
 //?dcm? -- why is this here?
 DnsHandler::~DnsHandler()
 {
@@ -72,6 +72,20 @@ class DnsInterface
       DnsResult* createDnsResult(DnsHandler* handler=0);
       void lookup(DnsResult* res, const Uri& uri);
 
+      // Adds a stub to spread lookups across. It should share the cache of
+      // the stub this interface was created with, and be driven by a thread
+      // of its own. Add all shards before the first lookup.
+      void addDnsShard(DnsStub& dnsStub);
+      // The stub a lookup of target goes through, picked by hash of target.
+      DnsStub& getDnsStub(const Data& target);
+
+      // Saves the DNS cache, the vips and the grey/blacklisted tuples to
+      // filename, for loadDnsSnapshot() to warm up the next run with. Entries
+      // that expired in the meantime are dropped on load. Safe to call from
+      // any thread.
+      bool saveDnsSnapshot(const Data& filename);
+      bool loadDnsSnapshot(const Data& filename);
+
       TupleMarkManager& getMarkManager(){return mMarkManager;}
 
       bool setUdpOnlyOnNumeric(bool value)
@@ -102,6 +116,8 @@ class DnsInterface
       bool mUdpOnlyOnNumeric;
 
       DnsStub& mDnsStub;  
+      std::vector<DnsStub*> mDnsShards; // includes mDnsStub
+      bool mUseDnsVip;
       RRVip mVip;                      // Ensure all access is from DnsThread/DnsStub fifo for thread safety
       TupleMarkManager mMarkManager;   // Ensure all access is from DnsThread/DnsStub fifo for thread safety
 };
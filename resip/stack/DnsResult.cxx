@@ -93,7 +93,7 @@ EnumResult::onDnsResult(const DNSResult<DnsCnameRecord>&)
 
 DnsResult::DnsResult(DnsInterface& interfaceObj, DnsStub& dns, RRVip& vip, DnsHandler* handler) 
    : mInterface(interfaceObj),
-     mDnsStub(dns),
+     mDnsStub(&dns),
      mVip(vip),
      mHandler(handler),
      mSRVCount(0),
@@ -155,7 +155,7 @@ DnsResult::blacklistLast(UInt64 expiry)
                                                                    mLastResult, 
                                                                    expiry, 
                                                                    TupleMarkManager::BLACK);
-      mDnsStub.queueCommand(command);
+      mDnsStub->queueCommand(command);
       return true;
    }
    return false;
@@ -173,7 +173,7 @@ DnsResult::greylistLast(UInt64 expiry)
                                                                    mLastResult, 
                                                                    expiry, 
                                                                    TupleMarkManager::GREY);
-      mDnsStub.queueCommand(command);
+      mDnsStub->queueCommand(command);
       return true;
    }
    return false;
@@ -241,7 +241,7 @@ void
 DnsResult::whitelistLast()
 {
     WhitelistCommand* command = new WhitelistCommand(mVip, mLastReturnedPath);
-    mDnsStub.queueCommand(command);
+    mDnsStub->queueCommand(command);
 }
 
 void
@@ -260,9 +260,13 @@ DnsResult::lookup(const Uri& uri)
 {
    DebugLog (<< "DnsResult::lookup " << uri);
 
+   // All queries for this result go through one stub, so its callbacks
+   // all come from the same thread
+   mDnsStub = &mInterface.getDnsStub(uri.host());
+
    // Dispatch lookup request to DnsThread
    LookupCommand *command = new LookupCommand(*this, uri);
-   mDnsStub.queueCommand(command);
+   mDnsStub->queueCommand(command);
 }
 
 void
@@ -273,13 +277,13 @@ DnsResult::lookupInternalWithEnum(const Uri& uri)
       destroy();
       return;
    }
-   if (!mDnsStub.getEnumSuffixes().empty() && 
+   if (!mDnsStub->getEnumSuffixes().empty() && 
        uri.isEnumSearchable() &&
-       mDnsStub.getEnumDomains().find(uri.host()) != mDnsStub.getEnumDomains().end())
+       mDnsStub->getEnumDomains().find(uri.host()) != mDnsStub->getEnumDomains().end())
    {
       mInputUri = uri;
       int order = 0;
-      std::vector<Data> enums = uri.getEnumLookups(mDnsStub.getEnumSuffixes());
+      std::vector<Data> enums = uri.getEnumLookups(mDnsStub->getEnumSuffixes());
       resip_assert(enums.size() >= 1);
       if (!enums.empty())
       {
@@ -287,7 +291,7 @@ DnsResult::lookupInternalWithEnum(const Uri& uri)
          for(std::vector<Data>::iterator it = enums.begin(); it != enums.end(); it++)
          {
             InfoLog (<< "Doing ENUM lookup on " << *it);
-            mDnsStub.lookup<RR_NAPTR>(*it, Protocol::Enum, new EnumResult(*this, order++)); 
+            mDnsStub->lookup<RR_NAPTR>(*it, Protocol::Enum, new EnumResult(*this, order++)); 
          }
          return;
       }
@@ -361,7 +365,7 @@ DnsResult::lookupInternal(const Uri& uri)
                   if (mHandler) mHandler->handle(this);
                   return;
                }
-               if(!mDnsStub.supportedType(T_SRV)) 
+               if(!mDnsStub->supportedType(T_SRV)) 
                {
                   mPort = getDefaultPort(mTransport, uri.port());
                   lookupHost(mTarget); // for current target and port
@@ -369,7 +373,7 @@ DnsResult::lookupInternal(const Uri& uri)
                else
                {
                   mSRVCount++;
-                  mDnsStub.lookup<RR_SRV>("_sips._udp." + mTarget, Protocol::Sip, this);
+                  mDnsStub->lookup<RR_SRV>("_sips._udp." + mTarget, Protocol::Sip, this);
                   StackLog (<< "Doing SRV lookup of _sips._udp." << mTarget);
                }
             }
@@ -384,7 +388,7 @@ DnsResult::lookupInternal(const Uri& uri)
                   if (mHandler) mHandler->handle(this);
                   return;
                }
-               if(!mDnsStub.supportedType(T_SRV)) 
+               if(!mDnsStub->supportedType(T_SRV)) 
                {
                   mPort = getDefaultPort(mTransport, uri.port());
                   lookupHost(mTarget); // for current target and port
@@ -392,7 +396,7 @@ DnsResult::lookupInternal(const Uri& uri)
                else
                {
                   mSRVCount++;
-                  mDnsStub.lookup<RR_SRV>("_sips._tcp." + mTarget, Protocol::Sip,  this);
+                  mDnsStub->lookup<RR_SRV>("_sips._tcp." + mTarget, Protocol::Sip,  this);
                   StackLog (<< "Doing SRV lookup of _sips._tcp." << mTarget);
                }
             }
@@ -407,7 +411,7 @@ DnsResult::lookupInternal(const Uri& uri)
                return;
             }
 
-            if(!mDnsStub.supportedType(T_SRV)) 
+            if(!mDnsStub->supportedType(T_SRV)) 
             {
                mPort = getDefaultPort(mTransport, uri.port());
                lookupHost(mTarget); // for current target and port
@@ -418,17 +422,17 @@ DnsResult::lookupInternal(const Uri& uri)
             {
                case TLS: //deprecated, mean TLS over TCP
                   mSRVCount++;
-                  mDnsStub.lookup<RR_SRV>("_sips._tcp." + mTarget, Protocol::Sip, this);
+                  mDnsStub->lookup<RR_SRV>("_sips._tcp." + mTarget, Protocol::Sip, this);
                   StackLog (<< "Doing SRV lookup of _sips._tcp." << mTarget);
                   break;
                case DTLS: //deprecated, mean TLS over TCP
                   mSRVCount++;
-                  mDnsStub.lookup<RR_SRV>("_sip._dtls." + mTarget, Protocol::Sip, this);
+                  mDnsStub->lookup<RR_SRV>("_sip._dtls." + mTarget, Protocol::Sip, this);
                   StackLog (<< "Doing SRV lookup of _sip._dtls." << mTarget);
                   break;
                case TCP:
                   mSRVCount++;
-                  mDnsStub.lookup<RR_SRV>("_sip._tcp." + mTarget, Protocol::Sip, this);
+                  mDnsStub->lookup<RR_SRV>("_sip._tcp." + mTarget, Protocol::Sip, this);
                   StackLog (<< "Doing SRV lookup of _sip._tcp." << mTarget);
                   break;
                case SCTP:
@@ -436,7 +440,7 @@ DnsResult::lookupInternal(const Uri& uri)
                case UDP:
                default: //fall through to UDP for unimplemented & unknown
                   mSRVCount++;
-                  mDnsStub.lookup<RR_SRV>("_sip._udp." + mTarget, Protocol::Sip, this);
+                  mDnsStub->lookup<RR_SRV>("_sip._udp." + mTarget, Protocol::Sip, this);
                   StackLog (<< "Doing SRV lookup of _sip._udp." << mTarget);
             }
          }
@@ -445,7 +449,7 @@ DnsResult::lookupInternal(const Uri& uri)
    else // transport parameter is not specified
    {
       // if hostname is numeric, a port is specified, or NAPTR queries are not support by the DNS layer - skip NAPTR lookup
-      if (isNumeric || uri.port() != 0 || !mDnsStub.supportedType(T_NAPTR))
+      if (isNumeric || uri.port() != 0 || !mDnsStub->supportedType(T_NAPTR))
       {
          TupleMarkManager::MarkType mark=TupleMarkManager::BLACK;
          Tuple tuple;
@@ -586,7 +590,7 @@ DnsResult::lookupInternal(const Uri& uri)
       }
       else // do NAPTR
       {
-         mDnsStub.lookup<RR_NAPTR>(mTarget, Protocol::Sip, this); // for current target
+         mDnsStub->lookup<RR_NAPTR>(mTarget, Protocol::Sip, this); // for current target
       }
    }
 }
@@ -598,15 +602,15 @@ void DnsResult::lookupHost(const Data& target)
 #ifdef USE_IPV6
       DebugLog(<< "Doing host (AAAA) lookup: " << target);
       mPassHostFromAAAAtoA = target;
-      mDnsStub.lookup<RR_AAAA>(target, Protocol::Sip, this);
+      mDnsStub->lookup<RR_AAAA>(target, Protocol::Sip, this);
 #else
       resip_assert(0);
-      mDnsStub.lookup<RR_A>(target, Protocol::Sip, this);
+      mDnsStub->lookup<RR_A>(target, Protocol::Sip, this);
 #endif
    }
    else if (mInterface.isSupported(mTransport, V4))
    {
-      mDnsStub.lookup<RR_A>(target, Protocol::Sip, this);
+      mDnsStub->lookup<RR_A>(target, Protocol::Sip, this);
    }
    else
    {
@@ -1090,7 +1094,7 @@ void DnsResult::onDnsResult(const DNSResult<DnsAAAARecord>& result)
       StackLog (<< "Failed async AAAA query: " << result.msg);
    }
    // funnel through to host processing
-   mDnsStub.lookup<RR_A>(mPassHostFromAAAAtoA, Protocol::Sip, this);
+   mDnsStub->lookup<RR_A>(mPassHostFromAAAAtoA, Protocol::Sip, this);
 #else
    resip_assert(0);
 #endif
@@ -1374,7 +1378,7 @@ DnsResult::onNaptrResult(const DNSResult<DnsNaptrRecord>& result)
                StackLog (<< "NAPTR record is supported and matches highes priority order. doing SRV query: " << (*it));
                mTopOrderedNAPTRs[(*it).replacement] = (*it);
                mSRVCount++;
-               mDnsStub.lookup<RR_SRV>((*it).replacement, Protocol::Sip, this);
+               mDnsStub->lookup<RR_SRV>((*it).replacement, Protocol::Sip, this);
             }
          }
       }
@@ -1404,32 +1408,32 @@ DnsResult::onNaptrResult(const DNSResult<DnsNaptrRecord>& result)
          }
 
          mSRVCount++;
-         mDnsStub.lookup<RR_SRV>("_sips._tcp." + mTarget, Protocol::Sip, this);
+         mDnsStub->lookup<RR_SRV>("_sips._tcp." + mTarget, Protocol::Sip, this);
          StackLog (<< "Doing SRV lookup of _sips._tcp." << mTarget);
       }
       else
       {
          if (mInterface.isSupportedProtocol(TLS))
          {
-            mDnsStub.lookup<RR_SRV>("_sips._tcp." + mTarget, Protocol::Sip, this);
+            mDnsStub->lookup<RR_SRV>("_sips._tcp." + mTarget, Protocol::Sip, this);
             ++mSRVCount;
             StackLog (<< "Doing SRV lookup of _sips._tcp." << mTarget);
          }
          if (mInterface.isSupportedProtocol(DTLS))
          {
-            mDnsStub.lookup<RR_SRV>("_sips._udp." + mTarget, Protocol::Sip, this);
+            mDnsStub->lookup<RR_SRV>("_sips._udp." + mTarget, Protocol::Sip, this);
             ++mSRVCount;
             StackLog (<< "Doing SRV lookup of _sips._udp." << mTarget);
          }
          if (mInterface.isSupportedProtocol(TCP))
          {
-            mDnsStub.lookup<RR_SRV>("_sip._tcp." + mTarget, Protocol::Sip, this);
+            mDnsStub->lookup<RR_SRV>("_sip._tcp." + mTarget, Protocol::Sip, this);
             ++mSRVCount;
             StackLog (<< "Doing SRV lookup of _sip._tcp." << mTarget);
          }
          if (mInterface.isSupportedProtocol(UDP))
          {
-            mDnsStub.lookup<RR_SRV>("_sip._udp." + mTarget, Protocol::Sip, this);
+            mDnsStub->lookup<RR_SRV>("_sip._udp." + mTarget, Protocol::Sip, this);
             ++mSRVCount;
             StackLog (<< "Doing SRV lookup of _sip._udp." << mTarget);
          }
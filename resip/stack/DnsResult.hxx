@@ -239,7 +239,7 @@ class DnsResult : public DnsResultSink, public EnumResultSink
       
    private:
       DnsInterface& mInterface;
-      DnsStub& mDnsStub;
+      DnsStub* mDnsStub; // the DnsInterface's stub for the target, see lookup()
       RRVip& mVip;
       DnsHandler* mHandler;
       int mSRVCount;
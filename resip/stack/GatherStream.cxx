@@ -0,0 +1,174 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include "resip/stack/GatherStream.hxx"
+
+using namespace resip;
+
+GatherBuffer::GatherBuffer(SendData& out)
+   : DataBuffer(out.data),
+     mOut(out),
+     mRegionCount(0),
+     mRunStart(out.data.size())
+{
+}
+
+GatherBuffer::~GatherBuffer()
+{
+}
+
+#ifdef RESIP_USE_STL_STREAMS
+std::streamsize
+GatherBuffer::xsputn(const char* s, std::streamsize n)
+{
+   if (n > 0 && gather(s, size_t(n)))
+   {
+      return n;
+   }
+   return DataBuffer::xsputn(s, n);
+}
+#else
+size_t
+GatherBuffer::writebuf(const char* s, size_t count)
+{
+   if (gather(s, count))
+   {
+      return count;
+   }
+   return DataBuffer::writebuf(s, count);
+}
+#endif
+
+bool
+GatherBuffer::gather(const char* s, size_t n)
+{
+   // room for this piece, the run of copied bytes before it and the one
+   // that will follow it
+   if (n < GatherStream::MinPieceSize || 
+       mOut.pieces.size() + 3 > SendData::MaxPieces)
+   {
+      return false;
+   }
+
+   for (unsigned int i = 0; i < mRegionCount; ++i)
+   {
+      if (s >= mRegions[i].first && s + n <= mRegions[i].second)
+      {
+         if (mOut.pieces.empty())
+         {
+            mOut.pieces.reserve(SendData::MaxPieces);
+         }
+         closeRun();
+         mOut.pieces.push_back(SendData::Piece(s, 0, n));
+         return true;
+      }
+   }
+   return false;
+}
+
+void
+GatherBuffer::closeRun()
+{
+#ifdef RESIP_USE_STL_STREAMS
+   // commit what is in the put area to data
+   sync();
+#endif
+   size_t end = mOut.data.size();
+   if (end > mRunStart)
+   {
+      mOut.pieces.push_back(SendData::Piece(0, mRunStart, end - mRunStart));
+      mRunStart = end;
+   }
+}
+
+GatherStream::GatherStream(SendData& out)
+   : GatherBuffer(out),
+     EncodeStream(this)
+{
+}
+
+GatherStream::~GatherStream()
+{
+   finish();
+}
+
+void
+GatherStream::addRegion(const char* start, size_t size)
+{
+   if (size > 0 && mRegionCount < MaxRegions)
+   {
+      mRegions[mRegionCount++] = std::make_pair(start, start + size);
+   }
+}
+
+void
+GatherStream::keepAlive(const std::shared_ptr<const void>& owner)
+{
+   mOut.rawBuffers = owner;
+}
+
+void
+GatherStream::finish()
+{
+   flush();
+   if (mOut.pieces.empty())
+   {
+      mOut.rawBuffers.reset();
+   }
+   else
+   {
+      closeRun();
+   }
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
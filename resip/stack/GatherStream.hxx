@@ -0,0 +1,129 @@
+#ifndef RESIP_GatherStream_hxx
+#define RESIP_GatherStream_hxx
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "rutil/DataStream.hxx"
+#include "resip/stack/SendData.hxx"
+
+namespace resip
+{
+
+/**
+   @internal
+   The stream buffer behind GatherStream.
+*/
+class GatherBuffer : public DataBuffer
+{
+   public:
+      GatherBuffer(SendData& out);
+      virtual ~GatherBuffer();
+
+   protected:
+#ifdef RESIP_USE_STL_STREAMS
+      virtual std::streamsize xsputn(const char* s, std::streamsize n);
+#else
+      virtual size_t writebuf(const char* s, size_t count);
+#endif
+
+      bool gather(const char* s, size_t n);
+      void closeRun();
+
+      // regions past this many are not gathered from, only copied
+      static const unsigned int MaxRegions = 8;
+
+      SendData& mOut;
+      std::pair<const char*, const char*> mRegions[MaxRegions];
+      unsigned int mRegionCount;
+      // where the bytes written since the last gathered piece start in data
+      size_t mRunStart;
+};
+
+/**
+   @internal
+   An output stream that encodes a message into a SendData. It appends to
+   the SendData's data like a DataStream would, except that a write of at
+   least MinPieceSize bytes that lies within one of the regions passed to
+   addRegion() is not copied; the SendData gets a piece referring to it
+   instead (see SendData::isGathered()). The regions must outlive the 
+   SendData, which is what keepAlive() is for.
+
+   If nothing ends up referenced, the SendData is left as an ordinary one.
+*/
+class GatherStream : private GatherBuffer, public EncodeStream
+{
+   public:
+      GatherStream(SendData& out);
+      /// Calls finish().
+      ~GatherStream();
+
+      void addRegion(const char* start, size_t size);
+      void keepAlive(const std::shared_ptr<const void>& owner);
+
+      /// Settles the SendData's pieces. Nothing may be written after this.
+      void finish();
+
+      /// Below this, copying is cheaper than sending a separate piece.
+      static const size_t MinPieceSize = 64;
+
+   private:
+      GatherStream(const GatherStream&);
+      GatherStream& operator=(const GatherStream&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -41,6 +41,17 @@ class HeaderFieldValue
       HeaderFieldValue(const HeaderFieldValue& hfv);
       HeaderFieldValue(const HeaderFieldValue& hfv, CopyPaddingEnum);
       HeaderFieldValue(const HeaderFieldValue& hfv, NoOwnershipEnum);
+      // Lets HeaderFieldValueList grow without copying the text of every
+      // value it already holds.
+      HeaderFieldValue(HeaderFieldValue&& hfv) noexcept
+         : mField(hfv.mField),
+           mFieldLength(hfv.mFieldLength),
+           mMine(hfv.mMine)
+      {
+         hfv.mField=0;
+         hfv.mFieldLength=0;
+         hfv.mMine=false;
+      }
       HeaderFieldValue& operator=(const HeaderFieldValue&);
       HeaderFieldValue& copyWithPadding(const HeaderFieldValue& rhs);
       HeaderFieldValue& swap(HeaderFieldValue& orig);
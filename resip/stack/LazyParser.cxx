@@ -8,6 +8,7 @@
 #include "resip/stack/Headers.hxx"
 #include "resip/stack/HeaderFieldValue.hxx"
 #include "resip/stack/LazyParser.hxx"
+#include "rutil/DataStream.hxx"
 #include "rutil/ParseBuffer.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
@@ -115,6 +116,26 @@ LazyParser::encode(EncodeStream& str) const
    }
 }
 
+void
+LazyParser::keepEncoding()
+{
+   if (mState != DIRTY || !cacheEncoding())
+   {
+      return;
+   }
+
+   // Keep the encoding as the raw field, which makes this WELL_FORMED again.
+   Data encoded;
+   {
+      DataStream ds(encoded);
+      encodeParsed(ds);
+   }
+   char* field = new char[encoded.size()];
+   memcpy(field, encoded.data(), encoded.size());
+   mHeaderField.init(field, encoded.size(), true);
+   mState = WELL_FORMED;
+}
+
 #ifndef  RESIP_USE_STL_STREAMS
 EncodeStream&
 resip::operator<<(EncodeStream&s, const LazyParser& lp)
@@ -84,6 +84,17 @@ class LazyParser
       */
       EncodeStream& encode(EncodeStream& str) const;
 
+      /**
+         @brief If this element has been modified since it was parsed, and 
+            cacheEncoding() allows it, encodes it once and keeps the result 
+            as its raw field, so later encodes (and copies) just copy the 
+            bytes out. Any non-const access throws the kept encoding away.
+         @note encode() never does this itself, since it is called from 
+            whatever thread happens to log or capture the element. Call 
+            this from the thread that owns the element.
+      */
+      void keepEncoding();
+
       /**
          @brief Returns true iff a parse has been attempted.
          @note This means that this will return true if a parse failed earlier.
@@ -132,6 +143,12 @@ class LazyParser
       // called in destructor and on assignment 
       void clear();
 
+      /**
+         @internal
+         Whether keepEncoding() may keep this element's encoding.
+      */
+      virtual bool cacheEncoding() const { return false; }
+
       // context for error messages
       virtual const Data& errorContext() const = 0;
       
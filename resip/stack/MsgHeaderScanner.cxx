@@ -5,6 +5,20 @@
 #include <ctype.h>
 #include <limits.h>
 #include <stdio.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RESIP_MSG_HEADER_SCANNER_SSE2
+#include <emmintrin.h>
+// AVX2 is only used when the CPU reports it at runtime, which needs the
+// compiler's per-function target support.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RESIP_MSG_HEADER_SCANNER_AVX2
+#include <immintrin.h>
+#endif
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 #include "resip/stack/HeaderTypes.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/MsgHeaderScanner.hxx"
@@ -412,6 +426,220 @@ static void initStateMachine()
                   sMsgStart); // Arbitrary but possibly handy.
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//   In some states (the status line, values, quoted strings, angle-bracketed
+//   values) almost every character is a "taNone" transition back to the same
+//   state.  Only a handful of characters do anything there, so runs of the
+//   others can be skipped a block at a time, as long as their text properties
+//   still make it into the text property bit mask.
+
+enum { maxNumRunStopChars = 6 };
+
+struct RunInfo
+{
+      // 0 if the state can't be skipped through
+      int numStopChars;
+      // the characters whose transition is not "taNone" to the same state
+      char stopChars[maxNumRunStopChars];
+};
+
+static RunInfo runInfoArray[numStates];
+
+struct TextPropCharInfo
+{
+      char character;
+      MsgHeaderScanner::TextPropBitMask textPropBitMask;
+};
+
+static TextPropCharInfo textPropCharArray[UCHAR_MAX+1];
+static int numTextPropChars = 0;
+
+static void initRunInfoArray()
+{
+   for (int state = 0; state < numStates; ++state)
+   {
+      RunInfo& runInfo = runInfoArray[state];
+      runInfo.numStopChars = 0;
+      bool tooMany = false;
+      for (unsigned int charIndex = 0; charIndex <= UCHAR_MAX; ++charIndex)
+      {
+         const TransitionInfo& transitionInfo =
+            stateMachine[state][c2i(charInfoArray[charIndex].category)];
+         if (transitionInfo.action == taNone && transitionInfo.nextState == state)
+         {
+            continue;
+         }
+         if (runInfo.numStopChars == maxNumRunStopChars)
+         {
+            tooMany = true;
+            break;
+         }
+         runInfo.stopChars[runInfo.numStopChars++] = (char)charIndex;
+      }
+      // The chunk sentinel must stop every run; that is what keeps the
+      // block loads inside the chunk.
+      bool stopsAtSentinel = false;
+      for (int i = 0; i < runInfo.numStopChars; ++i)
+      {
+         stopsAtSentinel |= (runInfo.stopChars[i] == (char)chunkTermSentinelChar);
+      }
+      if (tooMany || !stopsAtSentinel)
+      {
+         runInfo.numStopChars = 0;
+      }
+   }
+
+   numTextPropChars = 0;
+   for (unsigned int charIndex = 0; charIndex <= UCHAR_MAX; ++charIndex)
+   {
+      if (charInfoArray[charIndex].textPropBitMask)
+      {
+         textPropCharArray[numTextPropChars].character = (char)charIndex;
+         textPropCharArray[numTextPropChars].textPropBitMask =
+            charInfoArray[charIndex].textPropBitMask;
+         ++numTextPropChars;
+      }
+   }
+}
+
+static inline unsigned int lowestSetBitIndex(unsigned int bits)
+{
+#if defined(_MSC_VER)
+   unsigned long index;
+   _BitScanForward(&index, bits);
+   return (unsigned int)index;
+#else
+   return (unsigned int)__builtin_ctz(bits);
+#endif
+}
+
+//   A run skipper returns the first character at or after "charPtr" that is
+//   one of "runInfo"'s stop characters, or some earlier character once fewer
+//   than a block's worth remain before "termCharPtr" (the sentinel).  The text
+//   properties of the characters skipped are or'ed into "textPropBitMask".
+typedef char* (*SkipRunFunc)(char* charPtr,
+                             const char* termCharPtr,
+                             const RunInfo& runInfo,
+                             MsgHeaderScanner::TextPropBitMask& textPropBitMask);
+
+#if defined(RESIP_MSG_HEADER_SCANNER_SSE2)
+
+static char* skipRunSse2(char* charPtr,
+                         const char* termCharPtr,
+                         const RunInfo& runInfo,
+                         MsgHeaderScanner::TextPropBitMask& textPropBitMask)
+{
+   while (termCharPtr - charPtr >= 16 - 1)
+   {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(charPtr));
+      unsigned int stopBits = 0;
+      for (int i = 0; i < runInfo.numStopChars; ++i)
+      {
+         stopBits |= (unsigned int)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(block, _mm_set1_epi8(runInfo.stopChars[i])));
+      }
+      // the characters before the first stop character (all 16 if none)
+      unsigned int runBits = stopBits ? (stopBits & (0U - stopBits)) - 1 : 0xFFFFU;
+      for (int i = 0; i < numTextPropChars; ++i)
+      {
+         if (!(textPropBitMask & textPropCharArray[i].textPropBitMask) &&
+             ((unsigned int)_mm_movemask_epi8(
+                 _mm_cmpeq_epi8(block, _mm_set1_epi8(textPropCharArray[i].character))) & runBits))
+         {
+            textPropBitMask |= textPropCharArray[i].textPropBitMask;
+         }
+      }
+      if (stopBits)
+      {
+         return charPtr + lowestSetBitIndex(stopBits);
+      }
+      charPtr += 16;
+   }
+   return charPtr;
+}
+
+#endif
+
+#if defined(RESIP_MSG_HEADER_SCANNER_AVX2)
+
+__attribute__((target("avx2")))
+static char* skipRunAvx2(char* charPtr,
+                         const char* termCharPtr,
+                         const RunInfo& runInfo,
+                         MsgHeaderScanner::TextPropBitMask& textPropBitMask)
+{
+   while (termCharPtr - charPtr >= 32 - 1)
+   {
+      __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(charPtr));
+      unsigned int stopBits = 0;
+      for (int i = 0; i < runInfo.numStopChars; ++i)
+      {
+         stopBits |= (unsigned int)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(block, _mm256_set1_epi8(runInfo.stopChars[i])));
+      }
+      unsigned int runBits = stopBits ? (stopBits & (0U - stopBits)) - 1 : 0xFFFFFFFFU;
+      for (int i = 0; i < numTextPropChars; ++i)
+      {
+         if (!(textPropBitMask & textPropCharArray[i].textPropBitMask) &&
+             ((unsigned int)_mm256_movemask_epi8(
+                 _mm256_cmpeq_epi8(block, _mm256_set1_epi8(textPropCharArray[i].character))) & runBits))
+         {
+            textPropBitMask |= textPropCharArray[i].textPropBitMask;
+         }
+      }
+      if (stopBits)
+      {
+         return charPtr + lowestSetBitIndex(stopBits);
+      }
+      charPtr += 32;
+   }
+   // Let the 16 byte blocks have a go at the tail.
+   return skipRunSse2(charPtr, termCharPtr, runInfo, textPropBitMask);
+}
+
+#endif
+
+static MsgHeaderScanner::ScanMode bestScanMode()
+{
+#if defined(RESIP_MSG_HEADER_SCANNER_AVX2)
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2"))
+   {
+      return MsgHeaderScanner::smAvx2;
+   }
+#endif
+#if defined(RESIP_MSG_HEADER_SCANNER_SSE2)
+   return MsgHeaderScanner::smSse2;
+#else
+   return MsgHeaderScanner::smScalar;
+#endif
+}
+
+static MsgHeaderScanner::ScanMode scanMode = MsgHeaderScanner::smScalar;
+static SkipRunFunc skipRunFunc = 0;
+
+static void selectScanMode(MsgHeaderScanner::ScanMode mode)
+{
+   MsgHeaderScanner::ScanMode best = bestScanMode();
+   scanMode = mode < best ? mode : best;
+   switch (scanMode)
+   {
+#if defined(RESIP_MSG_HEADER_SCANNER_AVX2)
+      case MsgHeaderScanner::smAvx2:
+         skipRunFunc = skipRunAvx2;
+         break;
+#endif
+#if defined(RESIP_MSG_HEADER_SCANNER_SSE2)
+      case MsgHeaderScanner::smSse2:
+         skipRunFunc = skipRunSse2;
+         break;
+#endif
+      default:
+         skipRunFunc = 0;
+         break;
+   }
+}
+
 // Debug follows
 #if defined(RESIP_MSG_HEADER_SCANNER_DEBUG)  
 
@@ -932,6 +1160,8 @@ MsgHeaderScanner::scanChunk(char * chunk,
    {
       textStartCharPtr = chunk;
    }
+   SkipRunFunc localSkipRunFunc = skipRunFunc;
+   RunInfo* localRunInfoArray = runInfoArray;
    --charPtr;  // The loop starts by advancing "charPtr", so pre-adjust it.
    for (;;)
    {
@@ -939,6 +1169,13 @@ MsgHeaderScanner::scanChunk(char * chunk,
       // The code in this block is executed once per message header character.
       // This entire file is designed specifically to minimize this block's size.
       ++charPtr;
+      if (localSkipRunFunc && localRunInfoArray[(unsigned)localState].numStopChars)
+      {
+         charPtr = localSkipRunFunc(charPtr,
+                                    termCharPtr,
+                                    localRunInfoArray[(unsigned)localState],
+                                    localTextPropBitMask);
+      }
       CharInfo *charInfo = &localCharInfoArray[((unsigned char) (*charPtr))];
       CharCategory charCategory = charInfo->category;
       localTextPropBitMask |= charInfo->textPropBitMask;
@@ -1067,9 +1304,27 @@ MsgHeaderScanner::initialize()
 {
    initCharInfoArray();
    initStateMachine();
+   initRunInfoArray();
+   selectScanMode(smAvx2);
    return true;
 }
 
+MsgHeaderScanner::ScanMode
+MsgHeaderScanner::setScanMode(ScanMode mode)
+{
+   // Force instance so things are initialized
+   MsgHeaderScanner scanner;(void)scanner;
+   selectScanMode(mode);
+   return scanMode;
+}
+
+MsgHeaderScanner::ScanMode
+MsgHeaderScanner::getScanMode()
+{
+   MsgHeaderScanner scanner;(void)scanner;
+   return scanMode;
+}
+
 
 } //namespace resip
 
@@ -65,6 +65,21 @@ class MsgHeaderScanner
          tpbmContainsParen      = 1 << 5      // '(' or ')', possibly mismatched
       };
       typedef unsigned char TextPropBitMask;
+
+      // How scanChunk() gets through runs of characters that do not change
+      // the scanner's state (most of the status line and field values).
+      // Every mode produces exactly the same result.
+      enum ScanMode
+      {
+         smScalar,   // one character at a time through the state machine
+         smSse2,     // 16 characters at a time
+         smAvx2      // 32 characters at a time
+      };
+
+      // Selects the fastest mode the CPU supports that is no faster than
+      // "mode", and returns it. The default is the fastest mode supported.
+      static ScanMode setScanMode(ScanMode mode);
+      static ScanMode getScanMode();
     
       inline unsigned int getHeaderCount() const { return mNumHeaders;} 
 
@@ -27,6 +27,8 @@ using namespace std;
 const ParserCategory::ParameterTypeSet 
 ParserCategory::EmptyParameterTypeSet; 
 
+bool ParserCategory::mEncodeCaching = false;
+
 ParserCategory::ParserCategory(const HeaderFieldValue& headerFieldValue,
                                Headers::Type headerType,
                                PoolBase* pool)
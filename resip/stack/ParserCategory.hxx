@@ -263,6 +263,23 @@ class ParserCategory : public LazyParser
       */
       int numUnknownParams() const {return (int)mUnknownParameters.size();};
 
+      /**
+         @brief Turns caching of header encodings on or off (it is off by
+            default).
+
+         When on, keepEncoding() (or SipMessage::keepHeaderEncodings())
+         keeps the encoding of a modified header, so a message that is
+         encoded over and over (resent, retransmitted from a TU, logged)
+         does not have to run every header through its encoder each time.
+         Any non-const access to the header throws the kept encoding away,
+         but a reference to a part of a header (the Uri of a NameAddr, say)
+         that is held on to and then modified through is not seen, and the
+         stale encoding would be sent. Only turn the cache on if no part of
+         the application (or any library it uses) does that.
+      */
+      static void setEncodeCaching(bool enabled) { mEncodeCaching = enabled; }
+      static bool getEncodeCaching() { return mEncodeCaching; }
+
    protected:
       ParserCategory(PoolBase* pool=0);
 
@@ -288,6 +305,7 @@ class ParserCategory : public LazyParser
       }
 
       virtual const Data& errorContext() const;
+      virtual bool cacheEncoding() const { return mEncodeCaching; }
 
       typedef std::vector<Parameter*, StlPoolAllocator<Parameter*, PoolBase> > ParameterList; 
       ParameterList mParameters;
@@ -297,6 +315,8 @@ class ParserCategory : public LazyParser
    private:
       void clear();
       void copyParametersFrom(const ParserCategory& other);
+
+      static bool mEncodeCaching;
       friend EncodeStream& operator<<(EncodeStream&, const ParserCategory&);
       friend class NameAddr;
 };
@@ -76,6 +76,18 @@ ParserContainerBase::append(const ParserContainerBase& source)
    copyParsers(source.mParsers);
 }
 
+void
+ParserContainerBase::keepEncodings()
+{
+   for (Parsers::iterator i = mParsers.begin(); i != mParsers.end(); ++i)
+   {
+      if (i->pc)
+      {
+         i->pc->keepEncoding();
+      }
+   }
+}
+
 EncodeStream& 
 ParserContainerBase::encode(const Data& headerName, 
                             EncodeStream& str) const
@@ -115,6 +115,11 @@ class ParserContainerBase
         */
       void append(const ParserContainerBase& rhs);
 
+      /**
+        @brief calls keepEncoding() on every parsed element
+        */
+      void keepEncodings();
+
       /**
         @brief pure virtual function to be implemented in derived classes
          The intention is to provide an ability to parse all elements 
@@ -1,6 +1,9 @@
 #ifndef RESIP_SendData_HXX
 #define RESIP_SendData_HXX
 
+#include <memory>
+#include <vector>
+
 #include "rutil/Data.hxx"
 #include "resip/stack/Tuple.hxx"
 
@@ -56,11 +59,71 @@ class SendData
       void clear()
       {
          data.clear();
+         pieces.clear();
+         rawBuffers.reset();
       }
 
       bool empty() const
       {
-         return data.empty();
+         return data.empty() && pieces.empty();
+      }
+
+      /**
+         A run of bytes of a gathered message: length bytes at raw, or, 
+         when raw is 0, length bytes of data starting at offset.
+      */
+      struct Piece
+      {
+         Piece(const char* r, size_t o, size_t l) : raw(r), offset(o), length(l) {}
+         const char* raw;
+         size_t offset;
+         size_t length;
+      };
+
+      /// Most pieces a gathered message is split into; see GatherStream.
+      static const unsigned int MaxPieces = 32;
+
+      /// True if the message is pieces rather than just data.
+      bool isGathered() const
+      {
+         return !pieces.empty();
+      }
+
+      const char* pieceData(const Piece& piece) const
+      {
+         return piece.raw ? piece.raw : data.data() + piece.offset;
+      }
+
+      /// Size of the whole message, gathered or not.
+      size_t size() const
+      {
+         if (pieces.empty())
+         {
+            return data.size();
+         }
+         size_t total = 0;
+         for (std::vector<Piece>::const_iterator i = pieces.begin(); i != pieces.end(); ++i)
+         {
+            total += i->length;
+         }
+         return total;
+      }
+
+      /// Turns a gathered message back into one that is all in data.
+      void flatten()
+      {
+         if (pieces.empty())
+         {
+            return;
+         }
+         Data whole(Data::size_type(size()), Data::Preallocate);
+         for (std::vector<Piece>::const_iterator i = pieces.begin(); i != pieces.end(); ++i)
+         {
+            whole.append(pieceData(*i), Data::size_type(i->length));
+         }
+         data.takeBuf(whole);
+         pieces.clear();
+         rawBuffers.reset();
       }
 
       Tuple destination;
@@ -69,6 +132,13 @@ class SendData
       Data sigcompId;
       bool isAlreadyCompressed;
 
+      // When gathered, data only holds the parts of the message that had 
+      // to be encoded, and pieces says how they interleave with the raw 
+      // regions (from a received message's buffers) that were not copied.
+      // rawBuffers keeps those buffers alive for as long as this is.
+      std::vector<Piece> pieces;
+      std::shared_ptr<const void> rawBuffers;
+
       // .bwc. Used for special commands: ie. to close connections, and enable flow timers
       SendDataCommand command;
 };
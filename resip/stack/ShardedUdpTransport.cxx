@@ -0,0 +1,246 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include "resip/stack/ShardedUdpTransport.hxx"
+#include "resip/stack/TransportThread.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/WinLeakCheck.hxx"
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
+
+using namespace std;
+using namespace resip;
+
+ShardedUdpTransport::ShardedUdpTransport(Fifo<TransactionMessage>& fifo,
+                                         int portNum,
+                                         IpVersion version,
+                                         StunSetting stun,
+                                         const Data& interfaceObj,
+                                         unsigned numShards,
+                                         AfterSocketCreationFuncPtr socketFunc,
+                                         Compression &compression,
+                                         unsigned transportFlags,
+                                         unsigned batchDepth)
+   : Transport(fifo, portNum, version, interfaceObj, Data::Empty,
+               socketFunc, compression, transportFlags)
+{
+   resip_assert(numShards > 0);
+   mTuple.setType(UDP);
+
+   unsigned shardFlags = transportFlags
+                         | RESIP_TRANSPORT_FLAG_OWNTHREAD
+                         | RESIP_TRANSPORT_FLAG_REUSEPORT;
+   try
+   {
+      for (unsigned i = 0; i < numShards; ++i)
+      {
+         // If we were asked for an ephemeral port, every shard after the
+         // first must bind to whatever the first one got.
+         int shardPort = mShards.empty() ? portNum : mShards.front()->port();
+         mShards.push_back(new UdpTransport(fifo, shardPort, version, stun,
+                                            interfaceObj, socketFunc,
+                                            compression, shardFlags, batchDepth));
+      }
+   }
+   catch (BaseException&)
+   {
+      for (vector<UdpTransport*>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+      {
+         delete *it;
+      }
+      mShards.clear();
+      throw;
+   }
+
+   mTuple = mShards.front()->getTuple();
+   mTuple.mFlowKey = 0;
+
+   InfoLog (<< "Creating sharded UDP transport host=" << interfaceObj
+            << " port=" << mTuple.getPort()
+            << " shards=" << numShards);
+}
+
+ShardedUdpTransport::~ShardedUdpTransport()
+{
+   for (vector<TransportThread*>::iterator it = mThreads.begin(); it != mThreads.end(); ++it)
+   {
+      (*it)->shutdown();
+   }
+   for (vector<TransportThread*>::iterator it = mThreads.begin(); it != mThreads.end(); ++it)
+   {
+      (*it)->join();
+      delete *it;
+   }
+   mThreads.clear();
+
+   for (vector<UdpTransport*>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      delete *it;
+   }
+   mShards.clear();
+}
+
+bool
+ShardedUdpTransport::isFinished() const
+{
+   for (vector<UdpTransport*>::const_iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      if (!(*it)->isFinished())
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+UdpTransport*
+ShardedUdpTransport::shardFor(const Tuple& destination) const
+{
+   if (mShards.size() == 1)
+   {
+      return mShards.front();
+   }
+   return mShards[destination.hash() % mShards.size()];
+}
+
+void
+ShardedUdpTransport::send(std::unique_ptr<SendData> data)
+{
+   shardFor(data->destination)->send(std::move(data));
+}
+
+void
+ShardedUdpTransport::poke()
+{
+   for (vector<UdpTransport*>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      (*it)->poke();
+   }
+}
+
+void
+ShardedUdpTransport::startOwnProcessing()
+{
+   resip_assert(mThreads.empty());
+   for (vector<UdpTransport*>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      // Messages received by a shard carry the shard's tuple; make sure it
+      // leads back to us.
+      (*it)->setKey(getKey());
+      mThreads.push_back(new TransportThread(**it));
+      mThreads.back()->run();
+   }
+}
+
+void
+ShardedUdpTransport::shutdown()
+{
+   Transport::shutdown();
+   for (vector<UdpTransport*>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      (*it)->shutdown();
+   }
+}
+
+unsigned int
+ShardedUdpTransport::getFifoSize() const
+{
+   unsigned int size = 0;
+   for (vector<UdpTransport*>::const_iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      size += (*it)->getFifoSize();
+   }
+   return size;
+}
+
+void
+ShardedUdpTransport::invokeAfterSocketCreationFunc() const
+{
+   for (vector<UdpTransport*>::const_iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      (*it)->invokeAfterSocketCreationFunc();
+   }
+}
+
+void
+ShardedUdpTransport::setCongestionManager(CongestionManager* manager)
+{
+   Transport::setCongestionManager(manager);
+   for (vector<UdpTransport*>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      (*it)->setCongestionManager(manager);
+   }
+}
+
+void
+ShardedUdpTransport::setSipMessageLoggingHandler(std::shared_ptr<SipMessageLoggingHandler> handler) noexcept
+{
+   // Messages are received by the shards, and logged by whichever one got
+   // them; sends are logged against this transport.
+   for (vector<UdpTransport*>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      (*it)->setSipMessageLoggingHandler(handler);
+   }
+   Transport::setSipMessageLoggingHandler(std::move(handler));
+}
+
+void
+ShardedUdpTransport::setRcvBufLen(int buflen)
+{
+   for (vector<UdpTransport*>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      (*it)->setRcvBufLen(buflen);
+   }
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
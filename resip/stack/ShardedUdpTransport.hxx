@@ -0,0 +1,153 @@
+#if !defined(RESIP_SHARDEDUDPTRANSPORT_HXX)
+#define RESIP_SHARDEDUDPTRANSPORT_HXX
+
+#include <vector>
+
+#include "resip/stack/Transport.hxx"
+#include "resip/stack/UdpTransport.hxx"
+#include "rutil/HeapInstanceCounter.hxx"
+
+namespace resip
+{
+
+class TransportThread;
+
+/**
+   @ingroup transports
+
+   @brief A UDP Transport that spreads one ip:port over several sockets.
+
+   Opens N UdpTransport shards bound to the same address with SO_REUSEPORT,
+   so that the kernel load-balances incoming datagrams across them, and
+   drives each shard from its own TransportThread. To the rest of the stack
+   (TransportSelector, the TransactionController) this looks like a single
+   Transport: all shards share this transport's key, so responses and
+   retransmissions are routed back here and then handed to a shard.
+   Outbound messages are assigned to a shard by hashing the destination,
+   which keeps messages to any one peer in order.
+
+   Shards are always serviced by their own threads, regardless of whether
+   the SipStack itself is threaded.
+
+   @internal Created by SipStack::addTransport when more than one shard is
+   requested.
+*/
+class ShardedUdpTransport : public Transport
+{
+   public:
+      RESIP_HeapCount(ShardedUdpTransport);
+
+      /**
+         @param numShards number of sockets (and threads) to open; must be
+         at least 1.
+         @param batchDepth datagrams per system call on each shard; see
+         UdpTransport::getBatchDepth().
+
+         @throws Transport::Exception if SO_REUSEPORT is unavailable or any
+         of the shards can not be bound.
+
+         @see UdpTransport::UdpTransport for the remaining parameters.
+      */
+      ShardedUdpTransport(Fifo<TransactionMessage>& fifo,
+                          int portNum,
+                          IpVersion version,
+                          StunSetting stun,
+                          const Data& interfaceObj,
+                          unsigned numShards,
+                          AfterSocketCreationFuncPtr socketFunc = 0,
+                          Compression &compression = Compression::Disabled,
+                          unsigned transportFlags = 0,
+                          unsigned batchDepth = 1);
+      virtual ~ShardedUdpTransport();
+
+      virtual bool isFinished() const;
+      virtual void send(std::unique_ptr<SendData> data);
+      virtual void poke();
+
+      // Shards provide their own cycles; nothing to do in the stack's loop
+      virtual void process(FdSet& fdset) {}
+      virtual void buildFdSet(FdSet& fdset) {}
+      virtual void process() {}
+      virtual void setPollGrp(FdPollGrp *grp) {}
+
+      virtual bool isReliable() const { return false; }
+      virtual bool isDatagram() const { return true; }
+#ifndef WIN32
+      virtual bool supportsGatheredSends() const { return true; }
+#endif
+
+      virtual bool shareStackProcessAndSelect() const { return false; }
+      virtual void startOwnProcessing();
+      virtual bool hasDataToSend() const { return false; }
+      virtual void shutdown();
+
+      virtual unsigned int getFifoSize() const;
+      virtual void invokeAfterSocketCreationFunc() const;
+      virtual void setCongestionManager(CongestionManager* manager);
+      virtual void setRcvBufLen(int buflen);
+      virtual void setSipMessageLoggingHandler(std::shared_ptr<SipMessageLoggingHandler> handler) noexcept;
+
+      unsigned getNumShards() const { return (unsigned)mShards.size(); }
+
+   protected:
+      UdpTransport* shardFor(const Tuple& destination) const;
+
+   private:
+      std::vector<UdpTransport*> mShards;
+      std::vector<TransportThread*> mThreads;
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
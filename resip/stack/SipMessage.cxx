@@ -8,6 +8,7 @@
 #include "resip/stack/HeaderFieldValueList.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/ExtensionHeader.hxx"
+#include "resip/stack/GatherStream.hxx"
 #include "rutil/Coders.hxx"
 #include "rutil/CountStream.hxx"
 #include "rutil/Logger.hxx"
@@ -28,16 +29,25 @@ using namespace std;
 
 bool SipMessage::checkContentLength=true;
 
+ArenaPool::Profile&
+SipMessage::getArenaProfile()
+{
+   static ArenaPool::Profile profile;
+   return profile;
+}
+
 SipMessage::SipMessage(const Tuple *receivedTransportTuple)
    : mIsDecorated(false),
      mIsBadAck200(false),     
      mIsExternal(receivedTransportTuple != 0),  // may be modified later by setFromTU or setFromExternal
+     mPool(getArenaProfile()),
      mHeaders(StlPoolAllocator<HeaderFieldValueList*, PoolBase >(&mPool)),
 #ifndef __SUNPRO_CC
      mUnknownHeaders(StlPoolAllocator<std::pair<Data, HeaderFieldValueList*>, PoolBase >(&mPool)),
 #else
      mUnknownHeaders(),
 #endif
+     mBufferList(StlPoolAllocator<std::pair<char*, size_t>, PoolBase >(&mPool)),
      mRequest(false),
      mResponse(false),
      mInvalid(false),
@@ -54,12 +64,14 @@ SipMessage::SipMessage(const Tuple *receivedTransportTuple)
 }
 
 SipMessage::SipMessage(const SipMessage& from)
-   : mHeaders(StlPoolAllocator<HeaderFieldValueList*, PoolBase >(&mPool)),
+   : mPool(getArenaProfile()),
+     mHeaders(StlPoolAllocator<HeaderFieldValueList*, PoolBase >(&mPool)),
 #ifndef __SUNPRO_CC
      mUnknownHeaders(StlPoolAllocator<std::pair<Data, HeaderFieldValueList*>, PoolBase >(&mPool)),
 #else
      mUnknownHeaders(),
 #endif
+     mBufferList(StlPoolAllocator<std::pair<char*, size_t>, PoolBase >(&mPool)),
      mCreatedTime(Timer::getTimeMicroSec())
 {
    init(from);
@@ -84,8 +96,8 @@ SipMessage::operator=(const SipMessage& rhs)
 
 SipMessage::~SipMessage()
 {
-//#define DINKYPOOL_PROFILING
-#ifdef DINKYPOOL_PROFILING
+//#define ARENAPOOL_PROFILING
+#ifdef ARENAPOOL_PROFILING
    if (mPool.getHeapBytes() > 0)
    {
        InfoLog(<< "SipMessage mPool filled up and used " << mPool.getHeapBytes() << " bytes on the heap, consider increasing the mPool size (sizeof SipMessage is " << sizeof(SipMessage) << " bytes): msg="
@@ -149,13 +161,17 @@ SipMessage::init(const SipMessage& rhs)
 
    memcpy(&mHeaderIndices,&rhs.mHeaderIndices,sizeof(mHeaderIndices));
 
+   // Text rhs has not parsed yet is referred to in its receive buffers,
+   // which we share, rather than copied.
+   mSharedBuffers = rhs.mSharedBuffers;
+
    // .bwc. Clear out the pesky invalid 0 index.
    clearHeaders();
    mHeaders.reserve(rhs.mHeaders.size());
    for (TypedHeaders::const_iterator i = rhs.mHeaders.begin();
         i != rhs.mHeaders.end(); i++)
    {
-      mHeaders.push_back(getCopyHfvl(**i));
+      mHeaders.push_back(getSharingCopyHfvl(**i));
    }
 
    for (UnknownHeaders::const_iterator i = rhs.mUnknownHeaders.begin();
@@ -163,7 +179,7 @@ SipMessage::init(const SipMessage& rhs)
    {
       mUnknownHeaders.push_back(pair<Data, HeaderFieldValueList*>(
                                    i->first,
-                                   getCopyHfvl(*i->second)));
+                                   getSharingCopyHfvl(*i->second)));
    }
    if (rhs.mStartLine != 0)
    {
@@ -175,7 +191,14 @@ SipMessage::init(const SipMessage& rhs)
    }
    else if (rhs.mContentsHfv.getBuffer() != 0)
    {
-      mContentsHfv.copyWithPadding(rhs.mContentsHfv);
+      if (isShared(rhs.mContentsHfv.getBuffer(), rhs.mContentsHfv.getLength()))
+      {
+         mContentsHfv.init(rhs.mContentsHfv.getBuffer(), rhs.mContentsHfv.getLength(), false);
+      }
+      else
+      {
+         mContentsHfv.copyWithPadding(rhs.mContentsHfv);
+      }
    }
    else
    {
@@ -233,11 +256,12 @@ SipMessage::freeMem(bool leaveResponseStuff)
    {
       clearHeaders();
 
-      for (vector<char*>::iterator i = mBufferList.begin();
+      for (BufferList::iterator i = mBufferList.begin();
            i != mBufferList.end(); i++)
       {
-         delete [] *i;
+         delete [] i->first;
       }
+      mSharedBuffers.reset();
    }
 
    if(mStartLine)
@@ -277,7 +301,7 @@ SipMessage::make(const Data& data, bool isExternal)
    size_t len = data.size();
    char *buffer = new char[len + 5];
 
-   msg->addBuffer(buffer);
+   msg->addBuffer(buffer, len);
    memcpy(buffer,data.data(), len);
    MsgHeaderScanner msgHeaderScanner;
    msgHeaderScanner.prepareForMessage(msg);
@@ -382,6 +406,18 @@ SipMessage::getTransactionId() const
    }
 }
 
+size_t
+SipMessage::getTransactionIdHash() const
+{
+   const Data& tid = getTransactionId();
+   const Via& via = header(h_Vias).front();
+   if (via.exists(p_branch) && &via.param(p_branch).getTransactionId() == &tid)
+   {
+      return via.param(p_branch).getTransactionIdHash();
+   }
+   return tid.caseInsensitiveTokenHash();
+}
+
 void
 SipMessage::compute2543TransactionHash() const
 {
@@ -860,10 +896,134 @@ SipMessage::encodeEmbedded(EncodeStream& str) const
    return str;
 }
 
+// Receive buffers shared between a message, its copies and the SendData
+// encoded from them. Never written to once shared.
+class SipMessage::SharedBuffers
+{
+   public:
+      SharedBuffers(const std::shared_ptr<SharedBuffers>& older)
+         : mOlder(older)
+      {}
+
+      ~SharedBuffers()
+      {
+         for (std::vector<std::pair<char*, size_t> >::iterator i = mBuffers.begin();
+              i != mBuffers.end(); ++i)
+         {
+            delete [] i->first;
+         }
+      }
+
+      std::vector<std::pair<char*, size_t> > mBuffers;
+      // buffers that were shared before these were added to the message
+      std::shared_ptr<SharedBuffers> mOlder;
+};
+
 void
-SipMessage::addBuffer(char* buf)
+SipMessage::addBuffer(char* buf, size_t size)
 {
-   mBufferList.push_back(buf);
+   if (size == 0)
+   {
+      mBufferList.push_back(std::make_pair(buf, size));
+      return;
+   }
+
+   // Only this message refers to mSharedBuffers until it is copied or
+   // encoded; after that, later buffers go into a new generation.
+   if (!mSharedBuffers || mSharedBuffers.use_count() > 1)
+   {
+      mSharedBuffers = std::make_shared<SharedBuffers>(mSharedBuffers);
+   }
+   mSharedBuffers->mBuffers.push_back(std::make_pair(buf, size));
+}
+
+bool
+SipMessage::isShared(const char* start, size_t size) const
+{
+   for (const SharedBuffers* shared = mSharedBuffers.get(); shared; shared = shared->mOlder.get())
+   {
+      for (std::vector<std::pair<char*, size_t> >::const_iterator i = shared->mBuffers.begin();
+           i != shared->mBuffers.end(); ++i)
+      {
+         if (start >= i->first && start + size <= i->first + i->second)
+         {
+            return true;
+         }
+      }
+   }
+   return false;
+}
+
+HeaderFieldValueList*
+SipMessage::getSharingCopyHfvl(const HeaderFieldValueList& hfvl)
+{
+   if (hfvl.getParserContainer() != 0 || !mSharedBuffers)
+   {
+      return getCopyHfvl(hfvl);
+   }
+
+   HeaderFieldValueList* copy = getEmptyHfvl();
+   copy->reserve(hfvl.size());
+   for (HeaderFieldValueList::const_iterator i = hfvl.begin(); i != hfvl.end(); ++i)
+   {
+      if (isShared(i->getBuffer(), i->getLength()))
+      {
+         copy->push_back(i->getBuffer(), i->getLength(), false);
+      }
+      else
+      {
+         copy->push_back(0, 0, false);
+         *copy->back() = *i;
+      }
+   }
+   return copy;
+}
+
+void
+SipMessage::encodeGathered(GatherStream& str)
+{
+   for (const SharedBuffers* shared = mSharedBuffers.get(); shared; shared = shared->mOlder.get())
+   {
+      for (std::vector<std::pair<char*, size_t> >::const_iterator i = shared->mBuffers.begin();
+           i != shared->mBuffers.end(); ++i)
+      {
+         str.addRegion(i->first, i->second);
+      }
+   }
+   str.keepAlive(mSharedBuffers);
+   encode(str);
+   str.finish();
+}
+
+void
+SipMessage::keepHeaderEncodings()
+{
+   if (!ParserCategory::getEncodeCaching())
+   {
+      return;
+   }
+
+   for (UInt8 i = 0; i < Headers::MAX_HEADERS; i++)
+   {
+      if (mHeaderIndices[i] > 0)
+      {
+         ParserContainerBase* pc = mHeaders[mHeaderIndices[i]]->getParserContainer();
+         if (pc)
+         {
+            pc->keepEncodings();
+         }
+      }
+   }
+
+   for (UnknownHeaders::iterator i = mUnknownHeaders.begin(); 
+        i != mUnknownHeaders.end(); i++)
+   {
+      ParserContainerBase* pc = i->second->getParserContainer();
+      if (pc)
+      {
+         pc->keepEncodings();
+      }
+   }
 }
 
 void 
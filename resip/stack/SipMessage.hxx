@@ -21,7 +21,7 @@
 #include "resip/stack/WsCookieContext.hxx"
 #include "rutil/BaseException.hxx"
 #include "rutil/Data.hxx"
-#include "rutil/DinkyPool.hxx"
+#include "rutil/ArenaPool.hxx"
 #include "rutil/StlPoolAllocator.hxx"
 #include "rutil/Timer.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
@@ -31,6 +31,7 @@ namespace resip
 
 class Contents;
 class ExtensionHeader;
+class GatherStream;
 class SecurityAttributes;
 
 /**
@@ -172,6 +173,10 @@ class SipMessage : public TransactionMessage
       /// Returns the transaction id from the branch or if 2543, the computed hash.
       virtual const Data& getTransactionId() const;
 
+      /// Returns the hash of getTransactionId(), which for a branch tid was
+      /// already computed when the Via was parsed.
+      virtual size_t getTransactionIdHash() const;
+
       /**
          @brief Calculates an MD5 hash over the Request-URI, To tag (for
          non-INVITE transactions), From tag, Call-ID, CSeq (including
@@ -195,6 +200,19 @@ class SipMessage : public TransactionMessage
       
       static bool checkContentLength;
 
+      /**
+      @brief The sizing policy shared by the arenas of all SipMessages.
+
+      Everything a SipMessage allocates while it is parsed (header lists, 
+      parser containers, parsed headers and their parameters) comes out of 
+      a per-message arena that is freed in one go with the message. The 
+      first 3732 bytes are part of the SipMessage itself; past that the 
+      arena takes heap blocks whose size follows the observed size of 
+      recent messages. Use this to bound that sizing, to cap how much a 
+      single message may take in blocks, or to turn block chaining off.
+      */
+      static ArenaPool::Profile& getArenaProfile();
+
       /**
       @brief Base exception for SipMessage related exceptions
       */
@@ -271,6 +289,26 @@ class SipMessage : public TransactionMessage
       virtual EncodeStream& encodeBrief(EncodeStream& str) const;
       EncodeStream& encodeSingleHeader(Headers::Type type, EncodeStream& str) const;
 
+      /** @brief Encodes the message for a transport that can send from 
+          several buffers at once.
+
+          Unparsed headers and an unparsed body that are still in the 
+          buffers the message was received in are referred to there rather 
+          than copied. Those buffers become shared with the SendData being 
+          encoded into, so they live as long as either of them needs them.
+      */
+      void encodeGathered(GatherStream& str);
+
+      /** @brief Keeps the encoding of every header that has been modified, 
+          so that later encodes of this message (or of copies of it) just 
+          copy the bytes out.
+
+          Does nothing unless ParserCategory::setEncodeCaching(true) has 
+          been called. Call it from the thread that owns the message, once 
+          it is done modifying the headers.
+      */
+      void keepHeaderEncodings();
+
       /// Returns true if message is a request, false otherwise
       inline bool isRequest() const {return mRequest;}
       /// Returns true if message is a response, false otherwise
@@ -533,7 +571,14 @@ class SipMessage : public TransactionMessage
       void setDestination(const Tuple& tuple) { mDestination = tuple; }
       Tuple& getDestination() { return mDestination; }
 
-      void addBuffer(char* buf);
+      /** @brief Hands the message a buffer it was parsed from, to be freed 
+          with delete[] when no longer needed.
+
+          @param size The size of the buffer. When given, copies of this 
+          message and encodeGathered() can refer to the unparsed text in it 
+          instead of copying it.
+      */
+      void addBuffer(char* buf, size_t size=0);
 
       UInt64 getCreatedTimeMicroSec() const {return mCreatedTime;}
 
@@ -633,6 +678,11 @@ class SipMessage : public TransactionMessage
          return new (ptr) HeaderFieldValueList(hfvl, mPool);
       }
 
+      HeaderFieldValueList* getSharingCopyHfvl(const HeaderFieldValueList& hfvl);
+
+      class SharedBuffers;
+      bool isShared(const char* start, size_t size) const;
+
       inline void freeHfvl(HeaderFieldValueList* hfvl)
       {
          if(hfvl)
@@ -663,10 +713,10 @@ class SipMessage : public TransactionMessage
       bool mIsExternal;
 
       // Sizing so that average SipMessages don't need to allocate heap memory
-      // To profile current sizing, enable DINKYPOOL_PROFILING in SipMessage.cxx 
+      // To profile current sizing, enable ARENAPOOL_PROFILING in SipMessage.cxx 
       // and look for DebugLog message in SipMessage destructor to know when heap
       // allocations are occuring and how much of the pool is used.
-      DinkyPool<3732> mPool;
+      InlineArenaPool<3732> mPool;
 
       typedef std::vector<HeaderFieldValueList*, 
                            StlPoolAllocator<HeaderFieldValueList*, 
@@ -691,8 +741,17 @@ class SipMessage : public TransactionMessage
       // Used by the TU to specify where a message is to go
       Tuple mDestination;
       
-      // Raw buffers coming from the Transport. message manages the memory
-      std::vector<char*> mBufferList;
+      // Raw buffers coming from the Transport, and their sizes (0 when not
+      // known). message manages the memory
+      typedef std::vector<std::pair<char*, size_t>, 
+                          StlPoolAllocator<std::pair<char*, size_t>, PoolBase> > BufferList;
+      BufferList mBufferList;
+
+      // Raw buffers of known size, which copies of this message and gathered
+      // encodes may also refer to. addBuffer() puts them here while the
+      // message is still being built, so copying a message never modifies
+      // it.
+      std::shared_ptr<SharedBuffers> mSharedBuffers;
 
       // special case for the first line of message
       StartLine* mStartLine;
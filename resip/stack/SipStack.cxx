@@ -30,6 +30,7 @@
 #include "rutil/AsyncProcessHandler.hxx"
 #include "resip/stack/TcpTransport.hxx"
 #include "resip/stack/UdpTransport.hxx"
+#include "resip/stack/ShardedUdpTransport.hxx"
 #include "resip/stack/WsTransport.hxx"
 #include "resip/stack/TransactionUser.hxx"
 #include "resip/stack/TransactionUserMessage.hxx"
@@ -196,6 +197,16 @@ SipStack::init(const SipStackOptions& options)
          mAsyncProcessHandler,
          mPollGrp);
    mDnsThread = 0;
+   for(unsigned int i=1; i<options.mDnsShards; ++i)
+   {
+      mDnsShards.push_back(new DnsStub(
+            options.mExtraNameserverList
+                   ? *options.mExtraNameserverList : DnsStub::EmptyNameserverList,
+            options.mSocketFunc,
+            mAsyncProcessHandler,
+            mPollGrp,
+            mDnsStub));
+   }
 
    mCompression = options.mCompression
          ? options.mCompression : new Compression(Compression::NONE);
@@ -204,8 +215,14 @@ SipStack::init(const SipStackOptions& options)
 
    // WATCHOUT: the transaction controller constructor will
    // grab the security, DnsStub, compression and statsManager
-   mTransactionController = new TransactionController(*this, mAsyncProcessHandler, options.mUseDnsVip);
+   mTransactionController = new TransactionController(*this, mAsyncProcessHandler, options.mUseDnsVip,
+                                                      resipMax(options.mTransactionControllerShards, 1U));
    mTransactionController->transportSelector().setPollGrp(mPollGrp);
+   mTransactionController->transportSelector().setGatheredEncoding(options.mGatheredEncoding);
+   for(size_t i=0; i<mDnsShards.size(); ++i)
+   {
+      mTransactionController->transportSelector().addDnsShard(*mDnsShards[i]);
+   }
    mTransactionControllerThread = 0;
    mTransportSelectorThread = 0;
 
@@ -228,8 +245,18 @@ SipStack::~SipStack()
 
    delete mDnsThread;
    mDnsThread=0;
+   for(size_t i=0; i<mDnsShardThreads.size(); ++i)
+   {
+      delete mDnsShardThreads[i];
+   }
+   mDnsShardThreads.clear();
    delete mTransactionControllerThread;
    mTransactionControllerThread=0;
+   for(size_t i=0; i<mTransactionControllerShardThreads.size(); ++i)
+   {
+      delete mTransactionControllerShardThreads[i];
+   }
+   mTransactionControllerShardThreads.clear();
    delete mTransportSelectorThread;
    mTransportSelectorThread=0;
 
@@ -239,6 +266,11 @@ SipStack::~SipStack()
 #endif
    delete mCompression;
 
+   for(size_t i=0; i<mDnsShards.size(); ++i)
+   {
+      delete mDnsShards[i];
+   }
+   mDnsShards.clear();
    delete mDnsStub;
    if (mPollGrpIsMine)
    {
@@ -267,10 +299,32 @@ SipStack::run()
    mDnsThread=new DnsThread(*mDnsStub);
    mDnsThread->run();
 
+   for(size_t i=0; i<mDnsShardThreads.size(); ++i)
+   {
+      delete mDnsShardThreads[i];
+   }
+   mDnsShardThreads.clear();
+   for(size_t i=0; i<mDnsShards.size(); ++i)
+   {
+      mDnsShardThreads.push_back(new DnsThread(*mDnsShards[i]));
+      mDnsShardThreads.back()->run();
+   }
+
    delete mTransactionControllerThread;
    mTransactionControllerThread=new TransactionControllerThread(*mTransactionController);
    mTransactionControllerThread->run();
 
+   for(size_t i=0; i<mTransactionControllerShardThreads.size(); ++i)
+   {
+      delete mTransactionControllerShardThreads[i];
+   }
+   mTransactionControllerShardThreads.clear();
+   for(unsigned int i=1; i<mTransactionController->getNumShards(); ++i)
+   {
+      mTransactionControllerShardThreads.push_back(new TransactionControllerThread(mTransactionController->getShard(i)));
+      mTransactionControllerShardThreads.back()->run();
+   }
+
    delete mTransportSelectorThread;
    mTransportSelectorThread=new TransportSelectorThread(mTransactionController->transportSelector());
    mTransportSelectorThread->run();
@@ -299,12 +353,24 @@ SipStack::shutdownAndJoinThreads()
       mDnsThread->join();
    }
 
+   for(size_t i=0; i<mDnsShardThreads.size(); ++i)
+   {
+      mDnsShardThreads[i]->shutdown();
+      mDnsShardThreads[i]->join();
+   }
+
    if(mTransactionControllerThread)
    {
       mTransactionControllerThread->shutdown();
       mTransactionControllerThread->join();
    }
 
+   for(size_t i=0; i<mTransactionControllerShardThreads.size(); ++i)
+   {
+      mTransactionControllerShardThreads[i]->shutdown();
+      mTransactionControllerShardThreads[i]->join();
+   }
+
    if(mTransportSelectorThread)
    {
       mTransportSelectorThread->shutdown();
@@ -343,7 +409,9 @@ SipStack::addTransport( TransportType protocol,
                         bool useEmailAsSIP,
                         std::shared_ptr<WsConnectionValidator> wsConnectionValidator,
                         std::shared_ptr<WsCookieContextFactory> wsCookieContextFactory,
-                        const Data& netNs)
+                        const Data& netNs,
+                        unsigned numShards,
+                        unsigned batchDepth)
 {
    resip_assert(!mShuttingDown);
 
@@ -380,14 +448,21 @@ SipStack::addTransport( TransportType protocol,
    }
 #endif
 
-   InternalTransport* transport=0;
+   Transport* transport=0;
    Fifo<TransactionMessage>& stateMacFifo = mTransactionController->transportSelector().stateMacFifo();
    try
    {
       switch (protocol)
       {
          case UDP:
-            transport = new UdpTransport(stateMacFifo, port, version, stun, ipInterface, mSocketFunc, *mCompression, transportFlags);
+            if (numShards > 1)
+            {
+               transport = new ShardedUdpTransport(stateMacFifo, port, version, stun, ipInterface, numShards, mSocketFunc, *mCompression, transportFlags, batchDepth);
+            }
+            else
+            {
+               transport = new UdpTransport(stateMacFifo, port, version, stun, ipInterface, mSocketFunc, *mCompression, transportFlags, batchDepth);
+            }
             break;
          case TCP:
             transport = 
@@ -1068,12 +1143,19 @@ SipStack::processTimers()
 {
    if(!mTransactionControllerThread)
    {
-      mTransactionController->process();
+      for(unsigned int i=0; i<mTransactionController->getNumShards(); ++i)
+      {
+         mTransactionController->getShard(i).process();
+      }
    }
 
    if(!mDnsThread)
    {
       mDnsStub->processTimers();
+      for(size_t i=0; i<mDnsShards.size(); ++i)
+      {
+         mDnsShards[i]->processTimers();
+      }
    }
 
    if(!mTransportSelectorThread)
@@ -1114,8 +1196,21 @@ SipStack::getTimeTillNextProcessMS()
 
    unsigned int dnsNextProcess = (mDnsThread ? 
                            INT_MAX : mDnsStub->getTimeTillNextProcessMS());
-   unsigned int tcNextProcess = mTransactionControllerThread ? INT_MAX : 
-                           mTransactionController->getTimeTillNextProcessMS();
+   if(!mDnsThread)
+   {
+      for(size_t i=0; i<mDnsShards.size(); ++i)
+      {
+         dnsNextProcess = resipMin(dnsNextProcess, mDnsShards[i]->getTimeTillNextProcessMS());
+      }
+   }
+   unsigned int tcNextProcess = INT_MAX;
+   if(!mTransactionControllerThread)
+   {
+      for(unsigned int i=0; i<mTransactionController->getNumShards(); ++i)
+      {
+         tcNextProcess = resipMin(tcNextProcess, mTransactionController->getShard(i).getTimeTillNextProcessMS());
+      }
+   }
    unsigned int tsNextProcess = mTransportSelectorThread ? INT_MAX : mTransactionController->transportSelector().getTimeTillNextProcessMS();
 
    return resipMin(Timer::getMaxSystemTimeWaitMs(),
@@ -1205,12 +1300,20 @@ void
 SipStack::setEnumSuffixes(const std::vector<Data>& suffixes)
 {
    mDnsStub->setEnumSuffixes(suffixes);
+   for(size_t i=0; i<mDnsShards.size(); ++i)
+   {
+      mDnsShards[i]->setEnumSuffixes(suffixes);
+   }
 }
 
 void
 SipStack::setEnumDomains(const std::map<Data,Data>& domains)
 {
    mDnsStub->setEnumDomains(domains);
+   for(size_t i=0; i<mDnsShards.size(); ++i)
+   {
+      mDnsShards[i]->setEnumDomains(domains);
+   }
 }
 
 void
@@ -1225,6 +1328,18 @@ SipStack::logDnsCache()
    mDnsStub->logDnsCache();
 }
 
+bool
+SipStack::saveDnsSnapshot(const Data& filename)
+{
+   return mTransactionController->transportSelector().saveDnsSnapshot(filename);
+}
+
+bool
+SipStack::loadDnsSnapshot(const Data& filename)
+{
+   return mTransactionController->transportSelector().loadDnsSnapshot(filename);
+}
+
 void 
 SipStack::getDnsCacheDump(std::pair<unsigned long, unsigned long> key, GetDnsCacheDumpHandler* handler)
 {
@@ -1235,6 +1350,10 @@ void
 SipStack::reloadDnsServers()
 {
    mDnsStub->reloadDnsServers();
+   for(size_t i=0; i<mDnsShards.size(); ++i)
+   {
+      mDnsShards[i]->reloadDnsServers();
+   }
 }
 
 volatile bool&
@@ -1258,13 +1377,13 @@ SipStack::dump(EncodeStream& strm)  const
       strm << "domains: " << Inserter(this->mDomains) << std::endl;
    }
    strm << " TUFifo size=" << this->mTUFifo.size() << std::endl
-        << " Timers size=" << this->mTransactionController->mTimers.size() << std::endl;
+        << " Timers size=" << this->mTransactionController->getTimerQueueSize() << std::endl;
    {
       Lock lock(mAppTimerMutex);
       strm << " AppTimers size=" << this->mAppTimers.size() << std::endl;
    }
-   strm << " ServerTransactionMap size=" << this->mTransactionController->mServerTransactionMap.size() << std::endl
-        << " ClientTransactionMap size=" << this->mTransactionController->mClientTransactionMap.size() << std::endl
+   strm << " ServerTransactionMap size=" << this->mTransactionController->getNumServerTransactions() << std::endl
+        << " ClientTransactionMap size=" << this->mTransactionController->getNumClientTransactions() << std::endl
         // !slg! TODO - There is technically a threading concern with the following three lines and the runtime addTransport or removeTransport call
         << " Exact interface / Specific port=" << Inserter(this->mTransactionController->mTransportSelector.mExactTransports) << std::endl
         << " Any interface / Specific port=" << Inserter(this->mTransactionController->mTransportSelector.mAnyInterfaceTransports) << std::endl
@@ -103,6 +103,27 @@ class FdPollGrp;
            Set to true to enable Whitelisting of DNS entries.  A feature
            that usually desired by UA's that want to stick to a known
            good server / dns result.
+
+        mTransactionControllerShards
+           Number of TransactionControllers the transaction load is split
+           across, by hash of the transaction id (Via branch). With run(),
+           each gets its own TransactionControllerThread. Defaults to 1.
+           Transports should be added before run() when this is more than
+           one, since every shard reads the TransportSelector's tables.
+
+        mGatheredEncoding
+           Set to true to encode outgoing messages on datagram transports
+           into a list of pieces that point straight into the receive
+           buffers of the message they were copied from, instead of into
+           one contiguous buffer. The pieces are sent with sendmsg(), so
+           a proxied request is not copied on the way out. Defaults to
+           false.
+
+        mDnsShards
+           Number of DnsStubs (each with its own resolver channel) that DNS
+           resolution is spread across, by hash of the name being resolved.
+           They share one DNS cache. With run(), each gets its own
+           DnsThread. Defaults to 1.
 **/
 class SipStackOptions
 {
@@ -111,7 +132,8 @@ class SipStackOptions
          : mSecurity(0), mExtraNameserverList(0),
            mAsyncProcessHandler(0), mStateless(false),
            mSocketFunc(0), mCompression(0), mPollGrp(0),
-           mUseDnsVip(false)
+           mUseDnsVip(false), mTransactionControllerShards(1),
+           mGatheredEncoding(false), mDnsShards(1)
       {
       }
 
@@ -123,6 +145,9 @@ class SipStackOptions
       Compression *mCompression;
       FdPollGrp* mPollGrp;
       bool mUseDnsVip;
+      unsigned int mTransactionControllerShards;
+      bool mGatheredEncoding;
+      unsigned int mDnsShards;
 };
 
 
@@ -353,6 +378,15 @@ class SipStack : public FdSetIOObserver
          @param netNs                 Set the network namespace (netns) in which the Transport is
                                       to bind the the given address and port.
 
+         @param numShards             UDP only: number of sockets to open on the same address
+                                      and port (using SO_REUSEPORT), each serviced by its own
+                                      thread.  Values greater than 1 create a
+                                      ShardedUdpTransport.  Ignored for other protocols.
+
+         @param batchDepth            UDP only: number of datagrams read or written per system
+                                      call (recvmmsg/sendmmsg), for each shard.  1 reads and
+                                      writes one at a time.  Ignored for other protocols.
+
       */
       Transport* addTransport(TransportType protocol,
                               int port,
@@ -368,7 +402,9 @@ class SipStack : public FdSetIOObserver
                               bool useEmailAsSIP = false,
                               std::shared_ptr<WsConnectionValidator> = nullptr,
                               std::shared_ptr<WsCookieContextFactory> = nullptr,
-                              const Data& netNs = Data::Empty
+                              const Data& netNs = Data::Empty,
+                              unsigned numShards = 1,
+                              unsigned batchDepth = 1
                              );
 
       /**
@@ -908,6 +944,26 @@ class SipStack : public FdSetIOObserver
       */
       void logDnsCache();
 
+      /**
+          @brief Save the DNS cache to a file, for a restarted stack to load
+
+          @details Writes the unexpired DNS cache entries with their TTLs,
+          the DNS vips and the grey/blacklisted targets to a compact binary
+          file. Call it on shutdown, and loadDnsSnapshot() on startup, so the
+          first requests after a restart do not all wait on fresh
+          NAPTR/SRV/A resolution.
+      */
+      bool saveDnsSnapshot(const Data& filename);
+
+      /**
+          @brief Load a file written by saveDnsSnapshot()
+
+          @details Entries that expired while the stack was down are
+          dropped, and entries already resolved since startup are kept.
+          Returns false if there is no snapshot or it is corrupt.
+      */
+      bool loadDnsSnapshot(const Data& filename);
+
       /**
           @brief Get a string representation of the DNS Cache. 
           @param key - a pair representing the request key, can be used
@@ -947,7 +1003,7 @@ class SipStack : public FdSetIOObserver
       */
       bool getFixBadDialogIdentifiers() const 
       {
-         return mTransactionController->mFixBadDialogIdentifiers;
+         return mTransactionController->getFixBadDialogIdentifiers();
       }
 
       /**
@@ -965,7 +1021,7 @@ class SipStack : public FdSetIOObserver
       */
       void setFixBadDialogIdentifiers(bool pFixBadDialogIdentifiers) 
       {
-         mTransactionController->mFixBadDialogIdentifiers = pFixBadDialogIdentifiers;
+         mTransactionController->setFixBadDialogIdentifiers(pFixBadDialogIdentifiers);
       }
 
       inline bool getFixBadCSeqNumbers() const
@@ -1112,6 +1168,9 @@ class SipStack : public FdSetIOObserver
 
       DnsStub* mDnsStub;
       DnsThread* mDnsThread;
+      /** @brief DnsStubs 1..N-1, sharing mDnsStub's cache, and their threads **/
+      std::vector<DnsStub*> mDnsShards;
+      std::vector<DnsThread*> mDnsShardThreads;
 
       /** @brief If this object exists, it manages compression parameters **/
       Compression* mCompression;
@@ -1158,6 +1217,8 @@ class SipStack : public FdSetIOObserver
       TransactionController* mTransactionController;
 
       TransactionControllerThread* mTransactionControllerThread;
+      /** @brief threads for TransactionController shards 1..N-1 **/
+      std::vector<TransactionControllerThread*> mTransactionControllerShardThreads;
       TransportSelectorThread* mTransportSelectorThread;
       bool mInternalThreadsRunning;
       bool mProcessingHasStarted; 
@@ -2,6 +2,7 @@
 #include "config.h"
 #endif
 
+#include "rutil/Lock.hxx"
 #include "rutil/Logger.hxx"
 #include "resip/stack/StatisticsManager.hxx"
 #include "resip/stack/SipMessage.hxx"
@@ -26,6 +27,29 @@ StatisticsManager::~StatisticsManager()
 {
    if ( mPublicPayload )
        delete mPublicPayload;
+   for (vector<StatisticsShard*>::iterator i = mShards.begin(); i != mShards.end(); ++i)
+   {
+      delete *i;
+   }
+}
+
+StatisticsShard&
+StatisticsManager::addShard()
+{
+   Lock lock(mShardsMutex);
+   mShards.push_back(new StatisticsShard);
+   return *mShards.back();
+}
+
+void
+StatisticsManager::zeroOut()
+{
+   Payload::zeroOut();
+   Lock lock(mShardsMutex);
+   for (vector<StatisticsShard*>::iterator i = mShards.begin(); i != mShards.end(); ++i)
+   {
+      (*i)->zeroOut();
+   }
 }
 
 void 
@@ -35,8 +59,18 @@ StatisticsManager::setInterval(unsigned long intervalSecs)
 }
 
 void 
-StatisticsManager::poll()
+StatisticsManager::poll(bool requested)
 {
+   // totals are rebuilt from the shards each time
+   Payload::zeroOut();
+   {
+      Lock lock(mShardsMutex);
+      for (vector<StatisticsShard*>::iterator i = mShards.begin(); i != mShards.end(); ++i)
+      {
+         (*i)->addTo(*this);
+      }
+   }
+
    // get snapshot data now..
    tuFifoSize = mStack.mTransactionController->getTuFifoSize();
    transportFifoSizeSum = mStack.mTransactionController->sumTransportFifoSizes();
@@ -44,6 +78,22 @@ StatisticsManager::poll()
    activeTimers = mStack.mTransactionController->getTimerQueueSize();
    activeClientTransactions = mStack.mTransactionController->getNumClientTransactions();
    activeServerTransactions = mStack.mTransactionController->getNumServerTransactions();
+   mStack.mTransactionController->sumConnectionStatistics(openTcpConnections, connectionBufferBytes,
+                                                          connectionWrites, connectionMessagesWritten);
+   mStack.mTransactionController->sumTlsHandshakeStatistics(tlsFullHandshakes, tlsResumedHandshakes);
+
+   DnsStub::CacheStatistics dnsStats;
+   mStack.getDnsStub().getCacheStatistics(dnsStats);
+   for(size_t i=0; i<mStack.mDnsShards.size(); ++i)
+   {
+      DnsStub::CacheStatistics shardStats;
+      mStack.mDnsShards[i]->getCacheStatistics(shardStats);
+      dnsStats += shardStats;
+   }
+   dnsCacheHits = dnsStats.hits;
+   dnsCacheMisses = dnsStats.misses;
+   dnsCacheStaleHits = dnsStats.staleHits;
+   dnsPrefetches = dnsStats.prefetches;
 
    // .kw. At last check payload was > 146kB, which seems too large
    // to alloc on stack. Also, the post'd message has reference
@@ -57,7 +107,7 @@ StatisticsManager::poll()
    mPublicPayload->loadIn(*this);
 
    bool postToStack = true;
-   StatisticsMessage msg(*mPublicPayload);
+   StatisticsMessage msg(*mPublicPayload, requested);
    // WATCHOUT: msg contains reference to the payload, and this reference
    // is preserved thru clone().
 
@@ -71,13 +121,6 @@ StatisticsManager::poll()
       // let the app do what it wants with it
       mStack.post(msg);
    }
-   
-   // !bwc! TODO maybe change this? Or is a flexible implementation of 
-   // CongestionManager::logCurrentState() enough?
-   if(mStack.mCongestionManager)
-   {
-      mStack.mCongestionManager->logCurrentState();
-   }
 }
 
 void 
@@ -85,20 +128,142 @@ StatisticsManager::process()
 {
    if (Timer::getTimeMs() >= mNextPoll)
    {
-      poll();
+      poll(false);
       mNextPoll += mInterval;
+
+      // Only the periodic poll logs the fifos; polls requested through
+      // SipStack::pollStatistics() (eg. by a metrics scraper) may be
+      // frequent.
+      // !bwc! TODO maybe change this? Or is a flexible implementation of 
+      // CongestionManager::logCurrentState() enough?
+      if(mStack.mCongestionManager)
+      {
+         mStack.mCongestionManager->logCurrentState();
+      }
+   }
+}
+
+StatisticsShard::StatisticsShard()
+   : mZeroOutPending(false)
+{
+   clear();
+}
+
+template<size_t N>
+static void
+clearCounters(std::atomic<unsigned int> (&counters)[N])
+{
+   for (size_t i = 0; i < N; ++i)
+   {
+      counters[i].store(0, std::memory_order_relaxed);
+   }
+}
+
+template<size_t N, size_t M>
+static void
+clearCounters(std::atomic<unsigned int> (&counters)[N][M])
+{
+   for (size_t i = 0; i < N; ++i)
+   {
+      clearCounters(counters[i]);
    }
 }
 
-bool
-StatisticsManager::sent(SipMessage* msg)
+template<size_t N>
+static void
+addCounters(unsigned int (&to)[N], const std::atomic<unsigned int> (&counters)[N])
 {
+   for (size_t i = 0; i < N; ++i)
+   {
+      to[i] += counters[i].load(std::memory_order_relaxed);
+   }
+}
+
+template<size_t N, size_t M>
+static void
+addCounters(unsigned int (&to)[N][M], const std::atomic<unsigned int> (&counters)[N][M])
+{
+   for (size_t i = 0; i < N; ++i)
+   {
+      addCounters(to[i], counters[i]);
+   }
+}
+
+void
+StatisticsShard::clear()
+{
+   mRequestsSent.store(0, std::memory_order_relaxed);
+   mResponsesSent.store(0, std::memory_order_relaxed);
+   mRequestsRetransmitted.store(0, std::memory_order_relaxed);
+   mResponsesRetransmitted.store(0, std::memory_order_relaxed);
+   mRequestsReceived.store(0, std::memory_order_relaxed);
+   mResponsesReceived.store(0, std::memory_order_relaxed);
+   clearCounters(mRequestsSentByMethod);
+   clearCounters(mRequestsRetransmittedByMethod);
+   clearCounters(mRequestsReceivedByMethod);
+   clearCounters(mResponsesSentByMethod);
+   clearCounters(mResponsesRetransmittedByMethod);
+   clearCounters(mResponsesReceivedByMethod);
+   clearCounters(mResponsesSentByMethodByCode);
+   clearCounters(mResponsesRetransmittedByMethodByCode);
+   clearCounters(mResponsesReceivedByMethodByCode);
+   mTransactionSetupTime.reset();
+   for (int i = 0; i < MAX_METHODS; ++i)
+   {
+      mResponseTimeByMethod[i].reset();
+   }
+   mFifoDwellTime.reset();
+   mZeroOutPending.store(false, std::memory_order_release);
+}
+
+void
+StatisticsShard::zeroOut()
+{
+   mZeroOutPending.store(true, std::memory_order_relaxed);
+}
+
+void
+StatisticsShard::addTo(StatisticsMessage::Payload& payload) const
+{
+   if (mZeroOutPending.load(std::memory_order_acquire))
+   {
+      // the owner has yet to get round to it, so everything here is stale
+      return;
+   }
+
+   payload.requestsSent += mRequestsSent.load(std::memory_order_relaxed);
+   payload.responsesSent += mResponsesSent.load(std::memory_order_relaxed);
+   payload.requestsRetransmitted += mRequestsRetransmitted.load(std::memory_order_relaxed);
+   payload.responsesRetransmitted += mResponsesRetransmitted.load(std::memory_order_relaxed);
+   payload.requestsReceived += mRequestsReceived.load(std::memory_order_relaxed);
+   payload.responsesReceived += mResponsesReceived.load(std::memory_order_relaxed);
+   addCounters(payload.requestsSentByMethod, mRequestsSentByMethod);
+   addCounters(payload.requestsRetransmittedByMethod, mRequestsRetransmittedByMethod);
+   addCounters(payload.requestsReceivedByMethod, mRequestsReceivedByMethod);
+   addCounters(payload.responsesSentByMethod, mResponsesSentByMethod);
+   addCounters(payload.responsesRetransmittedByMethod, mResponsesRetransmittedByMethod);
+   addCounters(payload.responsesReceivedByMethod, mResponsesReceivedByMethod);
+   addCounters(payload.responsesSentByMethodByCode, mResponsesSentByMethodByCode);
+   addCounters(payload.responsesRetransmittedByMethodByCode, mResponsesRetransmittedByMethodByCode);
+   addCounters(payload.responsesReceivedByMethodByCode, mResponsesReceivedByMethodByCode);
+   payload.transactionSetupTime += mTransactionSetupTime;
+   for (int i = 0; i < MAX_METHODS; ++i)
+   {
+      payload.responseTimeByMethod[i] += mResponseTimeByMethod[i];
+   }
+   payload.fifoDwellTime += mFifoDwellTime;
+}
+
+void
+StatisticsShard::sent(SipMessage* msg)
+{
+   checkZeroOut();
    MethodTypes met = msg->method();
 
    if (msg->isRequest())
    {
-      ++requestsSent;
-      ++requestsSentByMethod[met];
+      increment(mRequestsSent);
+      increment(mRequestsSentByMethod[met]);
    }
    else if (msg->isResponse())
    {
@@ -108,56 +273,76 @@ StatisticsManager::sent(SipMessage* msg)
          code = 0;
       }
 
-      ++responsesSent;
-      ++responsesSentByMethod[met];
-      ++responsesSentByMethodByCode[met][code];
+      increment(mResponsesSent);
+      increment(mResponsesSentByMethod[met]);
+      increment(mResponsesSentByMethodByCode[met][code]);
    }
-   
-   return false;
 }
 
-bool 
-StatisticsManager::retransmitted(MethodTypes met, 
-                                 bool request, 
-                                 unsigned int code)
+void
+StatisticsShard::retransmitted(MethodTypes met, 
+                               bool request, 
+                               unsigned int code)
 {
+   checkZeroOut();
    if(request)
    {
-      ++requestsRetransmitted;
-      ++requestsRetransmittedByMethod[met];
+      increment(mRequestsRetransmitted);
+      increment(mRequestsRetransmittedByMethod[met]);
    }
    else
    {
-      ++responsesRetransmitted;
-      ++responsesRetransmittedByMethod[met];
-      ++responsesRetransmittedByMethodByCode[met][code];
+      if (code >= MaxCode)
+      {
+         code = 0;
+      }
+      increment(mResponsesRetransmitted);
+      increment(mResponsesRetransmittedByMethod[met]);
+      increment(mResponsesRetransmittedByMethodByCode[met][code]);
    }
-   return false;
 }
 
-bool
-StatisticsManager::received(SipMessage* msg)
+void
+StatisticsShard::received(SipMessage* msg)
 {
+   checkZeroOut();
    MethodTypes met = msg->header(h_CSeq).method();
 
+   // the transport stamped the message when it read it
+   UInt64 now = Timer::getTimeMicroSec();
+   UInt64 created = msg->getCreatedTimeMicroSec();
+   mFifoDwellTime.record(now > created ? now - created : 0);
+
    if (msg->isRequest())
    {
-      ++requestsReceived;
-      ++requestsReceivedByMethod[met];
+      increment(mRequestsReceived);
+      increment(mRequestsReceivedByMethod[met]);
    }
    else if (msg->isResponse())
    {
-      ++responsesReceived;
-      ++responsesReceivedByMethod[met];
+      increment(mResponsesReceived);
+      increment(mResponsesReceivedByMethod[met]);
       int code = msg->const_header(h_StatusLine).statusCode();
       if (code < 0 || code >= MaxCode)
       {
          code = 0;
       }
-      ++responsesReceivedByMethodByCode[met][code];
+      increment(mResponsesReceivedByMethodByCode[met][code]);
    }
+}
 
-   return false;
+void
+StatisticsShard::transactionSetup(UInt64 elapsedMicroSec)
+{
+   checkZeroOut();
+   mTransactionSetupTime.record(elapsedMicroSec);
+}
+
+void
+StatisticsShard::responded(MethodTypes method, UInt64 elapsedMicroSec)
+{
+   checkZeroOut();
+   mResponseTimeByMethod[method].record(elapsedMicroSec);
 }
 
 /* ====================================================================
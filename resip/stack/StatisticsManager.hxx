@@ -1,8 +1,13 @@
 #ifndef RESIP_StatisticsManager_hxx
 #define RESIP_StatisticsManager_hxx
 
+#include <atomic>
+#include <vector>
+
 #include "rutil/Timer.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/LatencyHistogram.hxx"
+#include "rutil/Mutex.hxx"
 #include "resip/stack/StatisticsMessage.hxx"
 #include "resip/stack/StatisticsHandler.hxx"
 
@@ -12,10 +17,87 @@ class SipStack;
 class SipMessage;
 class TransactionController;
 
+/**
+   @internal
+   @brief The message counts and latencies of one TransactionController
+      shard, summed into the StatisticsManager's payload on each poll.
+
+   Only the shard's own thread writes to these, so counting is a plain
+   relaxed load and store with no lock and no shared cache line; poll()
+   reads them from shard 0's thread while they are being written.
+*/
+class StatisticsShard
+{
+   public:
+      StatisticsShard();
+
+      void sent(SipMessage* msg);
+      void retransmitted(MethodTypes type, bool request, unsigned int code);
+      void received(SipMessage* msg);
+      /// first response (of any kind) to a client transaction
+      void transactionSetup(UInt64 elapsedMicroSec);
+      /// first final response to a client transaction
+      void responded(MethodTypes method, UInt64 elapsedMicroSec);
+
+      /// Asks the owning thread to zero everything before it next counts.
+      void zeroOut();
+      /// Adds the counts and latencies to payload (unless a zeroOut() is pending).
+      void addTo(StatisticsMessage::Payload& payload) const;
+
+   private:
+      typedef std::atomic<unsigned int> Counter;
+      enum {MaxCode = StatisticsMessage::Payload::MaxCode};
+
+      static void increment(Counter& counter)
+      {
+         counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      }
+      void checkZeroOut()
+      {
+         if (mZeroOutPending.load(std::memory_order_relaxed))
+         {
+            clear();
+         }
+      }
+      void clear();
+
+      std::atomic<bool> mZeroOutPending;
+
+      Counter mRequestsSent;
+      Counter mResponsesSent;
+      Counter mRequestsRetransmitted;
+      Counter mResponsesRetransmitted;
+      Counter mRequestsReceived;
+      Counter mResponsesReceived;
+
+      Counter mRequestsSentByMethod[MAX_METHODS];
+      Counter mRequestsRetransmittedByMethod[MAX_METHODS];
+      Counter mRequestsReceivedByMethod[MAX_METHODS];
+      Counter mResponsesSentByMethod[MAX_METHODS];
+      Counter mResponsesRetransmittedByMethod[MAX_METHODS];
+      Counter mResponsesReceivedByMethod[MAX_METHODS];
+
+      Counter mResponsesSentByMethodByCode[MAX_METHODS][MaxCode];
+      Counter mResponsesRetransmittedByMethodByCode[MAX_METHODS][MaxCode];
+      Counter mResponsesReceivedByMethodByCode[MAX_METHODS][MaxCode];
+
+      LatencyHistogram mTransactionSetupTime;
+      LatencyHistogram mResponseTimeByMethod[MAX_METHODS];
+      LatencyHistogram mFifoDwellTime;
+
+      // dis-allowed by not implemented
+      StatisticsShard(const StatisticsShard&);
+      StatisticsShard& operator=(const StatisticsShard&);
+};
+
 /**
    @brief Keeps track of various statistics on the stack's operation, and 
       periodically issues a StatisticsMessage to the TransactionUser (or, if the
       ExternalStatsHandler is set, it will be sent there).
+
+   Message counts and latencies are kept per TransactionController shard
+   (see StatisticsShard) and only summed into this payload when it is
+   polled, so between polls the payload holds the previous totals.
 */
 class StatisticsManager : public StatisticsMessage::Payload
 {
@@ -51,14 +133,17 @@ class StatisticsManager : public StatisticsMessage::Payload
       }
 
    private:
+      friend class TransactionController;
       friend class TransactionState;
-      bool sent(SipMessage* msg);
-      bool retransmitted(MethodTypes type, bool request, unsigned int code);
-      bool received(SipMessage* msg);
 
-      void poll(); // force an update
+      /// Registers a TransactionController shard; the result lives as long as this.
+      StatisticsShard& addShard();
+      void zeroOut();
+      void poll(bool requested); // force an update
 
       SipStack& mStack;
+      Mutex mShardsMutex;
+      std::vector<StatisticsShard*> mShards;
       UInt64 mInterval;
       UInt64 mNextPoll;
 
@@ -9,14 +9,16 @@ using namespace resip;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::STATS
 
-StatisticsMessage::StatisticsMessage(const StatisticsMessage::AtomicPayload& payload)
+StatisticsMessage::StatisticsMessage(const StatisticsMessage::AtomicPayload& payload, bool requested)
    : ApplicationMessage(),
-     mPayload(payload)
+     mPayload(payload),
+     mRequested(requested)
 {}
 
 StatisticsMessage::StatisticsMessage(const StatisticsMessage& rhs)
    : ApplicationMessage(rhs),
-     mPayload(rhs.mPayload)
+     mPayload(rhs.mPayload),
+     mRequested(rhs.mRequested)
 {}
 
 StatisticsMessage::~StatisticsMessage()
@@ -121,6 +123,15 @@ StatisticsMessage::Payload::zeroOut()
    activeClientTransactions = 0;
    activeServerTransactions = 0;
    pendingDnsQueries = 0;
+   connectionBufferBytes = 0;
+   connectionWrites = 0;
+   connectionMessagesWritten = 0;
+   tlsFullHandshakes = 0;
+   tlsResumedHandshakes = 0;
+   dnsCacheHits = 0;
+   dnsCacheMisses = 0;
+   dnsCacheStaleHits = 0;
+   dnsPrefetches = 0;
    requestsSent = 0;
    responsesSent = 0;
    requestsRetransmitted = 0;
@@ -137,6 +148,12 @@ StatisticsMessage::Payload::zeroOut()
    memset(responsesSentByMethodByCode, 0, sizeof(responsesSentByMethodByCode));
    memset(responsesRetransmittedByMethodByCode, 0, sizeof(responsesRetransmittedByMethodByCode));
    memset(responsesReceivedByMethodByCode, 0, sizeof(responsesReceivedByMethodByCode));
+   transactionSetupTime.reset();
+   for (int i = 0; i < MAX_METHODS; ++i)
+   {
+      responseTimeByMethod[i].reset();
+   }
+   fifoDwellTime.reset();
 }
 
 StatisticsMessage::Payload&
@@ -153,6 +170,16 @@ StatisticsMessage::Payload::operator=(const StatisticsMessage::Payload& rhs)
       activeClientTransactions = rhs.activeClientTransactions;
       activeServerTransactions = rhs.activeServerTransactions;
       pendingDnsQueries = rhs.pendingDnsQueries;
+      connectionBufferBytes = rhs.connectionBufferBytes;
+      connectionWrites = rhs.connectionWrites;
+      connectionMessagesWritten = rhs.connectionMessagesWritten;
+      tlsFullHandshakes = rhs.tlsFullHandshakes;
+      tlsResumedHandshakes = rhs.tlsResumedHandshakes;
+
+      dnsCacheHits = rhs.dnsCacheHits;
+      dnsCacheMisses = rhs.dnsCacheMisses;
+      dnsCacheStaleHits = rhs.dnsCacheStaleHits;
+      dnsPrefetches = rhs.dnsPrefetches;
 
       requestsSent = rhs.requestsSent;
       responsesSent = rhs.responsesSent;
@@ -171,6 +198,13 @@ StatisticsMessage::Payload::operator=(const StatisticsMessage::Payload& rhs)
       memcpy(responsesSentByMethodByCode, rhs.responsesSentByMethodByCode, sizeof(responsesSentByMethodByCode));
       memcpy(responsesRetransmittedByMethodByCode, rhs.responsesRetransmittedByMethodByCode, sizeof(responsesRetransmittedByMethodByCode));
       memcpy(responsesReceivedByMethodByCode, rhs.responsesReceivedByMethodByCode, sizeof(responsesReceivedByMethodByCode));
+
+      transactionSetupTime = rhs.transactionSetupTime;
+      for (int i = 0; i < MAX_METHODS; ++i)
+      {
+         responseTimeByMethod[i] = rhs.responseTimeByMethod[i];
+      }
+      fifoDwellTime = rhs.fifoDwellTime;
    }
 
    return *this;
@@ -221,6 +255,21 @@ resip::operator<<(EncodeStream& strm, const StatisticsMessage::Payload& stats)
         << " SERVERTX " << stats.activeServerTransactions
         << " TIMERS " << stats.activeTimers
         << std::endl
+        << "Connections: " << stats.openTcpConnections
+        << " rx buffers " << stats.connectionBufferBytes
+        << " bytes (" << (stats.openTcpConnections ? stats.connectionBufferBytes/stats.openTcpConnections : 0)
+        << " per connection)"
+        << " writes " << stats.connectionWrites
+        << " msgs " << stats.connectionMessagesWritten
+        << std::endl
+        << "TLS handshakes: full " << stats.tlsFullHandshakes
+        << " resumed " << stats.tlsResumedHandshakes
+        << std::endl
+        << "DNS cache: hits " << stats.dnsCacheHits
+        << " misses " << stats.dnsCacheMisses
+        << " stale " << stats.dnsCacheStaleHits
+        << " prefetches " << stats.dnsPrefetches
+        << std::endl
         << "Transaction summary: reqi " << stats.requestsReceived
         << " reqo " << stats.requestsSent
         << " rspi " << stats.responsesReceived
@@ -272,7 +321,19 @@ resip::operator<<(EncodeStream& strm, const StatisticsMessage::Payload& stats)
         << " INFx " << stats.requestsRetransmittedByMethod[INFO]
         << " PRAx " << stats.requestsRetransmittedByMethod[PRACK]
         << " SERx " << stats.requestsRetransmittedByMethod[SERVICE]
-        << " UPDx " << stats.requestsRetransmittedByMethod[UPDATE];
+        << " UPDx " << stats.requestsRetransmittedByMethod[UPDATE]
+        << std::endl
+        << "Latency (us): setup " << stats.transactionSetupTime
+        << " fifo " << stats.fifoDwellTime;
+   for (int m = 0; m < MAX_METHODS; ++m)
+   {
+      if (stats.responseTimeByMethod[m].count())
+      {
+         strm << std::endl
+              << "Response time (us): " << getMethodName((MethodTypes)m)
+              << " " << stats.responseTimeByMethod[m];
+      }
+   }
    strm.flush();
    return strm;
 }
@@ -6,6 +6,7 @@
 #include "resip/stack/MethodTypes.hxx"
 #include "rutil/Mutex.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
+#include "rutil/LatencyHistogram.hxx"
 
 namespace resip
 {
@@ -16,7 +17,9 @@ class StatisticsMessage : public ApplicationMessage
    public:
       RESIP_HeapCount(StatisticsMessage);
       class AtomicPayload;
-      StatisticsMessage(const AtomicPayload& payload);
+      /// requested is true when the poll was asked for through
+      /// SipStack::pollStatistics() rather than made on the interval.
+      StatisticsMessage(const AtomicPayload& payload, bool requested = false);
       StatisticsMessage(const StatisticsMessage& rhs);
 
       virtual ~StatisticsMessage();
@@ -31,10 +34,21 @@ class StatisticsMessage : public ApplicationMessage
             unsigned int transportFifoSizeSum;
             unsigned int transactionFifoSize;
             unsigned int activeTimers;
-            unsigned int openTcpConnections; // .dlb. not implemented
+            unsigned int openTcpConnections; // all stream transports
             unsigned int activeClientTransactions;
             unsigned int activeServerTransactions;
             unsigned int pendingDnsQueries; // .dlb. not implemented
+            UInt64 connectionBufferBytes; // receive buffers held for openTcpConnections
+            UInt64 connectionWrites; // stream writes that sent something...
+            UInt64 connectionMessagesWritten; // ...and the messages they completed
+            UInt64 tlsFullHandshakes;
+            UInt64 tlsResumedHandshakes; // handshakes that reused a session or ticket
+
+            // DnsStub cache counters, since the stub was created
+            unsigned int dnsCacheHits;
+            unsigned int dnsCacheMisses;
+            unsigned int dnsCacheStaleHits;
+            unsigned int dnsPrefetches;
 
             unsigned int requestsSent; // includes retransmissions
             unsigned int responsesSent; // includes retransmissions
@@ -56,6 +70,14 @@ class StatisticsMessage : public ApplicationMessage
             unsigned int responsesRetransmittedByMethodByCode[MAX_METHODS][MaxCode];
             unsigned int responsesReceivedByMethodByCode[MAX_METHODS][MaxCode];
 
+            // Latencies in microseconds
+            // client transaction created until its first response arrives
+            LatencyHistogram transactionSetupTime;
+            // client transaction created until its first final response arrives
+            LatencyHistogram responseTimeByMethod[MAX_METHODS];
+            // message read off the wire until the transaction layer takes it
+            LatencyHistogram fifoDwellTime;
+
             unsigned int sum2xxIn(MethodTypes method) const;
             unsigned int sumErrIn(MethodTypes method) const;
             unsigned int sum2xxOut(MethodTypes method) const;
@@ -66,6 +88,7 @@ class StatisticsMessage : public ApplicationMessage
       };
 
       void loadOut(Payload& payload) const;
+      bool isRequested() const { return mRequested; }
       static void logStats(const Subsystem& subsystem, const Payload& stats);
 
       virtual EncodeStream& encode(EncodeStream& strm) const;
@@ -89,6 +112,7 @@ class StatisticsMessage : public ApplicationMessage
       
    private:
       const AtomicPayload& mPayload;
+      bool mRequested;
       friend EncodeStream& operator<<(EncodeStream& strm, const StatisticsMessage::Payload& stats);
 };
 
@@ -8,6 +8,7 @@
 #include "rutil/Data.hxx"
 #include "rutil/DnsUtil.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/DeferredLog.hxx"
 #include "rutil/NetNs.hxx"
 #include "resip/stack/TcpBaseTransport.hxx"
 
@@ -27,7 +28,8 @@ TcpBaseTransport::TcpBaseTransport(Fifo<TransactionMessage>& fifo,
                                    Compression &compression,
                                    unsigned transportFlags,
                                    const Data& netNs)
-   : InternalTransport(fifo, portNum, version, pinterface, socketFunc, compression, transportFlags, netNs)
+   : InternalTransport(fifo, portNum, version, pinterface, socketFunc, compression, transportFlags, netNs),
+     mAcceptPaused(false)
 {
    if ( (mTransportFlags & RESIP_TRANSPORT_FLAG_NOBIND)==0 )
    {
@@ -133,7 +135,7 @@ TcpBaseTransport::buildFdSet( FdSet& fdset)
 {
    resip_assert( mPollGrp==NULL );
    mConnectionManager.buildFdSet(fdset);
-   if ( mFd!=INVALID_SOCKET )
+   if ( mFd!=INVALID_SOCKET && !mAcceptPaused )
    {
       fdset.setRead(mFd); // for the transport itself (accept)
    }
@@ -313,7 +315,7 @@ TcpBaseTransport::processAllWriteRequests()
    while (mTxFifoOutBuffer.messageAvailable())
    {
       SendData* data = mTxFifoOutBuffer.getNext();
-      DebugLog (<< "Processing write for " << data->destination);
+      DeferredDebugLog("Processing write for {}", data->destination);
 
       // this will check by connectionId first, then by address
       Connection* conn = mConnectionManager.findConnection(data->destination);
@@ -407,7 +409,7 @@ TcpBaseTransport::process(FdSet& fdSet)
    mConnectionManager.process(fdSet);
 
    // process our own listen/accept socket for incoming connections
-   if (mFd!=INVALID_SOCKET && fdSet.readyToRead(mFd))
+   if (mFd!=INVALID_SOCKET && !mAcceptPaused && fdSet.readyToRead(mFd))
    {
       processListen();
    }
@@ -418,12 +420,28 @@ TcpBaseTransport::process(FdSet& fdSet)
 void
 TcpBaseTransport::processPollEvent(FdPollEventMask mask) 
 {
-   if (mask & FPEM_Read)
+   if ((mask & FPEM_Read) && !mAcceptPaused)
    {
       while(processListen() > 0);
    }
 }
 
+void
+TcpBaseTransport::pauseAccepting(bool pause)
+{
+   if (pause == mAcceptPaused)
+   {
+      return;
+   }
+   mAcceptPaused = pause;
+   if (!pause && mPollGrp && mFd != INVALID_SOCKET)
+   {
+      // the listen socket is edge triggered, so what arrived while paused
+      // would otherwise wait for the next connection attempt
+      while(processListen() > 0);
+   }
+}
+
 void
 TcpBaseTransport::setRcvBufLen(int buflen)
 {
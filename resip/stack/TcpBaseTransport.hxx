@@ -35,6 +35,11 @@ class TcpBaseTransport : public InternalTransport, public FdPollItemIf
       ConnectionManager& getConnectionManager() {return mConnectionManager;}
       const ConnectionManager& getConnectionManager() const {return mConnectionManager;}
 
+      virtual unsigned int getConnectionCount() const { return mConnectionManager.getConnectionCount(); }
+      virtual UInt64 getReceiveBufferBytes() const { return mConnectionManager.getReceiveBufferBytes(); }
+      virtual UInt64 getWrites() const { return mConnectionManager.getWrites(); }
+      virtual UInt64 getMessagesWritten() const { return mConnectionManager.getMessagesWritten(); }
+
       virtual void invokeAfterSocketCreationFunc() const;
 
    protected:
@@ -58,6 +63,15 @@ class TcpBaseTransport : public InternalTransport, public FdPollItemIf
       // return 1 if accepted connection
       int processListen();
 
+      /** While paused, new connections wait in the kernel's listen queue
+          (and are refused once it is full).  Unpausing takes in whatever
+          queued up meanwhile. */
+      void pauseAccepting(bool pause);
+      bool isAcceptingPaused() const { return mAcceptPaused; }
+
+      /// deletes every connection, for use by derived class d'tors
+      void closeConnections() { mConnectionManager.closeConnections(); }
+
       /* Helper to make a new outgoing TCP connection.
        * Makes the socket, connects it, etc.
        */
@@ -70,6 +84,7 @@ class TcpBaseTransport : public InternalTransport, public FdPollItemIf
    private:
       static const int MaxBufferSize;
       ConnectionManager mConnectionManager;
+      bool mAcceptPaused;
 };
 
 }
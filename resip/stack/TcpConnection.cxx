@@ -108,6 +108,30 @@ TcpConnection::write( const char* buf, const int count )
    return bytesWritten;
 }
 
+#ifndef WIN32
+int
+TcpConnection::writeGathered(const struct iovec* iov, int count)
+{
+   resip_assert(count > 0);
+
+   int bytesWritten = (int)::writev(getSocket(), iov, count);
+
+   if (bytesWritten == INVALID_SOCKET)
+   {
+      int e = getErrno();
+      if (e == EAGAIN || e == EWOULDBLOCK)
+      {
+          return 0;
+      }
+      InfoLog (<< "Failed writev on " << getSocket() << " " << strerror(e));
+      Transport::error(e);
+      return -1;
+   }
+
+   return bytesWritten;
+}
+#endif
+
 bool 
 TcpConnection::hasDataToRead()
 {
@@ -15,6 +15,9 @@ class TcpConnection : public Connection
       
       int read( char* buf, const int count );
       int write( const char* buf, const int count );
+#ifndef WIN32
+      virtual int writeGathered(const struct iovec* iov, int count);
+#endif
       virtual bool hasDataToRead(); // has data that can be read 
       virtual bool isGood(); // has valid connection
       virtual bool isWritable();
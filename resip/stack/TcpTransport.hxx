@@ -22,6 +22,10 @@ class TcpTransport : public TcpBaseTransport
                    const Data& netNs = Data::Empty);
       virtual  ~TcpTransport();
 
+#ifndef WIN32
+      virtual bool supportsGatheredSends() const { return true; }
+#endif
+
    protected:
       Connection* createConnection(const Tuple& who, Socket fd, bool server=false);
 };
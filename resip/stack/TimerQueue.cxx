@@ -19,6 +19,17 @@ using namespace std;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSACTION
 
+namespace
+{
+struct DeletePayload
+{
+   void operator()(const TimerWithPayload& timer) const
+   {
+      delete timer.getMessage();
+   }
+};
+}
+
 TransactionTimerQueue::TransactionTimerQueue(Fifo<TimerMessage>& fifo)
    : mFifo(fifo)
 {
@@ -33,52 +44,65 @@ DtlsTimerQueue::DtlsTimerQueue( Fifo<DtlsMessage>& fifo )
 
 DtlsTimerQueue::~DtlsTimerQueue()
 {
-   while(!mTimers.empty())
-   {
-      delete mTimers.top().getMessage();
-      mTimers.pop();
-   }
+   mTimers.clear(DeletePayload());
 }
 
 #endif
 
-UInt64
+TransactionTimerQueue::Handle
 TransactionTimerQueue::add(Timer::Type type, const Data& transactionId, unsigned long msOffset)
 {
    TransactionTimer t(msOffset, type, transactionId);
-   mTimers.push(t);
    DebugLog (<< "Adding timer: " << Timer::toData(type) << " tid=" << transactionId << " ms=" << msOffset);
-   return mTimers.top().getWhen();
+   return mTimers.push(t);
 }
 
 #ifdef USE_DTLS
 
-UInt64
+DtlsTimerQueue::Handle
 DtlsTimerQueue::add( SSL *ssl, unsigned long msOffset )
 {
    TimerWithPayload t( msOffset, new DtlsMessage( ssl ) ) ;
-   mTimers.push( t ) ;
-   return mTimers.top().getWhen();
+   return mTimers.push( t ) ;
+}
+
+bool
+DtlsTimerQueue::cancel(Handle handle)
+{
+   const TimerWithPayload* timer = mTimers.find(handle);
+   if (!timer)
+   {
+      return false;
+   }
+   delete timer->getMessage();
+   return mTimers.cancel(handle);
 }
 
 #endif
 
 BaseTimeLimitTimerQueue::~BaseTimeLimitTimerQueue()
 {
-   while(!mTimers.empty())
-   {
-      delete mTimers.top().getMessage();
-      mTimers.pop();
-   }
+   mTimers.clear(DeletePayload());
 }
 
-UInt64
+BaseTimeLimitTimerQueue::Handle
 BaseTimeLimitTimerQueue::add(unsigned int timeMs,Message* payload)
 {
    resip_assert(payload);
    DebugLog(<< "Adding application timer: " << payload->brief() << " ms=" << timeMs);
-   mTimers.push(TimerWithPayload(timeMs,payload));
-   return mTimers.top().getWhen();
+   return mTimers.push(TimerWithPayload(timeMs,payload));
+}
+
+bool
+BaseTimeLimitTimerQueue::cancel(Handle handle)
+{
+   const TimerWithPayload* timer = mTimers.find(handle);
+   if (!timer)
+   {
+      return false;
+   }
+   delete timer->getMessage();
+   return mTimers.cancel(handle);
 }
 
 void
@@ -110,20 +134,27 @@ TuSelectorTimerQueue::TuSelectorTimerQueue(TuSelector& sel) : mFifoSelector(sel)
 
 TuSelectorTimerQueue::~TuSelectorTimerQueue()
 {
-   while(!mTimers.empty())
-   {
-      delete mTimers.top().getMessage();
-      mTimers.pop();
-   }
+   mTimers.clear(DeletePayload());
 }
 
-UInt64
+TuSelectorTimerQueue::Handle
 TuSelectorTimerQueue::add(unsigned int timeMs,Message* payload)
 {
    resip_assert(payload);
    DebugLog(<< "Adding application timer: " << payload->brief() << " ms=" << timeMs);
-   mTimers.push(TimerWithPayload(timeMs,payload));
-   return mTimers.top().getWhen();
+   return mTimers.push(TimerWithPayload(timeMs,payload));
+}
+
+bool
+TuSelectorTimerQueue::cancel(Handle handle)
+{
+   const TimerWithPayload* timer = mTimers.find(handle);
+   if (!timer)
+   {
+      return false;
+   }
+   delete timer->getMessage();
+   return mTimers.cancel(handle);
 }
 
 void
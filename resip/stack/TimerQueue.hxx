@@ -14,10 +14,7 @@
 #include "rutil/Fifo.hxx"
 #include "rutil/TimeLimitFifo.hxx"
 #include "rutil/Timer.hxx"
-
-// .dlb. 
-// to do: timer wheel for transaction-bound timers and a heap for
-// everything longer.
+#include "rutil/TimerWheel.hxx"
 
 namespace resip
 {
@@ -31,27 +28,27 @@ class TuSelector;
   * @brief This class takes a fifo as a place to where you can write your stuff.
   * When using this in the main loop, call process() on this.
   * During Transaction processing, TimerMessages and SIP messages are generated.
-  * 
-    @todo .dlb. timer wheel for transaction-bound timers and a heap for 
-      everything longer.
+  *
+  * Timers are kept in a TimerWheel, so add() and cancel() are O(1)
+  * regardless of how many timers are pending. The handle returned by a
+  * subclass's add() may be passed to cancel() to drop a timer that is no
+  * longer needed instead of letting it fire into a stale transaction.
   */
 template <class T>
 class TimerQueue
 {
    public:
+      /// Identifies a timer added to the queue; see cancel().
+      typedef typename TimerWheel<T>::Handle Handle;
+
       // This is the logic that runs when a timer goes off. This is the only
       // thing subclasses must implement.
       virtual void processTimer(const T& timer)=0;
 
-      /// @brief deletes the message associated with the timer as well.
+      /// @brief destroys any timers still pending; subclasses that own a
+      /// payload delete it in their own destructors.
       virtual ~TimerQueue()
       {
-         //xkd-2004-11-4
-         // delete the message associated with the timer
-         while (!mTimers.empty())
-         {
-            mTimers.pop();
-         }
       }
 
       /// @brief provides the time in milliseconds before the next timer will fire
@@ -59,11 +56,14 @@ class TimerQueue
       ///  @retval 0 implies that timers occur in the past
       /// @retval INT_MAX implies that there are no timers
       ///
+      /// @note For timers more than a minute out this may be somewhat
+      /// early (see TimerWheel::nextExpiry()); process() then just
+      /// cascades the wheel and nothing fires.
       unsigned int msTillNextTimer()
       {
          if (!mTimers.empty())
          {
-            UInt64 next = mTimers.top().getWhen();
+            UInt64 next = mTimers.nextExpiry();
             UInt64 now = Timer::getTimeMs();
             if (now > next) 
             {
@@ -96,20 +96,36 @@ class TimerQueue
          if (!mTimers.empty())
          {
             UInt64 now=Timer::getTimeMs();
-            while (!mTimers.empty() && !(mTimers.top().getWhen() > now))
+            Handle handle;
+            const T* timer;
+            while ((timer = mTimers.expired(now, handle)) != 0)
             {
-               processTimer(mTimers.top());
-               mTimers.pop();
+               processTimer(*timer);
+               mTimers.cancel(handle);
             }
 
             if(!mTimers.empty())
             {
-               return mTimers.top().getWhen();
+               return mTimers.nextExpiry();
             }
          }
          return 0;
       }
 
+      /// @brief removes a timer that has not fired yet. O(1).
+      /// @return false if the timer already fired or was cancelled, in
+      /// which case this is a no-op.
+      virtual bool cancel(Handle handle)
+      {
+         return mTimers.cancel(handle);
+      }
+
+      /// @return true if the timer identified by handle has not fired yet
+      bool pending(Handle handle) const
+      {
+         return mTimers.pending(handle);
+      }
+
       int size() const
       {
          return (int)mTimers.size();
@@ -149,8 +165,7 @@ class TimerQueue
 #endif
 
    protected:
-      typedef std::vector<T, std::allocator<T> > TimerVector;
-      std::priority_queue<T, TimerVector, std::greater<T> > mTimers;
+      TimerWheel<T> mTimers;
 };
 
 /**
@@ -160,7 +175,9 @@ class BaseTimeLimitTimerQueue : public TimerQueue<TimerWithPayload>
 {
    public:
       ~BaseTimeLimitTimerQueue();
-      UInt64 add(unsigned int timeMs,Message* payload);
+      Handle add(unsigned int timeMs,Message* payload);
+      /// deletes the payload of a timer that has not fired
+      virtual bool cancel(Handle handle);
       virtual void processTimer(const TimerWithPayload& timer);
    protected:
       virtual void addToFifo(Message*, TimeLimitFifo<Message>::DepthUsage)=0;      
@@ -189,7 +206,9 @@ class TuSelectorTimerQueue : public TimerQueue<TimerWithPayload>
    public:
       TuSelectorTimerQueue(TuSelector& sel);
       ~TuSelectorTimerQueue();
-      UInt64 add(unsigned int timeMs,Message* payload);
+      Handle add(unsigned int timeMs,Message* payload);
+      /// deletes the payload of a timer that has not fired
+      virtual bool cancel(Handle handle);
       virtual void processTimer(const TimerWithPayload& timer);
    private:
       TuSelector& mFifoSelector;
@@ -203,7 +222,7 @@ class TransactionTimerQueue : public TimerQueue<TransactionTimer>
 {
    public:
       TransactionTimerQueue(Fifo<TimerMessage>& fifo);
-      UInt64 add(Timer::Type type, const Data& transactionId, unsigned long msOffset);
+      Handle add(Timer::Type type, const Data& transactionId, unsigned long msOffset);
       virtual void processTimer(const TransactionTimer& timer);
    private:
       Fifo<TimerMessage>& mFifo;
@@ -221,7 +240,9 @@ class DtlsTimerQueue : public TimerQueue<TimerWithPayload>
    public:
       DtlsTimerQueue(Fifo<DtlsMessage>& fifo);
       ~DtlsTimerQueue();
-      UInt64 add(SSL *, unsigned long msOffset);
+      Handle add(SSL *, unsigned long msOffset);
+      /// deletes the payload of a timer that has not fired
+      virtual bool cancel(Handle handle);
       virtual void processTimer(const TimerWithPayload& timer) ;
       
    private:
@@ -11,6 +11,10 @@
 #include "resip/stack/TerminateFlow.hxx"
 #include "resip/stack/EnableFlowTimer.hxx"
 #include "resip/stack/InvokeAfterSocketCreationFunc.hxx"
+#include "resip/stack/KeepAliveMessage.hxx"
+#include "resip/stack/DnsResultMessage.hxx"
+#include "resip/stack/TcpConnectState.hxx"
+#include "resip/stack/TransportFailure.hxx"
 #include "resip/stack/ZeroOutStatistics.hxx"
 #include "resip/stack/PollStatistics.hxx"
 #include "resip/stack/ShutdownMessage.hxx"
@@ -39,7 +43,8 @@ unsigned int TransactionController::MaxTUFifoTimeDepthSecs = 0;
 
 TransactionController::TransactionController(SipStack& stack, 
                                              AsyncProcessHandler* handler,
-                                             bool useDnsVip) :
+                                             bool useDnsVip,
+                                             unsigned int shards) :
    mStack(stack),
    mDiscardStrayResponses(true),
    mFixBadDialogIdentifiers(true),
@@ -48,17 +53,47 @@ TransactionController::TransactionController(SipStack& stack,
    mStateMacFifoOutBuffer(mStateMacFifo),
    mCongestionManager(0),
    mTuSelector(stack.mTuSelector),
-   mTransportSelector(mStateMacFifo,
-                      stack.getSecurity(),
-                      stack.getDnsStub(),
-                      stack.getCompression(),
-                      useDnsVip),
+   mOwnedTransportSelector(new TransportSelector(mStateMacFifo,
+                                                 stack.getSecurity(),
+                                                 stack.getDnsStub(),
+                                                 stack.getCompression(),
+                                                 useDnsVip)),
+   mTransportSelector(*mOwnedTransportSelector),
    mTimers(mTimerFifo),
    mShuttingDown(false),
+   mPrimary(0),
    mStatsManager(stack.mStatsManager),
+   mStatsShard(mStatsManager.addShard()),
    mHostname(DnsUtil::getLocalHostName())
 {
    mStateMacFifo.setDescription("TransactionController::mStateMacFifo");
+   for(unsigned int i=1; i<shards; ++i)
+   {
+      mShards.push_back(new TransactionController(*this, handler));
+   }
+}
+
+TransactionController::TransactionController(TransactionController& primary,
+                                             AsyncProcessHandler* handler) :
+   mStack(primary.mStack),
+   mDiscardStrayResponses(primary.mDiscardStrayResponses),
+   mFixBadDialogIdentifiers(primary.mFixBadDialogIdentifiers),
+   mFixBadCSeqNumbers(primary.mFixBadCSeqNumbers),
+   mStateMacFifo(handler),
+   mStateMacFifoOutBuffer(mStateMacFifo),
+   mCongestionManager(0),
+   mTuSelector(primary.mTuSelector),
+   mTransportSelector(primary.mTransportSelector),
+   mTimers(mTimerFifo),
+   mShuttingDown(false),
+   mPrimary(&primary),
+   mStatsManager(primary.mStatsManager),
+   mStatsShard(mStatsManager.addShard()),
+   mHostname(primary.mHostname)
+{
+   // Same description as shard 0, so congestion settings keyed on it apply
+   // to every shard.
+   mStateMacFifo.setDescription("TransactionController::mStateMacFifo");
 }
 
 #if defined(WIN32) && !defined(__GNUC__)
@@ -67,6 +102,13 @@ TransactionController::TransactionController(SipStack& stack,
 
 TransactionController::~TransactionController()
 {
+   // The shards share our TransportSelector, so they have to go first.
+   for(std::vector<TransactionController*>::iterator i=mShards.begin(); i!=mShards.end(); ++i)
+   {
+      delete *i;
+   }
+   mShards.clear();
+
    if(mClientTransactionMap.size())
    {
       WarningLog(<< "On shutdown, there are Client TransactionStates remaining!");
@@ -85,6 +127,86 @@ TransactionController::isTUOverloaded() const
    return !mTuSelector.wouldAccept(TimeLimitFifo<Message>::EnforceTimeDepth);
 }
 
+TransactionController&
+TransactionController::getShard(unsigned int index)
+{
+   resip_assert(index < getNumShards());
+   return index == 0 ? *this : *mShards[index-1];
+}
+
+// Messages that are looked up in the transaction maps. Everything else
+// (transport management, statistics, keepalives) is handled by shard 0.
+static bool
+isTransactionScoped(TransactionMessage* message)
+{
+   if(dynamic_cast<SipMessage*>(message))
+   {
+      return !dynamic_cast<KeepAliveMessage*>(message);
+   }
+   return dynamic_cast<TransportFailure*>(message) ||
+          dynamic_cast<DnsResultMessage*>(message) ||
+          dynamic_cast<TcpConnectState*>(message) ||
+          dynamic_cast<AbandonServerTransaction*>(message) ||
+          dynamic_cast<CancelClientInviteTransaction*>(message);
+}
+
+// A CANCEL forms its own transaction, keyed on the branch with "cancel"
+// appended, but has to be handled by the shard holding the INVITE it
+// cancels. Any trailing "cancel"s are therefore ignored when picking the
+// shard; since the transaction maps match tids case-insensitively, so
+// does this.
+static size_t
+shardHash(TransactionMessage* message)
+{
+   static const Data cancel("cancel");
+   const Data& tid = message->getTransactionId();
+   Data::size_type len = tid.size();
+   while(len > cancel.size() &&
+         isEqualNoCase(Data(Data::Share, tid.data() + len - cancel.size(), cancel.size()), cancel))
+   {
+      len -= cancel.size();
+   }
+   if(len == tid.size())
+   {
+      return message->getTransactionIdHash();
+   }
+   return Data(Data::Share, tid.data(), len).caseInsensitiveTokenHash();
+}
+
+TransactionController&
+TransactionController::shardFor(TransactionMessage* message)
+{
+   if(mShards.empty() || !isTransactionScoped(message))
+   {
+      return *this;
+   }
+
+   size_t hash;
+   try
+   {
+      hash = shardHash(message);
+   }
+   catch(resip::BaseException&)
+   {
+      // TransactionState::process() drops these
+      return *this;
+   }
+   return getShard((unsigned int)(hash % getNumShards()));
+}
+
+bool
+TransactionController::shardsIdle() const
+{
+   for(std::vector<TransactionController*>::const_iterator i=mShards.begin(); i!=mShards.end(); ++i)
+   {
+      if((*i)->mStateMacFifo.messageAvailable())
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
 void
 TransactionController::shutdown()
 {
@@ -99,7 +221,8 @@ TransactionController::process(int timeout)
        //mTimers.empty() && 
        !mStateMacFifoOutBuffer.messageAvailable() && // !dcm! -- see below 
        !mStack.mTUFifo.messageAvailable() &&
-       mTransportSelector.isFinished())
+       mTransportSelector.isFinished() &&
+       shardsIdle())
 // !dcm! -- why would one wait for the Tu's fifo to be empty before delivering a
 // shutdown message?
    {
@@ -118,7 +241,7 @@ TransactionController::process(int timeout)
 
       // Check if Statistics Manager needs to be polled - note:  all statistic manager polls should happen from the 
       // TransactionController thread / process loop
-      if(mStack.mStatisticsManagerEnabled)
+      if(!mPrimary && mStack.mStatisticsManagerEnabled)
       {
          mStatsManager.process();
       }
@@ -150,7 +273,15 @@ TransactionController::process(int timeout)
          int runs=16;
          while(message)
          {
-            TransactionState::process(*this, message);
+            TransactionController& owner = shardFor(message);
+            if(&owner == this)
+            {
+               TransactionState::process(*this, message);
+            }
+            else
+            {
+               owner.mStateMacFifo.add(message);
+            }
             if(--runs==0)
             {
                break;
@@ -176,19 +307,21 @@ TransactionController::getTimeTillNextProcessMS()
 void
 TransactionController::send(SipMessage* msg)
 {
+   // Straight to the owning shard; no need to bounce off shard 0.
+   TransactionController& owner = shardFor(msg);
    if(msg->isRequest() && 
       msg->method() != ACK && 
-      getRejectionBehavior()!=CongestionManager::NORMAL)
+      owner.getRejectionBehavior()!=CongestionManager::NORMAL)
    {
       // Need to 503 this.
       SipMessage* resp(Helper::makeResponse(*msg, 503));
-      resp->header(h_RetryAfter).value()=(UInt32)mStateMacFifo.expectedWaitTimeMilliSec()/1000;
+      resp->header(h_RetryAfter).value()=(UInt32)owner.mStateMacFifo.expectedWaitTimeMilliSec()/1000;
       resp->setTransactionUser(msg->getTransactionUser());
       mTuSelector.add(resp, TimeLimitFifo<Message>::InternalElement);
       delete msg;
       return;
    }
-   mStateMacFifo.add(msg);
+   owner.mStateMacFifo.add(msg);
 }
 
 
@@ -204,30 +337,63 @@ TransactionController::sumTransportFifoSizes() const
    return mTransportSelector.sumTransportFifoSizes();
 }
 
+void
+TransactionController::sumConnectionStatistics(unsigned int& connections, UInt64& receiveBufferBytes,
+                                               UInt64& writes, UInt64& messagesWritten) const
+{
+   mTransportSelector.sumConnectionStatistics(connections, receiveBufferBytes, writes, messagesWritten);
+}
+
+void
+TransactionController::sumTlsHandshakeStatistics(UInt64& full, UInt64& resumed) const
+{
+   mTransportSelector.sumTlsHandshakeStatistics(full, resumed);
+}
+
 unsigned int 
 TransactionController::getTransactionFifoSize() const
 {
    // Should we include the stuff in mStateMacFifoOutBuffer here too? This is
    // likely to be called from other threads...
-   return mStateMacFifo.size();
+   unsigned int size = mStateMacFifo.size();
+   for(std::vector<TransactionController*>::const_iterator i=mShards.begin(); i!=mShards.end(); ++i)
+   {
+      size += (*i)->getTransactionFifoSize();
+   }
+   return size;
 }
 
 unsigned int 
 TransactionController::getNumClientTransactions() const
 {
-   return mClientTransactionMap.size();
+   unsigned int size = mClientTransactionMap.size();
+   for(std::vector<TransactionController*>::const_iterator i=mShards.begin(); i!=mShards.end(); ++i)
+   {
+      size += (*i)->getNumClientTransactions();
+   }
+   return size;
 }
 
 unsigned int 
 TransactionController::getNumServerTransactions() const
 {
-   return mServerTransactionMap.size();
+   unsigned int size = mServerTransactionMap.size();
+   for(std::vector<TransactionController*>::const_iterator i=mShards.begin(); i!=mShards.end(); ++i)
+   {
+      size += (*i)->getNumServerTransactions();
+   }
+   return size;
 }
 
 unsigned int 
 TransactionController::getTimerQueueSize() const
 {
-   return mTimers.size();
+   unsigned int size = mTimers.size();
+   for(std::vector<TransactionController*>::const_iterator i=mShards.begin(); i!=mShards.end(); ++i)
+   {
+      size += (*i)->getTimerQueueSize();
+   }
+   return size;
 }
 
 void 
@@ -256,13 +422,15 @@ void TransactionController::unregisterMarkListener(MarkListener* listener)
 void 
 TransactionController::abandonServerTransaction(const Data& tid)
 {
-   mStateMacFifo.add(new AbandonServerTransaction(tid));
+   TransactionMessage* abandon = new AbandonServerTransaction(tid);
+   shardFor(abandon).mStateMacFifo.add(abandon);
 }
 
 void 
 TransactionController::cancelClientInviteTransaction(const Data& tid, const resip::Tokens* reasons)
 {
-   mStateMacFifo.add(new CancelClientInviteTransaction(tid, reasons));
+   TransactionMessage* cancel = new CancelClientInviteTransaction(tid, reasons);
+   shardFor(cancel).mStateMacFifo.add(cancel);
 }
 
 void 
@@ -9,6 +9,9 @@
 
 #include "rutil/ConsumerFifoBuffer.hxx"
 
+#include <memory>
+#include <vector>
+
 namespace resip
 {
 
@@ -16,6 +19,7 @@ class TransactionMessage;
 class TimerMessage;
 class ApplicationMessage;
 class StatisticsManager;
+class StatisticsShard;
 class SipStack;
 class Compression;
 class FdPollGrp;
@@ -27,9 +31,22 @@ class TransactionController
       static unsigned int MaxTUFifoSize;
       static unsigned int MaxTUFifoTimeDepthSecs;
 
-      TransactionController(SipStack& stack, AsyncProcessHandler* handler, bool useDnsVip);
+      /**
+         @param shards Number of TransactionControllers that share the
+            transaction load. This controller is shard 0; it owns the
+            TransportSelector and creates the others, which share it.
+            Every message belonging to a transaction is handled by the shard
+            picked by the hash of its transaction id, so each shard has its
+            own transaction maps, timers and state machine fifo and they can
+            be driven from separate threads.
+      */
+      TransactionController(SipStack& stack, AsyncProcessHandler* handler, bool useDnsVip,
+                            unsigned int shards=1);
       ~TransactionController();
 
+      unsigned int getNumShards() const { return (unsigned int)mShards.size() + 1; }
+      TransactionController& getShard(unsigned int index);
+
       void process(int timeout=0);
       unsigned int getTimeTillNextProcessMS();
 
@@ -45,6 +62,9 @@ class TransactionController
 
       unsigned int getTuFifoSize() const;
       unsigned int sumTransportFifoSizes() const;
+      void sumConnectionStatistics(unsigned int& connections, UInt64& receiveBufferBytes,
+                                   UInt64& writes, UInt64& messagesWritten) const;
+      void sumTlsHandshakeStatistics(UInt64& full, UInt64& resumed) const;
       unsigned int getTransactionFifoSize() const;
       unsigned int getNumClientTransactions() const;
       unsigned int getNumServerTransactions() const;
@@ -64,6 +84,10 @@ class TransactionController
          {
             mCongestionManager->registerFifo(&mStateMacFifo);
          }
+         for(std::vector<TransactionController*>::iterator i=mShards.begin(); i!=mShards.end(); ++i)
+         {
+            (*i)->setCongestionManager(manager);
+         }
       }
 
       CongestionManager::RejectionBehavior getRejectionBehavior() const
@@ -86,12 +110,20 @@ class TransactionController
       inline void setFixBadDialogIdentifiers(bool pFixBadDialogIdentifiers) 
       {
          mFixBadDialogIdentifiers = pFixBadDialogIdentifiers;
+         for(std::vector<TransactionController*>::iterator i=mShards.begin(); i!=mShards.end(); ++i)
+         {
+            (*i)->setFixBadDialogIdentifiers(pFixBadDialogIdentifiers);
+         }
       }
 
       inline bool getFixBadCSeqNumbers() const { return mFixBadCSeqNumbers;} 
       inline void setFixBadCSeqNumbers(bool pFixBadCSeqNumbers)
       {
          mFixBadCSeqNumbers = pFixBadCSeqNumbers;
+         for(std::vector<TransactionController*>::iterator i=mShards.begin(); i!=mShards.end(); ++i)
+         {
+            (*i)->setFixBadCSeqNumbers(pFixBadCSeqNumbers);
+         }
       }
 
       void abandonServerTransaction(const Data& tid);
@@ -108,6 +140,15 @@ class TransactionController
    private:
       TransactionController(const TransactionController& rhs);
       TransactionController& operator=(const TransactionController& rhs);
+
+      // creates an additional shard that shares primary's TransportSelector
+      TransactionController(TransactionController& primary, AsyncProcessHandler* handler);
+
+      // the shard that owns the transaction message belongs to (*this if
+      // there are no other shards, or the message is not transaction scoped)
+      TransactionController& shardFor(TransactionMessage* message);
+      bool shardsIdle() const;
+
       SipStack& mStack;
       
       // If true, indicate to the Transaction to ignore responses for which
@@ -139,20 +180,31 @@ class TransactionController
       // from the sipstack (for convenience)
       TuSelector& mTuSelector;
 
-      // Used to decide which transport to send a sip message on. 
-      TransportSelector mTransportSelector;
+      // Used to decide which transport to send a sip message on. Owned by
+      // shard 0 and shared with the other shards.
+      std::unique_ptr<TransportSelector> mOwnedTransportSelector;
+      TransportSelector& mTransportSelector;
+
+      // timers associated with the transactions. When a timer fires, it is
+      // placed in the mStateMacFifo. Declared before the transaction maps
+      // since TransactionStates cancel their timers when deleted.
+      TransactionTimerQueue  mTimers;
 
       // stores all of the transactions that are currently active in this stack 
       TransactionMap mClientTransactionMap;
       TransactionMap mServerTransactionMap;
 
-      // timers associated with the transactions. When a timer fires, it is
-      // placed in the mStateMacFifo
-      TransactionTimerQueue  mTimers;
-
       bool mShuttingDown;
+
+      // Shards 1..N-1 (owned). Only shard 0 has any; it receives everything
+      // the transports produce and forwards what belongs to other shards.
+      std::vector<TransactionController*> mShards;
+      // shard 0 as seen from the other shards, 0 on shard 0 itself
+      TransactionController* mPrimary;
       
       StatisticsManager& mStatsManager;
+      // this shard's counters in mStatsManager
+      StatisticsShard& mStatsShard;
       
       Data mHostname;
       
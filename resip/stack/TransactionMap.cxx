@@ -10,61 +10,83 @@ using namespace resip;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSACTION
 
+static const unsigned int MinBits = 6;
+
+TransactionMap::TransactionMap()
+   : mSlots(size_t(1) << MinBits),
+     mKeys(size_t(1) << MinBits),
+     mMask((size_t(1) << MinBits) - 1),
+     mBits(MinBits),
+     mSize(0)
+{
+}
+
 TransactionMap::~TransactionMap()
 {
-   //DebugLog (<< "Deleting TransactionMap: " << this << " " << mMap.size() << " entries");
-   while (!mMap.empty())
+   //DebugLog (<< "Deleting TransactionMap: " << this << " " << mSize << " entries");
+   // ~TransactionState erases itself, which may shift a later entry into
+   // this slot; keep going until it stays empty.
+   for (size_t i = 0; i < mSlots.size(); ++i)
    {
-      DebugLog (<< mMap.begin()->first << " -> " << mMap.begin()->second << ": " << *mMap.begin()->second);
-      delete mMap.begin()->second;
+      while (mSlots[i].mState)
+      {
+         DebugLog (<< mKeys[i] << " -> " << mSlots[i].mState << ": " << *mSlots[i].mState);
+         delete mSlots[i].mState;
+      }
    }
 }
 
 TransactionState* 
 TransactionMap::find( const Data& tid ) const
 {
-   MapConstIterator i = mMap.find(tid);
-   if (i != mMap.end())
-   {
-      return i->second;
-   }
-   else
-   {
-      return 0;
-   }
+   return find(tid, tid.caseInsensitiveTokenHash());
+}
+
+TransactionState* 
+TransactionMap::find( const Data& tid, size_t hash ) const
+{
+   size_t i = locate(tid, hash);
+   return i == npos ? 0 : mSlots[i].mState;
 }
  
 void 
 TransactionMap::add(const Data& tid, TransactionState* state  )
 {
-   MapIterator i = mMap.find(tid);
-   if (i != mMap.end())
+   size_t hash = tid.caseInsensitiveTokenHash();
+   size_t i = locate(tid, hash);
+   if (i != npos)
    {
-      if (i->second != state)
+      if (mSlots[i].mState != state)
       {
          // .bwc. ~TransactionState will remove itself from the map.
-         delete i->second;
+         delete mSlots[i].mState;
          //DebugLog (<< "Replacing TMAP[" << tid << "] = " << state << " : " << *state);
-         mMap[tid] = state;
+         i = locate(tid, hash);
+         if (i != npos)
+         {
+            mSlots[i].mState = state;
+            return;
+         }
+         insert(tid, hash, state);
       }
    }
    else
    {
       //DebugLog (<< "Inserting TMAP[" << tid << "] = " << state << " : " << *state);
-      mMap[tid] = state;
+      insert(tid, hash, state);
    }
 }
  
 void 
 TransactionMap::erase(const Data& tid )
 {
-   MapIterator i = mMap.find(tid);
-   if (i != mMap.end())
+   size_t i = locate(tid, tid.caseInsensitiveTokenHash());
+   if (i != npos)
    {
       // don't delete it here, the TransactionState deletes itself and removes
       // itself from the map
-      //DebugLog (<< "Erasing " << tid << "(" << i->second << ")");
-      mMap.erase(i);
+      //DebugLog (<< "Erasing " << tid << "(" << mSlots[i].mState << ")");
+      removeAt(i);
    }
    else
    {
@@ -76,10 +98,89 @@ TransactionMap::erase(const Data& tid )
 int
 TransactionMap::size() const
 {
-   return (int)mMap.size();
+   return (int)mSize;
 }
 
+size_t
+TransactionMap::locate(const Data& tid, size_t hash) const
+{
+   // We treat branch parameters as case insensitive (RFC3261):
+   // 7.3.1 Header Field Format
+   // ....
+   //    When comparing header fields, field names are always case-
+   //    insensitive.Unless otherwise stated in the definition of a
+   //    particular header field, field values, parameter names, and parameter
+   //    values are case-insensitive.Tokens are always case-insensitive.
+   //    Unless specified otherwise, values expressed as quoted strings are
+   //    case-sensitive.
+   for (size_t i = home(hash); mSlots[i].mState; i = (i + 1) & mMask)
+   {
+      if (mSlots[i].mHash == hash && isEqualNoCase(mKeys[i], tid))
+      {
+         return i;
+      }
+   }
+   return npos;
+}
 
+void
+TransactionMap::insert(const Data& tid, size_t hash, TransactionState* state)
+{
+   // keep the load factor under 3/4
+   if ((mSize + 1) * 4 > mSlots.size() * 3)
+   {
+      grow();
+   }
+   size_t i = home(hash);
+   while (mSlots[i].mState)
+   {
+      i = (i + 1) & mMask;
+   }
+   mSlots[i].mHash = hash;
+   mSlots[i].mState = state;
+   mKeys[i] = tid;
+   ++mSize;
+}
+
+void
+TransactionMap::removeAt(size_t hole)
+{
+   // Backward shift deletion: walk the rest of the probe run and move back
+   // any entry whose home slot does not lie between the hole and where it
+   // sits now, so every entry stays reachable from its home slot.
+   for (size_t i = (hole + 1) & mMask; mSlots[i].mState; i = (i + 1) & mMask)
+   {
+      size_t h = home(mSlots[i].mHash);
+      bool movable = (hole <= i) ? (h <= hole || h > i) : (h <= hole && h > i);
+      if (movable)
+      {
+         mSlots[hole] = mSlots[i];
+         mKeys[hole] = mKeys[i];
+         hole = i;
+      }
+   }
+   mSlots[hole] = Slot();
+   --mSize;
+}
+
+void
+TransactionMap::grow()
+{
+   std::vector<Slot> slots(mSlots.size() * 2);
+   std::vector<Data> keys(mSlots.size() * 2);
+   slots.swap(mSlots);
+   keys.swap(mKeys);
+   ++mBits;
+   mMask = mSlots.size() - 1;
+   mSize = 0;
+   for (size_t i = 0; i < slots.size(); ++i)
+   {
+      if (slots[i].mState)
+      {
+         insert(keys[i], slots[i].mHash, slots[i].mState);
+      }
+   }
+}
 
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
@@ -1,8 +1,9 @@
 #if !defined(RESIP_TRANSACTIONMAP_HXX)
 #define RESIP_TRANSACTIONMAP_HXX
 
+#include <vector>
+
 #include "rutil/Data.hxx"
-#include "rutil/HashMap.hxx"
 
 namespace resip
 {
@@ -10,99 +11,64 @@ namespace resip
 
 /**
    @internal
+
+   Maps transaction ids to TransactionStates.
+
+   This is a flat open-addressing table with linear probing. Each slot
+   holds the hash of its key next to the state pointer, in an array apart
+   from the keys themselves, so a probe walks a few contiguous cache lines
+   and only touches a key whose hash matched. Deletion shifts the rest of
+   the probe run back instead of leaving tombstones, so lookups never slow
+   down as transactions come and go.
+
+   The hash is Data::caseInsensitiveTokenHash() of the tid; callers on the
+   message path pass the one BranchParameter computed while parsing the
+   Via (see TransactionMessage::getTransactionIdHash()) so the tid is not
+   rehashed for every lookup.
 */
 class TransactionMap 
 {
   public:
+     TransactionMap();
      ~TransactionMap();
      
      TransactionState* find( const Data& transactionId ) const;
+     TransactionState* find( const Data& transactionId, size_t hash ) const;
      void add( const Data& transactionId, TransactionState* state  );
      void erase( const Data& transactionId );
      int size() const;
      
   private:
+     TransactionMap(const TransactionMap&);
+     TransactionMap& operator=(const TransactionMap&);
 
-     // We treat branch parameters as case insensitive (RFC3261):
-     // 7.3.1 Header Field Format
-     // ....
-     //    When comparing header fields, field names are always case-
-     //    insensitive.Unless otherwise stated in the definition of a
-     //    particular header field, field values, parameter names, and parameter
-     //    values are case-insensitive.Tokens are always case-insensitive.
-     //    Unless specified otherwise, values expressed as quoted strings are
-     //    case-sensitive.
-#if  defined(__INTEL_COMPILER ) || (defined(WIN32) && defined(_MSC_VER) && (_MSC_VER >= 1310) && (_MSC_VER < 1900))  // !slg! not sure if this works on __INTEL_COMPILER 
-      /**
-         @internal
-      */
-      class BranchCompare
-      {
-         public:
-            enum { bucket_size = 4, min_buckets = 8 };
+     struct Slot
+     {
+        Slot() : mHash(0), mState(0) {}
+        size_t mHash;
+        TransactionState* mState; // 0 if the slot is free
+     };
 
-            inline size_t operator()(const Data& branch) const
-            {
-               return branch.caseInsensitiveTokenHash();
-            }
+     // home slot of a hash; the multiplication spreads the hash bits so the
+     // table size can be a power of two
+     size_t home(size_t hash) const
+     {
+        return size_t((UInt64(hash) * 0x9E3779B97F4A7C15ULL) >> (64 - mBits));
+     }
 
-            inline bool operator()(const Data& branch1, const Data& branch2) const
-            {
-               return isLessThanNoCase(branch1,branch2);
-            }
-      };
-#elif defined(HASH_MAP_NAMESPACE)
-      /**
-         @internal
-      */
-      class BranchHasher
-      {
-         public:
-            inline size_t operator()(const Data& branch) const
-            {
-               return branch.caseInsensitiveTokenHash();
-            }
-      };
+     // index of the slot holding transactionId, or npos
+     size_t locate(const Data& transactionId, size_t hash) const;
+     void insert(const Data& transactionId, size_t hash, TransactionState* state);
+     void removeAt(size_t index);
+     void grow();
 
-      /**
-         @internal
-      */
-      class BranchEqual
-      {
-         public:
-            inline bool operator()(const Data& branch1, const Data& branch2) const
-            {
-               return isEqualNoCase(branch1,branch2);
-            }
-      };
-#else
-      /**
-         @internal
-      */
-      class BranchCompare
-      {
-         public:
-            inline bool operator()(const Data& branch1, const Data& branch2) const
-            {
-               return isLessThanNoCase(branch1,branch2);
-            }
-      };
-#endif
-
-      // .bwc. If rutil/HashMap.hxx fails to find a hash_map impl for the 
-      // platform we're using, it will #define HashMap to a std::map, which
-      // takes different template args. We try to compensate for this here.
-#if  defined(__INTEL_COMPILER ) || (defined(WIN32) && defined(_MSC_VER) && (_MSC_VER >= 1310) && (_MSC_VER < 1900))
-     typedef HashMap<Data, TransactionState*, BranchCompare> Map;
-#elif defined(HASH_MAP_NAMESPACE)
-     typedef HashMap<Data, TransactionState*, BranchHasher, BranchEqual> Map;
-#else
-     typedef std::map<Data, TransactionState*, BranchCompare> Map;
-#endif
+     static const size_t npos = size_t(-1);
 
-     Map mMap;
-     typedef Map::iterator MapIterator;
-     typedef Map::const_iterator MapConstIterator;
+     std::vector<Slot> mSlots;
+     std::vector<Data> mKeys;
+     size_t mMask;
+     unsigned int mBits;
+     size_t mSize;
 };
 }
 
@@ -15,6 +15,13 @@ class TransactionMessage : public Message
 
       virtual const Data& getTransactionId() const=0; 
 
+      // hash of getTransactionId() as used by TransactionMap; messages that
+      // have it at hand already should override this
+      virtual size_t getTransactionIdHash() const
+      {
+         return getTransactionId().caseInsensitiveTokenHash();
+      }
+
       // indicates this message is associated with a Client Transaction for the
       // purpose of determining which TransactionMap to use
       virtual bool isClientTransaction() const = 0; 
@@ -48,7 +48,7 @@ using namespace resip;
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSACTION
 
 UInt64 TransactionState::DnsGreylistDurationMs = 32000;  // default to 32 seconds, application can override
-UInt32 TransactionState::StatelessIdCounter = 0;
+std::atomic<UInt32> TransactionState::StatelessIdCounter(0);
 
 TransactionState::TransactionState(TransactionController& controller, Machine m, 
                                    State s, const Data& id, MethodTypes method, const Data& methodText, TransactionUser* tu) : 
@@ -70,7 +70,10 @@ TransactionState::TransactionState(TransactionController& controller, Machine m,
    mTransactionUser(tu),
    mFailureReason(TransportFailure::None),
    mFailureSubCode(0),
-   mTcpConnectTimerStarted(false)
+   mTcpConnectTimerStarted(false),
+   mStartTime(controller.mStack.statisticsManagerEnabled() ? Timer::getTimeMicroSec() : 0),
+   mTimedFirstResponse(false),
+   mTimedFinalResponse(false)
 {
    StackLog (<< "Creating new TransactionState: " << *this);
 }
@@ -109,7 +112,7 @@ TransactionState::handleInternalCancel(SipMessage* cancel,
    cancel->header(h_Vias).front().param(p_branch) = clientInvite.mNextTransmission->const_header(h_Vias).front().param(p_branch);
    state->processClientNonInvite(cancel);
    // for the INVITE in case we never get a 487
-   clientInvite.mController.mTimers.add(Timer::TimerCleanUp, clientInvite.mId, 128*Timer::T1);
+   clientInvite.startTimer(Timer::TimerCleanUp, 128*Timer::T1);
 }
 
 bool
@@ -159,6 +162,11 @@ TransactionState::~TransactionState()
 
    //StackLog (<< "Deleting TransactionState " << mId << " : " << this);
    erase(mId);
+
+   for (TimerHandles::const_iterator i = mTimerHandles.begin(); i != mTimerHandles.end(); ++i)
+   {
+      mController.mTimers.cancel(*i);
+   }
    
    delete mNextTransmission;
    delete mMethodText;
@@ -243,7 +251,7 @@ TransactionState::processSipMessageAsNew(SipMessage* sip, TransactionController&
             else
             {
                //StackLog(<<" adding T100 timer (INV)");
-               controller.mTimers.add(Timer::TimerTrying, tid, Timer::T100);
+               state->startTimer(Timer::TimerTrying, Timer::T100);
             }
             state->sendToTU(sip);
             return true;
@@ -254,7 +262,7 @@ TransactionState::processSipMessageAsNew(SipMessage* sip, TransactionController&
             // to it, so that the cancel request can be treated as it's own transaction.  sip->getTransactionId()
             // will be the original tid from the wire and should match the tid of the INVITE request being 
             // cancelled.
-            TransactionState* matchingInvite = controller.mServerTransactionMap.find(sip->getTransactionId());
+            TransactionState* matchingInvite = controller.mServerTransactionMap.find(sip->getTransactionId(), sip->getTransactionIdHash());
             if (matchingInvite == 0)
             {
                InfoLog (<< "No matching INVITE for incoming (from wire) CANCEL to uas");
@@ -322,12 +330,12 @@ TransactionState::processSipMessageAsNew(SipMessage* sip, TransactionController&
                                                             Data::Empty,
                                                             tu);
             state->add(state->mId);
-            state->mController.mTimers.add(Timer::TimerStateless, state->mId, Timer::TS );
+            state->startTimer(Timer::TimerStateless, Timer::TS );
             state->processStateless(sip);
          }
          else if (method == CANCEL)
          {
-            TransactionState* matchingInvite = controller.mClientTransactionMap.find(sip->getTransactionId());
+            TransactionState* matchingInvite = controller.mClientTransactionMap.find(sip->getTransactionId(), sip->getTransactionIdHash());
                
             if (matchingInvite == 0)
             {
@@ -394,7 +402,7 @@ TransactionState::processSipMessageAsNew(SipMessage* sip, TransactionController&
                                  sip->methodStr(),
                                  tu);
          state->add(state->mId);
-         state->mController.mTimers.add(Timer::TimerStateless, state->mId, Timer::TS );
+         state->startTimer(Timer::TimerStateless, Timer::TS );
          state->processStateless(sip);
       }
    }
@@ -489,7 +497,7 @@ TransactionState::process(TransactionController& controller,
       PollStatistics* pollStatistics = dynamic_cast<PollStatistics*>(message);
       if(pollStatistics)
       {
-         controller.mStatsManager.poll();
+         controller.mStatsManager.poll(true);
          delete pollStatistics;
          return;
       }
@@ -519,9 +527,11 @@ TransactionState::process(TransactionController& controller,
    
    // .bwc. We can't do anything without a tid here. Check this first.
    Data tid;   
+   size_t tidHash = 0;
    try
    {
       tid = message->getTransactionId();
+      tidHash = message->getTransactionIdHash();
    }
    catch(resip::BaseException&)
    {
@@ -539,7 +549,7 @@ TransactionState::process(TransactionController& controller,
       // ?bwc? Should this come after checking for error conditions?
       if(controller.mStack.statisticsManagerEnabled() && sip->isExternal())
       {
-         controller.mStatsManager.received(sip);
+         controller.mStatsShard.received(sip);
       }
       
       // .bwc. Check for error conditions we can respond to.
@@ -597,17 +607,18 @@ TransactionState::process(TransactionController& controller,
       if (method == CANCEL) 
       {
          tid += "cancel";
+         tidHash = tid.caseInsensitiveTokenHash();
       }
    }
       
    TransactionState* state = 0;
    if (message->isClientTransaction()) 
    {
-      state = controller.mClientTransactionMap.find(tid);
+      state = controller.mClientTransactionMap.find(tid, tidHash);
    }
    else 
    {
-      state = controller.mServerTransactionMap.find(tid);
+      state = controller.mServerTransactionMap.find(tid, tidHash);
    }
    
    if (state && sip && sip->isExternal())
@@ -771,6 +782,13 @@ TransactionState::process(TransactionController& controller,
    {
       StackLog (<< "Found matching transaction for " << message->brief() << " -> " << *state);
 
+      if (sip && sip->isExternal() && sip->isResponse() &&
+          (state->mMachine == ClientNonInvite || state->mMachine == ClientInvite) &&
+          controller.mStack.statisticsManagerEnabled())
+      {
+         state->timeResponse(*sip);
+      }
+
       switch (state->mMachine)
       {
          case ClientNonInvite:
@@ -840,7 +858,11 @@ TransactionState::processTimer(TransactionController& controller,
 {
    Data tid = message->getTransactionId();
 
-   if(controller.getRejectionBehavior()==CongestionManager::REJECTING_NON_ESSENTIAL)
+   TransactionState* state = 0;
+   if (message->isClientTransaction()) state = controller.mClientTransactionMap.find(tid);
+   else state = controller.mServerTransactionMap.find(tid);
+
+   if(state && controller.getRejectionBehavior()==CongestionManager::REJECTING_NON_ESSENTIAL)
    {
       // .bwc. State machine fifo is backed up; we probably should not be 
       // retransmitting anything right now. If we have a retransmit timer, 
@@ -848,23 +870,17 @@ TransactionState::processTimer(TransactionController& controller,
       switch(message->getType())
       {
          case Timer::TimerA: // doubling
-            controller.mTimers.add(Timer::TimerA, 
-                                    tid, 
-                                    message->getDuration()*2);
+            state->startTimer(Timer::TimerA, message->getDuration()*2);
             delete message;
             return;
          case Timer::TimerE1:// doubling, until T2
          case Timer::TimerG: // doubling, until T2
-            controller.mTimers.add(message->getType(), 
-                                    tid, 
-                                    resipMin(message->getDuration()*2,
-                                             Timer::T2));
+            state->startTimer(message->getType(), 
+                              resipMin(message->getDuration()*2, Timer::T2));
             delete message;
             return;
          case Timer::TimerE2:// just reset
-            controller.mTimers.add(Timer::TimerE2, 
-                                    tid, 
-                                    Timer::T2);
+            state->startTimer(Timer::TimerE2, Timer::T2);
             delete message;
             return;
          default:
@@ -872,10 +888,6 @@ TransactionState::processTimer(TransactionController& controller,
       }
    }
 
-   TransactionState* state = 0;
-   if (message->isClientTransaction()) state = controller.mClientTransactionMap.find(tid);
-   else state = controller.mServerTransactionMap.find(tid);
-   
    if (state) // found transaction for timer
    {
       StackLog (<< "Found matching transaction for " << message->brief() << " -> " << *state);
@@ -916,6 +928,26 @@ TransactionState::processTimer(TransactionController& controller,
 
 }
 
+void
+TransactionState::startTimer(Timer::Type type, unsigned long msOffset)
+{
+   if (mTimerHandles.size() >= 8)
+   {
+      // Forget the timers that have already fired, so retransmission
+      // timers don't grow this without bound.
+      TimerHandles::iterator out = mTimerHandles.begin();
+      for (TimerHandles::iterator i = mTimerHandles.begin(); i != mTimerHandles.end(); ++i)
+      {
+         if (mController.mTimers.pending(*i))
+         {
+            *out++ = *i;
+         }
+      }
+      mTimerHandles.erase(out, mTimerHandles.end());
+   }
+   mTimerHandles.push_back(mController.mTimers.add(type, mId, msOffset));
+}
+
 void
 TransactionState::startServerNonInviteTimerTrying(SipMessage& sip, const Data& tid)
 {
@@ -927,7 +959,8 @@ TransactionState::startServerNonInviteTimerTrying(SipMessage& sip, const Data& t
       while(duration*2<Timer::T2) duration = duration * 2;
    }
    resetNextTransmission(make100(&sip));  // Store for use when timer expires
-   mController.mTimers.add(Timer::TimerTrying, tid, duration );  // Start trying timer so that we can send 100 to NITs as recommened in RFC4320
+   resip_assert(tid == mId);
+   startTimer(Timer::TimerTrying, duration);  // Start trying timer so that we can send 100 to NITs as recommened in RFC4320
 }
 
 void
@@ -1030,7 +1063,7 @@ TransactionState::processClientNonInvite(TransactionMessage* msg)
       SipMessage* sip = dynamic_cast<SipMessage*>(msg);
       resetNextTransmission(sip);
       saveOriginalContactAndVia(*sip);
-      mController.mTimers.add(Timer::TimerF, mId, Timer::TF);
+      startTimer(Timer::TimerF, Timer::TF);
       sendCurrentToWire();
    }
    else if (isResponse(msg) && isFromWire(msg)) // from the wire
@@ -1047,7 +1080,7 @@ TransactionState::processClientNonInvite(TransactionMessage* msg)
             // Should we restart the E2 timer though?  If so, we need to use somekind of timer sequence number so that previous E2 timers get discarded.
             if (!mIsReliable && mState == Trying)
             {
-               mController.mTimers.add(Timer::TimerE2, mId, Timer::T2 );
+               startTimer(Timer::TimerE2, Timer::T2 );
             }
             mState = Proceeding;
             sendToTU(msg); // don't delete            
@@ -1083,7 +1116,7 @@ TransactionState::processClientNonInvite(TransactionMessage* msg)
          else if (mState != Completed) // prevent TimerK reproduced
          {
             mState = Completed;
-            mController.mTimers.add(Timer::TimerK, mId, Timer::T4 );
+            startTimer(Timer::TimerK, Timer::T4 );
             // !bwc! Got final response in NIT. We don't need to do anything
             // except quietly absorb retransmissions. Dump all state.
             if(mDnsResult)
@@ -1113,7 +1146,7 @@ TransactionState::processClientNonInvite(TransactionMessage* msg)
             {
                unsigned long d = timer->getDuration();
                if (d < Timer::T2) d *= 2;
-               mController.mTimers.add(Timer::TimerE1, mId, d);
+               startTimer(Timer::TimerE1, d);
                StackLog (<< "Transmitting current message");
                sendCurrentToWire();
                delete timer;
@@ -1128,7 +1161,7 @@ TransactionState::processClientNonInvite(TransactionMessage* msg)
          case Timer::TimerE2:
             if (mState == Proceeding)
             {
-               mController.mTimers.add(Timer::TimerE2, mId, Timer::T2);
+               startTimer(Timer::TimerE2, Timer::T2);
                StackLog (<< "Transmitting current message");
                sendCurrentToWire();
                delete timer;
@@ -1228,7 +1261,7 @@ TransactionState::processClientInvite(TransactionMessage* msg)
             {
                resetNextTransmission(sip);
                saveOriginalContactAndVia(*sip);
-               mController.mTimers.add(Timer::TimerB, mId, Timer::TB );
+               startTimer(Timer::TimerB, Timer::TB );
                sendCurrentToWire();
             }
             else
@@ -1320,7 +1353,7 @@ TransactionState::processClientInvite(TransactionMessage* msg)
                }
                StackLog (<< "Received 2xx on client invite transaction");
                StackLog (<< *this);
-               mController.mTimers.add(Timer::TimerStaleClient, mId, Timer::TS );
+               startTimer(Timer::TimerStaleClient, Timer::TS );
             }
             else if (code >= 300)
             {
@@ -1358,7 +1391,7 @@ TransactionState::processClientInvite(TransactionMessage* msg)
                      // reliable, if transport is Unreliable then Fire the Timer D which 
                      // take care of re-Transmission of ACK 
                      mState = Completed;
-                     mController.mTimers.add(Timer::TimerD, mId, Timer::TD );
+                     startTimer(Timer::TimerD, Timer::TD );
                      SipMessage* ack = Helper::makeFailureAck(*mNextTransmission, *sip);
                      mNextTransmission->copyOutboundDecoratorsToStackFailureAck(*ack);
                      resetNextTransmission(ack);
@@ -1425,7 +1458,7 @@ TransactionState::processClientInvite(TransactionMessage* msg)
                unsigned long d = timer->getDuration()*2;
                // TimerA is supposed to double with each retransmit RFC3261 17.1.1          
 
-               mController.mTimers.add(Timer::TimerA, mId, d);
+               startTimer(Timer::TimerA, d);
                DebugLog (<< "Retransmitting INVITE ");
                sendCurrentToWire();
             }
@@ -1628,7 +1661,7 @@ TransactionState::processServerNonInvite(TransactionMessage* msg)
             if (mState == Trying || mState == Proceeding)
             {
                mState = Completed;
-               mController.mTimers.add(Timer::TimerJ, mId, 64*Timer::T1 );
+               startTimer(Timer::TimerJ, 64*Timer::T1 );
                resetNextTransmission(sip);
                sendCurrentToWire();
             }
@@ -1718,7 +1751,7 @@ TransactionState::processServerNonInvite(TransactionMessage* msg)
             // retransmission comes in. In the meantime, set up timers for
             // transaction termination.
             mState = Completed;
-            mController.mTimers.add(Timer::TimerJ, mId, 64*Timer::T1 );
+            startTimer(Timer::TimerJ, 64*Timer::T1 );
          }
       }
       delete msg;
@@ -1753,10 +1786,10 @@ TransactionState::processServerInvite(TransactionMessage* msg)
                mAckIsValid=true;
                resetNextTransmission(Helper::makeResponse(*sip, 500));
                mState = Completed;
-               mController.mTimers.add(Timer::TimerH, mId, Timer::TH );
+               startTimer(Timer::TimerH, Timer::TH );
                if (!mIsReliable)
                {
-                  mController.mTimers.add(Timer::TimerG, mId, Timer::T1 );
+                  startTimer(Timer::TimerG, Timer::T1 );
                }
                sendCurrentToWire();
                delete msg;
@@ -1807,7 +1840,7 @@ TransactionState::processServerInvite(TransactionMessage* msg)
                {
                   //StackLog (<< "Received ACK in Completed (unreliable) - confirmed, start Timer I");
                   mState = Confirmed;
-                  mController.mTimers.add(Timer::TimerI, mId, Timer::T4 );
+                  startTimer(Timer::TimerI, Timer::T4 );
                   // !bwc! Got an ACK/failure; we can stop retransmitting
                   // our failure response now.
                   resetNextTransmission(0);
@@ -1882,7 +1915,7 @@ TransactionState::processServerInvite(TransactionMessage* msg)
                   // source Tuple that the request was received on. 
                   //terminateServerTransaction(mId);
                   mMachine = ServerStale;
-                  mController.mTimers.add(Timer::TimerStaleServer, mId, Timer::TS );
+                  startTimer(Timer::TimerStaleServer, Timer::TS );
                }
                else
                {
@@ -1908,10 +1941,10 @@ TransactionState::processServerInvite(TransactionMessage* msg)
                   StackLog (<< "Received failed response in Trying or Proceeding. Start Timer H, move to completed." << *this);
                   resetNextTransmission(sip);
                   mState = Completed;
-                  mController.mTimers.add(Timer::TimerH, mId, Timer::TH );
+                  startTimer(Timer::TimerH, Timer::TH );
                   if (!mIsReliable)
                   {
-                     mController.mTimers.add(Timer::TimerG, mId, Timer::T1 );
+                     startTimer(Timer::TimerG, Timer::T1 );
                   }
                   sendCurrentToWire(); // don't delete msg
                }
@@ -1949,7 +1982,7 @@ TransactionState::processServerInvite(TransactionMessage* msg)
             {
                StackLog (<< "TimerG fired. retransmit, and re-add TimerG");
                sendCurrentToWire();
-               mController.mTimers.add(Timer::TimerG, mId, resipMin(Timer::T2, timer->getDuration()*2) );  //  TimerG is supposed to double - up until a max of T2 RFC3261 17.2.1
+               startTimer(Timer::TimerG, resipMin(Timer::T2, timer->getDuration()*2) );  //  TimerG is supposed to double - up until a max of T2 RFC3261 17.2.1
             }
             break;
 
@@ -2018,10 +2051,10 @@ TransactionState::processServerInvite(TransactionMessage* msg)
             mAckIsValid=true;
             StackLog (<< "Received failed response in Trying or Proceeding. Start Timer H, move to completed." << *this);
             mState = Completed;
-            mController.mTimers.add(Timer::TimerH, mId, Timer::TH );
+            startTimer(Timer::TimerH, Timer::TH );
             if (!mIsReliable)
             {
-               mController.mTimers.add(Timer::TimerG, mId, Timer::T1 );
+               startTimer(Timer::TimerG, Timer::T1 );
             }
          }
          else
@@ -2428,7 +2461,7 @@ TransactionState::processTcpConnectState(TransactionMessage* msg)
        (mState == Trying || mState == Calling))
    {
       // Start Timer
-      mController.mTimers.add(Timer::TcpConnectTimer, mId, Timer::TcpConnectTimeout);
+      startTimer(Timer::TcpConnectTimer, Timer::TcpConnectTimeout);
       mTcpConnectTimerStarted = true;
    }
    else if (tcpConnectState->getState() == TcpConnectState::Connected &&
@@ -2520,11 +2553,11 @@ TransactionState::processReliability(TransportType type)
             switch (mMachine)
             {
                case ClientNonInvite:
-                  mController.mTimers.add(Timer::TimerE1, mId, Timer::T1 );
+                  startTimer(Timer::TimerE1, Timer::T1 );
                   break;
                   
                case ClientInvite:
-                  mController.mTimers.add(Timer::TimerA, mId, Timer::T1 );
+                  startTimer(Timer::TimerA, Timer::T1 );
                   break;
 
                default:
@@ -2590,9 +2623,9 @@ TransactionState::sendCurrentToWire()
    {
       if(mController.mStack.statisticsManagerEnabled())
       {
-         mController.mStatsManager.retransmitted(mCurrentMethodType, 
-                                                   isClient(), 
-                                                   mCurrentResponseCode);
+         mController.mStatsShard.retransmitted(mCurrentMethodType, 
+                                              isClient(), 
+                                              mCurrentResponseCode);
       }
 
       mController.mTransportSelector.retransmit(mMsgToRetransmit);
@@ -2710,6 +2743,30 @@ TransactionState::sendCurrentToWire()
    }
 }
 
+void
+TransactionState::timeResponse(const SipMessage& response)
+{
+   // Only the first response and the first final response are timed;
+   // anything after that is a retransmission or a further provisional.
+   int code = response.const_header(h_StatusLine).statusCode();
+   if (mStartTime == 0 || (mTimedFirstResponse && (code < 200 || mTimedFinalResponse)))
+   {
+      return;
+   }
+
+   UInt64 elapsed = Timer::getTimeMicroSec() - mStartTime;
+   if (!mTimedFirstResponse)
+   {
+      mController.mStatsShard.transactionSetup(elapsed);
+      mTimedFirstResponse = true;
+   }
+   if (code >= 200 && !mTimedFinalResponse)
+   {
+      mController.mStatsShard.responded(mMethod, elapsed);
+      mTimedFinalResponse = true;
+   }
+}
+
 void
 TransactionState::onSendSuccess()
 {
@@ -2717,7 +2774,7 @@ TransactionState::onSendSuccess()
 
    if(mController.mStack.statisticsManagerEnabled())
    {
-      mController.mStatsManager.sent(sip);
+      mController.mStatsShard.sent(sip);
    }
 
    mCurrentMethodType = sip->method();
@@ -1,13 +1,17 @@
 #if !defined(RESIP_TRANSACTIONSTATE_HXX)
 #define RESIP_TRANSACTIONSTATE_HXX
 
+#include <atomic>
 #include <iosfwd>
 #include <memory>
+#include <vector>
 #include "rutil/dns/DnsHandler.hxx"
 #include "resip/stack/MethodTypes.hxx"
 #include "resip/stack/SipMessage.hxx"
+#include "resip/stack/TimerQueue.hxx"
 #include "resip/stack/Transport.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
+#include "rutil/Timer.hxx"
 
 namespace resip
 {
@@ -115,12 +119,15 @@ class TransactionState : public DnsHandler
       static void sendToTU(TransactionUser* tu, TransactionController& controller, TransactionMessage* msg);
       void sendCurrentToWire();
       void onSendSuccess();
+      // records latencies for a response to a client transaction
+      void timeResponse(const SipMessage& response);
       SipMessage* make100(SipMessage* request) const;
       void terminateClientTransaction(const Data& tid); 
       void terminateServerTransaction(const Data& tid); 
       const Data& tid(SipMessage* sip) const;
 
       void startServerNonInviteTimerTrying(SipMessage& sip, const Data& tid);
+      void startTimer(Timer::Type type, unsigned long msOffset);
 
       static TransactionState* makeCancelTransaction(TransactionState* tran, Machine machine, const Data& tid);
       static void handleInternalCancel(SipMessage* cancel,
@@ -194,7 +201,20 @@ class TransactionState : public DnsHandler
       int mFailureSubCode;
       bool mTcpConnectTimerStarted;
 
-      static UInt32 StatelessIdCounter;
+      // when this transaction was created (0 if statistics were disabled),
+      // and which of its response latencies have been recorded
+      UInt64 mStartTime;
+      bool mTimedFirstResponse;
+      bool mTimedFinalResponse;
+
+      // Handles (see TimerQueue::cancel()) of the timers started through
+      // startTimer(); whatever has not fired by the time this transaction
+      // is deleted is cancelled instead of firing into nothing.
+      typedef std::vector<TransactionTimerQueue::Handle> TimerHandles;
+      TimerHandles mTimerHandles;
+
+      // shared by every TransactionController shard
+      static std::atomic<UInt32> StatelessIdCounter;
       
       friend EncodeStream& operator<<(EncodeStream& strm, const TransactionState& state);
       friend class TransactionController;
@@ -55,6 +55,11 @@ class FdPollGrp;
  *    Specifies whether this Transport object has its own thread (ie; if
  *    set, the TransportSelector should not run the select/poll loop for
  *    this transport, since that is another thread's job)
+ * REUSEPORT:
+ *    Set SO_REUSEPORT on the socket before binding, so that several
+ *    transports may bind the same address and port and have the kernel
+ *    spread incoming traffic across them. Only honoured by UdpTransport;
+ *    used by ShardedUdpTransport.
  */
 #define RESIP_TRANSPORT_FLAG_NOBIND      (1<<0)
 #define RESIP_TRANSPORT_FLAG_RXALL       (1<<1)
@@ -62,6 +67,7 @@ class FdPollGrp;
 #define RESIP_TRANSPORT_FLAG_KEEP_BUFFER (1<<3)
 #define RESIP_TRANSPORT_FLAG_TXNOW       (1<<4)
 #define RESIP_TRANSPORT_FLAG_OWNTHREAD   (1<<5)
+#define RESIP_TRANSPORT_FLAG_REUSEPORT   (1<<6)
 
 /**
    @brief The base class for Transport classes.
@@ -96,9 +102,11 @@ class Transport : public FdSetIOObserver
           virtual void inboundMessage(const Tuple& source, const Tuple& destination, const SipMessage &msg) = 0;
       };
 
-      void setSipMessageLoggingHandler(std::shared_ptr<SipMessageLoggingHandler> handler) noexcept { mSipMessageLoggingHandler = std::move(handler); }
-      void unsetSipMessageLoggingHandler() noexcept { mSipMessageLoggingHandler.reset(); }
-      std::shared_ptr<SipMessageLoggingHandler> getSipMessageLoggingHandler() const noexcept { return mSipMessageLoggingHandler; }
+      // The handler may be changed while the transport is processing on
+      // another thread, so it is swapped and read atomically.
+      virtual void setSipMessageLoggingHandler(std::shared_ptr<SipMessageLoggingHandler> handler) noexcept { std::atomic_store(&mSipMessageLoggingHandler, std::move(handler)); }
+      virtual void unsetSipMessageLoggingHandler() noexcept { setSipMessageLoggingHandler(std::shared_ptr<SipMessageLoggingHandler>()); }
+      std::shared_ptr<SipMessageLoggingHandler> getSipMessageLoggingHandler() const noexcept { return std::atomic_load(&mSipMessageLoggingHandler); }
 
       /**
          @brief General exception class for Transport.
@@ -277,6 +285,13 @@ class Transport : public FdSetIOObserver
       virtual bool isReliable() const =0;
       virtual bool isDatagram() const =0;
 
+      /**
+         @return true if the transport can send a gathered SendData (see
+         SendData::isGathered()) without flattening it first. Gathered
+         sends are only handed to transports that say so.
+      */
+      virtual bool supportsGatheredSends() const { return false; }
+
       /// @return net namespace in which Transport is bound
       const Data& netNs() const { return(mTuple.getNetNs()); }
 
@@ -357,6 +372,19 @@ class Transport : public FdSetIOObserver
       //# queued messages on this transport
       virtual unsigned int getFifoSize() const=0;
 
+      //# open connections and bytes held in their receive buffers
+      //# (stream transports only)
+      virtual unsigned int getConnectionCount() const { return 0; }
+      virtual UInt64 getReceiveBufferBytes() const { return 0; }
+      //# writes that sent something, and the messages they completed
+      //# (stream transports only)
+      virtual UInt64 getWrites() const { return 0; }
+      virtual UInt64 getMessagesWritten() const { return 0; }
+      //# TLS handshakes completed in full and by resuming a session
+      //# (TLS transports only)
+      virtual UInt64 getTlsFullHandshakes() const { return 0; }
+      virtual UInt64 getTlsResumedHandshakes() const { return 0; }
+
       void callSocketFunc(Socket sock);
       virtual void invokeAfterSocketCreationFunc() const = 0;  //used to invoke the after socket creation func immeidately for all existing sockets - can be used to modify QOS settings at runtime
 
@@ -22,17 +22,21 @@
 #include "resip/stack/TransactionState.hxx"
 #include "resip/stack/TransportFailure.hxx"
 #include "resip/stack/TransportSelector.hxx"
+#include "resip/stack/GatherStream.hxx"
 #include "resip/stack/InternalTransport.hxx"
 #include "resip/stack/TcpBaseTransport.hxx"
 #include "resip/stack/TcpTransport.hxx"
 #include "resip/stack/UdpTransport.hxx"
+#include "resip/stack/ShardedUdpTransport.hxx"
 #include "resip/stack/WsTransport.hxx"
 #include "resip/stack/Uri.hxx"
 
 #include "rutil/DataStream.hxx"
 #include "rutil/DnsUtil.hxx"
 #include "rutil/Inserter.hxx"
+#include "rutil/Lock.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/DeferredLog.hxx"
 #include "rutil/Socket.hxx"
 #include "rutil/FdPoll.hxx"
 #include "rutil/WinLeakCheck.hxx"
@@ -67,6 +71,19 @@ using namespace resip;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
 
+// The bytes of a SendData, gathered or not; for logging.
+static Data
+wholeMessage(const SendData& send)
+{
+   if (!send.isGathered())
+   {
+      return send.data;
+   }
+   SendData whole(send);
+   whole.flatten();
+   return whole.data;
+}
+
 TransportSelector::TransportSelector(Fifo<TransactionMessage>& fifo, Security* security, DnsStub& dnsStub, Compression &compression, bool useDnsVip) :
    mDns(dnsStub, useDnsVip),
    mStateMacFifo(fifo),
@@ -75,6 +92,7 @@ TransportSelector::TransportSelector(Fifo<TransactionMessage>& fifo, Security* s
    mSigcompStack (0),
    mPollGrp(0),
    mAvgBufferSize(1024),
+   mGatheredEncoding(false),
    mInterruptorHandle(0)
 {
    memset(&mUnspecified.v4Address, 0, sizeof(sockaddr_in));
@@ -145,6 +163,7 @@ TransportSelector::~TransportSelector()
 void
 TransportSelector::shutdown()
 {
+   ReadLock lock(mTransportsMutex);
    for(TransportKeyMap::iterator it = mTransports.begin(); it != mTransports.end(); it++)
    {
        it->second->shutdown();
@@ -154,6 +173,7 @@ TransportSelector::shutdown()
 bool
 TransportSelector::isFinished() const
 {
+   ReadLock lock(mTransportsMutex);
    for(TransportKeyMap::const_iterator it = mTransports.begin(); it != mTransports.end(); it++)
    {
       if (!it->second->isFinished())
@@ -168,6 +188,7 @@ void
 TransportSelector::addTransport(std::unique_ptr<Transport> autoTransport, bool isStackRunning)
 {
    Transport* transport = autoTransport.release();
+   WriteLock lock(mTransportsMutex);
 
    // !bwc! This is a multimap from TransportType/IpVersion to Transport*.
    // Make _extra_ sure that no garbage goes in here.
@@ -183,7 +204,8 @@ TransportSelector::addTransport(std::unique_ptr<Transport> autoTransport, bool i
 #endif
    else if(transport->transport()==UDP)
    {
-      resip_assert(dynamic_cast<UdpTransport*>(transport));
+      resip_assert(dynamic_cast<UdpTransport*>(transport) ||
+                   dynamic_cast<ShardedUdpTransport*>(transport));
    }
 #ifdef USE_DTLS
 #ifdef USE_SSL
@@ -298,6 +320,7 @@ void
 TransportSelector::removeTransport(unsigned int transportKey)
 {
    Transport* transportToRemove = 0;
+   WriteLock lock(mTransportsMutex);
 
    // Find transport in global map and remove it
    // Note: it is important that this map is removed from before rebuildAnyPortTransportMaps is called,
@@ -533,6 +556,7 @@ TransportSelector::checkTransportAddRemoveQueue()
 void 
 TransportSelector::poke()
 {
+   ReadLock lock(mTransportsMutex);
    for(TransportList::iterator it = mHasOwnProcessTransports.begin(); it != mHasOwnProcessTransports.end(); it++)
    {
       try
@@ -723,7 +747,7 @@ TransportSelector::findTransportByVia(SipMessage* msg, const Tuple& target, Tupl
    source = Tuple(via.sentHost(), via.sentPort(), target.ipVersion(), 
       via.transport().empty() ? target.getType() : toTransportType(via.transport()), // Transport type is pre-populated in via, lock to it
       Data::Empty, target.getNetNs());
-   DebugLog(<< "TransportSelector::findTransportByVia: source: " << source);
+   DeferredDebugLog("TransportSelector::findTransportByVia: source: {}", source);
 
    if ( target.mFlowKey!=0 && (source.getPort()==0 || source.isAnyInterface()) )
    {
@@ -788,6 +812,7 @@ TransportSelector::determineSourceInterface(SipMessage* msg, const Tuple& target
 
       // this process will determine which interface the kernel would use to
       // send a packet to the target by making a connect call on a udp socket.
+      Lock lock(mSocketsMutex);
       Socket tmp = INVALID_SOCKET;
       Data netNs = target.getNetNs();
       // One IPV4 and IPV6 socket per namespace.  Even if we do not support netns,
@@ -913,10 +938,8 @@ TransportSelector::determineSourceInterface(SipMessage* msg, const Tuple& target
          source.setPort(0);
       }
 
-      DebugLog (<< "Looked up source for destination: " << target
-                << " -> " << source
-                << " sent-by=" << via.sentHost()
-                << " sent-port=" << via.sentPort());
+      DeferredDebugLog("Looked up source for destination: {} -> {} sent-by={} sent-port={}",
+                       target, source, via.sentHost(), via.sentPort());
 
       return source;
    }
@@ -928,6 +951,7 @@ TransportSelector::TransmitState
 TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
 {
    resip_assert(msg);
+   ReadLock lock(mTransportsMutex);
 
    if(msg->mIsDecorated)
    {
@@ -1320,22 +1344,34 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
                                                    msg->getTransactionId(),
                                                    remoteSigcompId));
 
-         send->data.reserve(mAvgBufferSize + mAvgBufferSize/4);
+         int avgBufferSize = mAvgBufferSize.load(std::memory_order_relaxed);
+         send->data.reserve(avgBufferSize + avgBufferSize/4);
 
-         DataStream str(send->data);
-         msg->encode(str);
-         str.flush();
+         if (mGatheredEncoding && 
+             transport->supportsGatheredSends() && 
+             remoteSigcompId.empty())
+         {
+            GatherStream str(*send);
+            msg->encodeGathered(str);
+         }
+         else
+         {
+            DataStream str(send->data);
+            msg->encode(str);
+            str.flush();
+         }
 
          // !bwc! Moving average of message size. (Used to intelligently
          // predict how much space to reserve in the buffer, to minimize
          // dynamic resizing.)
-         mAvgBufferSize = (255*mAvgBufferSize + send->data.size()+128)/256;
+         mAvgBufferSize.store((255*avgBufferSize + (int)send->data.size()+128)/256,
+                              std::memory_order_relaxed);
 
-         resip_assert(!send->data.empty());
+         resip_assert(!send->empty());
          DebugLog (<< "Transmitting to " << target
                    << " tlsDomain=" << msg->getTlsDomain()
                    << " via " << source
-                   << std::endl << std::endl << send->data.escaped()
+                   << std::endl << std::endl << wholeMessage(*send).escaped()
                    << "sigcomp id=" << remoteSigcompId);
 
          if(sendData)
@@ -1364,6 +1400,7 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
 void
 TransportSelector::retransmit(const SendData& data)
 {
+   ReadLock lock(mTransportsMutex);
    resip_assert(data.destination.mTransportKey);
    Transport* transport = findTransportByDest(data.destination);
 
@@ -1394,18 +1431,25 @@ TransportSelector::retransmit(const SendData& data)
    {
       // If this is not true, it means the transport has been removed.
       std::shared_ptr<Transport::SipMessageLoggingHandler> handler = transport->getSipMessageLoggingHandler();
+      std::unique_ptr<SendData> clone(data.clone());
+      // handlers only know how to look at data
+      if (clone->isGathered() && (handler || !transport->supportsGatheredSends()))
+      {
+         clone->flatten();
+      }
       if(handler)
       {
-         handler->outboundRetransmit(transport->getTuple(), data.destination, data);
+         handler->outboundRetransmit(transport->getTuple(), clone->destination, *clone);
       }
        
-      transport->send(std::unique_ptr<SendData>(data.clone()));
+      transport->send(std::move(clone));
    }
 }
 
 void 
 TransportSelector::closeConnection(const Tuple& peer)
 {
+   ReadLock lock(mTransportsMutex);
    Transport* t = findTransportByDest(peer);
    if(t)
    {
@@ -1421,6 +1465,7 @@ TransportSelector::closeConnection(const Tuple& peer)
 unsigned int
 TransportSelector::sumTransportFifoSizes() const
 {
+   ReadLock lock(mTransportsMutex);
    unsigned int sum = 0;
    for(TransportKeyMap::const_iterator it = mTransports.begin(); it != mTransports.end(); it++)
    {
@@ -1429,6 +1474,37 @@ TransportSelector::sumTransportFifoSizes() const
    return sum;
 }
 
+void
+TransportSelector::sumConnectionStatistics(unsigned int& connections, UInt64& receiveBufferBytes,
+                                           UInt64& writes, UInt64& messagesWritten) const
+{
+   ReadLock lock(mTransportsMutex);
+   connections = 0;
+   receiveBufferBytes = 0;
+   writes = 0;
+   messagesWritten = 0;
+   for(TransportKeyMap::const_iterator it = mTransports.begin(); it != mTransports.end(); it++)
+   {
+      connections += it->second->getConnectionCount();
+      receiveBufferBytes += it->second->getReceiveBufferBytes();
+      writes += it->second->getWrites();
+      messagesWritten += it->second->getMessagesWritten();
+   }
+}
+
+void
+TransportSelector::sumTlsHandshakeStatistics(UInt64& full, UInt64& resumed) const
+{
+   ReadLock lock(mTransportsMutex);
+   full = 0;
+   resumed = 0;
+   for(TransportKeyMap::const_iterator it = mTransports.begin(); it != mTransports.end(); it++)
+   {
+      full += it->second->getTlsFullHandshakes();
+      resumed += it->second->getTlsResumedHandshakes();
+   }
+}
+
 void 
 TransportSelector::terminateFlow(const resip::Tuple& flow)
 {
@@ -1438,6 +1514,7 @@ TransportSelector::terminateFlow(const resip::Tuple& flow)
 void 
 TransportSelector::enableFlowTimer(const resip::Tuple& flow)
 {
+   ReadLock lock(mTransportsMutex);
    Transport* t = findTransportByDest(flow);
    if(t)
    {
@@ -1453,6 +1530,7 @@ TransportSelector::enableFlowTimer(const resip::Tuple& flow)
 void 
 TransportSelector::invokeAfterSocketCreationFunc(TransportType type)
 {
+   ReadLock lock(mTransportsMutex);
     for (TransportKeyMap::iterator it = mTransports.begin(); it != mTransports.end(); it++)
     {
         if (type == UNKNOWN_TRANSPORT || type == it->second->transport())
@@ -1546,7 +1624,7 @@ TransportSelector::findLoopbackTransportBySource(bool ignorePort, Tuple& search)
 Transport*
 TransportSelector::findTransportBySource(Tuple& search, const SipMessage* msg) const
 {
-   DebugLog(<< "findTransportBySource(" << search << ")");
+   DeferredDebugLog("findTransportBySource({})", search);
 
    if(msg && 
       !msg->getTlsDomain().empty() && 
@@ -5,6 +5,7 @@
 #include <sys/select.h>
 #endif
 
+#include <atomic>
 #include <map>
 #include <vector>
 #include <list>
@@ -12,6 +13,8 @@
 #include "rutil/Data.hxx"
 #include "rutil/Fifo.hxx"
 #include "rutil/GenericIPAddress.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/RWMutex.hxx"
 #include "resip/stack/Transport.hxx"
 #include "resip/stack/DnsInterface.hxx"
 #include "rutil/SelectInterruptor.hxx"
@@ -79,6 +82,15 @@ class TransportSelector
       /// Must be called before adding any transports
       void setPollGrp(FdPollGrp *pollGrp);
 
+      /**
+         When enabled, messages for transports that support it are encoded
+         with SipMessage::encodeGathered(), so that text still in the 
+         buffers a message was received in is sent from there rather than
+         copied. Off by default.
+      */
+      void setGatheredEncoding(bool enable) { mGatheredEncoding = enable; }
+      bool getGatheredEncoding() const { return mGatheredEncoding; }
+
       /// Called when the TransportSelector will be running in a different 
       // thread than the TransactionController; this will allow the thread to be 
       // interrupted when poke() is called.
@@ -122,6 +134,9 @@ class TransportSelector
       void closeConnection(const Tuple& peer);
 
       unsigned int sumTransportFifoSizes() const;
+      void sumConnectionStatistics(unsigned int& connections, UInt64& receiveBufferBytes,
+                                   UInt64& writes, UInt64& messagesWritten) const;
+      void sumTlsHandshakeStatistics(UInt64& full, UInt64& resumed) const;
 
       unsigned int getTimeTillNextProcessMS();
       Fifo<TransactionMessage>& stateMacFifo() { return mStateMacFifo; }
@@ -144,6 +159,21 @@ class TransportSelector
          return mDns.getUdpOnlyOnNumeric();
       }
 
+      void addDnsShard(DnsStub& dnsStub)
+      {
+         mDns.addDnsShard(dnsStub);
+      }
+
+      bool saveDnsSnapshot(const Data& filename)
+      {
+         return mDns.saveDnsSnapshot(filename);
+      }
+
+      bool loadDnsSnapshot(const Data& filename)
+      {
+         return mDns.loadDnsSnapshot(filename);
+      }
+
       void setCongestionManager(CongestionManager* manager)
       {
          for(TransportKeyMap::iterator i=mTransports.begin();
@@ -237,9 +267,17 @@ class TransportSelector
       typedef std::multimap<Tuple, Transport*, Tuple::AnyPortAnyInterfaceCompare> TypeToTransportMap;
       TypeToTransportMap mTypeToTransportMap;
 
+      // Guards the transport maps above (except mSharedProcessTransports).
+      // Runtime add/remove happens on the primary TransactionController
+      // shard while the other shards transmit through this selector.
+      mutable RWMutex mTransportsMutex;
+
       // fake socket(s) one for each netns, for connect() and route table lookups
       mutable HashMap<Data, Socket> mSockets;
       mutable HashMap<Data, Socket> mSocket6s;
+      // transmit() is called from every TransactionController shard; the
+      // connect()/getsockname() dance on the fake sockets must not interleave
+      mutable Mutex mSocketsMutex;
 
       // An AF_UNSPEC addr_in for rapid unconnect
       GenericIPAddress mUnspecified;
@@ -252,7 +290,10 @@ class TransportSelector
       // epoll support, for sharedprocess transports
       FdPollGrp* mPollGrp;
 
-      int mAvgBufferSize;
+      // Every TransactionController shard transmits through this selector;
+      // it is only an estimate, so updates may be lost but must not tear.
+      std::atomic<int> mAvgBufferSize;
+      bool mGatheredEncoding;
       Fifo<Transport> mTransportsToAddRemove;
       std::unique_ptr<SelectInterruptor> mSelectInterruptor;
       FdPollItemHandle mInterruptorHandle;
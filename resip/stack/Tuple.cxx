@@ -721,6 +721,37 @@ Tuple::operator<(const Tuple& rhs) const
    }
 }
 
+void
+DeferredLogArg<Tuple>::encode(Data& buffer, const Tuple& tuple)
+{
+   DeferredLog::encodeDecoder(buffer, &decode);
+   buffer.append(tuple.pad, sizeof(tuple.pad));
+   DeferredLog::encodeValue(buffer, tuple.mTransportType);
+   DeferredLog::encodeValue(buffer, tuple.mFlowKey);
+   DeferredLog::encodeValue(buffer, tuple.mTransportKey);
+   DeferredLog::encodeText(buffer, tuple.mTargetDomain.data(), tuple.mTargetDomain.size());
+   DeferredLog::encodeText(buffer, tuple.mNetNs.data(), tuple.mNetNs.size());
+}
+
+const char*
+DeferredLogArg<Tuple>::decode(EncodeStream& strm, const char* arg)
+{
+   Tuple tuple;
+   memcpy(tuple.pad, arg, sizeof(tuple.pad));
+   arg += sizeof(tuple.pad);
+   arg = DeferredLog::decodeValue(arg, tuple.mTransportType);
+   arg = DeferredLog::decodeValue(arg, tuple.mFlowKey);
+   arg = DeferredLog::decodeValue(arg, tuple.mTransportKey);
+   const char* text;
+   UInt32 length;
+   arg = DeferredLog::decodeText(arg, text, length);
+   tuple.mTargetDomain.copy(text, length);
+   arg = DeferredLog::decodeText(arg, text, length);
+   tuple.mNetNs.copy(text, length);
+   strm << tuple;
+   return arg;
+}
+
 EncodeStream&
 resip::operator<<(EncodeStream& ostrm, const Tuple& tuple)
 {
@@ -14,6 +14,7 @@
 #include "rutil/TransportType.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/DeferredLog.hxx"
 
 #if defined(WIN32)
 #include <Ws2tcpip.h>
@@ -280,12 +281,22 @@ private:
 
       friend EncodeStream& operator<<(EncodeStream& strm, const Tuple& tuple);
       friend class DnsResult;
+      friend struct DeferredLogArg<Tuple>;
 };
 
 
 EncodeStream&
 operator<<(EncodeStream& ostrm, const Tuple& tuple);
 
+/// Lets the DeferredLog macros copy a Tuple's address and leave the
+/// inet_ntop and formatting to the log writer.
+template <>
+struct DeferredLogArg<Tuple>
+{
+   static void encode(Data& buffer, const Tuple& tuple);
+   static const char* decode(EncodeStream& strm, const char* arg);
+};
+
 }
 
 HashValue(resip::Tuple);
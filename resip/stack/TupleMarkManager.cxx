@@ -3,6 +3,7 @@
 #include "resip/stack/MarkListener.hxx"
 #include "rutil/Lock.hxx"
 #include "rutil/Timer.hxx"
+#include "rutil/dns/DnsSnapshot.hxx"
 
 namespace resip
 {
@@ -11,25 +12,27 @@ TupleMarkManager::MarkType
 TupleMarkManager::getMarkType(const Tuple& tuple)
 {
    ListEntry entry(tuple,0);
-   TupleList::iterator i=mList.find(entry);
-   
-   if(i!=mList.end())
    {
+      Lock lock(mListMutex);
+      TupleList::iterator i=mList.find(entry);
+
+      if(i==mList.end())
+      {
+         return OK;
+      }
+
       UInt64 now=Timer::getTimeMs();
       if(i->first.mExpiry > now)
       {
          return i->second;
       }
-      else
-      {
-         mList.erase(i);
-         // ?bwc? Should we do this?
-         UInt64 expiry = 0;
-         MarkType mark = OK;
-         notifyListeners(tuple,expiry,mark);
-      }
+      mList.erase(i);
    }
-   
+
+   // ?bwc? Should we do this?
+   UInt64 expiry = 0;
+   MarkType mark = OK;
+   notifyListeners(tuple,expiry,mark);
    return OK;
 }
 
@@ -38,9 +41,75 @@ void TupleMarkManager::mark(const Tuple& tuple,UInt64 expiry,MarkType mark)
    // .amr. Notify listeners first so they can change the entry if they want
    notifyListeners(tuple,expiry,mark);
    ListEntry entry(tuple,expiry);
+   Lock lock(mListMutex);
    mList[entry]=mark;
 }
 
+void TupleMarkManager::encodeSnapshot(DnsSnapshotWriter& writer)
+{
+   UInt64 now=Timer::getTimeMs();
+   Lock lock(mListMutex);
+   UInt32 count=0;
+   for(TupleList::const_iterator i=mList.begin();i!=mList.end();++i)
+   {
+      if(i->second!=OK && i->first.mExpiry > now)
+      {
+         ++count;
+      }
+   }
+
+   writer.putUInt32(count);
+   for(TupleList::const_iterator i=mList.begin();i!=mList.end();++i)
+   {
+      if(i->second!=OK && i->first.mExpiry > now)
+      {
+         const Tuple& tuple=i->first.mTuple;
+         writer.putData(Tuple::inet_ntop(tuple));
+         writer.putUInt16((UInt16)tuple.getPort());
+         writer.putUInt8((UInt8)tuple.ipVersion());
+         writer.putUInt8((UInt8)tuple.getType());
+         writer.putData(tuple.getTargetDomain());
+         writer.putUInt64(i->first.mExpiry - now);
+         writer.putUInt8((UInt8)i->second);
+      }
+   }
+}
+
+bool TupleMarkManager::decodeSnapshot(DnsSnapshotReader& reader)
+{
+   UInt64 now=Timer::getTimeMs();
+   UInt64 age=reader.age()*1000;
+   UInt32 count=0;
+   reader.getUInt32(count);
+   for(UInt32 n=0;n<count && reader.ok();++n)
+   {
+      Data address;
+      UInt16 port=0;
+      UInt8 ipVersion=0;
+      UInt8 type=0;
+      Data targetDomain;
+      UInt64 remaining=0;
+      UInt8 mark=OK;
+      reader.getData(address);
+      reader.getUInt16(port);
+      reader.getUInt8(ipVersion);
+      reader.getUInt8(type);
+      reader.getData(targetDomain);
+      reader.getUInt64(remaining);
+      if(!reader.getUInt8(mark) || remaining <= age ||
+         (mark!=GREY && mark!=BLACK) || type>=MAX_TRANSPORT)
+      {
+         continue;
+      }
+
+      Tuple tuple(address, port, ipVersion==V6 ? V6 : V4, (TransportType)type, targetDomain);
+      ListEntry entry(tuple, now + remaining - age);
+      Lock lock(mListMutex);
+      mList[entry]=(MarkType)mark;
+   }
+   return reader.ok();
+}
+
 void TupleMarkManager::registerMarkListener(MarkListener* listener)
 {
    mListeners.insert(listener);
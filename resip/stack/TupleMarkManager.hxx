@@ -10,6 +10,8 @@ namespace resip
 {
 
 class MarkListener;
+class DnsSnapshotWriter;
+class DnsSnapshotReader;
 
 class TupleMarkManager
 {
@@ -31,6 +33,11 @@ class TupleMarkManager
       void registerMarkListener(MarkListener*);
       void unregisterMarkListener(MarkListener*);
 
+      // the unexpired grey/blacklist entries, for the DNS cache snapshot;
+      // restored entries do not notify listeners
+      void encodeSnapshot(DnsSnapshotWriter& writer);
+      bool decodeSnapshot(DnsSnapshotReader& reader);
+
    private:
       
       class ListEntry
@@ -51,6 +58,8 @@ class TupleMarkManager
       
       typedef std::map<ListEntry,MarkType> TupleList;
       TupleList mList;
+      // marks are read by the transaction layer and set from the DNS threads
+      Mutex mListMutex;
             
       typedef std::set<MarkListener*> Listeners;
       Listeners mListeners;
@@ -11,6 +11,7 @@
 #include "resip/stack/UdpTransport.hxx"
 #include "rutil/Data.hxx"
 #include "rutil/DnsUtil.hxx"
+#include "rutil/Inserter.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/Socket.hxx"
 #include "rutil/WinLeakCheck.hxx"
@@ -23,11 +24,93 @@
 #include <osc/SigcompMessage.h>
 #endif
 
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+#define RESIP_UDP_BATCH_IO
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+#if !defined(WIN32) && !defined(RESIP_UDP_BATCH_IO)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
 
 using namespace std;
 using namespace resip;
 
+#ifndef WIN32
+/**
+   Points iov at the pieces of a gathered SendData, or at its flat data.
+   iov must have room for SendData::MaxPieces entries. Returns the number
+   of entries used.
+*/
+static size_t
+fillIovecs(const SendData& send, iovec* iov)
+{
+   if (!send.isGathered())
+   {
+      iov[0].iov_base = (void*)send.data.data();
+      iov[0].iov_len = send.data.size();
+      return 1;
+   }
+   resip_assert(send.pieces.size() <= SendData::MaxPieces);
+   size_t n = 0;
+   for (std::vector<SendData::Piece>::const_iterator i = send.pieces.begin();
+        i != send.pieces.end(); ++i, ++n)
+   {
+      iov[n].iov_base = (void*)send.pieceData(*i);
+      iov[n].iov_len = i->length;
+   }
+   return n;
+}
+#endif
+
+/**
+   Scratch state for batched datagram I/O. The receive buffers form a
+   small pool: a buffer handed off to a SipMessage is replaced on the next
+   receive, all other buffers are reused from batch to batch.
+*/
+class UdpTransport::BatchIo
+{
+   public:
+      BatchIo(unsigned depth)
+         : mRxBuffers(depth, (char*)0),
+           mRxSenders(depth),
+           mTxData(depth, (SendData*)0)
+#ifdef RESIP_UDP_BATCH_IO
+           ,mRxHdrs(depth),
+           mRxIovs(depth),
+           mTxHdrs(depth),
+           mTxIovs(depth * (size_t)SendData::MaxPieces)
+#endif
+      {
+         for (unsigned i = 0; i < depth; ++i)
+         {
+            mRxBuffers[i] = MsgHeaderScanner::allocateBuffer(UdpTransport::MaxBufferSize);
+         }
+      }
+
+      ~BatchIo()
+      {
+         for (std::vector<char*>::iterator it = mRxBuffers.begin(); it != mRxBuffers.end(); ++it)
+         {
+            delete[] *it;
+         }
+      }
+
+      std::vector<char*> mRxBuffers;
+      std::vector<Tuple> mRxSenders;
+      std::vector<SendData*> mTxData;
+#ifdef RESIP_UDP_BATCH_IO
+      std::vector<mmsghdr> mRxHdrs;
+      std::vector<iovec> mRxIovs;
+      std::vector<mmsghdr> mTxHdrs;
+      std::vector<iovec> mTxIovs;
+#endif
+};
+
 UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
                            int portNum,
                            IpVersion version,
@@ -35,10 +118,14 @@ UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
                            const Data& pinterface,
                            AfterSocketCreationFuncPtr socketFunc,
                            Compression &compression,
-                           unsigned transportFlags)
+                           unsigned transportFlags,
+                           unsigned batchDepth)
    : InternalTransport(fifo, portNum, version, pinterface, socketFunc, compression, transportFlags),  
      mSigcompStack(0),
+     mRxBatchFill(2, 0),
+     mTxBatchFill(2, 0),
      mRxBuffer(0),
+     mBatchDepth(1),
      mStunSetting(stun),
      mExternalUnknownDatagramHandler(0),
      mInWritable(false)
@@ -49,6 +136,21 @@ UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
    mTuple.setType(UDP);
    mFd = InternalTransport::socket(transport(), version);
    mTuple.mFlowKey=(FlowKey)mFd;
+   if (transportFlags & RESIP_TRANSPORT_FLAG_REUSEPORT)
+   {
+#if defined(SO_REUSEPORT)
+      int on = 1;
+      if ( ::setsockopt(mFd, SOL_SOCKET, SO_REUSEPORT, (char*)&on, sizeof(on)) )
+      {
+         int e = getErrno();
+         ErrLog (<< "Couldn't set sockoptions SO_REUSEPORT: " << strerror(e));
+         throw Transport::Exception("Failed setsockopt SO_REUSEPORT", __FILE__,__LINE__);
+      }
+#else
+      ErrLog (<< "SO_REUSEPORT is not supported on this platform");
+      throw Transport::Exception("SO_REUSEPORT not supported", __FILE__,__LINE__);
+#endif
+   }
    bind();      // also makes it non-blocking
 
    InfoLog (<< "Creating UDP transport host=" << pinterface
@@ -70,6 +172,9 @@ UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
    DebugLog (<< "No compression library available: " << *this);
 #endif
    mTxFifo.setDescription("UdpTransport::mTxFifo");
+   // the batch state is used by whichever thread processes this transport,
+   // so it is fixed before there is one
+   initBatchDepth(batchDepth);
 }
 
 UdpTransport::~UdpTransport()
@@ -86,6 +191,12 @@ UdpTransport::~UdpTransport()
            <<" rxka="<<mRxKeepaliveCnt
            <<" rxtr="<<mRxTransactionCnt
            );
+   if (mBatchIo.get())
+   {
+      InfoLog(<< "Batch stats " << mTuple << " depth=" << mBatchDepth
+              << " rxfill=" << Inserter(mRxBatchFill)
+              << " txfill=" << Inserter(mTxBatchFill));
+   }
 #ifdef USE_SIGCOMP
    delete mSigcompStack;
 #endif
@@ -226,6 +337,12 @@ UdpTransport::process(FdSet& fdset)
 void
 UdpTransport::processTxAll()
 {
+   if (mBatchIo.get())
+   {
+      processTxBatch();
+      return;
+   }
+
    SendData *msg;
    ++mTxTryCnt;
    while ( (msg=mTxFifoOutBuffer.getNext(RESIP_FIFO_NOWAIT)) != NULL )
@@ -264,6 +381,7 @@ UdpTransport::processTxOne(SendData *data)
        sendData->sigcompId.size() > 0 &&
        !sendData->isAlreadyCompressed )
    {
+       sendData->flatten();
        osc::SigcompMessage *sm = mSigcompStack->compressMessage
          (sendData->data.data(), sendData->data.size(),
           sendData->sigcompId.data(), sendData->sigcompId.size(),
@@ -283,6 +401,21 @@ UdpTransport::processTxOne(SendData *data)
        delete sm;
    }
    else
+#endif
+#ifndef WIN32
+   if (sendData->isGathered())
+   {
+       iovec iov[SendData::MaxPieces];
+       msghdr hdr;
+       memset(&hdr, 0, sizeof(hdr));
+       hdr.msg_name = (void*)&addr;
+       hdr.msg_namelen = sendData->destination.length();
+       hdr.msg_iov = iov;
+       hdr.msg_iovlen = fillIovecs(*sendData, iov);
+       expected = (int)sendData->size();
+       count = (int)sendmsg(mFd, &hdr, 0);
+   }
+   else
 #endif
    {
        expected = (int)sendData->data.size();
@@ -321,6 +454,12 @@ UdpTransport::processTxOne(SendData *data)
 void
 UdpTransport::processRxAll()
 {
+   if (mBatchIo.get())
+   {
+      processRxBatch();
+      return;
+   }
+
    char *buffer = mRxBuffer;
    mRxBuffer = NULL;
    ++mRxTryCnt;
@@ -355,6 +494,175 @@ UdpTransport::processRxAll()
    }
 }
 
+/**
+ * Batched variant of processTxAll(). Pulls up to mBatchDepth messages off
+ * the tx fifo and hands them to the kernel with a single sendmmsg(). A
+ * message that needs individual treatment (commands, SigComp) ends the
+ * batch early so that wire order is preserved. Without TXALL, one batch is
+ * sent per writable event.
+ */
+void
+UdpTransport::processTxBatch()
+{
+#ifdef RESIP_UDP_BATCH_IO
+   BatchIo& io = *mBatchIo;
+   ++mTxTryCnt;
+   for (;;)
+   {
+      unsigned count = 0;
+      SendData* single = 0;
+      SendData* msg;
+      while (count < mBatchDepth &&
+             (msg=mTxFifoOutBuffer.getNext(RESIP_FIFO_NOWAIT)) != NULL)
+      {
+         if (msg->command != SendData::NoCommand
+#ifdef USE_SIGCOMP
+             || (mSigcompStack &&
+                 msg->sigcompId.size() > 0 &&
+                 !msg->isAlreadyCompressed)
+#endif
+            )
+         {
+            single = msg;
+            break;
+         }
+         resip_assert( msg->destination.getPort() != 0 );
+         io.mTxData[count] = msg;
+         iovec* iov = &io.mTxIovs[count * (size_t)SendData::MaxPieces];
+         mmsghdr& hdr = io.mTxHdrs[count];
+         memset(&hdr, 0, sizeof(hdr));
+         hdr.msg_hdr.msg_name = (void*)&msg->destination.getSockaddr();
+         hdr.msg_hdr.msg_namelen = msg->destination.length();
+         hdr.msg_hdr.msg_iov = iov;
+         hdr.msg_hdr.msg_iovlen = fillIovecs(*msg, iov);
+         ++count;
+      }
+
+      unsigned done = 0;
+      while (done < count)
+      {
+         int sent = sendmmsg(mFd, &io.mTxHdrs[done], count - done, 0);
+         if (sent <= 0)
+         {
+            // the first datagram not taken by the kernel is the one that
+            // failed; fail it and carry on with the rest of the batch
+            SendData* failed = io.mTxData[done];
+            int e = getErrno();
+            error(e);
+            InfoLog (<< "Failed (" << e << ") sending to " << failed->destination);
+            fail(failed->transactionId);
+            ++mTxFailCnt;
+            ++done;
+            continue;
+         }
+         for (int i = 0; i < sent; ++i, ++done)
+         {
+            if (io.mTxHdrs[done].msg_len != io.mTxData[done]->size())
+            {
+               ErrLog (<< "UDPTransport - send buffer full" );
+               fail(io.mTxData[done]->transactionId);
+            }
+         }
+      }
+
+      for (unsigned i = 0; i < count; ++i)
+      {
+         delete io.mTxData[i];
+         io.mTxData[i] = 0;
+      }
+      mTxMsgCnt += count;
+      ++mTxBatchFill[count];
+
+      if (single)
+      {
+         processTxOne(single);
+      }
+      else if (count < mBatchDepth)
+      {
+         break;   // fifo drained
+      }
+      if ( (mTransportFlags & RESIP_TRANSPORT_FLAG_TXALL)==0 )
+      {
+         break;
+      }
+   }
+#else
+   resip_assert(0);
+#endif
+}
+
+/**
+ * Batched variant of processRxAll(). Drains up to mBatchDepth datagrams
+ * with a single recvmmsg() into the pre-allocated buffer pool. With RXALL,
+ * keeps reading while batches come back full.
+ */
+void
+UdpTransport::processRxBatch()
+{
+#ifdef RESIP_UDP_BATCH_IO
+   BatchIo& io = *mBatchIo;
+   ++mRxTryCnt;
+   for (;;)
+   {
+      for (unsigned i = 0; i < mBatchDepth; ++i)
+      {
+         if (io.mRxBuffers[i] == NULL)
+         {
+            io.mRxBuffers[i] = MsgHeaderScanner::allocateBuffer(MaxBufferSize);
+         }
+         io.mRxSenders[i] = mTuple;
+         io.mRxIovs[i].iov_base = io.mRxBuffers[i];
+         io.mRxIovs[i].iov_len = MaxBufferSize;
+         mmsghdr& hdr = io.mRxHdrs[i];
+         memset(&hdr, 0, sizeof(hdr));
+         hdr.msg_hdr.msg_name = &io.mRxSenders[i].getMutableSockaddr();
+         hdr.msg_hdr.msg_namelen = io.mRxSenders[i].length();
+         hdr.msg_hdr.msg_iov = &io.mRxIovs[i];
+         hdr.msg_hdr.msg_iovlen = 1;
+      }
+
+      int count = recvmmsg(mFd, &io.mRxHdrs[0], mBatchDepth, 0, 0);
+      if ( count == SOCKET_ERROR )
+      {
+         int err = getErrno();
+         if ( err != EAGAIN && err != EWOULDBLOCK )
+         {
+            error( err );
+         }
+         count = 0;
+      }
+      ++mRxBatchFill[count];
+
+      for (int i = 0; i < count; ++i)
+      {
+         int len = (int)io.mRxHdrs[i].msg_len;
+         if (len+1 >= MaxBufferSize || (io.mRxHdrs[i].msg_hdr.msg_flags & MSG_TRUNC))
+         {
+            InfoLog(<<"Datagram exceeded max length "<<MaxBufferSize);
+            continue;
+         }
+         if (len == 0)
+         {
+            continue;
+         }
+         ++mRxMsgCnt;
+         if ( processRxParse(io.mRxBuffers[i], len, io.mRxSenders[i]) )
+         {
+            io.mRxBuffers[i] = NULL;
+         }
+      }
+
+      if ( count < (int)mBatchDepth ||
+           (mTransportFlags & RESIP_TRANSPORT_FLAG_RXALL) == 0 )
+      {
+         break;
+      }
+   }
+#else
+   resip_assert(0);
+#endif
+}
+
 /*
  * Receive from socket and store results into {buffer}. Updates
  * {buffer} with actual buffer (in case allocation required),
@@ -592,7 +900,7 @@ UdpTransport::processRxParse(char *buffer, int len, Tuple& sender)
 
    // Tell the SipMessage about this datagram buffer.
    // WATCHOUT: below here buffer is consumed by message
-   message->addBuffer(buffer);
+   message->addBuffer(buffer, len);
 
    mMsgHeaderScanner.prepareForMessage(message);
 
@@ -773,6 +1081,41 @@ UdpTransport::setRcvBufLen(int buflen)
    setSocketRcvBufLen(mFd, buflen);
 }
 
+void
+UdpTransport::initBatchDepth(unsigned depth)
+{
+   if (depth <= 1)
+   {
+      return;
+   }
+   if (depth > MaxBatchDepth)
+   {
+      WarningLog(<< "Batch depth " << depth << " exceeds maximum, using " << MaxBatchDepth);
+      depth = MaxBatchDepth;
+   }
+#ifndef RESIP_UDP_BATCH_IO
+   if (depth > 1)
+   {
+      WarningLog(<< "Batched datagram I/O not available on this platform, ignoring batch depth " << depth);
+      depth = 1;
+   }
+#endif
+   mBatchDepth = depth;
+   mBatchIo.reset(depth > 1 ? new BatchIo(depth) : 0);
+   mRxBatchFill.assign(depth+1, 0);
+   mTxBatchFill.assign(depth+1, 0);
+   InfoLog(<< "UDP transport " << mTuple << " batch depth set to " << mBatchDepth);
+}
+
+UdpTransport::BatchStats
+UdpTransport::getBatchStats() const
+{
+   BatchStats stats;
+   stats.mRxFill = mRxBatchFill;
+   stats.mTxFill = mTxBatchFill;
+   return stats;
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0
  *
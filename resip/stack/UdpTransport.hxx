@@ -2,6 +2,7 @@
 #define RESIP_UDPTRANSPORT_HXX
 
 #include <memory>
+#include <vector>
 #include "resip/stack/InternalTransport.hxx"
 #include "resip/stack/MsgHeaderScanner.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
@@ -63,11 +64,15 @@ public:
                 const Data& interfaceObj,
                 AfterSocketCreationFuncPtr socketFunc = 0,
                 Compression &compression = Compression::Disabled,
-                unsigned transportFlags = 0);
+                unsigned transportFlags = 0,
+                unsigned batchDepth = 1);
    virtual  ~UdpTransport();
 
    virtual bool isReliable() const { return false; }
    virtual bool isDatagram() const { return true; }
+#ifndef WIN32
+   virtual bool supportsGatheredSends() const { return true; }
+#endif
 
    virtual void process(FdSet& fdset);
    virtual void process();
@@ -76,11 +81,33 @@ public:
    virtual void setPollGrp(FdPollGrp *grp);
    virtual void setRcvBufLen(int buflen);
 
+   /** The number of datagrams drained from (recvmmsg) or flushed to
+       (sendmmsg) the socket per system call, as given to the constructor.
+       A depth of 1 (the default) uses the classic recvfrom/sendto path.
+       Depths above MaxBatchDepth are clamped, and platforms without
+       recvmmsg/sendmmsg always use 1. */
+   unsigned getBatchDepth() const { return mBatchDepth; }
+
+   /** Per-batch fill statistics. Element N of each vector counts the
+       batches that carried exactly N datagrams (element 0 counts
+       receive attempts that found the socket empty).  A high count at
+       index getBatchDepth() means the depth is limiting throughput. */
+   class BatchStats
+   {
+      public:
+         std::vector<unsigned> mRxFill;
+         std::vector<unsigned> mTxFill;
+   };
+   /// Snapshot of batch statistics; counters are owned by the transport
+   /// thread, so values read from other threads may be slightly stale.
+   BatchStats getBatchStats() const;
+
    // FdPollItemIf
    // virtual Socket getPollSocket() const;
    virtual void processPollEvent(FdPollEventMask mask);
 
    static const int MaxBufferSize = 8192;
+   static const unsigned MaxBatchDepth = 64;
 
    // STUN client functionality
    enum StunResult
@@ -104,6 +131,8 @@ protected:
    bool processRxParse(char *buffer, int len, Tuple& sender);
    void processTxAll();
    void processTxOne(SendData *data);
+   void processRxBatch();
+   void processTxBatch();
    void updateEvents();
 
    osc::Stack *mSigcompStack;
@@ -117,8 +146,16 @@ protected:
    unsigned mRxMsgCnt;
    unsigned mRxKeepaliveCnt;
    unsigned mRxTransactionCnt;
+   std::vector<unsigned> mRxBatchFill;
+   std::vector<unsigned> mTxBatchFill;
 private:
+   class BatchIo;
+
+   void initBatchDepth(unsigned depth);
+
    char* mRxBuffer;
+   unsigned mBatchDepth;
+   std::unique_ptr<BatchIo> mBatchIo;
    MsgHeaderScanner mMsgHeaderScanner;
    mutable resip::Mutex  myMutex;
    Tuple mStunMappedAddress;
@@ -1,4 +1,11 @@
 
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RESIP_WS_FRAME_EXTRACTOR_SSE2
+#include <emmintrin.h>
+#endif
+
 #include "rutil/Logger.hxx"
 #include "resip/stack/WsFrameExtractor.hxx"
 #include "rutil/WinLeakCheck.hxx"
@@ -12,9 +19,13 @@ const int WsFrameExtractor::mMaxHeaderLen = 14;
 
 WsFrameExtractor::WsFrameExtractor(Data::size_type maxMessage)
    : mMaxMessage(maxMessage),
+     mMessageBuffer(0),
+     mMessageCapacity(0),
      mMessageSize(0),
      mHaveHeader(false),
-     mHeaderLen(0)
+     mHeaderLen(0),
+     mPayloadLength(0),
+     mPayloadPos(0)
 {
    // we re-use this for multiple messages throughout
    // the lifetime of this parser object
@@ -23,16 +34,9 @@ WsFrameExtractor::WsFrameExtractor(Data::size_type maxMessage)
 
 WsFrameExtractor::~WsFrameExtractor()
 {
-   // FIXME - delete any objects left in the queues
    delete [] mWsHeader;
+   delete [] mMessageBuffer;
 
-   while(!mFrames.empty()) 
-   {
-      delete [] mFrames.front()->data();
-      delete mFrames.front();
-      mFrames.pop();
-   }
-      
    while(!mMessages.empty())
    {
       delete [] mMessages.front()->data();
@@ -50,12 +54,12 @@ WsFrameExtractor::processBytes(UInt8 *input, Data::size_type len, bool& dropConn
    Data::size_type pos = 0;
    while(input != 0 && pos < len)
    {
-      while(!mHaveHeader && pos < len)
+      if(!mHaveHeader)
       {
          StackLog(<<"Need a header, parsing bytes...");
          // Append bytes to the header buffer
          int needed = parseHeader();
-         if(mHeaderLen >= mMaxHeaderLen)
+         if(mHeaderLen + needed > mMaxHeaderLen)
          {
             WarningLog(<<"WS Frame header too long");
             dropConnection = true;
@@ -68,63 +72,53 @@ WsFrameExtractor::processBytes(UInt8 *input, Data::size_type len, bool& dropConn
          if(needed > 0)
          {
             StackLog(<<"Not enough bytes available to form a full header");
-            return ret;
+            break;
          }
-      }
-      if(mHaveHeader)
-      {
+         if(parseHeader() > 0)
+         {
+            // the length or mask key follow, now that we know they are there
+            continue;
+         }
+
          StackLog(<<"have header, parsing payload data...");
-         // Process input bytes to output buffer, unmasking if necessary
-         if(mMessageSize + mPayloadLength > mMaxMessage)
+         if(mPayloadLength > mMaxMessage - mMessageSize)
          {
             WarningLog(<<"WS frame header describes a payload size bigger than messageSizeMax, max = " << mMaxMessage 
                  << ", dropping connection");
             dropConnection = true;
             return ret;
          }
+         reserveFrame();
+      }
 
-         if(mPayload == 0)
-         {
-            StackLog(<<"starting new frame buffer");
-            // Include an extra byte at the end for null terminator
-            mPayload = (UInt8*)new char[mPayloadLength + 1];
-            mPayloadPos = 0;
-         }
-
-         Data::size_type takeBytes = len - pos;
-         if(takeBytes > mPayloadLength - mPayloadPos)
-         {
-            takeBytes = mPayloadLength - mPayloadPos;
-         }
+      // Process input bytes to the message buffer, unmasking if necessary
+      Data::size_type takeBytes = len - pos;
+      if(takeBytes > mPayloadLength - mPayloadPos)
+      {
+         takeBytes = (Data::size_type)(mPayloadLength - mPayloadPos);
+      }
 
-         if(mMasked)
-         {
-            Data::size_type endOffset = mPayloadPos + takeBytes;
-            for( ; mPayloadPos < endOffset; mPayloadPos++)
-            {
-               mPayload[mPayloadPos] = (input[pos++] ^ mWsMaskKey[(mPayloadPos & 3)]);
-            }
-         }
-         else
-         {
-            memmove(&mPayload[mPayloadPos], &input[pos], takeBytes);
-            pos += takeBytes;
-            mPayloadPos += takeBytes;
-         }
+      char* dest = mMessageBuffer + mMessageSize + mPayloadPos;
+      if(mMasked)
+      {
+         unmask(dest, &input[pos], takeBytes, mWsMaskKey, mPayloadPos);
+      }
+      else
+      {
+         memcpy(dest, &input[pos], takeBytes);
+      }
+      pos += takeBytes;
+      mPayloadPos += takeBytes;
 
-         if(mPayloadPos == mPayloadLength)
+      if(mPayloadPos == mPayloadLength)
+      {
+         StackLog(<<"Got a whole frame");
+         mMessageSize += (Data::size_type)mPayloadLength;
+         mHaveHeader = false;
+         mHeaderLen = 0;
+         if(mFinalFrame)
          {
-            StackLog(<<"Got a whole frame, queueing it");
-            mMessageSize += mPayloadLength;
-            Data *mFrame = new Data(Data::Borrow, (char *)mPayload, mPayloadLength, mPayloadLength + 1);
-            mFrames.push(mFrame);
-            mHaveHeader = false;
-            mHeaderLen = 0;
-            mPayload = 0;
-            if(mFinalFrame)
-            {
-               joinFrames();
-            }
+            finishMessage();
          }
       }
    }
@@ -139,6 +133,41 @@ WsFrameExtractor::processBytes(UInt8 *input, Data::size_type len, bool& dropConn
    return ret;
 }
 
+void
+WsFrameExtractor::unmask(char* dst, const UInt8* src, Data::size_type len,
+                         const UInt8* maskKey, Data::size_type keyOffset)
+{
+   // the key lined up with src[0], repeated to fill a block
+   UInt8 key[16];
+   for(int i = 0; i < 16; i++)
+   {
+      key[i] = maskKey[(keyOffset + i) & 3];
+   }
+
+   Data::size_type i = 0;
+#ifdef RESIP_WS_FRAME_EXTRACTOR_SSE2
+   const __m128i key128 = _mm_loadu_si128((const __m128i*)key);
+   for( ; i + 16 <= len; i += 16)
+   {
+      __m128i block = _mm_loadu_si128((const __m128i*)(src + i));
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(block, key128));
+   }
+#endif
+   UInt64 key64;
+   memcpy(&key64, key, sizeof(key64));
+   for( ; i + 8 <= len; i += 8)
+   {
+      UInt64 word;
+      memcpy(&word, src + i, sizeof(word));
+      word ^= key64;
+      memcpy(dst + i, &word, sizeof(word));
+   }
+   for( ; i < len; i++)
+   {
+      dst[i] = (char)(src[i] ^ key[i & 3]);
+   }
+}
+
 int
 WsFrameExtractor::parseHeader()
 {
@@ -172,12 +201,12 @@ WsFrameExtractor::parseHeader()
    }
    else if(mPayloadLength == 127)
    {
-      if(mHeaderLen < 8)
+      if(mHeaderLen < 10)
       {
          StackLog(<< "Too short to contain ws data [2]");
-         return (8 - mHeaderLen) + (mMasked ? 4 : 0);
+         return (10 - mHeaderLen) + (mMasked ? 4 : 0);
       }
-      mPayloadLength = (((UInt64)mWsHeader[hdrPos]) << 56 | ((UInt64)mWsHeader[hdrPos + 1]) << 48 | ((UInt64)mWsHeader[hdrPos + 2]) << 40 | ((UInt64)mWsHeader[hdrPos + 3]) << 32 | ((UInt64)mWsHeader[hdrPos + 4]) << 24 | ((UInt64)mWsHeader[hdrPos + 5]) << 16 | ((UInt64)mWsHeader[hdrPos + 6]) << 8 || ((UInt64)mWsHeader[hdrPos + 7]));
+      mPayloadLength = (((UInt64)mWsHeader[hdrPos]) << 56 | ((UInt64)mWsHeader[hdrPos + 1]) << 48 | ((UInt64)mWsHeader[hdrPos + 2]) << 40 | ((UInt64)mWsHeader[hdrPos + 3]) << 32 | ((UInt64)mWsHeader[hdrPos + 4]) << 24 | ((UInt64)mWsHeader[hdrPos + 5]) << 16 | ((UInt64)mWsHeader[hdrPos + 6]) << 8 | ((UInt64)mWsHeader[hdrPos + 7]));
       hdrPos += 8;
    }
 
@@ -199,54 +228,48 @@ WsFrameExtractor::parseHeader()
             << ", masked = "<< mMasked << ", final frame = "<< mFinalFrame);
 
    mHaveHeader = true;
-   mPayload = 0;
+   mPayloadPos = 0;
    return 0;
 }
 
 void
-WsFrameExtractor::joinFrames()
+WsFrameExtractor::reserveFrame()
 {
-   StackLog(<<"trying to join frames");
-   if(mFrames.empty())
+   // allow extra byte for null terminator
+   Data::size_type needed = mMessageSize + (Data::size_type)mPayloadLength + 1;
+   if(needed <= mMessageCapacity)
    {
-      ErrLog(<<"No frames to join!");
       return;
    }
-
-   Data *msg = mFrames.front();
-   mFrames.pop();
-   if(!mFrames.empty())
+   Data::size_type capacity = needed;
+   if(mMessageBuffer != 0)
    {
-      // must expand buffer because there are multiple frames
-      // can't use Data::reserve() to increase the buffer, because the
-      // ShareEnum will change to Take when expanded
-      char *_msg = (char *)msg->data();
-      Data::size_type frameSize = msg->size();
-      delete msg;
-
-      // allow extra byte for null terminator
-      char *newBuf = new char [mMessageSize + 1]; 
-      memcpy(newBuf, _msg, frameSize);
-
-      msg = new Data(Data::Borrow, newBuf, frameSize, mMessageSize + 1);
+      // a fragmented message: leave room for a few more fragments
+      capacity = resipMax(needed, resipMin(2 * mMessageCapacity, mMaxMessage + 1));
+      StackLog(<<"growing message buffer to " << capacity);
    }
-   while(!mFrames.empty())
+   char* buffer = new char[capacity];
+   if(mMessageBuffer != 0)
    {
-      Data *mFrame = mFrames.front();
-      mFrames.pop();
-      msg->append(mFrame->data(), mFrame->size());
-      delete [] mFrame->data();
-      delete mFrame;
+      memcpy(buffer, mMessageBuffer, mMessageSize);
+      delete [] mMessageBuffer;
    }
+   mMessageBuffer = buffer;
+   mMessageCapacity = capacity;
+}
 
-   // It is safe to cast because we used Borrow:
-   char *_msg = (char *)msg->data();
+void
+WsFrameExtractor::finishMessage()
+{
+   StackLog(<<"queueing a message of " << mMessageSize << " bytes");
    // MsgHeaderScanner expects space for an extra byte at the end:
-   _msg[mMessageSize] = 0;
+   mMessageBuffer[mMessageSize] = 0;
 
-   mMessages.push(msg);
+   mMessages.push(new Data(Data::Borrow, mMessageBuffer, mMessageSize, mMessageCapacity));
 
    // Ready to start examinging first frame of next message...
+   mMessageBuffer = 0;
+   mMessageCapacity = 0;
    mMessageSize = 0;
 }
 
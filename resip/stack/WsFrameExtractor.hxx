@@ -18,14 +18,25 @@ class WsFrameExtractor
       ~WsFrameExtractor();
       std::unique_ptr<Data> processBytes(UInt8 *input, Data::size_type len, bool& dropConnection);
 
+      /** XORs len bytes of src with the 4 byte maskKey into dst, a block
+          at a time; keyOffset is the position of src[0] within the frame
+          payload.  dst may be src. */
+      static void unmask(char* dst, const UInt8* src, Data::size_type len,
+                         const UInt8* maskKey, Data::size_type keyOffset);
+
    private:
 
       static const int mMaxHeaderLen;
 
       Data::size_type mMaxMessage;
 
-      std::queue<Data*> mFrames;
       std::queue<Data*> mMessages;
+
+      // Frames are unmasked straight into the message they belong to.
+      // Frames of a fragmented message land one after another, so the
+      // buffer is only reallocated if a later fragment does not fit.
+      char* mMessageBuffer;
+      Data::size_type mMessageCapacity;
       // for tracking the cumulative size of all full frames
       // not yet assembled into a message:
       Data::size_type mMessageSize;
@@ -37,13 +48,15 @@ class WsFrameExtractor
       bool mFinalFrame;
       bool mMasked;
       UInt8 mWsMaskKey[4];
-      Data::size_type mPayloadLength;
+      UInt64 mPayloadLength;
 
-      UInt8 *mPayload;
       Data::size_type mPayloadPos;
 
       int parseHeader();
-      void joinFrames();
+      /// make room in mMessageBuffer for the frame whose header was parsed
+      void reserveFrame();
+      /// queue the message made of the frames received so far
+      void finishMessage();
 
 };
 
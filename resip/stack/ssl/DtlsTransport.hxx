@@ -133,6 +133,8 @@ class DtlsTransport : public UdpTransport
       void process(FdSet& fdset);
       bool isReliable() const { return false; }
       bool isDatagram() const { return true; }
+      // records are built from one contiguous buffer
+      bool supportsGatheredSends() const { return false; }
       virtual void buildFdSet( FdSet& fdset);
 
       static const unsigned long DtlsReceiveTimeout = 250000 ;
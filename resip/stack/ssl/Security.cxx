@@ -20,7 +20,9 @@
 #include "rutil/ResipAssert.h"
 #include "rutil/BaseException.hxx"
 #include "rutil/DataStream.hxx"
+#include "rutil/Lock.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/Mutex.hxx"
 #include "rutil/Random.hxx"
 #include "rutil/Socket.hxx"
 #include "rutil/Timer.hxx"
@@ -56,6 +58,12 @@
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
 #include <openssl/ssl.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
 
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
 
@@ -136,6 +144,200 @@ verifyCallback(int iInCode, X509_STORE_CTX *pInStore)
  
 }
 
+namespace resip
+{
+
+/**
+   Session ticket keys shared by every SSL_CTX of one BaseSecurity.  The
+   current key encrypts new tickets; the one it replaced still decrypts
+   for another rotation period, and such tickets are renewed.  Each client
+   certificate policy has keys of its own, so a ticket issued where no
+   client certificate was required cannot skip the check on a transport
+   that requires one.  Handshakes run on all the TLS transport threads,
+   hence the mutex.
+*/
+class TlsTicketKeys
+{
+   public:
+      struct Key
+      {
+         unsigned char mName[16];
+         unsigned char mAesKey[32];
+         unsigned char mHmacKey[32];
+      };
+
+      // indexed by policy(): none, optional, mandatory
+      static const int PolicyCount = 3;
+
+      static int policy(const SSL* ssl)
+      {
+         int mode = SSL_get_verify_mode(ssl);
+         if (mode & SSL_VERIFY_FAIL_IF_NO_PEER_CERT)
+         {
+            return 2;
+         }
+         return (mode & SSL_VERIFY_PEER) ? 1 : 0;
+      }
+
+      TlsTicketKeys(unsigned int rotationSecs) :
+         mRotationSecs(rotationSecs),
+         mRotatedAt(0),
+         mHasPrevious(false)
+      {
+         Lock lock(mMutex);
+         rotate();
+      }
+
+      bool current(int policy, Key& key)
+      {
+         Lock lock(mMutex);
+         if (!rotateIfDue())
+         {
+            return false;
+         }
+         key = mCurrent[policy];
+         return true;
+      }
+
+      // 1 for the current key, 2 for the previous one, 0 if unknown
+      int find(int policy, const unsigned char* name, Key& key)
+      {
+         Lock lock(mMutex);
+         if (!rotateIfDue())
+         {
+            return 0;
+         }
+         if (memcmp(name, mCurrent[policy].mName, sizeof(key.mName)) == 0)
+         {
+            key = mCurrent[policy];
+            return 1;
+         }
+         if (mHasPrevious && memcmp(name, mPrevious[policy].mName, sizeof(key.mName)) == 0)
+         {
+            key = mPrevious[policy];
+            return 2;
+         }
+         return 0;
+      }
+
+   private:
+      bool rotateIfDue()
+      {
+         UInt64 now = Timer::getTimeSecs();
+         if (now - mRotatedAt >= 2 * (UInt64)mRotationSecs)
+         {
+            // nothing was issued for two periods; the previous key is stale too
+            mHasPrevious = false;
+            return rotate();
+         }
+         if (now - mRotatedAt >= mRotationSecs)
+         {
+            memcpy(mPrevious, mCurrent, sizeof(mCurrent));
+            mHasPrevious = true;
+            return rotate();
+         }
+         return true;
+      }
+
+      bool rotate()
+      {
+         if (RAND_bytes((unsigned char*)mCurrent, sizeof(mCurrent)) <= 0)
+         {
+            ErrLog(<< "RAND_bytes failed, cannot create a session ticket key");
+            mRotatedAt = 0;
+            return false;
+         }
+         mRotatedAt = Timer::getTimeSecs();
+         DebugLog(<< "New session ticket key, next rotation in " << mRotationSecs << "s");
+         return true;
+      }
+
+      Mutex mMutex;
+      const unsigned int mRotationSecs;
+      UInt64 mRotatedAt;
+      Key mCurrent[PolicyCount];
+      Key mPrevious[PolicyCount];
+      bool mHasPrevious;
+};
+
+}
+
+static int
+ticketKeysIndex()
+{
+   static const int index = SSL_CTX_get_ex_new_index(0, 0, 0, 0, 0);
+   return index;
+}
+
+extern "C"
+{
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static int
+ticketKeyCallback(SSL* ssl, unsigned char keyName[16], unsigned char* iv,
+                  EVP_CIPHER_CTX* cipherCtx, EVP_MAC_CTX* macCtx, int enc)
+#else
+static int
+ticketKeyCallback(SSL* ssl, unsigned char keyName[16], unsigned char* iv,
+                  EVP_CIPHER_CTX* cipherCtx, HMAC_CTX* macCtx, int enc)
+#endif
+{
+   TlsTicketKeys* keys = (TlsTicketKeys*)SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ticketKeysIndex());
+   if (!keys)
+   {
+      return -1;
+   }
+
+   TlsTicketKeys::Key key;
+   int policy = TlsTicketKeys::policy(ssl);
+   int found;
+   if (enc)
+   {
+      if (!keys->current(policy, key) ||
+          RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) <= 0)
+      {
+         return -1;
+      }
+      memcpy(keyName, key.mName, sizeof(key.mName));
+      found = 1;
+   }
+   else
+   {
+      found = keys->find(policy, keyName, key);
+      if (!found)
+      {
+         // unknown or expired key: fall back to a full handshake
+         return 0;
+      }
+#if defined(TLS1_3_VERSION)
+      if (SSL_version(ssl) >= TLS1_3_VERSION)
+      {
+         // TLS 1.3 clients use a ticket once, so always hand out the next
+         found = 2;
+      }
+#endif
+   }
+
+   if (!EVP_CipherInit_ex(cipherCtx, EVP_aes_256_cbc(), 0, key.mAesKey, iv, enc))
+   {
+      return -1;
+   }
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+   OSSL_PARAM params[2];
+   params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char*)"SHA256", 0);
+   params[1] = OSSL_PARAM_construct_end();
+   if (!EVP_MAC_init(macCtx, key.mHmacKey, sizeof(key.mHmacKey), params))
+#else
+   if (!HMAC_Init_ex(macCtx, key.mHmacKey, sizeof(key.mHmacKey), EVP_sha256(), 0))
+#endif
+   {
+      return -1;
+   }
+   return found;
+}
+
+}
+
 // .amr. RFC 5922 mandates exact match only on certificates, so this is the default, but RFC 2459 and RFC 3261 don't prevent wildcards, so enable if you want that mode.
 bool BaseSecurity::mAllowWildcardCertificates = false;
 BaseSecurity::CipherList BaseSecurity::ExportableSuite("HIGH:RC4-SHA:-COMPLEMENTOFDEFAULT");
@@ -156,6 +358,12 @@ BaseSecurity::CipherList BaseSecurity::StrongestSuite("HIGH:-COMPLEMENTOFDEFAULT
 long BaseSecurity::OpenSSLCTXSetOptions = SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3;
 long BaseSecurity::OpenSSLCTXClearOptions = 0;
 
+unsigned int BaseSecurity::TlsSessionCacheSize = 20480;
+unsigned int BaseSecurity::TlsSessionLifetime = 3600;
+bool BaseSecurity::TlsSessionTickets = true;
+unsigned int BaseSecurity::TlsTicketKeyRotation = 3600;
+unsigned int BaseSecurity::TlsClientSessionCacheSize = 1024;
+
 Security::Security(const CipherList& cipherSuite, const Data& defaultPrivateKeyPassPhrase, const Data& dHParamsFilename) :
    BaseSecurity(cipherSuite, defaultPrivateKeyPassPhrase, dHParamsFilename)
 {
@@ -403,6 +611,7 @@ Security::createDomainCtx(const SSL_METHOD* method, const Data& domain, const Da
    setDHParams(ctx);
    SSL_CTX_set_options(ctx, BaseSecurity::OpenSSLCTXSetOptions);
    SSL_CTX_clear_options(ctx, BaseSecurity::OpenSSLCTXClearOptions);
+   setSessionResumption(ctx);
 
    return ctx;
 }
@@ -1151,6 +1360,7 @@ Security::Exception::Exception(const Data& msg, const Data& file, const int line
 BaseSecurity::BaseSecurity (const CipherList& cipherSuite, const Data& defaultPrivateKeyPassPhrase, const Data& dHParamsFilename) :
    mTlsCtx(0),
    mSslCtx(0),
+   mTicketKeys(0),
    mCipherList(cipherSuite),
    mDefaultPrivateKeyPassPhrase(defaultPrivateKeyPassPhrase),
    mDHParamsFilename(dHParamsFilename),
@@ -1194,6 +1404,7 @@ BaseSecurity::BaseSecurity (const CipherList& cipherSuite, const Data& defaultPr
    setDHParams(mTlsCtx);
    SSL_CTX_set_options(mTlsCtx, BaseSecurity::OpenSSLCTXSetOptions);
    SSL_CTX_clear_options(mTlsCtx, BaseSecurity::OpenSSLCTXClearOptions);
+   setSessionResumption(mTlsCtx);
    
    mSslCtx = SSL_CTX_new( SSLv23_method() );
    resip_assert(mSslCtx);
@@ -1205,6 +1416,7 @@ BaseSecurity::BaseSecurity (const CipherList& cipherSuite, const Data& defaultPr
    setDHParams(mSslCtx);
    SSL_CTX_set_options(mSslCtx, BaseSecurity::OpenSSLCTXSetOptions);
    SSL_CTX_clear_options(mSslCtx, BaseSecurity::OpenSSLCTXClearOptions);
+   setSessionResumption(mSslCtx);
 }
 
 
@@ -1250,7 +1462,51 @@ BaseSecurity::~BaseSecurity ()
    {
       SSL_CTX_free(mSslCtx);mSslCtx=0;  // This free's X509_STORE (mRootSslCerts)
    }
+   delete mTicketKeys;
+
+}
+
+void
+BaseSecurity::setSessionResumption(SSL_CTX* ctx)
+{
+   // Without a session id context OpenSSL refuses to resume any session
+   // on a context that verifies peers, which all of ours do.  Server side
+   // TlsConnections replace it with one of their own (see there).
+   static const unsigned char sessionIdContext[] = "reSIProcate";
+   SSL_CTX_set_session_id_context(ctx, sessionIdContext, sizeof(sessionIdContext) - 1);
+
+   long mode = SSL_SESS_CACHE_OFF;
+   if (TlsSessionCacheSize > 0)
+   {
+      mode |= SSL_SESS_CACHE_SERVER;
+      SSL_CTX_sess_set_cache_size(ctx, TlsSessionCacheSize);
+   }
+   if (TlsClientSessionCacheSize > 0)
+   {
+      // makes OpenSSL hand new client sessions to the callback that
+      // TlsBaseTransport installs to keep them per destination
+      mode |= SSL_SESS_CACHE_CLIENT;
+   }
+   SSL_CTX_set_session_cache_mode(ctx, mode);
+   SSL_CTX_set_timeout(ctx, TlsSessionLifetime);
 
+   if (!TlsSessionTickets)
+   {
+      SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+   }
+   else if (TlsTicketKeyRotation > 0)
+   {
+      if (!mTicketKeys)
+      {
+         mTicketKeys = new TlsTicketKeys(TlsTicketKeyRotation);
+      }
+      SSL_CTX_set_ex_data(ctx, ticketKeysIndex(), mTicketKeys);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+      SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, ticketKeyCallback);
+#else
+      SSL_CTX_set_tlsext_ticket_key_cb(ctx, ticketKeyCallback);
+#endif
+   }
 }
 
 void
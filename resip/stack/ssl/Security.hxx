@@ -39,6 +39,7 @@ class Pkcs7Contents;
 class Security;
 class MultipartSignedContents;
 class SipMessage;
+class TlsTicketKeys;
 
 
 class BaseSecurity
@@ -90,6 +91,27 @@ class BaseSecurity
       static long OpenSSLCTXSetOptions;
       static long OpenSSLCTXClearOptions;
 
+      /**
+       * TLS session resumption, applied to every SSL_CTX created here.
+       * Set these before instantiating resip::Security.
+       *
+       * TlsSessionCacheSize is the number of sessions each SSL_CTX keeps
+       * for resumption by clients (0 disables the server side cache), and
+       * TlsSessionLifetime how long, in seconds, a session or ticket stays
+       * resumable.  With TlsSessionTickets set, RFC 5077 tickets are
+       * issued as well; their keys are replaced every TlsTicketKeyRotation
+       * seconds and the previous key is still accepted for one more
+       * period (0 keeps OpenSSL's per-context key for the process
+       * lifetime).  TlsClientSessionCacheSize is the number of
+       * destinations each TLS transport remembers a session for when it
+       * connects out (0 disables client side reuse).
+       */
+      static unsigned int TlsSessionCacheSize;
+      static unsigned int TlsSessionLifetime;
+      static bool TlsSessionTickets;
+      static unsigned int TlsTicketKeyRotation;
+      static unsigned int TlsClientSessionCacheSize;
+
       BaseSecurity(const CipherList& cipherSuite = StrongestSuite, const Data& defaultPrivateKeyPassPhrase = Data::Empty, const Data& dHParamsFilename = Data::Empty);
       virtual ~BaseSecurity();
 
@@ -225,6 +247,10 @@ class BaseSecurity
       SSL_CTX*       mSslCtx;
       static void dumpAsn(char*, Data);
 
+      // session cache and ticket settings for ctx
+      void setSessionResumption(SSL_CTX* ctx);
+      TlsTicketKeys* mTicketKeys;
+
       CipherList mCipherList;
       Data mDefaultPrivateKeyPassPhrase;
       Data mDHParamsFilename;
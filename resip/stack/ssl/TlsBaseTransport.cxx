@@ -13,7 +13,9 @@
 #include "rutil/Logger.hxx"
 #include "resip/stack/ssl/TlsBaseTransport.hxx"
 #include "resip/stack/ssl/TlsConnection.hxx"
+#include "resip/stack/ssl/TlsHandshakePool.hxx"
 #include "resip/stack/ssl/Security.hxx"
+#include "rutil/Lock.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
@@ -21,6 +23,9 @@
 using namespace std;
 using namespace resip;
 
+unsigned int TlsBaseTransport::HandshakeThreads = 0;
+unsigned int TlsBaseTransport::MaxPendingHandshakes = 256;
+
 TlsBaseTransport::TlsBaseTransport(Fifo<TransactionMessage>& fifo, 
                            int portNum, 
                            IpVersion version,
@@ -46,7 +51,11 @@ TlsBaseTransport::TlsBaseTransport(Fifo<TransactionMessage>& fifo,
    mCertificateFilename(certificateFilename),
    mPrivateKeyFilename(privateKeyFilename),
    mPrivateKeyPassPhrase(privateKeyPassPhrase),
-   mReloadCertificate(false)
+   mReloadCertificate(false),
+   mFullHandshakes(0),
+   mResumedHandshakes(0),
+   mHandshakePool(0),
+   mHandshakeWakeupHandle(0)
 {
    setTlsDomain(sipDomain);   
    mTuple.setType(transportType);
@@ -78,15 +87,41 @@ TlsBaseTransport::TlsBaseTransport(Fifo<TransactionMessage>& fifo,
          throw invalid_argument("Unrecognised SecurityTypes::SSLType value");
       }
    }
+
+   if (Security::TlsClientSessionCacheSize > 0)
+   {
+      SSL_CTX_sess_set_new_cb(getCtx(), TlsConnection::onNewSession);
+   }
+
+   if (HandshakeThreads > 0)
+   {
+      mHandshakePool = new TlsHandshakePool(*this, HandshakeThreads);
+   }
 }
 
 
 TlsBaseTransport::~TlsBaseTransport()
 {
+   if (mHandshakePool)
+   {
+      if (mPollGrp && mHandshakeWakeupHandle)
+      {
+         mPollGrp->delPollItem(mHandshakeWakeupHandle);
+         mHandshakeWakeupHandle = 0;
+      }
+      // connections take themselves out of the pool as they go
+      closeConnections();
+      delete mHandshakePool;
+      mHandshakePool = 0;
+   }
    if (mDomainCtx)
    {
       SSL_CTX_free(mDomainCtx);mDomainCtx=0;
    }
+   for (SessionMap::iterator it = mClientSessions.begin(); it != mClientSessions.end(); ++it)
+   {
+      SSL_SESSION_free(it->second);
+   }
 }
 
 void
@@ -156,6 +191,154 @@ TlsBaseTransport::setPeerCertificateVerificationCallback(
    return true;
 }
 
+SSL_SESSION*
+TlsBaseTransport::findClientSession(const Data& destination)
+{
+   Lock lock(mClientSessionsMutex);
+   SessionMap::iterator it = mClientSessions.find(destination);
+   if (it == mClientSessions.end())
+   {
+      return 0;
+   }
+   if (
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+       !SSL_SESSION_is_resumable(it->second) ||
+#endif
+       SSL_SESSION_get_time(it->second) + SSL_SESSION_get_timeout(it->second) < (long)time(0))
+   {
+      SSL_SESSION_free(it->second);
+      mClientSessions.erase(it);
+      return 0;
+   }
+   SSL_SESSION_up_ref(it->second);
+   return it->second;
+}
+
+void
+TlsBaseTransport::storeClientSession(const Data& destination, SSL_SESSION* session)
+{
+   Lock lock(mClientSessionsMutex);
+   SessionMap::iterator it = mClientSessions.find(destination);
+   if (it != mClientSessions.end())
+   {
+      SSL_SESSION_free(it->second);
+      it->second = session;
+      return;
+   }
+
+   if (mClientSessions.size() >= Security::TlsClientSessionCacheSize)
+   {
+      // make room: drop what has expired, else the oldest session
+      long now = (long)time(0);
+      SessionMap::iterator oldest = mClientSessions.end();
+      for (it = mClientSessions.begin(); it != mClientSessions.end(); )
+      {
+         long created = SSL_SESSION_get_time(it->second);
+         if (created + SSL_SESSION_get_timeout(it->second) < now)
+         {
+            SSL_SESSION_free(it->second);
+            mClientSessions.erase(it++);
+            continue;
+         }
+         if (oldest == mClientSessions.end() || created < SSL_SESSION_get_time(oldest->second))
+         {
+            oldest = it;
+         }
+         ++it;
+      }
+      if (mClientSessions.size() >= Security::TlsClientSessionCacheSize &&
+          oldest != mClientSessions.end())
+      {
+         SSL_SESSION_free(oldest->second);
+         mClientSessions.erase(oldest);
+      }
+   }
+   mClientSessions[destination] = session;
+}
+
+void
+TlsBaseTransport::onHandshakeDone(bool resumed)
+{
+   if (resumed)
+   {
+      ++mResumedHandshakes;
+   }
+   else
+   {
+      ++mFullHandshakes;
+   }
+}
+
+void
+TlsBaseTransport::startHandshakeStep(TlsConnection* conn)
+{
+   resip_assert(mHandshakePool);
+   mHandshakePool->post(conn);
+   if (MaxPendingHandshakes > 0 && !isAcceptingPaused() &&
+       mHandshakePool->pending() >= MaxPendingHandshakes)
+   {
+      WarningLog(<< "TLS handshake threads are behind, no longer accepting connections on " << mTuple);
+      pauseAccepting(true);
+   }
+}
+
+void
+TlsBaseTransport::processCompletedHandshakes()
+{
+   resip_assert(mHandshakePool);
+   TlsConnection* conn;
+   while ((conn = mHandshakePool->nextCompleted()) != 0)
+   {
+      // may delete conn
+      conn->handshakeStepDone();
+   }
+   if (isAcceptingPaused() && mHandshakePool->pending() < MaxPendingHandshakes)
+   {
+      InfoLog(<< "TLS handshake threads caught up, accepting connections on " << mTuple);
+      pauseAccepting(false);
+   }
+   flushStateMacFifo();
+}
+
+void
+TlsBaseTransport::process(FdSet& fdset)
+{
+   if (mHandshakePool)
+   {
+      mHandshakePool->process(fdset);
+      processCompletedHandshakes();
+   }
+   TcpBaseTransport::process(fdset);
+}
+
+void
+TlsBaseTransport::buildFdSet(FdSet& fdset)
+{
+   TcpBaseTransport::buildFdSet(fdset);
+   if (mHandshakePool)
+   {
+      mHandshakePool->buildFdSet(fdset);
+   }
+}
+
+void
+TlsBaseTransport::setPollGrp(FdPollGrp* grp)
+{
+   if (mHandshakePool)
+   {
+      if (mPollGrp && mHandshakeWakeupHandle)
+      {
+         mPollGrp->delPollItem(mHandshakeWakeupHandle);
+         mHandshakeWakeupHandle = 0;
+      }
+      if (grp)
+      {
+         mHandshakeWakeupHandle = grp->addPollItem(mHandshakePool->getWakeupSocket(), FPEM_Read, mHandshakePool);
+      }
+   }
+   TcpBaseTransport::setPollGrp(grp);
+}
+
 Connection* 
 TlsBaseTransport::createConnection(const Tuple& who, Socket fd, bool server)
 {
@@ -10,7 +10,10 @@
 #include "resip/stack/SecurityTypes.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
 #include "resip/stack/Compression.hxx"
+#include "rutil/Mutex.hxx"
 
+#include <map>
+#include <atomic>
 #include <openssl/ssl.h>
 
 namespace resip
@@ -19,11 +22,25 @@ namespace resip
 class Connection;
 class Message;
 class Security;
+class TlsConnection;
+class TlsHandshakePool;
 
 class TlsBaseTransport : public TcpBaseTransport
 {
    public:
       RESIP_HeapCount(TlsBaseTransport);
+
+      /** Threads per transport that run TLS handshakes, so that connection
+          bursts do not stall the transport thread on key exchange and
+          certificate checks.  0 runs handshakes on the transport thread.
+          Read when the transport is created.  Custom certificate
+          verification callbacks run on these threads when enabled. */
+      static unsigned int HandshakeThreads;
+      /** With HandshakeThreads, stop accepting new connections while this
+          many handshake steps are queued or running; they wait in the
+          listen queue until the workers catch up.  0 for no limit. */
+      static unsigned int MaxPendingHandshakes;
+
       TlsBaseTransport(Fifo<TransactionMessage>& fifo, 
                    int portNum, 
                    IpVersion version,
@@ -76,6 +93,28 @@ class TlsBaseTransport : public TcpBaseTransport
          void *func,
          void *arg);
 
+      /** session to offer when connecting to destination, 0 if there is
+          none; the caller must SSL_SESSION_free() it */
+      SSL_SESSION* findClientSession(const Data& destination);
+      /// remembers session for destination, taking over the reference
+      void storeClientSession(const Data& destination, SSL_SESSION* session);
+      void onHandshakeDone(bool resumed);
+
+      /// 0 unless HandshakeThreads was set
+      TlsHandshakePool* getHandshakePool() { return mHandshakePool; }
+      /// hands conn to the handshake threads, pausing accept if they fall behind
+      void startHandshakeStep(TlsConnection* conn);
+      /// resumes the connections whose handshake step is done
+      void processCompletedHandshakes();
+
+      using TcpBaseTransport::process;
+      virtual void process(FdSet& fdset);
+      virtual void buildFdSet(FdSet& fdset);
+      virtual void setPollGrp(FdPollGrp* grp);
+
+      virtual UInt64 getTlsFullHandshakes() const { return mFullHandshakes; }
+      virtual UInt64 getTlsResumedHandshakes() const { return mResumedHandshakes; }
+
    protected:
       Connection* createConnection(const Tuple& who, Socket fd, bool server=false);
 
@@ -91,6 +130,17 @@ class TlsBaseTransport : public TcpBaseTransport
       const Data mPrivateKeyFilename;
       const Data mPrivateKeyPassPhrase;
       volatile bool mReloadCertificate;
+
+      // sessions from our outbound connections; handshake threads store
+      // TLS 1.2 sessions too
+      typedef std::map<Data, SSL_SESSION*> SessionMap;
+      SessionMap mClientSessions;
+      Mutex mClientSessionsMutex;
+      std::atomic<UInt64> mFullHandshakes;
+      std::atomic<UInt64> mResumedHandshakes;
+
+      TlsHandshakePool* mHandshakePool;
+      FdPollItemHandle mHandshakeWakeupHandle;
 };
 
 }
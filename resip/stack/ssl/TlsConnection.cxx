@@ -6,8 +6,10 @@
 
 #include "resip/stack/ssl/TlsConnection.hxx"
 #include "resip/stack/ssl/TlsTransport.hxx"
+#include "resip/stack/ssl/TlsHandshakePool.hxx"
 #include "resip/stack/ssl/Security.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/DataStream.hxx"
 #include "resip/stack/Uri.hxx"
 #include "rutil/Socket.hxx"
 
@@ -56,6 +58,16 @@ inline bool handleOpenSSLErrorQueue(int ret, unsigned long err, const char* op)
    return hadReason;
 }
 
+#if defined(USE_SSL)
+// SSL ex_data slot pointing back at the TlsConnection
+static int
+connectionIndex()
+{
+   static const int index = SSL_get_ex_new_index(0, 0, 0, 0, 0);
+   return index;
+}
+#endif
+
 TlsConnection::TlsConnection( Transport* transport, const Tuple& tuple, 
                               Socket fd, Security* security, 
                               bool server, Data domain,  SecurityTypes::SSLType sslType ,
@@ -99,6 +111,7 @@ TlsConnection::TlsConnection( Transport* transport, const Tuple& tuple,
    
    mSsl = SSL_new(ctx);
    resip_assert(mSsl);
+   SSL_set_ex_data(mSsl, connectionIndex(), this);
 
    resip_assert( mSecurity );
 
@@ -124,6 +137,18 @@ TlsConnection::TlsConnection( Transport* transport, const Tuple& tuple,
          resip_assert( 0 );
       }
       SSL_set_verify(mSsl, verify_mode, 0);
+
+      // Transports can share an SSL_CTX, and with it the session cache,
+      // while asking for client certificates differently.  Sessions only
+      // resume where this context matches, so one established without a
+      // client certificate cannot skip the check on a Mandatory transport.
+      Data sessionIdContext;
+      {
+         DataStream ds(sessionIdContext);
+         ds << t->tlsDomain() << ' ' << t->interfaceName() << ':' << t->port() << ' ' << verify_mode;
+      }
+      sessionIdContext = sessionIdContext.md5(Data::BINARY);
+      SSL_set_session_id_context(mSsl, (const unsigned char*)sessionIdContext.data(), (unsigned int)sessionIdContext.size());
    }
 
    mBio = BIO_new_socket((int)fd,0/*close flag*/);
@@ -138,12 +163,24 @@ TlsConnection::TlsConnection( Transport* transport, const Tuple& tuple,
    mTlsState = Initial;
    mHandShakeWantsRead = false;
 
+   mHandshakePool = t->getHandshakePool();
+   mHandshakeParked = false;
+   mStepDone = false;
+   mStepResult = 0;
+   mStepError = SSL_ERROR_NONE;
+   mStepErrno = 0;
+   mStepErrorsLogged = false;
+
 #endif // USE_SSL   
 }
 
 TlsConnection::~TlsConnection()
 {
 #if defined(USE_SSL)
+   if (mHandshakeParked)
+   {
+      mHandshakePool->cancel(this);
+   }
    ERR_clear_error();
    int ret = SSL_shutdown(mSsl);
    if(ret < 0)
@@ -170,6 +207,37 @@ TlsConnection::~TlsConnection()
 }
 
 
+int
+TlsConnection::onNewSession(SSL* ssl, SSL_SESSION* session)
+{
+#if defined(USE_SSL)
+   TlsConnection* conn = (TlsConnection*)SSL_get_ex_data(ssl, connectionIndex());
+   if (!conn || conn->mServer)
+   {
+      // server sessions stay in the SSL_CTX cache only
+      return 0;
+   }
+   TlsBaseTransport *t = dynamic_cast<TlsBaseTransport*>(conn->transport());
+   resip_assert(t);
+   DebugLog( << "Saving TLS session for " << conn->who());
+   t->storeClientSession(conn->sessionDestination(), session);
+   return 1;
+#else
+   return 0;
+#endif // USE_SSL
+}
+
+Data
+TlsConnection::sessionDestination()
+{
+   Data destination;
+   {
+      DataStream ds(destination);
+      ds << who().getTargetDomain() << ' ' << Tuple::inet_ntop(who()) << ':' << who().getPort();
+   }
+   return destination;
+}
+
 const char*
 TlsConnection::fromState(TlsConnection::TlsState s)
 {
@@ -214,6 +282,18 @@ TlsConnection::checkState()
             DebugLog ( << "TLS SNI extension in Client Hello: " << who().getTargetDomain());
             SSL_set_tlsext_host_name(mSsl,who().getTargetDomain().c_str()); // set the SNI hostname
 #endif
+         if (Security::TlsClientSessionCacheSize > 0)
+         {
+            TlsBaseTransport *t = dynamic_cast<TlsBaseTransport*>(transport());
+            resip_assert(t);
+            SSL_SESSION* session = t->findClientSession(sessionDestination());
+            if (session)
+            {
+               DebugLog( << "Offering saved TLS session to " << who());
+               SSL_set_session(mSsl, session);
+               SSL_SESSION_free(session);
+            }
+         }
          SSL_set_connect_state(mSsl);
          mTlsState = Handshaking;
       }
@@ -222,13 +302,70 @@ TlsConnection::checkState()
       mTlsState = Handshaking;
    }
 
+   if (mHandshakePool)
+   {
+      if (mHandshakeParked)
+      {
+         return mTlsState;
+      }
+      if (mStepDone)
+      {
+         mStepDone = false;
+         return handshakeResult(mStepResult, mStepError, mStepErrno, mStepErrorsLogged);
+      }
+      // the socket is ready: let a handshake thread take the next step
+      mHandShakeWantsRead = false;
+      mHandshakeParked = true;
+      suspendPolling();
+      TlsBaseTransport *t = dynamic_cast<TlsBaseTransport*>(transport());
+      resip_assert(t);
+      t->startHandshakeStep(this);
+      return mTlsState;
+   }
+
    mHandShakeWantsRead = false;
    ok = SSL_do_handshake(mSsl);
-      
+   int err = (ok <= 0) ? SSL_get_error(mSsl,ok) : SSL_ERROR_NONE;
+   return handshakeResult(ok, err, (err == SSL_ERROR_SYSCALL) ? getErrno() : 0, false);
+#else
+   return mTlsState;
+#endif // USE_SSL   
+}
+
+void
+TlsConnection::runHandshakeStep()
+{
+#if defined(USE_SSL)
+   ERR_clear_error();
+   mStepResult = SSL_do_handshake(mSsl);
+   mStepError = (mStepResult <= 0) ? SSL_get_error(mSsl, mStepResult) : SSL_ERROR_NONE;
+   mStepErrno = (mStepError == SSL_ERROR_SYSCALL) ? getErrno() : 0;
+   // the error queue belongs to this thread
+   mStepErrorsLogged = ERR_peek_error() != 0;
+   if (mStepErrorsLogged)
+   {
+      handleOpenSSLErrorQueue(mStepResult, mStepError, "SSL_do_handshake");
+   }
+#endif // USE_SSL   
+}
+
+void
+TlsConnection::handshakeStepDone()
+{
+   mHandshakeParked = false;
+   mStepDone = true;
+   resumePolling();
+   // read() takes the result through checkState(), and when the handshake
+   // is up picks up anything that arrived with it
+   performReads();
+}
+
+TlsConnection::TlsState
+TlsConnection::handshakeResult(int ok, int err, int sysErrno, bool errorsLogged)
+{
+#if defined(USE_SSL)
    if ( ok <= 0 )
    {
-      int err = SSL_get_error(mSsl,ok);
-         
       switch (err)
       {
          case SSL_ERROR_WANT_READ:
@@ -262,7 +399,7 @@ TlsConnection::checkState()
          default:
             if(err == SSL_ERROR_SYSCALL)
             {
-               int e = getErrno();
+               int e = sysErrno;
                switch(e)
                {
                   case EINTR:
@@ -327,7 +464,10 @@ TlsConnection::checkState()
                DebugLog(<<"unrecognised/unhandled SSL_get_error result: " << err);
             }
             ErrLog( << "TLS handshake failed ");
-            handleOpenSSLErrorQueue(ok, err, "SSL_do_handshake");
+            if (!errorsLogged)
+            {
+               handleOpenSSLErrorQueue(ok, err, "SSL_do_handshake");
+            }
             mBio = NULL;
             mTlsState = Broken;
             return mTlsState;
@@ -366,7 +506,12 @@ TlsConnection::checkState()
       }
    }
 
-   InfoLog( << "TLS handshake done for peer " << getPeerNamesData()); 
+   bool resumed = SSL_session_reused(mSsl) != 0;
+   InfoLog( << "TLS handshake done for peer " << getPeerNamesData()
+            << (resumed ? " (session resumed)" : ""));
+   TlsBaseTransport *t = dynamic_cast<TlsBaseTransport*>(transport());
+   resip_assert(t);
+   t->onHandshakeDone(resumed);
    mTlsState = Up;
    if (!mOutstandingSends.empty())
    {
@@ -491,6 +636,13 @@ TlsConnection::transportWrite()
    {
       case Handshaking:
       case Initial:
+         if (mHandshakePool && mHandShakeWantsRead && !mStepDone)
+         {
+            // only the peer can move the handshake along; don't hand a
+            // handshake thread a step that would just want to read again
+            DebugLog(<< "Transportwrite--Handshaking--remove from write: " << mHandShakeWantsRead);
+            return true;
+         }
          checkState();
          if (mTlsState == Handshaking)
          {
@@ -576,6 +728,33 @@ TlsConnection::write( const char* buf, int count )
    return -1;
 }
 
+#ifndef WIN32
+int
+TlsConnection::writeGathered(const struct iovec* iov, int count)
+{
+   // An SSL_write() that could not complete must be retried with the same
+   // bytes, so what was gathered is kept until it has gone out.
+   if (mGatherBuffer.empty())
+   {
+      if (iov[0].iov_len >= MaxRecordSize)
+      {
+         return write((const char*)iov[0].iov_base, (int)iov[0].iov_len);
+      }
+      for (int i = 0; i < count && mGatherBuffer.size() < MaxRecordSize; ++i)
+      {
+         size_t n = resipMin((size_t)iov[i].iov_len, (size_t)(MaxRecordSize - mGatherBuffer.size()));
+         mGatherBuffer.append((const char*)iov[i].iov_base, (Data::size_type)n);
+      }
+   }
+
+   int ret = write(mGatherBuffer.data(), (int)mGatherBuffer.size());
+   if (ret != 0)
+   {
+      mGatherBuffer.clear();
+   }
+   return ret;
+}
+#endif
 
 bool 
 TlsConnection::hasDataToRead() // has data that can be read 
@@ -585,6 +764,10 @@ TlsConnection::hasDataToRead() // has data that can be read
    if(mTlsState == Initial)
       return false;
 
+   // pooled handshake steps start from socket readiness only
+   if(mHandshakePool && mTlsState != Up)
+      return false;
+
    if (checkState() != Up)
    {
       return false;
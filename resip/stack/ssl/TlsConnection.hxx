@@ -28,6 +28,7 @@ namespace resip
 
 class Tuple;
 class Security;
+class TlsHandshakePool;
 
 class TlsConnection : public Connection
 {
@@ -43,6 +44,10 @@ class TlsConnection : public Connection
 
       int read( char* buf, const int count );
       int write( const char* buf, const int count );
+#ifndef WIN32
+      /// one SSL_write of up to a record's worth of the buffers
+      virtual int writeGathered(const struct iovec* iov, int count);
+#endif
       virtual bool hasDataToRead(); // has data that can be read 
       virtual bool isGood(); // has valid connection
       virtual bool isWritable();
@@ -53,6 +58,15 @@ class TlsConnection : public Connection
       
       typedef enum TlsState { Initial, Broken, Handshaking, Up } TlsState;
       static const char * fromState(TlsState);
+
+      /// SSL_CTX new session callback, keeps client sessions for reuse
+      static int onNewSession(SSL* ssl, SSL_SESSION* session);
+
+      /// one SSL_do_handshake(), run by a TlsHandshakePool thread
+      void runHandshakeStep();
+      /** back from the TlsHandshakePool: act on the step's outcome; may
+          delete this */
+      void handshakeStepDone();
    
    private:
       /// No default c'tor
@@ -60,6 +74,10 @@ class TlsConnection : public Connection
       void computePeerName();
       Data getPeerNamesData() const;
       TlsState checkState();
+      /// acts on what SSL_do_handshake() returned
+      TlsState handshakeResult(int ok, int err, int sysErrno, bool errorsLogged);
+      /// key of the client session cache: target domain and address
+      Data sessionDestination();
 
       bool mServer;
       Security* mSecurity;
@@ -69,9 +87,25 @@ class TlsConnection : public Connection
       TlsState mTlsState;
       bool mHandShakeWantsRead;
 
+      /// set when handshake steps run on the transport's handshake threads
+      TlsHandshakePool* mHandshakePool;
+      /// posted to mHandshakePool, which owns mSsl until it hands it back
+      bool mHandshakeParked;
+      /// outcome of the last pooled step, not yet acted on
+      bool mStepDone;
+      int mStepResult;
+      int mStepError;
+      int mStepErrno;
+      bool mStepErrorsLogged;
+
       SSL* mSsl;
       BIO* mBio;
       std::list<BaseSecurity::PeerName> mPeerNames;
+
+      /// most plaintext one TLS record carries
+      enum { MaxRecordSize = 16384 };
+      /// bytes gathered for an SSL_write that has yet to go through
+      Data mGatherBuffer;
 };
  
 }
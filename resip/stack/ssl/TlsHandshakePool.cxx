@@ -0,0 +1,206 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#ifdef USE_SSL
+
+#include <algorithm>
+
+#include "resip/stack/ssl/TlsHandshakePool.hxx"
+#include "resip/stack/ssl/TlsBaseTransport.hxx"
+#include "resip/stack/ssl/TlsConnection.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/WinLeakCheck.hxx"
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
+
+using namespace resip;
+
+TlsHandshakePool::TlsHandshakePool(TlsBaseTransport& transport, unsigned int threads) :
+   mTransport(transport),
+   mShutdown(false)
+{
+   InfoLog(<< "Starting " << threads << " TLS handshake threads");
+   for (unsigned int i = 0; i < threads; ++i)
+   {
+      Worker* worker = new Worker(*this);
+      mWorkers.push_back(worker);
+      worker->run();
+   }
+}
+
+TlsHandshakePool::~TlsHandshakePool()
+{
+   {
+      Lock lock(mMutex);
+      mShutdown = true;
+      mWork.broadcast();
+   }
+   for (std::vector<Worker*>::iterator it = mWorkers.begin(); it != mWorkers.end(); ++it)
+   {
+      (*it)->shutdown();
+      (*it)->join();
+      delete *it;
+   }
+   // connections still queued were closed by the transport already
+   resip_assert(mRunning.empty());
+}
+
+void
+TlsHandshakePool::post(TlsConnection* conn)
+{
+   Lock lock(mMutex);
+   mWaiting.push_back(conn);
+   mWork.signal();
+}
+
+void
+TlsHandshakePool::cancel(TlsConnection* conn)
+{
+   Lock lock(mMutex);
+   while (mRunning.count(conn))
+   {
+      mFinished.wait(mMutex);
+   }
+   mWaiting.erase(std::remove(mWaiting.begin(), mWaiting.end(), conn), mWaiting.end());
+   mCompleted.erase(std::remove(mCompleted.begin(), mCompleted.end(), conn), mCompleted.end());
+}
+
+TlsConnection*
+TlsHandshakePool::nextCompleted()
+{
+   Lock lock(mMutex);
+   if (mCompleted.empty())
+   {
+      return 0;
+   }
+   TlsConnection* conn = mCompleted.front();
+   mCompleted.pop_front();
+   return conn;
+}
+
+unsigned int
+TlsHandshakePool::pending() const
+{
+   Lock lock(mMutex);
+   return (unsigned int)(mWaiting.size() + mRunning.size());
+}
+
+TlsConnection*
+TlsHandshakePool::take(unsigned int ms)
+{
+   Lock lock(mMutex);
+   if (mWaiting.empty() && !mShutdown)
+   {
+      mWork.wait(mMutex, ms);
+   }
+   if (mWaiting.empty() || mShutdown)
+   {
+      return 0;
+   }
+   TlsConnection* conn = mWaiting.front();
+   mWaiting.pop_front();
+   mRunning.insert(conn);
+   return conn;
+}
+
+void
+TlsHandshakePool::finish(TlsConnection* conn)
+{
+   Lock lock(mMutex);
+   mRunning.erase(conn);
+   mCompleted.push_back(conn);
+   mFinished.broadcast();
+   if (mCompleted.size() == 1)
+   {
+      // later completions are collected along with this one
+      mWakeup.interrupt();
+   }
+}
+
+void
+TlsHandshakePool::buildFdSet(FdSet& fdset)
+{
+   mWakeup.buildFdSet(fdset);
+}
+
+void
+TlsHandshakePool::process(FdSet& fdset)
+{
+   mWakeup.process(fdset);
+}
+
+void
+TlsHandshakePool::processPollEvent(FdPollEventMask mask)
+{
+   mWakeup.processPollEvent(mask);
+   mTransport.processCompletedHandshakes();
+}
+
+void
+TlsHandshakePool::Worker::thread()
+{
+   while (!isShutdown())
+   {
+      TlsConnection* conn = mPool.take(100);
+      if (conn)
+      {
+         conn->runHandshakeStep();
+         mPool.finish(conn);
+      }
+   }
+}
+
+#endif /* USE_SSL */
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
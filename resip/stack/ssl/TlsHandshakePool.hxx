@@ -0,0 +1,145 @@
+#if !defined(RESIP_TLSHANDSHAKEPOOL_HXX)
+#define RESIP_TLSHANDSHAKEPOOL_HXX
+
+#if defined(HAVE_CONFIG_H)
+  #include "config.h"
+#endif
+
+#include <deque>
+#include <set>
+#include <vector>
+
+#include "rutil/Mutex.hxx"
+#include "rutil/Condition.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/SelectInterruptor.hxx"
+#include "rutil/FdPoll.hxx"
+
+namespace resip
+{
+
+class FdSet;
+class TlsBaseTransport;
+class TlsConnection;
+
+/**
+   Threads that run the SSL_do_handshake() steps of a TlsBaseTransport's
+   connections, so that the key exchange and certificate checks of many
+   peers connecting at once do not hold up the transport thread.
+
+   The transport thread post()s a connection whose socket is ready; a worker
+   runs one step on the non-blocking socket and hands the connection back.
+   The transport thread is woken through a pipe and collects the finished
+   connections with nextCompleted().  While a connection is posted the
+   transport thread does not touch its SSL object.
+*/
+class TlsHandshakePool : public FdPollItemIf
+{
+   public:
+      TlsHandshakePool(TlsBaseTransport& transport, unsigned int threads);
+      virtual ~TlsHandshakePool();
+
+      /// queue conn for a handshake step
+      void post(TlsConnection* conn);
+      /// forget conn, waiting for a worker to finish with it if need be
+      void cancel(TlsConnection* conn);
+      /// a connection whose step is done, 0 if there is none
+      TlsConnection* nextCompleted();
+
+      /// steps queued or running
+      unsigned int pending() const;
+
+      /// the wakeup pipe, for select() based transports
+      void buildFdSet(FdSet& fdset);
+      void process(FdSet& fdset);
+      Socket getWakeupSocket() const { return mWakeup.getReadSocket(); }
+
+      /* callback method of FdPollItemIf */
+      virtual void processPollEvent(FdPollEventMask mask);
+
+   private:
+      class Worker : public ThreadIf
+      {
+         public:
+            explicit Worker(TlsHandshakePool& pool) : mPool(pool) {}
+            virtual void thread();
+         private:
+            TlsHandshakePool& mPool;
+      };
+
+      /// next connection to work on, marked running; 0 on timeout
+      TlsConnection* take(unsigned int ms);
+      void finish(TlsConnection* conn);
+
+      TlsBaseTransport& mTransport;
+      SelectInterruptor mWakeup;
+
+      mutable Mutex mMutex;
+      Condition mWork;
+      Condition mFinished;
+      std::deque<TlsConnection*> mWaiting;
+      std::set<TlsConnection*> mRunning;
+      std::deque<TlsConnection*> mCompleted;
+      bool mShutdown;
+
+      std::vector<Worker*> mWorkers;
+
+      /// no value semantics
+      TlsHandshakePool(const TlsHandshakePool&);
+      TlsHandshakePool& operator=(const TlsHandshakePool&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -40,6 +40,10 @@ class TlsTransport : public TlsBaseTransport
                    const Data& privateKeyFilename = "",
                    const Data& privateKeyPassPhrase = "");
       virtual  ~TlsTransport();
+
+#ifndef WIN32
+      virtual bool supportsGatheredSends() const { return true; }
+#endif
 };
 
 }
@@ -6,6 +6,7 @@
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/ExtensionHeader.hxx"
 #include "resip/stack/ExtensionParameter.hxx"
+#include "resip/stack/MsgHeaderScanner.hxx"
 #include "resip/stack/ParserCategories.hxx"
 #include "resip/stack/ParameterTypes.hxx"
 #include "resip/stack/Uri.hxx"
@@ -5774,12 +5775,9 @@ Content-Length: 0
 }
 
 
-int main()
+static void
+runTortureTests()
 {
-
-resip::SipMessage::checkContentLength=true;
-
-resip::Log::initialize("cout", "DEBUG", "RFC4475TortureTests");
 try
 {
    wsinv();
@@ -6347,6 +6345,28 @@ catch(resip::BaseException& e)
 }
 
 
+}
+
+int main()
+{
+
+resip::SipMessage::checkContentLength=true;
+
+resip::Log::initialize("cout", "DEBUG", "RFC4475TortureTests");
+
+// Every header scanning mode this CPU supports has to pass the whole corpus.
+const resip::MsgHeaderScanner::ScanMode modes[] = { resip::MsgHeaderScanner::smScalar,
+                                                    resip::MsgHeaderScanner::smSse2,
+                                                    resip::MsgHeaderScanner::smAvx2 };
+for(unsigned int i = 0; i < sizeof(modes)/sizeof(modes[0]); ++i)
+{
+   if(resip::MsgHeaderScanner::setScanMode(modes[i]) == modes[i])
+   {
+      InfoLog(<< "Running torture tests with MsgHeaderScanner mode " << modes[i]);
+      runTortureTests();
+   }
+}
+
 }
 
 /* ====================================================================
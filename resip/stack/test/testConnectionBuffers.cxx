@@ -0,0 +1,289 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <signal.h>
+
+#include "resip/stack/ConnectionManager.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "resip/stack/TcpTransport.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Socket.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+static const size_t ChunkSize = Connection::ChunkSize;
+
+static void
+process(TcpBaseTransport& transport)
+{
+   for (int i = 0; i < 5; ++i)
+   {
+      FdSet fdset;
+      transport.buildFdSet(fdset);
+      fdset.selectMilliSeconds(10);
+      transport.process(fdset);
+   }
+}
+
+static Socket
+connectTo(TcpBaseTransport& transport, int port)
+{
+   Tuple dest("127.0.0.1", port, V4, TCP);
+   Socket fd = ::socket(AF_INET, SOCK_STREAM, 0);
+   assert(fd != INVALID_SOCKET);
+   int ret = ::connect(fd, &dest.getSockaddr(), dest.length());
+   assert(ret == 0);
+   process(transport);
+   return fd;
+}
+
+static void
+sendBytes(Socket fd, const Data& bytes)
+{
+   int ret = ::send(fd, bytes.data(), (int)bytes.size(), 0);
+   assert(ret == (int)bytes.size());
+}
+
+static Data
+makeOptions(size_t bodySize)
+{
+   Data body(bodySize, Data::Preallocate);
+   for (size_t i = 0; i < bodySize; ++i)
+   {
+      body += char('a' + i % 26);
+   }
+   Data msg("OPTIONS sip:bob@127.0.0.1;transport=tcp SIP/2.0\r\n"
+            "Via: SIP/2.0/TCP 127.0.0.1:5070;branch=z9hG4bK-buffers\r\n"
+            "Max-Forwards: 70\r\n"
+            "To: <sip:bob@127.0.0.1>\r\n"
+            "From: <sip:alice@127.0.0.1>;tag=1234\r\n"
+            "Call-ID: buffers@127.0.0.1\r\n"
+            "CSeq: 1 OPTIONS\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length: ");
+   msg += Data((UInt64)bodySize);
+   msg += "\r\n\r\n";
+   msg += body;
+   return msg;
+}
+
+static std::unique_ptr<SipMessage>
+received(Fifo<TransactionMessage>& fifo)
+{
+   assert(fifo.messageAvailable());
+   std::unique_ptr<TransactionMessage> msg(fifo.getNext());
+   SipMessage* sip = dynamic_cast<SipMessage*>(msg.get());
+   assert(sip);
+   msg.release();
+   return std::unique_ptr<SipMessage>(sip);
+}
+
+static void
+testPooled()
+{
+   ConnectionManager::PoolReceiveBuffers = true;
+   Fifo<TransactionMessage> fifo;
+   TcpTransport transport(fifo, 5894, V4, "127.0.0.1");
+   const ConnectionManager& manager = transport.getConnectionManager();
+   assert(manager.getConnectionCount() == 0);
+   assert(transport.getReceiveBufferBytes() == 0);
+
+   Socket fd = connectTo(transport, 5894);
+   assert(transport.getConnectionCount() == 1);
+   assert(transport.getReceiveBufferBytes() == 0);
+
+   // a keepalive leaves the connection holding nothing; the buffer it was
+   // read into waits on the free list
+   sendBytes(fd, "\r\n\r\n");
+   process(transport);
+   assert(transport.getReceiveBufferBytes() == ChunkSize);
+
+   // part of a message: the connection keeps just the bytes not yet
+   // scanned (the rest have gone to the SipMessage)
+   Data msg(makeOptions(100));
+   sendBytes(fd, msg.substr(0, 60));
+   process(transport);
+   assert(!fifo.messageAvailable());
+   assert(transport.getReceiveBufferBytes() > ChunkSize);
+   assert(transport.getReceiveBufferBytes() < ChunkSize + 60);
+
+   sendBytes(fd, msg.substr(60));
+   process(transport);
+   std::unique_ptr<SipMessage> sip(received(fifo));
+   assert(sip->getContents()->getBodyData() == msg.substr(msg.size() - 100));
+   assert(transport.getReceiveBufferBytes() == ChunkSize);
+
+   // a body spread over reads, and bigger than a chunk
+   msg = makeOptions(3 * ChunkSize + 17);
+   size_t pos = 0;
+   size_t pieces[] = { 300, ChunkSize, 1000, ChunkSize + 5 };
+   for (size_t i = 0; i < sizeof(pieces)/sizeof(*pieces); ++i)
+   {
+      sendBytes(fd, msg.substr(pos, pieces[i]));
+      pos += pieces[i];
+      process(transport);
+      assert(!fifo.messageAvailable());
+      // never more than a chunk of slack over what has arrived
+      assert(transport.getReceiveBufferBytes() < ChunkSize + pos + ChunkSize/2);
+   }
+   sendBytes(fd, msg.substr(pos));
+   process(transport);
+   sip = received(fifo);
+   assert(sip->getContents()->getBodyData() == msg.substr(msg.size() - (3 * ChunkSize + 17)));
+   assert(transport.getReceiveBufferBytes() == ChunkSize);
+
+   // two messages and a bit in one read
+   Data two(makeOptions(10) + makeOptions(20) + makeOptions(30).substr(0, 40));
+   sendBytes(fd, two);
+   process(transport);
+   sip = received(fifo);
+   sip = received(fifo);
+   assert(sip->getContents()->getBodyData().size() == 20);
+   assert(!fifo.messageAvailable());
+   assert(transport.getReceiveBufferBytes() > ChunkSize);
+   assert(transport.getReceiveBufferBytes() <= ChunkSize + 40);
+   sendBytes(fd, makeOptions(30).substr(40));
+   process(transport);
+   sip = received(fifo);
+   assert(sip->getContents()->getBodyData().size() == 30);
+
+   closeSocket(fd);
+   process(transport);
+   assert(transport.getConnectionCount() == 0);
+   assert(transport.getReceiveBufferBytes() == ChunkSize);
+   ConnectionManager::PoolReceiveBuffers = false;
+}
+
+static void
+testUnpooled()
+{
+   Fifo<TransactionMessage> fifo;
+   TcpTransport transport(fifo, 5895, V4, "127.0.0.1");
+   Socket fd = connectTo(transport, 5895);
+
+   // a connection keeps its buffer between messages...
+   Data msg(makeOptions(100));
+   sendBytes(fd, msg);
+   process(transport);
+   received(fifo);
+   sendBytes(fd, msg.substr(0, 60));
+   process(transport);
+   assert(transport.getReceiveBufferBytes() == ChunkSize);
+
+   // ...but the accounting still follows it
+   closeSocket(fd);
+   process(transport);
+   assert(transport.getConnectionCount() == 0);
+   assert(transport.getReceiveBufferBytes() == 0);
+}
+
+// Idle flows a proxy holds on to, with and without the pool.
+static void
+measureIdle(bool pooled, int basePort)
+{
+   const int flows = 300;
+   ConnectionManager::PoolReceiveBuffers = pooled;
+   Fifo<TransactionMessage> fifo;
+   TcpTransport transport(fifo, basePort, V4, "127.0.0.1");
+   std::vector<Socket> fds;
+   Data msg(makeOptions(0));
+   for (int i = 0; i < flows; ++i)
+   {
+      fds.push_back(connectTo(transport, basePort));
+      sendBytes(fds.back(), msg);
+   }
+   process(transport);
+   while (fifo.messageAvailable())
+   {
+      delete fifo.getNext();
+   }
+   assert(transport.getConnectionCount() == (unsigned int)flows);
+   cerr << (pooled ? "pooled:   " : "unpooled: ") << flows << " idle connections hold "
+        << transport.getReceiveBufferBytes() << " bytes of receive buffer" << endl;
+   for (size_t i = 0; i < fds.size(); ++i)
+   {
+      closeSocket(fds[i]);
+   }
+   process(transport);
+   ConnectionManager::PoolReceiveBuffers = false;
+}
+
+int
+main(int argc, char* argv[])
+{
+#ifndef WIN32
+   signal(SIGPIPE, SIG_IGN);
+#else
+   initNetwork();
+#endif
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   testPooled();
+   testUnpooled();
+   measureIdle(false, 5896);
+   measureIdle(true, 5897);
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -0,0 +1,226 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "resip/stack/Tuple.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/HashMap.hxx"
+#include "rutil/Random.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+// The indexes ConnectionManager keeps its connections in; the values are
+// never dereferenced, so the tests store indexes.
+typedef HashMap<Tuple, size_t> AddrMap;
+typedef HashMap<Socket, size_t> IdMap;
+// what the tuple index used to be
+typedef std::map<Tuple, size_t> OrderedAddrMap;
+
+// A phone behind one of a few thousand NATs, 250 to a NAT, like a proxy's
+// outbound flows.
+static Tuple
+client(size_t i)
+{
+   size_t nat = i / 250;
+   Data addr("198." + Data((UInt32)(nat / 65536 % 256)) + "." +
+             Data((UInt32)(nat / 256 % 256)) + "." + Data((UInt32)(nat % 256)));
+   int port = 1024 + int(i % 250) * 257;
+   return Tuple(addr, port, V4, (i % 3) ? TCP : TLS);
+}
+
+// The tuple a lookup is done with: the same flow, but the parts
+// Tuple::operator== ignores are different.
+static Tuple
+lookupFor(const Tuple& tuple)
+{
+   Tuple search(tuple);
+   search.mFlowKey = 0;
+   search.onlyUseExistingConnection = true;
+   search.setTargetDomain("example.com");
+   return search;
+}
+
+static void
+testSemantics()
+{
+   AddrMap map;
+   map[Tuple("10.0.0.1", 5060, V4, TCP)] = 1;
+   map[Tuple("10.0.0.1", 5061, V4, TCP)] = 2;
+   map[Tuple("10.0.0.1", 5060, V4, TLS)] = 3;
+   map[Tuple("10.0.0.2", 5060, V4, TCP)] = 4;
+#ifdef USE_IPV6
+   map[Tuple("::ffff:10.0.0.1", 5060, V6, TCP)] = 5;
+   map[Tuple("2001:db8::1", 5060, V6, TCP)] = 6;
+   assert(map.size() == 6);
+   assert(map[lookupFor(Tuple("2001:db8::1", 5060, V6, TCP))] == 6);
+   assert(map.find(Tuple("2001:db8::1", 5060, V6, TLS)) == map.end());
+#else
+   assert(map.size() == 4);
+#endif
+
+   assert(map.find(lookupFor(Tuple("10.0.0.1", 5060, V4, TCP)))->second == 1);
+   assert(map.find(lookupFor(Tuple("10.0.0.1", 5061, V4, TCP)))->second == 2);
+   assert(map.find(lookupFor(Tuple("10.0.0.1", 5060, V4, TLS)))->second == 3);
+   assert(map.find(Tuple("10.0.0.1", 5060, V4, UDP)) == map.end());
+   assert(map.find(Tuple("10.0.0.3", 5060, V4, TCP)) == map.end());
+
+   // agrees with the ordered map on which tuples are the same flow
+   OrderedAddrMap ordered;
+   AddrMap hashed;
+   for (size_t i = 0; i < 20000; ++i)
+   {
+      Tuple tuple(client(size_t(Random::getRandom()) % 100000));
+      ordered[tuple] = i;
+      hashed[tuple] = i;
+   }
+   assert(ordered.size() == hashed.size());
+   for (size_t i = 0; i < 100000; ++i)
+   {
+      Tuple search(lookupFor(client(i)));
+      OrderedAddrMap::const_iterator o = ordered.find(search);
+      AddrMap::const_iterator h = hashed.find(search);
+      assert((o == ordered.end()) == (h == hashed.end()));
+      assert(o == ordered.end() || o->second == h->second);
+   }
+}
+
+// The hash has to spread NATed flows, which share a few addresses.
+static void
+testSpread()
+{
+   const size_t count = 100000;
+   AddrMap map(count);
+   for (size_t i = 0; i < count; ++i)
+   {
+      map[client(i)] = i;
+   }
+   assert(map.size() == count);
+   size_t longest = 0;
+   for (size_t b = 0; b < map.bucket_count(); ++b)
+   {
+      longest = map.bucket_size(b) > longest ? map.bucket_size(b) : longest;
+   }
+   assert(longest < 16);
+}
+
+template <class Map, class Key>
+static UInt64
+timeLookups(const vector<Key>& keys, const vector<Key>& searches, const vector<size_t>& order)
+{
+   Map map(keys.size());
+   for (size_t i = 0; i < keys.size(); ++i)
+   {
+      map[keys[i]] = i;
+   }
+   size_t found = 0;
+   UInt64 start = Timer::getTimeMs();
+   for (size_t i = 0; i < order.size(); ++i)
+   {
+      typename Map::const_iterator it = map.find(searches[order[i]]);
+      found += (it != map.end() && it->second == order[i]);
+   }
+   UInt64 elapsed = Timer::getTimeMs() - start;
+   assert(found == order.size());
+   return elapsed;
+}
+
+// Lookup rate with count live connections; only run when a count is given
+// on the command line.
+static void
+benchmark(size_t count)
+{
+   vector<Tuple> tuples;
+   vector<Tuple> searches;
+   vector<Socket> sockets;
+   tuples.reserve(count);
+   searches.reserve(count);
+   sockets.reserve(count);
+   for (size_t i = 0; i < count; ++i)
+   {
+      tuples.push_back(client(i));
+      searches.push_back(lookupFor(tuples.back()));
+      sockets.push_back(Socket(i + 16));
+   }
+   vector<size_t> order(count);
+   for (size_t i = 0; i < count; ++i)
+   {
+      order[i] = size_t(Random::getRandom()) % count;
+   }
+
+   UInt64 byTuple = timeLookups<AddrMap>(tuples, searches, order);
+   UInt64 bySocket = timeLookups<IdMap>(sockets, sockets, order);
+   cerr << count << " lookups among " << count << " connections in " << byTuple
+        << " ms by tuple, " << bySocket << " ms by socket" << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+   Random::initialize();
+
+   testSemantics();
+   testSpread();
+
+   if (argc > 1)
+   {
+      benchmark(size_t(atol(argv[1])));
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
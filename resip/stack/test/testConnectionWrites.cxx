@@ -0,0 +1,256 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <signal.h>
+
+#include "resip/stack/SendData.hxx"
+#include "resip/stack/TcpTransport.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Socket.hxx"
+
+#ifndef WIN32
+#include <sys/socket.h>
+#endif
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+static void
+process(TcpBaseTransport& transport)
+{
+   for (int i = 0; i < 5; ++i)
+   {
+      FdSet fdset;
+      transport.buildFdSet(fdset);
+      fdset.selectMilliSeconds(10);
+      transport.process(fdset);
+   }
+}
+
+// Connects to the transport, and returns the tuple it knows the flow by.
+static Socket
+connectTo(TcpBaseTransport& transport, int port, Tuple& flow)
+{
+   Tuple dest("127.0.0.1", port, V4, TCP);
+   Socket fd = ::socket(AF_INET, SOCK_STREAM, 0);
+   assert(fd != INVALID_SOCKET);
+   int ret = ::connect(fd, &dest.getSockaddr(), dest.length());
+   assert(ret == 0);
+   process(transport);
+   assert(transport.getConnectionCount() == 1);
+
+   sockaddr_in local;
+   socklen_t len = sizeof(local);
+   ret = ::getsockname(fd, (sockaddr*)&local, &len);
+   assert(ret == 0);
+   flow = Tuple((const sockaddr&)local, TCP);
+   return fd;
+}
+
+// Reads size bytes from the peer's end, running the transport meanwhile.
+static Data
+receiveAll(TcpBaseTransport& transport, Socket fd, size_t size)
+{
+   Data got(Data::size_type(size), Data::Preallocate);
+   char buf[65536];
+   while (got.size() < size)
+   {
+      process(transport);
+      int n = ::recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+      if (n > 0)
+      {
+         got.append(buf, n);
+      }
+   }
+   return got;
+}
+
+static Data
+message(int i, size_t size)
+{
+   Data msg(Data::size_type(size), Data::Preallocate);
+   msg += "message ";
+   msg += Data(i);
+   msg += ' ';
+   while (msg.size() < size)
+   {
+      msg += char('a' + (msg.size() + i) % 26);
+   }
+   return msg;
+}
+
+static const char* rawHeader = "raw header region\r\n";
+static const char* rawBody = "raw body region";
+
+// A gathered message, as GatherStream makes them: encoded parts in data,
+// raw regions left where they are.
+static std::unique_ptr<SendData>
+gathered(const Tuple& flow, int i, Data& whole)
+{
+   std::unique_ptr<SendData> send(new SendData(flow, Data::Empty, Data::Empty, Data::Empty));
+   Data first("INFO " + Data(i) + "\r\n");
+   Data second("\r\n");
+   send->data = first + second;
+   send->pieces.push_back(SendData::Piece(0, 0, first.size()));
+   send->pieces.push_back(SendData::Piece(rawHeader, 0, strlen(rawHeader)));
+   send->pieces.push_back(SendData::Piece(0, first.size(), second.size()));
+   send->pieces.push_back(SendData::Piece(rawBody, 0, strlen(rawBody)));
+   whole = first + rawHeader + second + rawBody;
+   assert(send->size() == whole.size());
+   return send;
+}
+
+static void
+testCoalesced()
+{
+   Fifo<TransactionMessage> fifo;
+   TcpTransport transport(fifo, 5898, V4, "127.0.0.1");
+   Tuple flow;
+   Socket fd = connectTo(transport, 5898, flow);
+
+   // a burst queued together goes out together, gathered messages and all
+   const int burst = 40;
+   Data expected;
+   for (int i = 0; i < burst; ++i)
+   {
+      if (i % 4 == 3)
+      {
+         Data whole;
+         transport.send(gathered(flow, i, whole));
+         expected += whole;
+      }
+      else
+      {
+         Data msg(message(i, 200 + 37 * i));
+         transport.send(std::unique_ptr<SendData>(new SendData(flow, msg, Data::Empty, Data::Empty)));
+         expected += msg;
+      }
+   }
+   assert(receiveAll(transport, fd, expected.size()) == expected);
+   assert(transport.getMessagesWritten() == (UInt64)burst);
+   cerr << burst << " messages in " << transport.getWrites() << " writes" << endl;
+   assert(transport.getWrites() < (UInt64)burst / 4);
+
+   closeSocket(fd);
+   process(transport);
+}
+
+// The peer stops reading, so writes are cut short mid-message; what
+// arrives must still be every message, whole and in order.
+static void
+testPartialWrites()
+{
+   Fifo<TransactionMessage> fifo;
+   TcpTransport transport(fifo, 5899, V4, "127.0.0.1");
+   Tuple flow;
+   Socket fd = connectTo(transport, 5899, flow);
+   int small = 4096;
+   setsockopt(fd, SOL_SOCKET, SO_RCVBUF, (const char*)&small, sizeof(small));
+
+   Data expected;
+   for (int round = 0; round < 4; ++round)
+   {
+      for (int i = 0; i < 300; ++i)
+      {
+         if (i % 5 == 0)
+         {
+            Data whole;
+            transport.send(gathered(flow, i, whole));
+            expected += whole;
+         }
+         else
+         {
+            Data msg(message(i, 1000 + 13 * i));
+            transport.send(std::unique_ptr<SendData>(new SendData(flow, msg, Data::Empty, Data::Empty)));
+            expected += msg;
+         }
+      }
+      process(transport);
+   }
+
+   Data got(receiveAll(transport, fd, expected.size()));
+   assert(got == expected);
+   assert(transport.getMessagesWritten() == 1200);
+   cerr << "1200 messages, some cut short, in " << transport.getWrites() << " writes" << endl;
+
+   closeSocket(fd);
+   process(transport);
+}
+
+int
+main(int argc, char* argv[])
+{
+#ifndef WIN32
+   signal(SIGPIPE, SIG_IGN);
+#else
+   initNetwork();
+#endif
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+#ifndef WIN32
+   testCoalesced();
+   testPartialWrites();
+#endif
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
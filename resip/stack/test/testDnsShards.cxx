@@ -0,0 +1,245 @@
+#include <cassert>
+#include <iostream>
+#include <set>
+#include <vector>
+
+#include "rutil/Data.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/dns/DnsStub.hxx"
+#include "rutil/dns/QueryTypes.hxx"
+#include "resip/stack/DnsInterface.hxx"
+
+using namespace resip;
+using namespace std;
+
+// DnsStubs whose cache the tests fill directly, so nothing goes out to
+// a real server.
+class TestStub : public DnsStub
+{
+   public:
+      TestStub(DnsStub* shareCacheWith = 0)
+         : DnsStub(EmptyNameserverList, 0, 0, 0, shareCacheWith)
+      {}
+
+      void cacheHost(const Data& name, UInt32 addr)
+      {
+         in_addr a;
+         a.s_addr = htonl(addr);
+         cache(name, a);
+      }
+};
+
+class CountingSink : public DnsResultSink
+{
+   public:
+      CountingSink() : mResults(0), mFailures(0) {}
+
+      void onDnsResult(const DNSResult<DnsHostRecord>& result)
+      {
+         ++mResults;
+         if (result.status != 0 || result.records.size() != 1)
+         {
+            ++mFailures;
+         }
+      }
+      void onLogDnsResult(const DNSResult<DnsHostRecord>&) {}
+
+      void onDnsResult(const DNSResult<DnsAAAARecord>&) { assert(0); }
+      void onDnsResult(const DNSResult<DnsSrvRecord>&) { assert(0); }
+      void onDnsResult(const DNSResult<DnsNaptrRecord>&) { assert(0); }
+      void onDnsResult(const DNSResult<DnsCnameRecord>&) { assert(0); }
+
+      int mResults;
+      int mFailures;
+};
+
+// A stub sharing another's cache answers from what the other one cached.
+static void
+testSharedCache()
+{
+   TestStub first;
+   TestStub second(&first);
+
+   first.cacheHost("Shared.Example.COM", 0x0a000001);
+
+   CountingSink sink;
+   second.lookup<RR_A>("shared.example.com", Protocol::Sip, &sink);
+   second.processTimers();
+   assert(sink.mResults == 1);
+   assert(sink.mFailures == 0);
+
+   DnsStub::CacheStatistics stats;
+   second.getCacheStatistics(stats);
+   assert(stats.hits == 1);
+   assert(stats.misses == 0);
+   first.getCacheStatistics(stats);
+   assert(stats.hits == 0);
+
+   // and a clear through either stub empties it for both
+   second.clearDnsCache();
+   second.processTimers();
+   second.cacheHost("other.example.com", 0x0a000002);
+   first.lookup<RR_A>("other.example.com", Protocol::Sip, &sink);
+   first.processTimers();
+   assert(sink.mResults == 2);
+   assert(sink.mFailures == 0);
+}
+
+// Every name always maps to the same stub, and names spread over all of them.
+static void
+testInterfaceShards()
+{
+   TestStub first;
+   TestStub second(&first);
+   TestStub third(&first);
+   DnsInterface dns(first);
+   assert(&dns.getDnsStub("example.com") == &first);
+
+   dns.addDnsShard(second);
+   dns.addDnsShard(third);
+
+   set<DnsStub*> used;
+   for (int i = 0; i < 100; ++i)
+   {
+      Data name("host" + Data(i) + ".example.com");
+      DnsStub& stub = dns.getDnsStub(name);
+      assert(&dns.getDnsStub(name) == &stub);
+      // the hash ignores case, like DNS
+      assert(&dns.getDnsStub(Data(name).uppercase()) == &stub);
+      used.insert(&stub);
+   }
+   assert(used.size() == 3);
+}
+
+// Stubs on their own threads caching and looking up through one small cache,
+// so entries are evicted while other threads are using them.
+class ShardThread : public ThreadIf
+{
+   public:
+      ShardThread(TestStub& stub, int id, int rounds)
+         : mStub(stub), mId(id), mRounds(rounds)
+      {}
+
+      void thread()
+      {
+         for (int i = 0; i < mRounds; ++i)
+         {
+            Data name("host" + Data(i % 200) + ".shard" + Data(mId) + ".example.com");
+            mStub.cacheHost(name, UInt32(i));
+            mStub.lookup<RR_A>(name, Protocol::Sip, &mSink);
+            mStub.processTimers();
+            // names other threads cache
+            mStub.lookup<RR_A>("host" + Data(i % 200) + ".shard" + Data((mId + 1) % 4) + ".example.com", Protocol::Sip, &mOtherSink);
+            mStub.processTimers();
+         }
+      }
+
+      TestStub& mStub;
+      int mId;
+      int mRounds;
+      CountingSink mSink;
+      CountingSink mOtherSink;
+};
+
+static void
+testConcurrentShards()
+{
+   const int rounds = 20000;
+   TestStub first;
+   first.setDnsCacheSize(100);
+   vector<TestStub*> stubs;
+   vector<ShardThread*> threads;
+   for (int i = 0; i < 4; ++i)
+   {
+      stubs.push_back(i == 0 ? &first : new TestStub(&first));
+      threads.push_back(new ShardThread(*stubs.back(), i, rounds));
+   }
+   for (size_t i = 0; i < threads.size(); ++i)
+   {
+      threads[i]->run();
+   }
+   for (size_t i = 0; i < threads.size(); ++i)
+   {
+      threads[i]->join();
+      // another thread can evict a name between caching and looking it up,
+      // which sends that lookup to the (absent) server; everything answered
+      // from the cache must be intact
+      DnsStub::CacheStatistics stats;
+      stubs[i]->getCacheStatistics(stats);
+      assert(stats.hits + stats.misses == 2 * rounds);
+      assert(threads[i]->mSink.mResults + threads[i]->mOtherSink.mResults == int(stats.hits));
+      assert(threads[i]->mSink.mResults > rounds / 2);
+      assert(threads[i]->mSink.mFailures == 0);
+      assert(threads[i]->mOtherSink.mFailures == 0);
+   }
+   for (size_t i = 0; i < threads.size(); ++i)
+   {
+      delete threads[i];
+      if (stubs[i] != &first)
+      {
+         delete stubs[i];
+      }
+   }
+}
+
+int
+main(int argc, char* argv[])
+{
+   testSharedCache();
+   testInterfaceShards();
+   testConcurrentShards();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -0,0 +1,334 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "resip/stack/MsgHeaderScanner.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+static const char* const modeNames[] = { "scalar", "sse2", "avx2" };
+
+static const char* const corpus[] =
+{
+   "INVITE sip:bob@biloxi.example.com;transport=tcp SIP/2.0\r\n"
+   "Via: SIP/2.0/TCP client.atlanta.example.com:5060;branch=z9hG4bK74bf9;received=192.0.2.101\r\n"
+   "Via: SIP/2.0/UDP proxy.example.com;branch=z9hG4bK776asdhds , SIP/2.0/UDP 10.0.0.1:5062;branch=z9hG4bK1234\r\n"
+   "Max-Forwards: 70\r\n"
+   "From: \"Alice, \\\"the\\\" Liddell\" <sip:alice@atlanta.example.com;user=phone>;tag=9fxced76sl\r\n"
+   "To: Bob <sip:bob@biloxi.example.com>\r\n"
+   "Call-ID: 3848276298220188511@atlanta.example.com\r\n"
+   "CSeq: 1 INVITE\r\n"
+   "Contact: <sip:alice@client.atlanta.example.com;transport=tcp>;expires=3600;q=0.7,\r\n"
+   "   <sip:alice@[2001:db8::10]:5070;ob>\r\n"
+   "Record-Route: <sip:p1.example.com;lr;ftag=9fxced76sl>,<sip:p2.example.com;lr>\r\n"
+   "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY, MESSAGE, SUBSCRIBE, INFO\r\n"
+   "Subject: a rather long subject line (with parens) that carries on for a good while 100%;\r\n"
+   "\tand is folded onto a second line\r\n"
+   "User-Agent: resip/1.x (test; scanner)\r\n"
+   "Content-Type: application/sdp\r\n"
+   "Content-Length: 0\r\n"
+   "\r\n",
+
+   "SIP/2.0 200 OK\r\n"
+   "Via: SIP/2.0/UDP 192.0.2.4;branch=z9hG4bKnashds8;received=192.0.2.4\r\n"
+   "To: <sip:bob@biloxi.example.com>;tag=8321234356\r\n"
+   "From: <sip:bob@biloxi.example.com>;tag=456248\r\n"
+   "Call-ID: 843817637684230@998sdasdh09\r\n"
+   "CSeq: 1826 REGISTER\r\n"
+   "Contact: <sip:bob@192.0.2.4>;expires=7200\r\n"
+   "WWW-Authenticate: Digest realm=\"atlanta.example.com\", qop=\"auth,auth-int\",\r\n"
+   " nonce=\"ea9c8e88df84f1cec4341ae6cbe5a359\", opaque=\"\", stale=FALSE, algorithm=MD5\r\n"
+   "Content-Length: 0\r\n"
+   "\r\n",
+
+   "OPTIONS sip:user@example.com SIP/2.0\r\n"
+   "To: sip:user@example.com\r\n"
+   "From: caller<sip:caller@example.com>;tag=323\r\n"
+   "Max-Forwards: 70\r\n"
+   "Call-ID: lwsdisp.1234abcd@funky.example.com\r\n"
+   "CSeq: 60 OPTIONS\r\n"
+   "Via: SIP/2.0/UDP funky.example.com;branch=z9hG4bKkdjuw\r\n"
+   "l: 0\r\n"
+   "\r\n",
+};
+
+static const unsigned int corpusSize = sizeof(corpus)/sizeof(corpus[0]);
+
+// Small deterministic generator, so a failure can be reproduced.
+static unsigned int
+nextRandom(unsigned int& seed)
+{
+   seed = seed * 1103515245U + 12345U;
+   return (seed >> 16) & 0x7FFF;
+}
+
+struct ScanOutcome
+{
+   int result;             // a ScanChunkResult, or -1 if something threw
+   size_t offset;          // of *unprocessedCharPtr in the input
+   unsigned int headers;
+   Data encoded;           // the preparsed headers, if scanning ended
+
+   bool operator==(const ScanOutcome& rhs) const
+   {
+      return result == rhs.result && offset == rhs.offset &&
+             headers == rhs.headers && encoded == rhs.encoded;
+   }
+};
+
+// Feeds "text" to a scanner "chunkSize" bytes at a time, carrying the
+// unprocessed tail of each chunk over into the next the way ConnectionBase
+// does.
+static ScanOutcome
+scan(const Data& text, size_t chunkSize)
+{
+   ScanOutcome outcome;
+   SipMessage msg;
+   MsgHeaderScanner scanner;
+   scanner.prepareForMessage(&msg);
+
+   size_t pos = 0;
+   const char* carried = 0;
+   size_t carriedLength = 0;
+   for (;;)
+   {
+      size_t take = text.size() - pos < chunkSize ? text.size() - pos : chunkSize;
+      size_t length = carriedLength + take;
+      char* buffer = MsgHeaderScanner::allocateBuffer((int)length);
+      msg.addBuffer(buffer);
+      if (carriedLength)
+      {
+         memcpy(buffer, carried, carriedLength);
+      }
+      memcpy(buffer + carriedLength, text.data() + pos, take);
+      size_t base = pos - carriedLength;
+      pos += take;
+
+      char* unprocessed;
+      try
+      {
+         outcome.result = scanner.scanChunk(buffer, (unsigned int)length, &unprocessed);
+      }
+      catch (BaseException&)
+      {
+         outcome.result = -1;
+         outcome.offset = 0;
+         break;
+      }
+      outcome.offset = base + (unprocessed - buffer);
+      if (outcome.result != MsgHeaderScanner::scrNextChunk || pos == text.size())
+      {
+         break;
+      }
+      carried = unprocessed;
+      carriedLength = (buffer + length) - unprocessed;
+   }
+
+   outcome.headers = scanner.getHeaderCount();
+   if (outcome.result == MsgHeaderScanner::scrEnd)
+   {
+      try
+      {
+         DataStream str(outcome.encoded);
+         msg.encodeSipFrag(str);
+      }
+      catch (BaseException&)
+      {
+         outcome.encoded = "exception while encoding";
+      }
+   }
+   return outcome;
+}
+
+static vector<MsgHeaderScanner::ScanMode>
+supportedModes()
+{
+   vector<MsgHeaderScanner::ScanMode> modes;
+   const MsgHeaderScanner::ScanMode all[] = { MsgHeaderScanner::smScalar,
+                                              MsgHeaderScanner::smSse2,
+                                              MsgHeaderScanner::smAvx2 };
+   for (unsigned int i = 0; i < sizeof(all)/sizeof(all[0]); ++i)
+   {
+      if (MsgHeaderScanner::setScanMode(all[i]) == all[i])
+      {
+         modes.push_back(all[i]);
+      }
+   }
+   return modes;
+}
+
+static void
+checkSameInEveryMode(const vector<MsgHeaderScanner::ScanMode>& modes,
+                     const Data& text,
+                     size_t chunkSize)
+{
+   MsgHeaderScanner::setScanMode(MsgHeaderScanner::smScalar);
+   ScanOutcome expected = scan(text, chunkSize);
+   for (size_t i = 1; i < modes.size(); ++i)
+   {
+      MsgHeaderScanner::setScanMode(modes[i]);
+      ScanOutcome outcome = scan(text, chunkSize);
+      if (!(outcome == expected))
+      {
+         cerr << "Mismatch in mode " << modeNames[modes[i]] << " with chunk size "
+              << chunkSize << " on:" << endl << text.escaped() << endl
+              << "expected result=" << expected.result << " offset=" << expected.offset
+              << " headers=" << expected.headers << endl << expected.encoded << endl
+              << "got result=" << outcome.result << " offset=" << outcome.offset
+              << " headers=" << outcome.headers << endl << outcome.encoded << endl;
+         assert(0);
+      }
+   }
+}
+
+static void
+testCorpus(const vector<MsgHeaderScanner::ScanMode>& modes)
+{
+   for (unsigned int i = 0; i < corpusSize; ++i)
+   {
+      Data text(corpus[i]);
+      MsgHeaderScanner::setScanMode(MsgHeaderScanner::smScalar);
+      assert(scan(text, text.size()).result == MsgHeaderScanner::scrEnd);
+      for (size_t chunkSize = 1; chunkSize <= text.size(); chunkSize += (chunkSize < 80 ? 1 : 37))
+      {
+         checkSameInEveryMode(modes, text, chunkSize);
+      }
+   }
+}
+
+// Sprinkles characters the state machine cares about over the corpus, so
+// runs are cut short at every possible offset within a block.
+static void
+testMutations(const vector<MsgHeaderScanner::ScanMode>& modes, unsigned int rounds)
+{
+   static const char interesting[] = "\r\n \t:,\"<>\\;%()\0aZ";
+   unsigned int seed = 4475;
+   for (unsigned int round = 0; round < rounds; ++round)
+   {
+      Data text(corpus[nextRandom(seed) % corpusSize]);
+      unsigned int mutations = 1 + nextRandom(seed) % 4;
+      for (unsigned int m = 0; m < mutations; ++m)
+      {
+         size_t at = nextRandom(seed) % text.size();
+         char c = interesting[nextRandom(seed) % (sizeof(interesting) - 1)];
+         Data mutated(text.data(), at);
+         mutated += c;
+         if (nextRandom(seed) % 2)
+         {
+            ++at;   // replace rather than insert
+         }
+         mutated += Data(text.data() + at, text.size() - at);
+         text = mutated;
+      }
+      checkSameInEveryMode(modes, text, text.size());
+      checkSameInEveryMode(modes, text, 1 + nextRandom(seed) % 96);
+   }
+}
+
+static void
+benchmark(const vector<MsgHeaderScanner::ScanMode>& modes, unsigned int runs)
+{
+   Data text(corpus[0]);
+   for (size_t i = 0; i < modes.size(); ++i)
+   {
+      MsgHeaderScanner::setScanMode(modes[i]);
+      UInt64 start = Timer::getTimeMicroSec();
+      for (unsigned int run = 0; run < runs; ++run)
+      {
+         SipMessage* msg = SipMessage::make(text);
+         assert(msg);
+         delete msg;
+      }
+      UInt64 elapsed = Timer::getTimeMicroSec() - start;
+      if (elapsed == 0)
+      {
+         elapsed = 1;
+      }
+      cerr << modeNames[modes[i]] << ": " << runs << " messages (" << text.size()
+           << " bytes) preparsed in " << elapsed / 1000 << " ms, "
+           << UInt64(runs) * 1000000 / elapsed << " messages/sec" << endl;
+   }
+}
+
+int
+main(int argc, char* argv[])
+{
+   vector<MsgHeaderScanner::ScanMode> modes = supportedModes();
+   cerr << "MsgHeaderScanner modes:";
+   for (size_t i = 0; i < modes.size(); ++i)
+   {
+      cerr << " " << modeNames[modes[i]];
+   }
+   cerr << endl;
+
+   testCorpus(modes);
+   testMutations(modes, 20000);
+   if (argc > 1)
+   {
+      benchmark(modes, (unsigned int)atoi(argv[1]));
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -3158,6 +3158,46 @@ main(int arc, char** argv)
       assert(tok.param(p_encoding) == Symbols::Hex);
    }
 
+   {
+      TR _tr( "Test encode caching");
+
+      // off by default, so a Uri held across encodes is always seen
+      assert(!ParserCategory::getEncodeCaching());
+      NameAddr held("<sip:alice@atlanta.example.com>");
+      Uri& uri = held.uri();
+      held.keepEncoding();
+      uri.host() = "biloxi.example.com";
+      ASSERT_EQ(toData(held), "<sip:alice@biloxi.example.com>", "uncached");
+
+      ParserCategory::setEncodeCaching(true);
+      // encoding alone never keeps anything, even with caching on
+      Uri& heldUri = held.uri();
+      toData(held);
+      toData(held);
+      heldUri.host() = "atlanta.example.com";
+      ASSERT_EQ(toData(held), "<sip:alice@atlanta.example.com>", "encode only");
+
+      NameAddr na("\"Alice\"<sip:alice@atlanta.example.com>;tag=1928301774");
+      na.param(p_tag) = "abc";
+      ASSERT_EQ(toData(na), "\"Alice\"<sip:alice@atlanta.example.com>;tag=abc", "modified");
+      na.keepEncoding();
+      ASSERT_EQ(toData(na), "\"Alice\"<sip:alice@atlanta.example.com>;tag=abc", "kept");
+
+      // copies carry it along
+      NameAddr copy(na);
+      ASSERT_EQ(toData(copy), "\"Alice\"<sip:alice@atlanta.example.com>;tag=abc", "copy of kept");
+      assert(copy.param(p_tag) == "abc");
+
+      // modifying throws it away
+      na.param(p_tag) = "def";
+      ASSERT_EQ(toData(na), "\"Alice\"<sip:alice@atlanta.example.com>;tag=def", "modified again");
+      na.keepEncoding();
+      na.uri().host() = "biloxi.example.com";
+      ASSERT_EQ(toData(na), "\"Alice\"<sip:alice@biloxi.example.com>;tag=def", "modified uri");
+
+      ParserCategory::setEncodeCaching(false);
+   }
+
    assert(!failed);
    resipCerr << "\nTEST OK" << endl;
 
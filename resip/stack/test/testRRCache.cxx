@@ -0,0 +1,429 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "rutil/Data.hxx"
+#include "rutil/Random.hxx"
+#include "rutil/Time.hxx"
+#include "rutil/Timer.hxx"
+#include "rutil/dns/DnsHostRecord.hxx"
+#include "rutil/dns/DnsNaptrRecord.hxx"
+#include "rutil/dns/DnsSnapshot.hxx"
+#include "rutil/dns/DnsSrvRecord.hxx"
+#include "rutil/dns/QueryTypes.hxx"
+#include "rutil/dns/RRCache.hxx"
+
+using namespace resip;
+using namespace std;
+
+static DnsHostRecord
+hostRecord(const Data& name, UInt32 addr)
+{
+   in_addr a;
+   a.s_addr = htonl(addr);
+   return DnsHostRecord(name, a);
+}
+
+static bool
+found(RRCache& cache, const Data& name, int type = RR_A::getRRType())
+{
+   RRCache::Result records;
+   int status = -1;
+   bool hit = cache.lookup(name, type, RRCache::Protocol::Sip, records, status);
+   assert(!hit || status == 0);
+   return hit;
+}
+
+static void
+testBasics()
+{
+   RRCache cache;
+   cache.updateCacheFromHostFile(hostRecord("Proxy.Example.COM", 0x0a000001));
+
+   RRCache::Result records;
+   int status = -1;
+   assert(cache.lookup("proxy.example.com", RR_A::getRRType(), RRCache::Protocol::Sip, records, status));
+   assert(status == 0);
+   assert(records.size() == 1);
+   assert(records[0]->name() == "Proxy.Example.COM");
+
+   // names compare case-insensitively, types do not collide
+   assert(found(cache, "PROXY.EXAMPLE.COM"));
+   assert(!found(cache, "proxy.example.com", RR_SRV::getRRType()));
+   assert(!found(cache, "proxy.example.co"));
+   assert(!found(cache, "proxy.example.com."));
+
+   // updating the same name in a different case replaces the records
+   cache.updateCacheFromHostFile(hostRecord("proxy.EXAMPLE.com", 0x0a000002));
+   assert(cache.lookup("Proxy.Example.Com", RR_A::getRRType(), RRCache::Protocol::Sip, records, status));
+   assert(records.size() == 1);
+
+   cache.clearCache();
+   assert(!found(cache, "proxy.example.com"));
+}
+
+// Once the cache is full the least recently used entry goes first; lookups
+// and refreshes count as a use. (purge() runs as soon as an insert brings
+// the cache up to its size, so it holds size - 1 entries between inserts.)
+static void
+testLru()
+{
+   RRCache cache;
+   cache.setSize(4);
+   for (int i = 0; i < 3; ++i)
+   {
+      cache.updateCacheFromHostFile(hostRecord("host" + Data(i) + ".example.com", 0x0a000000 + i));
+   }
+   assert(found(cache, "HOST0.example.com"));
+
+   // evicts host1, the oldest entry that was not looked up since
+   cache.updateCacheFromHostFile(hostRecord("host3.example.com", 0x0a000003));
+   // refreshing host2 leaves host0 as the oldest
+   cache.updateCacheFromHostFile(hostRecord("host2.example.com", 0x0a000012));
+   cache.updateCacheFromHostFile(hostRecord("host4.example.com", 0x0a000004));
+
+   assert(!found(cache, "host0.example.com"));
+   assert(!found(cache, "host1.example.com"));
+   assert(found(cache, "host2.example.com"));
+   assert(found(cache, "host3.example.com"));
+   assert(found(cache, "host4.example.com"));
+}
+
+// Host file entries live for an hour, so a two hour prefetch window puts
+// them in it straight away.
+static void
+testPrefetch()
+{
+   RRCache cache;
+   cache.updateCacheFromHostFile(hostRecord("proxy.example.com", 0x0a000001));
+
+   RRCache::Result records;
+   int status;
+   bool refresh = true;
+   assert(cache.lookup("proxy.example.com", RR_A::getRRType(), RRCache::Protocol::Sip, records, status, refresh) == RRCache::Fresh);
+   assert(!refresh);
+
+   cache.setPrefetch(7200, 0);
+   assert(cache.lookup("proxy.example.com", RR_A::getRRType(), RRCache::Protocol::Sip, records, status, refresh) == RRCache::Expiring);
+   assert(refresh);
+   assert(records.size() == 1);
+   // only the first lookup is asked to refresh
+   assert(cache.lookup("proxy.example.com", RR_A::getRRType(), RRCache::Protocol::Sip, records, status, refresh) == RRCache::Expiring);
+   assert(!refresh);
+   assert(records.size() == 1);
+
+   // an answer coming back starts the refresh cycle over
+   cache.updateCacheFromHostFile(hostRecord("proxy.example.com", 0x0a000002));
+   assert(cache.lookup("proxy.example.com", RR_A::getRRType(), RRCache::Protocol::Sip, records, status, refresh) == RRCache::Expiring);
+   assert(refresh);
+
+   assert(cache.lookup("other.example.com", RR_A::getRRType(), RRCache::Protocol::Sip, records, status, refresh) == RRCache::Missing);
+   assert(!refresh);
+}
+
+static void
+putEntry(DnsSnapshotWriter& writer, const Data& key, int rrType, UInt32 ttl)
+{
+   writer.putData(key);
+   writer.putUInt16((UInt16)rrType);
+   writer.putUInt32(0);
+   writer.putUInt32(ttl);
+   writer.putUInt32(1);
+   writer.putData(key);
+}
+
+// The snapshot as if it had been saved secs ago: bytes 8-15 of the header
+// hold the save time, big-endian.
+static Data
+aged(const Data& snapshot, UInt64 secs)
+{
+   Data result(snapshot);
+   UInt64 savedAt = 0;
+   for (int i = 8; i < 16; ++i)
+   {
+      savedAt = (savedAt << 8) | (unsigned char)snapshot[i];
+   }
+   savedAt -= secs;
+   for (int i = 15; i >= 8; --i)
+   {
+      result[i] = (char)(savedAt & 0xff);
+      savedAt >>= 8;
+   }
+   return result;
+}
+
+static void
+checkSnapshotEntries(RRCache& cache)
+{
+   RRCache::Result records;
+   int status;
+   assert(cache.lookup("a.example.com", RR_A::getRRType(), RRCache::Protocol::Sip, records, status));
+   assert(records.size() == 1);
+   assert(ntohl(dynamic_cast<DnsHostRecord*>(records[0])->addr().s_addr) == 0x0a000001);
+
+   assert(cache.lookup("_sip._udp.example.com", RR_SRV::getRRType(), RRCache::Protocol::Sip, records, status));
+   assert(records.size() == 1);
+   DnsSrvRecord* srv = dynamic_cast<DnsSrvRecord*>(records[0]);
+   assert(srv->priority() == 10 && srv->weight() == 20 && srv->port() == 5060);
+   assert(srv->target() == "a.example.com");
+
+   assert(cache.lookup("example.com", RR_NAPTR::getRRType(), RRCache::Protocol::Sip, records, status));
+   assert(records.size() == 1);
+   DnsNaptrRecord* naptr = dynamic_cast<DnsNaptrRecord*>(records[0]);
+   assert(naptr->order() == 50 && naptr->preference() == 51);
+   assert(naptr->flags() == "s" && naptr->service() == "SIP+D2U");
+   assert(naptr->replacement() == "_sip._udp.example.com");
+
+   // saved with less TTL left than the snapshot's age
+   assert(!found(cache, "gone.example.com"));
+}
+
+static void
+testSnapshot()
+{
+   DnsSnapshotWriter writer;
+   writer.putUInt32(4);
+   putEntry(writer, "a.example.com", RR_A::getRRType(), 600);
+   in_addr addr;
+   addr.s_addr = htonl(0x0a000001);
+   writer.putBytes(&addr, sizeof(addr));
+   putEntry(writer, "gone.example.com", RR_A::getRRType(), 50);
+   writer.putBytes(&addr, sizeof(addr));
+   putEntry(writer, "_sip._udp.example.com", RR_SRV::getRRType(), 600);
+   writer.putUInt16(10);
+   writer.putUInt16(20);
+   writer.putUInt16(5060);
+   writer.putData("a.example.com");
+   putEntry(writer, "example.com", RR_NAPTR::getRRType(), 600);
+   writer.putUInt16(50);
+   writer.putUInt16(51);
+   writer.putData("s");
+   writer.putData("SIP+D2U");
+   writer.putData("");
+   writer.putData("");
+   writer.putData("_sip._udp.example.com");
+
+   RRCache cache;
+   DnsSnapshotReader reader;
+   assert(reader.parse(aged(writer.snapshot(), 100)));
+   assert(reader.age() >= 100 && reader.age() < 110);
+   assert(cache.decodeSnapshot(reader) == 3);
+   assert(reader.ok() && reader.atEnd());
+   checkSnapshotEntries(cache);
+
+   // what a cache saves, another one loads, through a file
+   DnsSnapshotWriter saved;
+   cache.encodeSnapshot(saved);
+   const Data filename("testRRCache.snapshot");
+   assert(saved.save(filename));
+   RRCache reloaded;
+   DnsSnapshotReader fileReader;
+   assert(fileReader.load(filename));
+   remove(filename.c_str());
+   assert(reloaded.decodeSnapshot(fileReader) == 3);
+   assert(fileReader.atEnd());
+   checkSnapshotEntries(reloaded);
+
+   // entries resolved since startup are newer than the snapshot's
+   RRCache live;
+   live.updateCacheFromHostFile(hostRecord("a.example.com", 0x0a000002));
+   DnsSnapshotReader again;
+   assert(again.parse(saved.snapshot()));
+   assert(live.decodeSnapshot(again) == 2);
+   RRCache::Result records;
+   int status;
+   assert(live.lookup("a.example.com", RR_A::getRRType(), RRCache::Protocol::Sip, records, status));
+   assert(ntohl(dynamic_cast<DnsHostRecord*>(records[0])->addr().s_addr) == 0x0a000002);
+
+   // truncation and foreign files are caught rather than misread
+   DnsSnapshotReader truncated;
+   assert(truncated.parse(saved.snapshot().substr(0, saved.snapshot().size() - 3)));
+   RRCache partial;
+   partial.decodeSnapshot(truncated);
+   assert(!truncated.ok());
+   DnsSnapshotReader foreign;
+   assert(!foreign.parse("not a snapshot at all"));
+   DnsSnapshotReader missing;
+   assert(!missing.load("testRRCache.nonexistent"));
+}
+
+// Entries past their TTL are served as Stale, and refreshed, during the
+// grace period.
+static void
+testStaleGrace()
+{
+   // the only way in for an entry with a TTL this short is a snapshot
+   DnsSnapshotWriter writer;
+   writer.putUInt32(2);
+   in_addr addr;
+   addr.s_addr = htonl(0x0a000001);
+   putEntry(writer, "stale.example.com", RR_A::getRRType(), 2);
+   writer.putBytes(&addr, sizeof(addr));
+   putEntry(writer, "dead.example.com", RR_A::getRRType(), 2);
+   writer.putBytes(&addr, sizeof(addr));
+
+   RRCache cache;
+   cache.setPrefetch(0, 3600);
+   DnsSnapshotReader reader;
+   assert(reader.parse(writer.snapshot()));
+   assert(cache.decodeSnapshot(reader) == 2);
+
+   RRCache::Result records;
+   int status;
+   bool refresh = true;
+   RRCache::Freshness freshness = RRCache::Fresh;
+   for (int i = 0; i < 50 && freshness == RRCache::Fresh; ++i)
+   {
+      sleepMs(100);
+      freshness = cache.lookup("stale.example.com", RR_A::getRRType(), RRCache::Protocol::Sip, records, status, refresh);
+   }
+
+   // past its TTL, the old answer is still served, and one lookup is asked
+   // to refresh it
+   assert(freshness == RRCache::Stale);
+   assert(refresh);
+   assert(records.size() == 1);
+   assert(ntohl(dynamic_cast<DnsHostRecord*>(records[0])->addr().s_addr) == 0x0a000001);
+   assert(cache.lookup("stale.example.com", RR_A::getRRType(), RRCache::Protocol::Sip, records, status, refresh) == RRCache::Stale);
+   assert(!refresh);
+   assert(records.size() == 1);
+
+   // the refreshed answer replaces it
+   cache.updateCacheFromHostFile(hostRecord("stale.example.com", 0x0a000002));
+   assert(cache.lookup("stale.example.com", RR_A::getRRType(), RRCache::Protocol::Sip, records, status, refresh) == RRCache::Fresh);
+   assert(!refresh);
+   assert(records.size() == 1);
+   assert(ntohl(dynamic_cast<DnsHostRecord*>(records[0])->addr().s_addr) == 0x0a000002);
+
+   // without a grace period, an expired entry is gone
+   cache.setPrefetch(0, 0);
+   assert(cache.lookup("dead.example.com", RR_A::getRRType(), RRCache::Protocol::Sip, records, status, refresh) == RRCache::Missing);
+   assert(records.empty());
+   assert(!found(cache, "dead.example.com"));
+}
+
+static Data
+mixCase(const Data& name)
+{
+   Data mixed(name);
+   char* p = const_cast<char*>(mixed.data());
+   for (Data::size_type i = 0; i < mixed.size(); i += 2)
+   {
+      if (p[i] >= 'a' && p[i] <= 'z')
+      {
+         p[i] -= 'a' - 'A';
+      }
+   }
+   return mixed;
+}
+
+// Lookup rate with count cached names; only run when a count is given on
+// the command line.
+static void
+benchmark(size_t count)
+{
+   vector<Data> names;
+   vector<Data> probes;
+   names.reserve(count);
+   for (size_t i = 0; i < count; ++i)
+   {
+      // shaped like the SRV/host names an outbound proxy resolves
+      names.push_back("_sip._udp.gw" + Data((UInt64)i) + "." + Random::getRandomHex(4) + ".carrier.example.net");
+   }
+   probes.reserve(count);
+   for (size_t i = 0; i < count; ++i)
+   {
+      probes.push_back(mixCase(names[size_t(Random::getRandom()) % count]));
+   }
+
+   RRCache cache;
+   cache.setSize(int(count + 1));
+   for (size_t i = 0; i < count; ++i)
+   {
+      cache.updateCacheFromHostFile(hostRecord(names[i], UInt32(i)));
+   }
+   RRCache::Result records;
+   int status;
+   size_t hits = 0;
+   UInt64 start = Timer::getTimeMs();
+   for (size_t i = 0; i < count; ++i)
+   {
+      hits += cache.lookup(probes[i], RR_A::getRRType(), RRCache::Protocol::Sip, records, status);
+   }
+   UInt64 elapsed = Timer::getTimeMs() - start;
+   assert(hits == count);
+
+   cerr << count << " lookups among " << count << " cached names in " << elapsed << " ms" << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+   Random::initialize();
+
+   testBasics();
+   testLru();
+   testPrefetch();
+   testSnapshot();
+   testStaleGrace();
+
+   if (argc > 1)
+   {
+      benchmark(size_t(atol(argv[1])));
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
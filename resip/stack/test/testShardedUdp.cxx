@@ -0,0 +1,226 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "resip/stack/SendData.hxx"
+#include "resip/stack/ShardedUdpTransport.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Socket.hxx"
+#include "rutil/Timer.hxx"
+
+#ifndef WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#endif
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+class CountingLogger : public Transport::SipMessageLoggingHandler
+{
+   public:
+      CountingLogger() : mInbound(0), mOutbound(0) {}
+
+      virtual void outboundMessage(const Tuple& source, const Tuple& destination, const SipMessage& msg)
+      {
+         ++mOutbound;
+      }
+      virtual void inboundMessage(const Tuple& source, const Tuple& destination, const SipMessage& msg)
+      {
+         ++mInbound;
+      }
+
+      std::atomic<int> mInbound;
+      std::atomic<int> mOutbound;
+};
+
+static Data
+request(int client, int i)
+{
+   Data branch("z9hG4bK-" + Data(client) + "-" + Data(i));
+   return "OPTIONS sip:proxy@127.0.0.1 SIP/2.0\r\n"
+          "Via: SIP/2.0/UDP 127.0.0.1:5999;branch=" + branch + "\r\n"
+          "Max-Forwards: 70\r\n"
+          "To: <sip:proxy@127.0.0.1>\r\n"
+          "From: <sip:client" + Data(client) + "@127.0.0.1>;tag=" + Data(client) + "\r\n"
+          "Call-ID: " + branch + "\r\n"
+          "CSeq: " + Data(i + 1) + " OPTIONS\r\n"
+          "Content-Length: 0\r\n"
+          "\r\n";
+}
+
+// Clients on distinct source ports, so the kernel spreads them over the
+// shards. Each round waits for the last, to stay clear of the socket
+// buffers.
+static void
+testReceive(ShardedUdpTransport& transport, Fifo<TransactionMessage>& fifo,
+            vector<Socket>& clients, int rounds)
+{
+   Tuple dest("127.0.0.1", transport.port(), V4, UDP);
+   set<Data> callIds;
+   for (int i = 0; i < rounds; ++i)
+   {
+      for (size_t c = 0; c < clients.size(); ++c)
+      {
+         Data msg(request(int(c), i));
+         int n = ::sendto(clients[c], msg.data(), msg.size(), 0, &dest.getSockaddr(), dest.length());
+         assert(n == int(msg.size()));
+      }
+
+      UInt64 deadline = Timer::getTimeMs() + 5000;
+      while (callIds.size() < clients.size() * (i + 1) && Timer::getTimeMs() < deadline)
+      {
+         unique_ptr<TransactionMessage> msg(fifo.getNext(100));
+         SipMessage* sip = dynamic_cast<SipMessage*>(msg.get());
+         if (sip)
+         {
+            // whichever shard read it, it belongs to the sharded transport
+            assert(sip->getReceivedTransportTuple().mTransportKey == transport.getKey());
+            assert(sip->getReceivedTransportTuple().getPort() == transport.port());
+            assert(callIds.insert(sip->header(h_CallId).value()).second);
+         }
+      }
+      assert(callIds.size() == clients.size() * (i + 1));
+   }
+}
+
+static void
+testSend(ShardedUdpTransport& transport, vector<Socket>& clients)
+{
+   for (size_t c = 0; c < clients.size(); ++c)
+   {
+      sockaddr_in local;
+      socklen_t len = sizeof(local);
+      int ret = ::getsockname(clients[c], (sockaddr*)&local, &len);
+      assert(ret == 0);
+      Tuple dest((const sockaddr&)local, UDP);
+      transport.send(transport.makeSendData(dest, request(int(c), 1000), Data(int(c))));
+   }
+
+   for (size_t c = 0; c < clients.size(); ++c)
+   {
+      pollfd pfd;
+      pfd.fd = clients[c];
+      pfd.events = POLLIN;
+      assert(::poll(&pfd, 1, 5000) == 1);
+      char buf[4096];
+      int n = ::recv(clients[c], buf, sizeof(buf), 0);
+      assert(n > 0);
+      assert(Data(buf, n) == request(int(c), 1000));
+   }
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cerr, Log::Err, argv[0]);
+
+   const unsigned shards = 4;
+   const int numClients = 32;
+   const int rounds = 20;
+
+   Fifo<TransactionMessage> fifo;
+   ShardedUdpTransport transport(fifo, 0, V4, StunDisabled, "127.0.0.1", shards,
+                                 0, Compression::Disabled, 0, 8);
+   assert(transport.getNumShards() == shards);
+   assert(transport.port() != 0);
+   transport.setKey(7);
+
+   std::shared_ptr<CountingLogger> early = std::make_shared<CountingLogger>();
+   transport.setSipMessageLoggingHandler(early);
+   transport.startOwnProcessing();
+
+   vector<Socket> clients;
+   for (int c = 0; c < numClients; ++c)
+   {
+      Socket fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+      assert(fd != INVALID_SOCKET);
+      Tuple any("127.0.0.1", 0, V4, UDP);
+      int ret = ::bind(fd, &any.getSockaddr(), any.length());
+      assert(ret == 0);
+      clients.push_back(fd);
+   }
+
+   testReceive(transport, fifo, clients, rounds);
+   assert(early->mInbound == numClients * rounds);
+
+   // a handler set once the shards are running reaches them too
+   std::shared_ptr<CountingLogger> late = std::make_shared<CountingLogger>();
+   transport.setSipMessageLoggingHandler(late);
+   testReceive(transport, fifo, clients, 1);
+   assert(late->mInbound == numClients);
+   assert(early->mInbound == numClients * rounds);
+
+   testSend(transport, clients);
+
+   for (vector<Socket>::iterator it = clients.begin(); it != clients.end(); ++it)
+   {
+      closeSocket(*it);
+   }
+   transport.shutdown();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -4,6 +4,11 @@
 
 
 #include "resip/stack/SipMessage.hxx"
+#include "resip/stack/GatherStream.hxx"
+#include "resip/stack/SendData.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/Timer.hxx"
+#include <cassert>
 #include <fstream>
 #include <string>
 
@@ -14,16 +19,109 @@ class Args
 {
 public:
 
-	Args(void):runs(100000),runFs(false),runDs(true)
+	Args(void):runs(100000),runFs(false),runDs(true),runGs(true),runRs(true)
 	{}
 
 	int runs;
 	bool runFs;
 	bool runDs;
+	bool runGs;
+	bool runRs;
 };
 
 void processArgs(int argc, char* argv[],Args &args);
 
+// What a proxy does with a request: copy it, touch a header, encode the
+// copy for the wire.
+static void
+encodeCopy(const SipMessage& msg, SendData& out, bool gathered)
+{
+	SipMessage copy(msg);
+	copy.header(h_MaxForwards).value()--;
+	if (gathered)
+	{
+		GatherStream str(out);
+		copy.encodeGathered(str);
+	}
+	else
+	{
+		DataStream str(out.data);
+		copy.encode(str);
+	}
+}
+
+// What a proxy does to a request before forwarding it. Every header it
+// touches through a non-const accessor is re-encoded from its parsed form
+// when sent, until the encode cache kicks in.
+static SipMessage*
+forward(const SipMessage& msg)
+{
+	SipMessage* fwd = new SipMessage(msg);
+	Via via;
+	via.sentHost() = "proxy.example.com";
+	via.sentPort() = 5060;
+	via.param(p_branch).reset("c87542-forwarded-1");
+	fwd->header(h_Vias).push_front(via);
+	fwd->header(h_MaxForwards).value()--;
+	fwd->header(h_RecordRoutes).push_front(NameAddr("<sip:proxy.example.com;lr>"));
+	fwd->header(h_RequestLine).uri().host();
+	fwd->header(h_To).uri().host();
+	fwd->header(h_From).param(p_tag);
+	fwd->header(h_CSeq).sequence();
+	fwd->header(h_Contacts).front().uri().host();
+	return fwd;
+}
+
+// A gathered encode must produce the same bytes as a plain one, and must
+// stay valid after the messages it was made from are gone.
+static void
+checkGathered(const Data& txt)
+{
+	SipMessage* msg = SipMessage::make(txt);
+	assert(msg);
+
+	SendData plain(Tuple(), Data::Empty, Data::Empty, Data::Empty);
+	encodeCopy(*msg, plain, false);
+	assert(!plain.isGathered());
+
+	SendData gathered(Tuple(), Data::Empty, Data::Empty, Data::Empty);
+	encodeCopy(*msg, gathered, true);
+	assert(gathered.isGathered());
+	assert(gathered.pieces.size() <= SendData::MaxPieces);
+	assert(gathered.size() == plain.data.size());
+
+	size_t raw = 0;
+	for (std::vector<SendData::Piece>::const_iterator i = gathered.pieces.begin();
+	     i != gathered.pieces.end(); ++i)
+	{
+		raw += i->raw ? i->length : 0;
+	}
+	assert(raw > 0 && raw + gathered.data.size() == plain.data.size());
+	cout << "\r\nGathered encode: " << gathered.pieces.size() << " pieces, "
+	     << raw << " of " << plain.data.size() << " bytes not copied\r\n";
+
+	// a clone (what a retransmission holds) shares the received buffers too
+	SendData* clone = gathered.clone();
+	delete msg;
+	gathered.flatten();
+	assert(!gathered.isGathered());
+	assert(gathered.data == plain.data);
+	clone->flatten();
+	assert(clone->data == plain.data);
+	delete clone;
+
+	// the original is unparsed at this point; parsing it afterwards must
+	// not disturb what a copy sent
+	msg = SipMessage::make(txt);
+	SendData before(Tuple(), Data::Empty, Data::Empty, Data::Empty);
+	encodeCopy(*msg, before, true);
+	msg->header(h_Vias).front().param(p_branch).reset("z9hG4bK-changed");
+	msg->header(h_To).uri().user() = "someone-else";
+	delete msg;
+	before.flatten();
+	assert(before.data == plain.data);
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -31,7 +129,7 @@ main(int argc, char* argv[])
 
 	cout << "\r\n------------------------------------------------------\r\n";
 	cout << "Resiprocate resip::SipMessage encoder speed test rev 1.0\r\n";
-	cout << "Args: [-r <number of runs>] [-runfs=(yes|no)] [-runds=(yes|no)]\r\n";
+	cout << "Args: [-r <number of runs>] [-runfs=(yes|no)] [-runds=(yes|no)] [-rungs=(yes|no)] [-runrs=(yes|no)]\r\n";
 	cout << "Example: -r 100000 -runfs=yes -runds=no\r\n";
 	cout << "------------------------------------------------------------\r\n";
 
@@ -127,6 +225,80 @@ main(int argc, char* argv[])
 		cout << "\r\nOutput to resip::DataStream completed, elapsed time= " << secs << " seconds.\r\n";
 	}
 
+	if( args.runGs )
+	{
+		checkGathered(txt);
+
+		SendData out(Tuple(), Data::Empty, Data::Empty, Data::Empty);
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			bool gathered = (pass == 1);
+			cout << "\r\nCopy and encode to " << (gathered ? "GatherStream" : "DataStream")
+			     << ", runs = " << args.runs << ", ...\r\n";
+			startTime = Timer::getTimeMs();
+			for(int i=0; i<args.runs; i++)
+			{
+				encodeCopy(*msg, out, gathered);
+				out.clear();
+			}
+			elapsed = Timer::getTimeMs() - startTime;
+			secs = ((double) elapsed / 1000.0);
+			cout << "\r\nCopy and encode to " << (gathered ? "GatherStream" : "DataStream")
+			     << " completed, elapsed time= " << secs << " seconds, "
+			     << (elapsed ? (UInt64)args.runs * 1000 / elapsed : 0) << " msgs/sec.\r\n";
+		}
+	}
+
+	if( args.runRs )
+	{
+		Data first;
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			bool cached = (pass == 1);
+			ParserCategory::setEncodeCaching(cached);
+			SipMessage* fwd = forward(*msg);
+			fwd->keepHeaderEncodings();
+			Data data;
+
+			cout << "\r\nRe-encode forwarded INVITE, header cache " << (cached ? "on" : "off")
+			     << ", runs = " << args.runs << ", ...\r\n";
+			startTime = Timer::getTimeMs();
+			for(int i=0; i<args.runs; i++)
+			{
+				data.clear();
+				DataStream resipStr(data);
+				fwd->encode(resipStr);
+			}
+			elapsed = Timer::getTimeMs() - startTime;
+			secs = ((double) elapsed / 1000.0);
+			cout << "\r\nRe-encode forwarded INVITE, header cache " << (cached ? "on" : "off")
+			     << " completed, elapsed time= " << secs << " seconds, "
+			     << (elapsed ? (UInt64)args.runs * 1000 / elapsed : 0) << " encodes/sec.\r\n";
+
+			// the cache must not change a byte, and must not outlive a change
+			if (cached)
+			{
+				assert(data == first);
+				fwd->header(h_MaxForwards).value()--;
+				data.clear();
+				{
+					DataStream resipStr(data);
+					fwd->encode(resipStr);
+				}
+				assert(data != first);
+				assert(data.find("Max-Forwards: 67\r\n") != Data::npos);
+			}
+			else
+			{
+				first = data;
+			}
+			delete fwd;
+		}
+		ParserCategory::setEncodeCaching(false);
+	}
+
+	delete msg;
+
 	cout << "Test complete.\r\n";
 
 	return 0;
@@ -170,6 +342,14 @@ void processArgs(int argc, char* argv[],Args &args)
 				args.runFs = false;
 			}
 		}
+		else if( arg.substr(0,7) == "-rungs=" )
+		{
+			args.runGs = (arg.substr(7) == "yes");
+		}
+		else if( arg.substr(0,7) == "-runrs=" )
+		{
+			args.runRs = (arg.substr(7) == "yes");
+		}
 		else if( arg.substr(0,7) == "-runds=" )
 		{
 			if( arg.substr(7) == "yes" )
@@ -1,16 +1,199 @@
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/Uri.hxx"
 #include "resip/stack/test/TestSupport.hxx"
+#include "rutil/ArenaPool.hxx"
 
+#include <cstdlib>
 #include <iostream>
 #include <memory>
+#include <new>
 
 using namespace resip;
 using namespace std;
 
+// Counts every heap allocation made by the process (the libraries 
+// included) while sCounting is set.
+static bool sCounting = false;
+static size_t sAllocations = 0;
+static size_t sAllocatedBytes = 0;
+
+void*
+operator new(size_t size)
+{
+   if (sCounting)
+   {
+      ++sAllocations;
+      sAllocatedBytes += size;
+   }
+   void* ptr = malloc(size ? size : 1);
+   if (!ptr)
+   {
+      throw std::bad_alloc();
+   }
+   return ptr;
+}
+
+void*
+operator new[](size_t size)
+{
+   return operator new(size);
+}
+
+void
+operator delete(void* ptr) noexcept
+{
+   free(ptr);
+}
+
+void
+operator delete[](void* ptr) noexcept
+{
+   free(ptr);
+}
+
+static void
+testArenaPool()
+{
+   resipCerr << "Testing ArenaPool" << endl;
+
+   ArenaPool::Profile profile(1024, 4096, 8192);
+   {
+      InlineArenaPool<64> pool(profile);
+      void* first = pool.allocate(60);
+      assert(pool.getPoolBytes() == 64);
+      assert(pool.getHeapBytes() == 0);
+      pool.deallocate(first);
+
+      // spills into a block of the minimum size
+      char* block = static_cast<char*>(pool.allocate(100));
+      assert(pool.getBlockCount() == 1);
+      assert(pool.getHeapBytes() == 1024);
+      char* next = static_cast<char*>(pool.allocate(8));
+      assert(next == block + 104);
+      pool.deallocate(block);
+
+      // later blocks double, up to the heap cap
+      pool.allocate(1000);
+      assert(pool.getBlockCount() == 2);
+      assert(pool.getHeapBytes() == 1024 + 2048);
+      pool.allocate(3000);
+      assert(pool.getBlockCount() == 3);
+      assert(pool.getHeapBytes() == 1024 + 2048 + 4096);
+      pool.allocate(1000);
+      assert(pool.getBlockCount() == 3);
+      // the last block only gets what is left under the cap
+      pool.allocate(1024);
+      assert(pool.getBlockCount() == 4);
+      assert(pool.getHeapBytes() == 8192);
+
+      // past the cap, objects come from the heap one by one
+      void* fallback = pool.allocate(16);
+      assert(pool.getBlockCount() == 4);
+      assert(pool.getHeapBytes() == 8192 + 16);
+      pool.deallocate(fallback);
+   }
+   // the next arena starts with a block sized for what this one needed
+   assert(profile.getAverageSpill() > 0);
+   assert(profile.getBlockSize() == 4096);
+
+   profile.setEnabled(false);
+   {
+      InlineArenaPool<64> pool(profile);
+      void* ptr = pool.allocate(100);
+      assert(pool.getBlockCount() == 0);
+      assert(pool.getHeapBytes() == 104);
+      pool.deallocate(ptr);
+   }
+}
+
+static size_t
+countAllocations(bool arena)
+{
+   // A typical INVITE from a UA, a little bigger than the inline part of
+   // the arena once the usual headers have been parsed.
+   const char* txt = "INVITE sip:bob@biloxi.example.com SIP/2.0\r\n"
+                     "Via: SIP/2.0/UDP pc33.atlanta.example.com;branch=z9hG4bK776asdhds;rport\r\n"
+                     "Via: SIP/2.0/UDP p1.example.com;branch=z9hG4bK1234;received=192.0.2.1\r\n"
+                     "Max-Forwards: 70\r\n"
+                     "To: Bob <sip:bob@biloxi.example.com>\r\n"
+                     "From: Alice <sip:alice@atlanta.example.com>;tag=1928301774\r\n"
+                     "Call-ID: a84b4c76e66710@pc33.atlanta.example.com\r\n"
+                     "CSeq: 314159 INVITE\r\n"
+                     "Contact: <sip:alice@pc33.atlanta.example.com>\r\n"
+                     "Record-Route: <sip:p1.example.com;lr>\r\n"
+                     "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE\r\n"
+                     "Supported: replaces, timer\r\n"
+                     "Content-Type: application/sdp\r\n"
+                     "Content-Length: 149\r\n"
+                     "\r\n"
+                     "v=0\r\n"
+                     "o=alice 2890844526 2890844526 IN IP4 pc33.atlanta.example.com\r\n"
+                     "s=-\r\n"
+                     "c=IN IP4 192.0.2.101\r\n"
+                     "t=0 0\r\n"
+                     "m=audio 49172 RTP/AVP 0\r\n"
+                     "a=rtpmap:0 PCMU/8000\r\n";
+   const Data data(txt);
+   const int messages = 1000;
+
+   SipMessage::getArenaProfile().setEnabled(arena);
+
+   size_t parse = 0;
+   size_t contents = 0;
+   sAllocations = 0;
+   sAllocatedBytes = 0;
+   for (int i = 0; i < messages; ++i)
+   {
+      sCounting = true;
+      size_t before = sAllocations;
+      unique_ptr<SipMessage> msg(SipMessage::make(data));
+      assert(msg->header(h_Vias).front().param(p_branch).getTransactionId() == "776asdhds");
+      assert(msg->header(h_Vias).back().sentHost() == "p1.example.com");
+      assert(msg->header(h_To).uri().host() == "biloxi.example.com");
+      assert(msg->header(h_From).param(p_tag) == "1928301774");
+      assert(!msg->header(h_CallId).value().empty());
+      assert(msg->header(h_CSeq).sequence() == 314159);
+      assert(msg->header(h_Contacts).front().uri().user() == "alice");
+      assert(msg->header(h_RecordRoutes).front().uri().exists(p_lr));
+      assert(msg->header(h_MaxForwards).value() == 70);
+      assert(msg->header(h_Allows).size() == 5);
+      assert(msg->header(h_Supporteds).size() == 2);
+      assert(msg->header(h_RequestLine).uri().user() == "bob");
+      parse += sAllocations - before;
+
+      before = sAllocations;
+      assert(msg->getContents());
+      contents += sAllocations - before;
+
+      msg.reset();
+      sCounting = false;
+   }
+
+   resipCerr << "Arena " << (arena ? "enabled" : "disabled") << ": "
+             << double(parse) / messages << " allocations per message to parse headers, "
+             << double(contents) / messages << " more to parse the body, "
+             << sAllocatedBytes / messages << " bytes per message in all" << endl;
+
+   SipMessage::getArenaProfile().setEnabled(true);
+   return parse;
+}
+
+static void
+testAllocationCounts()
+{
+   resipCerr << "Counting allocations per message" << endl;
+
+   const size_t without = countAllocations(false);
+   const size_t with = countAllocations(true);
+   assert(with < without);
+}
+
 int
 main()
 {
+   testArenaPool();
+   testAllocationCounts();
+
    {
       const char *txt1 = "REGISTER sip:registrar.biloxi.com SIP/2.0\r\nVia: SIP/2.0/UDP bobspc.biloxi.com:5060;branch=z9hG4bKnashds7\r\nMax-Forwards: 70\r\nTo: Bob <sip:bob@biloxi.com>\r\nFrom: Bob <sip:bob@biloxi.com>;tag=456248\r\nCall-ID: 843817637684230@998sdasdh09\r\nCSeq: 1826 REGISTER\r\nContact: <sip:bob@192.0.2.4>\r\nExpires: 7200\r\nContent-Length: 0\r\n\r\n";
 
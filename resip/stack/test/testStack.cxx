@@ -11,6 +11,7 @@
 #endif
 
 #include <sys/types.h>
+#include <atomic>
 #include <iostream>
 #include <memory>
 
@@ -22,6 +23,7 @@
 #include "resip/stack/Helper.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/SipStack.hxx"
+#include "resip/stack/StatisticsMessage.hxx"
 #include "resip/stack/StackThread.hxx"
 #include "rutil/SelectInterruptor.hxx"
 #include "resip/stack/TransportThread.hxx"
@@ -155,7 +157,9 @@ class SipStackAndThread
    public:
       SipStackAndThread(const char *tType,
         AsyncProcessHandler *notifyDn=0,
-        AsyncProcessHandler *notifyUp=0);
+        AsyncProcessHandler *notifyUp=0,
+        unsigned int tcShards=1,
+        bool gathered=false);
          ~SipStackAndThread() {
          destroy();
       }
@@ -203,7 +207,8 @@ class SipStackAndThread
 
 
 SipStackAndThread::SipStackAndThread(const char *tType,
- AsyncProcessHandler *notifyDn, AsyncProcessHandler *notifyUp)
+ AsyncProcessHandler *notifyDn, AsyncProcessHandler *notifyUp,
+ unsigned int tcShards, bool gathered)
   : mStack(0), 
       mThread(0), 
       mSelIntr(0), 
@@ -249,6 +254,8 @@ SipStackAndThread::SipStackAndThread(const char *tType,
    options.mAsyncProcessHandler = mEventIntr?mEventIntr
       :(mSelIntr?mSelIntr:notifyDn);
    options.mPollGrp = mPollGrp;
+   options.mTransactionControllerShards = tcShards;
+   options.mGatheredEncoding = gathered;
    mStack = new SipStack(options);
    
    mStack->setFallbackPostNotify(notifyUp);
@@ -588,6 +595,90 @@ performTest(int verbose, int runs, int window, int invite,
    }
 }
 
+// Catches the payload a requested poll publishes, and wakes up the test.
+class StatisticsCatcher : public ExternalStatsHandler
+{
+   public:
+      StatisticsCatcher(StatisticsMessage::Payload& payload, AsyncProcessHandler& notify)
+         : mPayload(payload), mNotify(notify), mCaught(false)
+      {
+      }
+
+      virtual bool operator()(StatisticsMessage& statsMessage)
+      {
+         if (!statsMessage.isRequested())
+         {
+            // a periodic poll, not the one asked for
+            return false;
+         }
+         statsMessage.loadOut(mPayload);
+         mCaught = true;
+         mNotify.handleProcessNotification();
+         return false;
+      }
+
+      StatisticsMessage::Payload& mPayload;
+      AsyncProcessHandler& mNotify;
+      std::atomic<bool> mCaught;
+};
+
+static void
+pollStatistics(SipStackAndThread& stack, StackThreadPair& pair,
+               StatisticsMessage::Payload& payload)
+{
+   StatisticsCatcher catcher(payload, pair.mSharedUp);
+   stack->setExternalStatsHandler(&catcher);
+   stack->pollStatistics();
+   while (!catcher.mCaught)
+   {
+      int thisseltime;
+      pair.wait(thisseltime);
+      // wait() does nothing while the TUs have messages, and whatever
+      // performTest() left behind is of no further interest
+      Message* msg;
+      while ((msg = pair.mReceiver->receiveAny()) != 0 ||
+             (msg = pair.mSender->receiveAny()) != 0)
+      {
+         delete msg;
+      }
+   }
+   stack->setExternalStatsHandler(0);
+}
+
+// Every transaction performTest() ran should have been counted, whichever
+// TransactionController shard handled it.
+static void
+checkStatistics(int verbose, int runs, int invite, StackThreadPair& pair)
+{
+   MethodTypes method = invite ? INVITE : REGISTER;
+   std::unique_ptr<StatisticsMessage::Payload> stats(new StatisticsMessage::Payload);
+
+   pollStatistics(pair.mSender, pair, *stats);
+   if (verbose)
+   {
+      cout << "Sender statistics: " << *stats << endl;
+   }
+   assert(stats->requestsSentByMethod[method] >= (unsigned int)runs);
+   assert(stats->responsesReceivedByMethodByCode[method][200] >= (unsigned int)runs);
+   assert(stats->responseTimeByMethod[method].count() == (UInt64)runs);
+   assert(stats->transactionSetupTime.count() >= (UInt64)runs);
+   assert(stats->responseTimeByMethod[method].valueAtPercentile(50) > 0);
+
+   pollStatistics(pair.mReceiver, pair, *stats);
+   if (verbose)
+   {
+      cout << "Receiver statistics: " << *stats << endl;
+   }
+   assert(stats->requestsReceivedByMethod[method] >= (unsigned int)runs);
+   assert(stats->fifoDwellTime.count() >= (UInt64)runs);
+   assert(stats->responseTimeByMethod[method].count() == 0);
+
+   pair.mSender->zeroOutStatistics();
+   pollStatistics(pair.mSender, pair, *stats);
+   assert(stats->requestsSent == 0);
+   assert(stats->responseTimeByMethod[method].count() == 0);
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -611,6 +702,8 @@ main(int argc, char* argv[])
    int sendSleepMs = 0;
    int cManager=0;
    int statisticsInterval=60;
+   int tcShards=1;
+   int gathered=0;
 
 #if defined(HAVE_POPT_H)
 
@@ -637,6 +730,8 @@ main(int argc, char* argv[])
       {"sleep",       0,   POPT_ARG_INT,    &sendSleepMs,0, "time (ms) to sleep after each sent request", 0},
       {"use-congestion-manager",0, POPT_ARG_NONE, &cManager ,   0, "use a CongestionManager", 0},
       {"statistics-interval",       0,   POPT_ARG_INT,    &statisticsInterval,0, "time in seconds between statistics logging", 0},
+      {"tc-shards",   0,   POPT_ARG_INT,    &tcShards,  0, "number of TransactionController shards per stack", 0},
+      {"gathered",    0,   POPT_ARG_NONE,   &gathered,  0, "encode for gathered sends (udp)", 0},
       POPT_AUTOHELP
       { NULL, 0, 0, NULL, 0 }
    };
@@ -663,6 +758,8 @@ main(int argc, char* argv[])
      <<" bindIf="<<bindIfAddr
      <<" listen="<<doListen
      <<" tf="<<tpFlags
+     <<" tcShards="<<tcShards
+     <<" gathered="<<gathered
      <<"." << endl;
 
    const char *eachThreadType = threadType;
@@ -695,8 +792,8 @@ main(int argc, char* argv[])
    {
       notifyUp = &sharedUp;
    }
-   SipStackAndThread receiver(eachThreadType, commonIntr, notifyUp);
-   SipStackAndThread sender(eachThreadType, commonIntr, notifyUp);
+   SipStackAndThread receiver(eachThreadType, commonIntr, notifyUp, tcShards, gathered!=0);
+   SipStackAndThread sender(eachThreadType, commonIntr, notifyUp, tcShards, gathered!=0);
    receiver.getStack().setStatisticsInterval(statisticsInterval);
    sender.getStack().setStatisticsInterval(statisticsInterval);
 
@@ -808,6 +905,7 @@ main(int argc, char* argv[])
    performTest(verbose, runs, window, invite,
       bindIfAddr, numPorts, senderPort, registrarPort, proto,
       sendSleepMs, pair);
+   checkStatistics(verbose, runs, invite, pair);
 
    sender.shutdown();
    receiver.shutdown();
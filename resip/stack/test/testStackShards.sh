@@ -0,0 +1,8 @@
+#!/bin/sh
+
+# Runs the default testStack REGISTER test with the TransactionController
+# split into several shards. Used from "make check".
+
+set -e
+
+exec ./testStack --tc-shards 4
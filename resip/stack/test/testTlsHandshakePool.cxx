@@ -0,0 +1,280 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <signal.h>
+#include <vector>
+
+#include "resip/stack/SendData.hxx"
+#include "resip/stack/Symbols.hxx"
+#include "resip/stack/ssl/Security.hxx"
+#include "resip/stack/ssl/TlsTransport.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/FdPoll.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Socket.hxx"
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/x509v3.h>
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+static const Data certFile("testTlsHandshakePool_cert.pem");
+static const Data keyFile("testTlsHandshakePool_key.pem");
+
+static const int Clients = 8;
+
+// Writes a self-signed certificate and key for localhost, and returns
+// the certificate PEM so it can be trusted as a root.
+static Data
+makeCertificate()
+{
+   EVP_PKEY* pkey = 0;
+   EVP_PKEY_CTX* keyCtx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, 0);
+   assert(keyCtx);
+   assert(EVP_PKEY_keygen_init(keyCtx) > 0);
+   assert(EVP_PKEY_CTX_set_rsa_keygen_bits(keyCtx, 2048) > 0);
+   assert(EVP_PKEY_keygen(keyCtx, &pkey) > 0);
+   EVP_PKEY_CTX_free(keyCtx);
+
+   X509* cert = X509_new();
+   X509_set_version(cert, 2);
+   ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+   X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+   X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+   X509_set_pubkey(cert, pkey);
+   X509_NAME* name = X509_get_subject_name(cert);
+   X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1, -1, 0);
+   X509_set_issuer_name(cert, name);
+   X509V3_CTX v3;
+   X509V3_set_ctx(&v3, cert, cert, 0, 0, 0);
+   X509_EXTENSION* ext = X509V3_EXT_conf_nid(0, &v3, NID_subject_alt_name, (char*)"DNS:localhost");
+   assert(ext);
+   X509_add_ext(cert, ext, -1);
+   X509_EXTENSION_free(ext);
+   ext = X509V3_EXT_conf_nid(0, &v3, NID_basic_constraints, (char*)"critical,CA:TRUE");
+   X509_add_ext(cert, ext, -1);
+   X509_EXTENSION_free(ext);
+   assert(X509_sign(cert, pkey, EVP_sha256()) > 0);
+
+   FILE* f = fopen(keyFile.c_str(), "w");
+   assert(f);
+   PEM_write_PrivateKey(f, pkey, 0, 0, 0, 0, 0);
+   fclose(f);
+   f = fopen(certFile.c_str(), "w");
+   assert(f);
+   PEM_write_X509(f, cert);
+   fclose(f);
+
+   X509_free(cert);
+   EVP_PKEY_free(pkey);
+   return Data::fromFile(certFile);
+}
+
+typedef std::vector<TlsTransport*> Transports;
+
+static void
+process(Transports& transports, FdPollGrp* grp)
+{
+   if (grp)
+   {
+      grp->waitAndProcess(10);
+      for (Transports::iterator it = transports.begin(); it != transports.end(); ++it)
+      {
+         (*it)->process();
+      }
+      return;
+   }
+   FdSet fdset;
+   for (Transports::iterator it = transports.begin(); it != transports.end(); ++it)
+   {
+      (*it)->buildFdSet(fdset);
+   }
+   fdset.selectMilliSeconds(10);
+   for (Transports::iterator it = transports.begin(); it != transports.end(); ++it)
+   {
+      (*it)->process(fdset);
+   }
+}
+
+// All clients connect to the server at once; every handshake has to make
+// it through the handshake threads, with accepting paused whenever more
+// than MaxPendingHandshakes steps are outstanding.
+static void
+testBurst(const Data& rootCert, int basePort, FdPollGrp* grp)
+{
+   Security security;
+   security.addRootCertPEM(rootCert);
+
+   Fifo<TransactionMessage> fifo;
+   TlsTransport server(fifo, basePort, V4, "127.0.0.1", security, "localhost", SecurityTypes::SSLv23,
+                       0, Compression::Disabled, 0, SecurityTypes::None, false, certFile, keyFile);
+   assert(server.getHandshakePool());
+   Transports transports;
+   transports.push_back(&server);
+   for (int i = 1; i <= Clients; ++i)
+   {
+      transports.push_back(new TlsTransport(fifo, basePort + i, V4, "127.0.0.1", security, Data::Empty, SecurityTypes::SSLv23));
+   }
+   for (Transports::iterator it = transports.begin(); it != transports.end(); ++it)
+   {
+      (*it)->setPollGrp(grp);
+   }
+
+   Tuple dest("127.0.0.1", basePort, V4, TLS);
+   dest.setTargetDomain("localhost");
+   for (int i = 1; i <= Clients; ++i)
+   {
+      transports[i]->send(std::unique_ptr<SendData>(new SendData(dest, Symbols::CRLFCRLF, Data::Empty, Data::Empty)));
+   }
+   for (int i = 0; i < 1000 && server.getTlsFullHandshakes() < (UInt64)Clients; ++i)
+   {
+      process(transports, grp);
+   }
+   // the clients finish on their last step, which may lag the server's
+   for (int i = 0; i < 100; ++i)
+   {
+      process(transports, grp);
+   }
+   assert(server.getTlsFullHandshakes() == (UInt64)Clients);
+   assert(server.getConnectionCount() == (unsigned int)Clients);
+   for (int i = 1; i <= Clients; ++i)
+   {
+      assert(transports[i]->getTlsFullHandshakes() == 1);
+      assert(transports[i]->getConnectionCount() == 1);
+   }
+
+   for (int i = 1; i <= Clients; ++i)
+   {
+      std::unique_ptr<SendData> close(new SendData(dest, Data::Empty, Data::Empty, Data::Empty));
+      close->command = SendData::CloseConnection;
+      transports[i]->send(std::move(close));
+   }
+   for (int i = 0; i < 200 && server.getConnectionCount(); ++i)
+   {
+      process(transports, grp);
+   }
+   assert(server.getConnectionCount() == 0);
+
+   for (Transports::iterator it = transports.begin(); it != transports.end(); ++it)
+   {
+      (*it)->setPollGrp(0);
+      if (*it != &server)
+      {
+         delete *it;
+      }
+   }
+   cerr << (grp ? "poll" : "select") << ": " << server.getTlsFullHandshakes() << " handshakes" << endl;
+}
+
+// A transport going away with handshakes in the pool takes them back.
+static void
+testShutdown(const Data& rootCert, int basePort)
+{
+   Security security;
+   security.addRootCertPEM(rootCert);
+
+   Fifo<TransactionMessage> fifo;
+   TlsTransport* server = new TlsTransport(fifo, basePort, V4, "127.0.0.1", security, "localhost", SecurityTypes::SSLv23,
+                                           0, Compression::Disabled, 0, SecurityTypes::None, false, certFile, keyFile);
+   TlsTransport* client = new TlsTransport(fifo, basePort + 1, V4, "127.0.0.1", security, Data::Empty, SecurityTypes::SSLv23);
+   Transports transports;
+   transports.push_back(server);
+   transports.push_back(client);
+
+   Tuple dest("127.0.0.1", basePort, V4, TLS);
+   dest.setTargetDomain("localhost");
+   client->send(std::unique_ptr<SendData>(new SendData(dest, Symbols::CRLFCRLF, Data::Empty, Data::Empty)));
+   for (int i = 0; i < 3; ++i)
+   {
+      process(transports, 0);
+   }
+   delete client;
+   delete server;
+}
+
+int
+main(int argc, char* argv[])
+{
+#ifndef WIN32
+   signal(SIGPIPE, SIG_IGN);
+#else
+   initNetwork();
+#endif
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   Data rootCert(makeCertificate());
+   TlsBaseTransport::HandshakeThreads = 2;
+   TlsBaseTransport::MaxPendingHandshakes = 1;
+
+   testBurst(rootCert, 5910, 0);
+   FdPollGrp* grp = FdPollGrp::create();
+   testBurst(rootCert, 5920, grp);
+   delete grp;
+   testShutdown(rootCert, 5930);
+
+   remove(certFile.c_str());
+   remove(keyFile.c_str());
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -0,0 +1,292 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <signal.h>
+
+#include "resip/stack/SendData.hxx"
+#include "resip/stack/Symbols.hxx"
+#include "resip/stack/ssl/Security.hxx"
+#include "resip/stack/ssl/TlsTransport.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Socket.hxx"
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/x509v3.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+static const Data certFile("testTlsResumption_cert.pem");
+static const Data keyFile("testTlsResumption_key.pem");
+
+// Writes a self-signed certificate and key for localhost, and returns
+// the certificate PEM so it can be trusted as a root.
+static Data
+makeCertificate()
+{
+   EVP_PKEY* pkey = 0;
+   EVP_PKEY_CTX* keyCtx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, 0);
+   assert(keyCtx);
+   assert(EVP_PKEY_keygen_init(keyCtx) > 0);
+   assert(EVP_PKEY_CTX_set_rsa_keygen_bits(keyCtx, 2048) > 0);
+   assert(EVP_PKEY_keygen(keyCtx, &pkey) > 0);
+   EVP_PKEY_CTX_free(keyCtx);
+
+   X509* cert = X509_new();
+   X509_set_version(cert, 2);
+   ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+   X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+   X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+   X509_set_pubkey(cert, pkey);
+   X509_NAME* name = X509_get_subject_name(cert);
+   X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1, -1, 0);
+   X509_set_issuer_name(cert, name);
+   X509V3_CTX v3;
+   X509V3_set_ctx(&v3, cert, cert, 0, 0, 0);
+   X509_EXTENSION* ext = X509V3_EXT_conf_nid(0, &v3, NID_subject_alt_name, (char*)"DNS:localhost");
+   assert(ext);
+   X509_add_ext(cert, ext, -1);
+   X509_EXTENSION_free(ext);
+   ext = X509V3_EXT_conf_nid(0, &v3, NID_basic_constraints, (char*)"critical,CA:TRUE");
+   X509_add_ext(cert, ext, -1);
+   X509_EXTENSION_free(ext);
+   assert(X509_sign(cert, pkey, EVP_sha256()) > 0);
+
+   FILE* f = fopen(keyFile.c_str(), "w");
+   assert(f);
+   PEM_write_PrivateKey(f, pkey, 0, 0, 0, 0, 0);
+   fclose(f);
+   f = fopen(certFile.c_str(), "w");
+   assert(f);
+   PEM_write_X509(f, cert);
+   fclose(f);
+
+   X509_free(cert);
+   EVP_PKEY_free(pkey);
+   return Data::fromFile(certFile);
+}
+
+static void
+process(TcpBaseTransport& a, TcpBaseTransport& b)
+{
+   for (int i = 0; i < 5; ++i)
+   {
+      FdSet fdset;
+      a.buildFdSet(fdset);
+      b.buildFdSet(fdset);
+      fdset.selectMilliSeconds(10);
+      a.process(fdset);
+      b.process(fdset);
+   }
+}
+
+// Connects client to server, exchanges a keepalive, and closes the flow
+// again; returns whether the handshake resumed a session.
+static bool
+reconnect(TlsTransport& client, TlsTransport& server, int port)
+{
+   UInt64 full = client.getTlsFullHandshakes();
+   UInt64 resumed = client.getTlsResumedHandshakes();
+
+   Tuple dest("127.0.0.1", port, V4, TLS);
+   dest.setTargetDomain("localhost");
+   client.send(std::unique_ptr<SendData>(new SendData(dest, Symbols::CRLFCRLF, Data::Empty, Data::Empty)));
+   for (int i = 0; i < 200 && client.getTlsFullHandshakes() + client.getTlsResumedHandshakes() == full + resumed; ++i)
+   {
+      process(client, server);
+   }
+   assert(client.getConnectionCount() == 1);
+   assert(server.getConnectionCount() == 1);
+   // let the pong, and with it any TLS 1.3 session ticket, come back
+   for (int i = 0; i < 10; ++i)
+   {
+      process(client, server);
+   }
+
+   std::unique_ptr<SendData> close(new SendData(dest, Data::Empty, Data::Empty, Data::Empty));
+   close->command = SendData::CloseConnection;
+   client.send(std::move(close));
+   for (int i = 0; i < 200 && (client.getConnectionCount() || server.getConnectionCount()); ++i)
+   {
+      process(client, server);
+   }
+   assert(client.getConnectionCount() == 0);
+   assert(server.getConnectionCount() == 0);
+
+   bool wasResumed = client.getTlsResumedHandshakes() == resumed + 1;
+   assert(client.getTlsFullHandshakes() + client.getTlsResumedHandshakes() == full + resumed + 1);
+   assert(server.getTlsResumedHandshakes() == client.getTlsResumedHandshakes());
+   assert(server.getTlsFullHandshakes() == client.getTlsFullHandshakes());
+   return wasResumed;
+}
+
+// Stateless tickets, whose keys rotate every three seconds: a ticket is
+// accepted while its key is current or previous, and not after.
+static void
+testTickets(const Data& rootCert)
+{
+   BaseSecurity::TlsSessionTickets = true;
+   BaseSecurity::TlsTicketKeyRotation = 3;
+   Security security;
+   security.addRootCertPEM(rootCert);
+
+   Fifo<TransactionMessage> fifo;
+   TlsTransport server(fifo, 5900, V4, "127.0.0.1", security, "localhost", SecurityTypes::SSLv23,
+                       0, Compression::Disabled, 0, SecurityTypes::None, false, certFile, keyFile);
+   TlsTransport client(fifo, 5901, V4, "127.0.0.1", security, Data::Empty, SecurityTypes::SSLv23);
+
+   assert(!reconnect(client, server, 5900));
+   assert(reconnect(client, server, 5900));
+   usleep(3500000);
+   // the key rotated: the ticket is still good, and gets renewed
+   assert(reconnect(client, server, 5900));
+   sleep(7);
+   // two more periods: every key that could have made it is gone
+   assert(!reconnect(client, server, 5900));
+   assert(reconnect(client, server, 5900));
+   cerr << "tickets: " << client.getTlsFullHandshakes() << " full, "
+        << client.getTlsResumedHandshakes() << " resumed" << endl;
+}
+
+// TLS 1.2 without tickets resumes from the server side session cache.
+static void
+testSessionCache(const Data& rootCert)
+{
+   BaseSecurity::TlsSessionTickets = false;
+   long setOptions = BaseSecurity::OpenSSLCTXSetOptions;
+   BaseSecurity::OpenSSLCTXSetOptions |= SSL_OP_NO_TLSv1_3;
+   Security security;
+   security.addRootCertPEM(rootCert);
+   BaseSecurity::OpenSSLCTXSetOptions = setOptions;
+
+   Fifo<TransactionMessage> fifo;
+   TlsTransport server(fifo, 5902, V4, "127.0.0.1", security, "localhost", SecurityTypes::SSLv23,
+                       0, Compression::Disabled, 0, SecurityTypes::None, false, certFile, keyFile);
+   TlsTransport client(fifo, 5903, V4, "127.0.0.1", security, Data::Empty, SecurityTypes::SSLv23);
+
+   assert(!reconnect(client, server, 5902));
+   assert(reconnect(client, server, 5902));
+   assert(reconnect(client, server, 5902));
+   cerr << "session cache: " << client.getTlsFullHandshakes() << " full, "
+        << client.getTlsResumedHandshakes() << " resumed" << endl;
+}
+
+// A session from a transport that does not ask for client certificates
+// must not resume on one that requires them, even with the same ticket
+// keys behind both.
+static void
+testVerificationPolicies(const Data& rootCert)
+{
+   BaseSecurity::TlsSessionTickets = true;
+   Security security;
+   security.addRootCertPEM(rootCert);
+
+   Fifo<TransactionMessage> fifo;
+   TlsTransport open(fifo, 5904, V4, "127.0.0.1", security, "localhost", SecurityTypes::SSLv23,
+                     0, Compression::Disabled, 0, SecurityTypes::None, false, certFile, keyFile);
+   TlsTransport strict(fifo, 5905, V4, "127.0.0.1", security, "localhost", SecurityTypes::SSLv23,
+                       0, Compression::Disabled, 0, SecurityTypes::Mandatory, false, certFile, keyFile);
+   TlsTransport client(fifo, 5906, V4, "127.0.0.1", security, "localhost", SecurityTypes::SSLv23,
+                       0, Compression::Disabled, 0, SecurityTypes::None, false, certFile, keyFile);
+   TlsTransport other(fifo, 5907, V4, "127.0.0.1", security, "localhost", SecurityTypes::SSLv23,
+                      0, Compression::Disabled, 0, SecurityTypes::None, false, certFile, keyFile);
+
+   assert(!reconnect(client, open, 5904));
+   assert(reconnect(client, open, 5904));
+
+   // offer that session to the Mandatory transport
+   SSL_SESSION* session = client.findClientSession("localhost 127.0.0.1:5904");
+   assert(session);
+   other.storeClientSession("localhost 127.0.0.1:5905", session);
+   assert(!reconnect(other, strict, 5905));
+   // a session made there still resumes there
+   assert(reconnect(other, strict, 5905));
+   cerr << "verification policies: " << strict.getTlsFullHandshakes() << " full, "
+        << strict.getTlsResumedHandshakes() << " resumed" << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+#ifndef WIN32
+   signal(SIGPIPE, SIG_IGN);
+#else
+   initNetwork();
+#endif
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   Data rootCert(makeCertificate());
+   testTickets(rootCert);
+   testSessionCache(rootCert);
+   testVerificationPolicies(rootCert);
+
+   remove(certFile.c_str());
+   remove(keyFile.c_str());
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
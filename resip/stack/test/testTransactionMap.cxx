@@ -0,0 +1,219 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "resip/stack/TransactionMap.hxx"
+#include "resip/stack/TransactionState.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Random.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+// The map never dereferences its values (only ~TransactionMap deletes
+// whatever is left), so the tests store fake pointers and empty the map
+// before it goes away.
+static TransactionState*
+fake(size_t i)
+{
+   return reinterpret_cast<TransactionState*>((i + 1) * 16);
+}
+
+static void
+testBasics()
+{
+   TransactionMap map;
+   assert(map.size() == 0);
+   assert(map.find("abc") == 0);
+
+   map.add("abcDEF", fake(1));
+   assert(map.size() == 1);
+   assert(map.find("abcDEF") == fake(1));
+   // tids compare case-insensitively
+   assert(map.find("ABCdef") == fake(1));
+   assert(map.find("ABCdef", Data("abcdef").caseInsensitiveTokenHash()) == fake(1));
+   assert(map.find("abcDEFcancel") == 0);
+
+   // adding the same state again is a no-op
+   map.add("abcdef", fake(1));
+   assert(map.size() == 1);
+
+   map.add("abcDEFcancel", fake(2));
+   assert(map.size() == 2);
+   assert(map.find("abcDEFcancel") == fake(2));
+
+   map.erase("ABCDEF");
+   assert(map.size() == 1);
+   assert(map.find("abcDEF") == 0);
+   assert(map.find("abcDEFcancel") == fake(2));
+   map.erase("abcDEFcancel");
+   assert(map.size() == 0);
+}
+
+// Interleaves adds and erases through several grow()s and checks every
+// surviving entry stays reachable, which exercises the backward shift.
+static void
+testChurn()
+{
+   TransactionMap map;
+   std::map<Data, size_t> reference;
+   vector<Data> tids;
+   for (size_t i = 0; i < 20000; ++i)
+   {
+      tids.push_back(Random::getRandomHex(8));
+   }
+
+   for (size_t round = 0; round < 100000; ++round)
+   {
+      size_t i = size_t(Random::getRandom()) % tids.size();
+      if (reference.count(tids[i]))
+      {
+         map.erase(tids[i]);
+         reference.erase(tids[i]);
+      }
+      else
+      {
+         map.add(tids[i], fake(i));
+         reference[tids[i]] = i;
+      }
+      assert(map.size() == (int)reference.size());
+   }
+
+   for (size_t i = 0; i < tids.size(); ++i)
+   {
+      std::map<Data, size_t>::const_iterator r = reference.find(tids[i]);
+      assert(map.find(tids[i]) == (r == reference.end() ? 0 : fake(r->second)));
+   }
+
+   for (std::map<Data, size_t>::const_iterator r = reference.begin(); r != reference.end(); ++r)
+   {
+      map.erase(r->first);
+   }
+   assert(map.size() == 0);
+}
+
+// Lookup rate at a large number of live transactions; only run when a
+// count is given on the command line.
+static void
+benchmark(size_t count)
+{
+   vector<Data> tids;
+   vector<size_t> hashes;
+   tids.reserve(count);
+   hashes.reserve(count);
+   for (size_t i = 0; i < count; ++i)
+   {
+      // what BranchParameter leaves after stripping the magic cookie
+      tids.push_back(Random::getRandomHex(8));
+      hashes.push_back(tids.back().caseInsensitiveTokenHash());
+   }
+   vector<size_t> order(count);
+   for (size_t i = 0; i < count; ++i)
+   {
+      order[i] = size_t(Random::getRandom()) % count;
+   }
+
+   TransactionMap map;
+   for (size_t i = 0; i < count; ++i)
+   {
+      map.add(tids[i], fake(i));
+   }
+
+   size_t found = 0;
+   UInt64 start = Timer::getTimeMs();
+   for (size_t i = 0; i < count; ++i)
+   {
+      found += map.find(tids[order[i]], hashes[order[i]]) != 0;
+   }
+   UInt64 elapsed = Timer::getTimeMs() - start;
+   assert(found == count);
+   cerr << count << " lookups (hash from Via) among " << count << " transactions in " 
+        << elapsed << " ms" << endl;
+
+   found = 0;
+   start = Timer::getTimeMs();
+   for (size_t i = 0; i < count; ++i)
+   {
+      found += map.find(tids[order[i]]) != 0;
+   }
+   elapsed = Timer::getTimeMs() - start;
+   assert(found == count);
+   cerr << count << " lookups (hash on lookup) among " << count << " transactions in " 
+        << elapsed << " ms" << endl;
+
+   for (size_t i = 0; i < count; ++i)
+   {
+      map.erase(tids[i]);
+   }
+}
+
+int
+main(int argc, char* argv[])
+{
+   Random::initialize();
+
+   testBasics();
+   testChurn();
+
+   if (argc > 1)
+   {
+      benchmark(size_t(atol(argv[1])));
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
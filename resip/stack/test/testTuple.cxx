@@ -287,6 +287,20 @@ main()
    }
 #endif
 
+   // Deferred log encoding of a Tuple formats like operator<<
+   {
+      Tuple tuple("192.168.1.106", 5069, V4, TLS, "example.com");
+      tuple.mFlowKey = 17;
+      Data args;
+      DeferredLogArg<Tuple>::encode(args, tuple);
+      Data formatted;
+      {
+         oDataStream strm(formatted);
+         DeferredLog::format(strm, "to {}", args);
+      }
+      assert(formatted == "to " + Data::from(tuple));
+   }
+
    resipCerr << "ALL OK" << std::endl;
 }
 
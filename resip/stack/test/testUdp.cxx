@@ -20,6 +20,7 @@
 #include "rutil/DnsUtil.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/DataStream.hxx"
+#include "rutil/Inserter.hxx"
 
 #include <utility>
 
@@ -36,6 +37,7 @@ main(int argc, char* argv[])
    int runs = 100;
    int window = 10;
    int seltime = 100;
+   int batchDepth = 1;
 
 #if defined (HAVE_POPT_H) 
    struct poptOption table[] = {
@@ -44,6 +46,7 @@ main(int argc, char* argv[])
       {"num-runs",    'r', POPT_ARG_INT,    &runs,      0, "number of calls in test", 0},
       {"window-size", 'w', POPT_ARG_INT,    &window,    0, "number of registrations in test", 0},
       {"select-time", 's', POPT_ARG_INT,    &seltime,   0, "number of runs in test", 0},
+      {"batch-depth", 'b', POPT_ARG_INT,    &batchDepth, 0, "datagrams per recvmmsg/sendmmsg call", 0},
       POPT_AUTOHELP
       { NULL, 0, 0, NULL, 0 }
    };
@@ -62,10 +65,12 @@ main(int argc, char* argv[])
    cout << "Performing " << runs << " runs." << endl;
    
    Fifo<TransactionMessage> txFifo;
-   UdpTransport* sender = new UdpTransport(txFifo, 5070, V4, StunDisabled, Data::Empty);
+   UdpTransport* sender = new UdpTransport(txFifo, 5070, V4, StunDisabled, Data::Empty,
+                                           0, Compression::Disabled, 0, batchDepth);
 
    Fifo<TransactionMessage> rxFifo;
-   UdpTransport* receiver = new UdpTransport(rxFifo, 5080, V4, StunDisabled, Data::Empty);
+   UdpTransport* receiver = new UdpTransport(rxFifo, 5080, V4, StunDisabled, Data::Empty,
+                                             0, Compression::Disabled, 0, batchDepth);
 
    NameAddr target;
    target.uri().scheme() = "sip";
@@ -161,6 +166,14 @@ main(int argc, char* argv[])
    cout << runs << " calls performed in " << elapsed << " ms, a rate of "
         << runs / ((float) elapsed / 1000.0) << " calls per second.]" << endl;
 
+   if (batchDepth > 1)
+   {
+      UdpTransport::BatchStats txStats = sender->getBatchStats();
+      UdpTransport::BatchStats rxStats = receiver->getBatchStats();
+      cout << "tx batch fill: " << Inserter(txStats.mTxFill) << endl;
+      cout << "rx batch fill: " << Inserter(rxStats.mRxFill) << endl;
+   }
+
    return 0;
 }
 /* ====================================================================
@@ -0,0 +1,288 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "resip/stack/WsFrameExtractor.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+static unsigned int
+nextRandom(unsigned int& seed)
+{
+   seed = seed * 1103515245 + 12345;
+   return (seed >> 16) & 0x7fff;
+}
+
+static Data
+makePayload(Data::size_type size, unsigned int& seed)
+{
+   Data payload(size, Data::Preallocate);
+   for (Data::size_type i = 0; i < size; ++i)
+   {
+      payload += (char)(' ' + nextRandom(seed) % 95);
+   }
+   return payload;
+}
+
+// Appends a WebSocket frame carrying payload to out, masked as a client's
+// frames are unless key is 0.
+static void
+appendFrame(Data& out, const Data& payload, bool final, const UInt8* key)
+{
+   UInt8 header[14];
+   int len = 0;
+   header[len++] = (final ? 0x80 : 0x00) | 0x01;
+   UInt8 maskBit = key ? 0x80 : 0x00;
+   UInt64 size = payload.size();
+   if (size < 126)
+   {
+      header[len++] = maskBit | (UInt8)size;
+   }
+   else if (size < 65536)
+   {
+      header[len++] = maskBit | 126;
+      header[len++] = (UInt8)(size >> 8);
+      header[len++] = (UInt8)size;
+   }
+   else
+   {
+      header[len++] = maskBit | 127;
+      for (int shift = 56; shift >= 0; shift -= 8)
+      {
+         header[len++] = (UInt8)(size >> shift);
+      }
+   }
+   if (key)
+   {
+      memcpy(header + len, key, 4);
+      len += 4;
+   }
+   out.append((const char*)header, len);
+   for (Data::size_type i = 0; i < payload.size(); ++i)
+   {
+      out += (char)(key ? payload[i] ^ key[i & 3] : payload[i]);
+   }
+}
+
+// The message split into fragments frames of about the same size.
+static Data
+makeMessage(const Data& payload, int fragments, const UInt8* key)
+{
+   Data out;
+   Data::size_type step = payload.size() / fragments;
+   for (int i = 0; i < fragments; ++i)
+   {
+      Data::size_type start = i * step;
+      Data::size_type end = (i == fragments - 1) ? payload.size() : start + step;
+      appendFrame(out, payload.substr(start, end - start), i == fragments - 1, key);
+   }
+   return out;
+}
+
+static void
+freeMessage(std::unique_ptr<Data>& msg)
+{
+   // the extractor lends its buffer, as it does to a SipMessage
+   delete [] msg->data();
+   msg.reset();
+}
+
+static void
+testUnmask()
+{
+   const UInt8 key[4] = { 0x12, 0x34, 0x56, 0x78 };
+   unsigned int seed = 1;
+   for (Data::size_type len = 0; len < 100; ++len)
+   {
+      Data src(makePayload(len, seed));
+      for (Data::size_type offset = 0; offset < 4; ++offset)
+      {
+         vector<char> dst(len + 1, 0);
+         WsFrameExtractor::unmask(&dst[0], (const UInt8*)src.data(), len, key, offset);
+         vector<char> inPlace(src.data(), src.data() + len);
+         inPlace.push_back(0);
+         WsFrameExtractor::unmask(&inPlace[0], (const UInt8*)&inPlace[0], len, key, offset);
+         for (Data::size_type i = 0; i < len; ++i)
+         {
+            char expected = (char)(src[i] ^ key[(offset + i) & 3]);
+            assert(dst[i] == expected);
+            assert(inPlace[i] == expected);
+         }
+      }
+   }
+}
+
+// Feeds the frames of two messages in chunks of chunkSize bytes and checks
+// both come out whole.
+static void
+checkMessages(const Data& payload, int fragments, const UInt8* key, Data::size_type chunkSize)
+{
+   Data wire(makeMessage(payload, fragments, key));
+   wire += makeMessage(payload, 1, key);
+
+   WsFrameExtractor extractor(payload.size() + 10);
+   int messages = 0;
+   for (Data::size_type pos = 0; pos < wire.size(); pos += chunkSize)
+   {
+      Data::size_type len = resipMin(chunkSize, wire.size() - pos);
+      bool dropConnection = false;
+      std::unique_ptr<Data> msg = extractor.processBytes((UInt8*)wire.data() + pos, len, dropConnection);
+      assert(!dropConnection);
+      while (msg.get())
+      {
+         assert(*msg == payload);
+         assert(msg->data()[msg->size()] == 0);
+         ++messages;
+         freeMessage(msg);
+         msg = extractor.processBytes(0, 0, dropConnection);
+      }
+   }
+   assert(messages == 2);
+}
+
+static void
+testReassembly()
+{
+   const UInt8 key[4] = { 0xa1, 0x0b, 0xfe, 0x47 };
+   unsigned int seed = 7;
+   const Data::size_type sizes[] = { 0, 1, 17, 125, 126, 1000, 65535, 65536, 70000 };
+   for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+   {
+      Data payload(makePayload(sizes[s], seed));
+      for (int fragments = 1; fragments <= 3; ++fragments)
+      {
+         if (sizes[s] < (Data::size_type)fragments)
+         {
+            continue;
+         }
+         const Data::size_type chunkSizes[] = { 1, 3, 1000, payload.size() * 4 + 100 };
+         for (size_t c = 0; c < sizeof(chunkSizes) / sizeof(chunkSizes[0]); ++c)
+         {
+            if (chunkSizes[c] == 1 && sizes[s] > 1000)
+            {
+               continue;
+            }
+            checkMessages(payload, fragments, key, chunkSizes[c]);
+            checkMessages(payload, fragments, 0, chunkSizes[c]);
+         }
+      }
+   }
+
+   // a message over the limit gets the connection dropped
+   Data payload(makePayload(2000, seed));
+   Data wire(makeMessage(payload, 2, key));
+   WsFrameExtractor extractor(1500);
+   bool dropConnection = false;
+   std::unique_ptr<Data> msg = extractor.processBytes((UInt8*)wire.data(), wire.size(), dropConnection);
+   assert(!msg.get());
+   assert(dropConnection);
+}
+
+static void
+benchmark(unsigned int megabytes)
+{
+   const UInt8 key[4] = { 0x37, 0xfa, 0x21, 0x3d };
+   unsigned int seed = 3;
+   const Data::size_type sizes[] = { 1024, 4096, 16384, 65536 };
+   for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+   {
+      Data payload(makePayload(sizes[s], seed));
+      for (int fragments = 1; fragments <= 4; fragments *= 4)
+      {
+         Data wire(makeMessage(payload, fragments, key));
+         unsigned int runs = (unsigned int)((UInt64)megabytes * 1024 * 1024 / sizes[s]);
+         WsFrameExtractor extractor(sizes[s] + 10);
+         UInt64 start = Timer::getTimeMicroSec();
+         for (unsigned int run = 0; run < runs; ++run)
+         {
+            bool dropConnection = false;
+            std::unique_ptr<Data> msg = extractor.processBytes((UInt8*)wire.data(), wire.size(), dropConnection);
+            assert(msg.get() && msg->size() == sizes[s]);
+            freeMessage(msg);
+         }
+         UInt64 elapsed = Timer::getTimeMicroSec() - start;
+         if (elapsed == 0)
+         {
+            elapsed = 1;
+         }
+         cerr << sizes[s] << " byte messages in " << fragments << " frame(s): " << runs
+              << " in " << elapsed / 1000 << " ms, " << UInt64(runs) * sizes[s] / elapsed
+              << " MB/s" << endl;
+      }
+   }
+}
+
+int
+main(int argc, char* argv[])
+{
+   testUnmask();
+   testReassembly();
+
+   if (argc > 1)
+   {
+      benchmark((unsigned int)atoi(argv[1]));
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
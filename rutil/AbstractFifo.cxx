@@ -12,6 +12,20 @@ FifoStatsInterface::~FifoStatsInterface()
 {
 }
 
+bool FifoConfig::mLockFreeDefault = false;
+
+void
+FifoConfig::setLockFreeDefault(bool lockFree)
+{
+   mLockFreeDefault = lockFree;
+}
+
+bool
+FifoConfig::getLockFreeDefault()
+{
+   return mLockFreeDefault;
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
  * 
@@ -2,12 +2,14 @@
 #define RESIP_AbstractFifo_hxx 
 
 #include "rutil/ResipAssert.h"
+#include <atomic>
 #include <deque>
 
 #include "rutil/Mutex.hxx"
 #include "rutil/Condition.hxx"
 #include "rutil/Lock.hxx"
 #include "rutil/CongestionManager.hxx"
+#include "rutil/MpscQueue.hxx"
 
 #include "rutil/compat.hxx"
 #include "rutil/Timer.hxx"
@@ -97,6 +99,24 @@ class FifoStatsInterface
       UInt8 mRole;
 };
 
+/**
+   @brief Process-wide defaults for the fifo classes.
+*/
+class FifoConfig
+{
+   public:
+      /**
+         Selects the lock-free producer path (see AbstractFifo::setLockFree())
+         for every fifo constructed after this call. This is meant to be set
+         once at startup, before the SipStack and its TUs are created.
+      */
+      static void setLockFreeDefault(bool lockFree);
+      static bool getLockFreeDefault();
+
+   private:
+      static bool mLockFreeDefault;
+};
+
 /**
   * The getNext() method takes an argument {ms} that normally
   * the number of milliseconds to wait. There are two special values:
@@ -116,6 +136,11 @@ class FifoStatsInterface
    (aka template hoist) 
    AbstractFifo's get operations are all threadsafe; AbstractFifo does not 
    define any put operations (these are defined in subclasses).
+
+   In lock-free mode (see setLockFree()) producers do not take the mutex:
+   new items go onto an MpscQueue inbox, which consumers move into the
+   deque, with the mutex held, before looking at it. Producers only lock to
+   signal the condition when a consumer is actually blocked in a wait.
    @note Users of the resip stack will not need to interact with this class 
       directly in most cases. Look at Fifo and TimeLimitFifo instead.
 
@@ -134,7 +159,9 @@ class AbstractFifo : public FifoStatsInterface
             mLastSampleTakenMicroSec(0),
             mCounter(0),
             mAverageServiceTimeMicroSec(0),
-            mSize(0)
+            mSize(0),
+            mWaiters(0),
+            mLockFree(FifoConfig::getLockFreeDefault())
       {}
 
       virtual ~AbstractFifo()
@@ -148,7 +175,7 @@ class AbstractFifo : public FifoStatsInterface
       bool empty() const
       {
          Lock lock(mMutex); (void)lock;
-         return mFifo.empty();
+         return mFifo.empty() && mInbox.size() == 0;
       }
 
       /**
@@ -161,7 +188,7 @@ class AbstractFifo : public FifoStatsInterface
       virtual unsigned int size() const
       {
          Lock lock(mMutex); (void)lock;
-         return (unsigned int)mFifo.size();
+         return (unsigned int)(mFifo.size() + mInbox.size());
       }
 
       /**
@@ -172,7 +199,7 @@ class AbstractFifo : public FifoStatsInterface
       bool messageAvailable() const
       {
          Lock lock(mMutex); (void)lock;
-         return !mFifo.empty();
+         return !mFifo.empty() || mInbox.size() != 0;
       }
 
       /**
@@ -187,12 +214,12 @@ class AbstractFifo : public FifoStatsInterface
 
       virtual size_t getCountDepth() const
       {
-         return mSize;
+         return pendingCount();
       }
 
       virtual time_t expectedWaitTimeMilliSec() const
       {
-         return ((mAverageServiceTimeMicroSec*mSize)+500)/1000;
+         return ((mAverageServiceTimeMicroSec*pendingCount())+500)/1000;
       }
 
       virtual time_t averageServiceTimeMicroSec() const
@@ -203,6 +230,26 @@ class AbstractFifo : public FifoStatsInterface
       /// remove all elements in the queue (or not)
       virtual void clear() {};
 
+      /**
+         @brief Lets producers add without taking the fifo's mutex.
+         @details Items are staged on a lock-free multi-producer queue and
+         moved into the fifo by the consumer. Size and time-depth statistics
+         are unchanged in meaning, but are only exact as of the consumer's
+         last visit. Defaults to FifoConfig::getLockFreeDefault(); must not
+         be changed once the fifo is shared between threads.
+      */
+      void setLockFree(bool lockFree)
+      {
+         Lock lock(mMutex); (void)lock;
+         drainInbox();
+         mLockFree = lockFree;
+      }
+
+      bool isLockFree() const
+      {
+         return mLockFree;
+      }
+
    protected:
       /** 
           @brief Returns the first message available.
@@ -216,12 +263,13 @@ class AbstractFifo : public FifoStatsInterface
       T getNext()
       {
          Lock lock(mMutex); (void)lock;
+         drainInbox();
          onFifoPolled();
 
          // Wait util there are messages available.
          while (mFifo.empty())
          {
-            mCondition.wait(mMutex);
+            waitLocked();
          }
 
          // Return the first message on the fifo.
@@ -253,17 +301,20 @@ class AbstractFifo : public FifoStatsInterface
          if(ms < 0)
          {
             Lock lock(mMutex); (void)lock;
+            drainInbox();
             onFifoPolled();
             if (mFifo.empty())	// WATCHOUT: Do not test mSize instead
               return false;
             toReturn = mFifo.front();
             mFifo.pop_front();
+            onMessagePopped();
             return true;
          }
 
          const UInt64 begin(Timer::getTimeMs());
          const UInt64 end(begin + (unsigned int)(ms)); // !kh! ms should've been unsigned :(
          Lock lock(mMutex); (void)lock;
+         drainInbox();
          onFifoPolled();
 
          // Wait until there are messages available
@@ -282,7 +333,7 @@ class AbstractFifo : public FifoStatsInterface
             unsigned int timeout((unsigned int)(end - now));
                     
             // bail if total wait time exceeds limit
-            bool signaled = mCondition.wait(mMutex, timeout);
+            bool signaled = waitLocked(timeout);
             if (!signaled)
             {
                return false;
@@ -302,11 +353,12 @@ class AbstractFifo : public FifoStatsInterface
       void getMultiple(Messages& other, unsigned int max)
       {
          Lock lock(mMutex); (void)lock;
+         drainInbox();
          onFifoPolled();
          resip_assert(other.empty());
          while (mFifo.empty())
          {
-            mCondition.wait(mMutex);
+            waitLocked();
          }
 
          if(mFifo.size() <= max)
@@ -338,6 +390,7 @@ class AbstractFifo : public FifoStatsInterface
          const UInt64 begin(Timer::getTimeMs());
          const UInt64 end(begin + (unsigned int)(ms)); // !kh! ms should've been unsigned :(
          Lock lock(mMutex); (void)lock;
+         drainInbox();
          onFifoPolled();
 
          // Wait until there are messages available
@@ -356,7 +409,7 @@ class AbstractFifo : public FifoStatsInterface
             unsigned int timeout((unsigned int)(end - now));
                     
             // bail if total wait time exceeds limit
-            bool signaled = mCondition.wait(mMutex, timeout);
+            bool signaled = waitLocked(timeout);
             if (!signaled)
             {
                return false;
@@ -381,8 +434,20 @@ class AbstractFifo : public FifoStatsInterface
          return true;
       }
 
+      /**
+         @return the number of items in the fifo after the add; in lock-free
+         mode, the number of items waiting in the inbox (so 1 still means
+         the consumer may need waking).
+      */
       size_t add(const T& item)
       {
+         if (mLockFree)
+         {
+            size_t pending = mInbox.push(item);
+            signalWaiter();
+            return pending;
+         }
+
          Lock lock(mMutex); (void)lock;
          mFifo.push_back(item);
          mCondition.signal();
@@ -392,6 +457,18 @@ class AbstractFifo : public FifoStatsInterface
 
       size_t addMultiple(Messages& items)
       {
+         if (mLockFree)
+         {
+            size_t pending = mInbox.size();
+            while (!items.empty())
+            {
+               pending = mInbox.push(items.front());
+               items.pop_front();
+            }
+            signalWaiter();
+            return pending;
+         }
+
          Lock lock(mMutex); (void)lock;
          size_t size=items.size();
          if(mFifo.empty())
@@ -428,6 +505,89 @@ class AbstractFifo : public FifoStatsInterface
       // in situations where it being off by a small amount is ok.
       UInt32 mSize;
 
+      /** @brief lock-free staging area for producers; see setLockFree() */
+      MpscQueue<T> mInbox;
+      /** @brief consumers blocked on mCondition (lock-free mode only) */
+      std::atomic<unsigned int> mWaiters;
+      bool mLockFree;
+
+      /**
+         Items added but not yet taken by a consumer, without locking. Same
+         caveat as mSize.
+      */
+      size_t pendingCount() const
+      {
+         return mSize + mInbox.size();
+      }
+
+      /**
+         Moves everything producers have staged into mFifo. Call with mMutex
+         held; a no-op unless lock-free.
+         @return the number of items moved.
+      */
+      size_t drainInbox()
+      {
+         if (!mLockFree)
+         {
+            return 0;
+         }
+         size_t num = mInbox.popAll(mFifo);
+         if (num)
+         {
+            onMessagePushed((int)num);
+         }
+         return num;
+      }
+
+      /**
+         Blocks on mCondition; call with mMutex held. In lock-free mode the
+         waiter is registered before the inbox is checked one last time, and
+         producers check for waiters after publishing, so between them one of
+         the two always notices the other.
+      */
+      void waitLocked()
+      {
+         if (!mLockFree)
+         {
+            mCondition.wait(mMutex);
+            return;
+         }
+         ++mWaiters;
+         if (drainInbox() == 0)
+         {
+            mCondition.wait(mMutex);
+         }
+         --mWaiters;
+         drainInbox();
+      }
+
+      /// @return false if the timeout elapsed without anything arriving
+      bool waitLocked(unsigned int ms)
+      {
+         if (!mLockFree)
+         {
+            return mCondition.wait(mMutex, ms);
+         }
+         bool signaled = true;
+         ++mWaiters;
+         if (drainInbox() == 0)
+         {
+            signaled = mCondition.wait(mMutex, ms);
+         }
+         --mWaiters;
+         return drainInbox() != 0 || signaled;
+      }
+
+      /// Producer side of waitLocked(); lock-free mode only.
+      void signalWaiter()
+      {
+         if (mWaiters.load() != 0)
+         {
+            Lock lock(mMutex); (void)lock;
+            mCondition.signal();
+         }
+      }
+
       virtual void onFifoPolled()
       {
          // !bwc! TODO allow this sampling frequency to be tweaked
@@ -0,0 +1,216 @@
+#include <limits>
+#include <new>
+
+#include "rutil/ArenaPool.hxx"
+
+using namespace resip;
+
+ArenaPool::Profile::Profile(size_t minBlockSize, 
+                            size_t maxBlockSize, 
+                            size_t maxHeapBytes)
+   : mEnabled(true),
+     mMinBlockSize(minBlockSize),
+     mMaxBlockSize(maxBlockSize),
+     mMaxHeapBytes(maxHeapBytes),
+     mAverageSpill(0)
+{
+}
+
+void
+ArenaPool::Profile::setBlockSizeLimits(size_t minBlockSize, size_t maxBlockSize)
+{
+   mMinBlockSize.store(minBlockSize, std::memory_order_relaxed);
+   mMaxBlockSize.store(resipMax(minBlockSize, maxBlockSize), std::memory_order_relaxed);
+}
+
+size_t
+ArenaPool::Profile::getBlockSize() const
+{
+   // A quarter of headroom over the average, in whole KB, so that a 
+   // slightly larger than usual object still fits in one block.
+   size_t average = mAverageSpill.load(std::memory_order_relaxed);
+   size_t size = (average + average/4 + 1023) & ~size_t(1023);
+   return resipMin(resipMax(size, getMinBlockSize()), getMaxBlockSize());
+}
+
+void
+ArenaPool::Profile::recordSpill(size_t bytes)
+{
+   size_t average = mAverageSpill.load(std::memory_order_relaxed);
+   if(average == 0)
+   {
+      average = bytes;
+   }
+   else
+   {
+      average = average - average/8 + bytes/8;
+   }
+   mAverageSpill.store(average, std::memory_order_relaxed);
+}
+
+ArenaPool::ArenaPool(Profile& profile, void* buffer, size_t bufferSize)
+   : mProfile(profile),
+     mBuffer(static_cast<char*>(buffer)),
+     mBufferSize(bufferSize),
+     mCur(mBuffer),
+     mEnd(mBuffer + bufferSize),
+     mBlocks(0),
+     mBufferUsed(0),
+     mBlockUsed(0),
+     mBlockBytes(0),
+     mFallbackBytes(0),
+     mFallbacks(0)
+{
+}
+
+ArenaPool::~ArenaPool()
+{
+   // Only arenas that outgrew their buffer say anything about how big a 
+   // block should be.
+   size_t spill = mFallbackBytes;
+   if(mBlocks)
+   {
+      spill += getPoolBytes() - mBufferUsed;
+   }
+   if(spill)
+   {
+      mProfile.recordSpill(spill);
+   }
+
+   while(mBlocks)
+   {
+      Block* next = mBlocks->mNext;
+      ::operator delete(mBlocks);
+      mBlocks = next;
+   }
+   delete mFallbacks;
+}
+
+void*
+ArenaPool::allocateSlow(size_t size)
+{
+   const size_t maxHeapBytes = mProfile.getMaxHeapBytes();
+   if(mProfile.isEnabled() && mBlockBytes + size <= maxHeapBytes)
+   {
+      size_t blockSize;
+      if(mBlocks)
+      {
+         mBlockUsed += size_t(mCur - mBlocks->data());
+         blockSize = resipMin(mBlocks->mSize*2, mProfile.getMaxBlockSize());
+      }
+      else
+      {
+         mBufferUsed = size_t(mCur - mBuffer);
+         blockSize = mProfile.getBlockSize();
+      }
+      blockSize = resipMin(blockSize, maxHeapBytes - mBlockBytes);
+      blockSize = resipMax(blockSize, size);
+
+      Block* block = static_cast<Block*>(::operator new(sizeof(Block) + blockSize));
+      block->mNext = mBlocks;
+      block->mSize = blockSize;
+      mBlocks = block;
+      mBlockBytes += blockSize;
+      mCur = block->data() + size;
+      mEnd = block->data() + blockSize;
+      return block->data();
+   }
+
+   if(!mFallbacks)
+   {
+      mFallbacks = new HashSet<void*>;
+   }
+   void* ptr = ::operator new(size);
+   mFallbacks->insert(ptr);
+   mFallbackBytes += size;
+   return ptr;
+}
+
+void
+ArenaPool::deallocate(void* ptr)
+{
+   // Anything we did not hand out as a fallback object lives in the buffer 
+   // or a block, and goes away with the arena.
+   if(mFallbacks && mFallbacks->erase(ptr))
+   {
+      ::operator delete(ptr);
+   }
+}
+
+size_t
+ArenaPool::max_size() const
+{
+   return std::numeric_limits<size_t>::max();
+}
+
+size_t
+ArenaPool::getPoolBytes() const
+{
+   if(!mBlocks)
+   {
+      return size_t(mCur - mBuffer);
+   }
+   return mBufferUsed + mBlockUsed + size_t(mCur - mBlocks->data());
+}
+
+unsigned int
+ArenaPool::getBlockCount() const
+{
+   unsigned int count = 0;
+   for(Block* block = mBlocks; block; block = block->mNext)
+   {
+      ++count;
+   }
+   return count;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -0,0 +1,198 @@
+#ifndef ArenaPool_Include_Guard
+#define ArenaPool_Include_Guard
+
+#include <atomic>
+#include <stddef.h>
+
+#include "rutil/HashMap.hxx"
+#include "rutil/PoolBase.hxx"
+#include "rutil/compat.hxx"
+
+namespace resip
+{
+/**
+   A bump allocator for objects that are built up piece by piece and torn 
+   down all at once, such as a SipMessage and everything it parses.
+
+   Allocations are carved out of a buffer supplied by the owner (normally 
+   a member of the owning object, see InlineArenaPool), and once that is 
+   used up, out of heap blocks chained off the arena. Deallocating arena 
+   memory is a no-op; the blocks are released together when the arena goes 
+   away.
+
+   How big those blocks are is decided by a Profile shared by every arena 
+   serving the same kind of object. The Profile keeps a moving average of 
+   how far its arenas spill past their inline buffer, so the first block is 
+   usually big enough to hold the rest of the object. An arena that has 
+   taken more than Profile::getMaxHeapBytes() in blocks stops chaining 
+   them and falls back to plain new/delete (which are then freed 
+   individually, and remembered so deallocate() can tell them apart from 
+   arena memory without walking the blocks), so an object that keeps replacing its parts cannot make 
+   its arena grow without bound.
+*/
+class ArenaPool : public PoolBase
+{
+   public:
+      class Profile
+      {
+         public:
+            Profile(size_t minBlockSize=1024, 
+                    size_t maxBlockSize=32768, 
+                    size_t maxHeapBytes=262144);
+
+            /**
+               When disabled, arenas no longer chain blocks; anything that 
+               does not fit in the inline buffer goes straight to the heap.
+               Settings may be changed while arenas using this Profile are 
+               live on other threads; they take effect from the next block.
+            */
+            void setEnabled(bool enabled) { mEnabled.store(enabled, std::memory_order_relaxed); }
+            bool isEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+
+            void setBlockSizeLimits(size_t minBlockSize, size_t maxBlockSize);
+            size_t getMinBlockSize() const { return mMinBlockSize.load(std::memory_order_relaxed); }
+            size_t getMaxBlockSize() const { return mMaxBlockSize.load(std::memory_order_relaxed); }
+
+            void setMaxHeapBytes(size_t maxHeapBytes) { mMaxHeapBytes.store(maxHeapBytes, std::memory_order_relaxed); }
+            size_t getMaxHeapBytes() const { return mMaxHeapBytes.load(std::memory_order_relaxed); }
+
+            /// Size of the first block an arena takes once its buffer is full.
+            size_t getBlockSize() const;
+
+            /// Called by ~ArenaPool with how much it needed beyond its buffer.
+            void recordSpill(size_t bytes);
+            size_t getAverageSpill() const { return mAverageSpill.load(std::memory_order_relaxed); }
+
+         private:
+            // Profiles are shared by arenas on every thread (SipMessage's 
+            // is a function static), so the settings are atomic too.
+            std::atomic<bool> mEnabled;
+            std::atomic<size_t> mMinBlockSize;
+            std::atomic<size_t> mMaxBlockSize;
+            std::atomic<size_t> mMaxHeapBytes;
+            // Updated without synchronization between the threads that 
+            // destroy arenas; losing the odd sample is harmless.
+            std::atomic<size_t> mAverageSpill;
+      };
+
+      ArenaPool(Profile& profile, void* buffer, size_t bufferSize);
+      virtual ~ArenaPool();
+
+      virtual void* allocate(size_t size)
+      {
+         size = (size + 7) & ~size_t(7);
+         if(size <= size_t(mEnd - mCur))
+         {
+            void* result = mCur;
+            mCur += size;
+            return result;
+         }
+         return allocateSlow(size);
+      }
+
+      virtual void deallocate(void* ptr);
+      virtual size_t max_size() const;
+
+      /// Bytes taken from the heap, whether as blocks or as single objects.
+      size_t getHeapBytes() const { return mBlockBytes + mFallbackBytes; }
+      /// Bytes handed out from the buffer and the blocks.
+      size_t getPoolBytes() const;
+      size_t getPoolSizeBytes() const { return mBufferSize; }
+      unsigned int getBlockCount() const;
+
+   private:
+      // disabled
+      ArenaPool& operator=(const ArenaPool& rhs);
+      ArenaPool(const ArenaPool& other);
+
+      struct Block
+      {
+         Block* mNext;
+         size_t mSize;
+         char* data() { return reinterpret_cast<char*>(this + 1); }
+      };
+
+      void* allocateSlow(size_t size);
+
+      Profile& mProfile;
+      char* const mBuffer;
+      const size_t mBufferSize;
+      char* mCur;
+      char* mEnd;
+      Block* mBlocks; // most recent first
+      size_t mBufferUsed; // set when we move on to the first block
+      size_t mBlockUsed; // handed out from blocks other than the current one
+      size_t mBlockBytes;
+      size_t mFallbackBytes;
+      HashSet<void*>* mFallbacks; // created with the first fallback object
+};
+
+/**
+   An ArenaPool whose buffer is S bytes held in the object itself, so the 
+   owner does not need to allocate anything until it outgrows that.
+*/
+template<unsigned int S>
+class InlineArenaPool : public ArenaPool
+{
+   public:
+      explicit InlineArenaPool(Profile& profile) 
+         : ArenaPool(profile, mBuf, sizeof(mBuf))
+      {}
+
+   private:
+      UInt64 mBuf[(S+7)/8]; // 8-byte chunks for alignment
+};
+
+}
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
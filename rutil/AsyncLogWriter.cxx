@@ -0,0 +1,390 @@
+#include <cstdlib>
+
+#include "rutil/AsyncLogWriter.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Subsystem.hxx"
+#include "rutil/Time.hxx"
+
+using namespace resip;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::NONE
+
+std::atomic<bool> AsyncLogWriter::mRunning(false);
+std::atomic<bool> AsyncLogWriter::mWakeupPending(false);
+std::atomic<UInt64> AsyncLogWriter::mDropped(0);
+UInt64 AsyncLogWriter::mDroppedReported = 0;
+unsigned int AsyncLogWriter::mQueueSize = 0;
+AsyncLogWriter* AsyncLogWriter::mWriter = 0;
+ThreadIf::TlsKey* AsyncLogWriter::mRingKey = 0;
+Mutex AsyncLogWriter::mControlMutex;
+Mutex AsyncLogWriter::mDrainMutex;
+Mutex AsyncLogWriter::mRingsMutex;
+std::vector<AsyncLogWriter::Ring*> AsyncLogWriter::mRings;
+std::vector<AsyncLogWriter::Ring*> AsyncLogWriter::mDraining;
+Data AsyncLogWriter::mFormatted;
+
+extern "C"
+{
+   void freeAsyncLogRing(void* ring)
+   {
+      // Lines the thread queued before exiting still have to be written, so
+      // leave the ring to the next drain.
+      static_cast<AsyncLogWriter::Ring*>(ring)->mOrphaned.store(true);
+   }
+}
+
+static void
+stopAsyncLogWriterAtExit()
+{
+   // Runs before Log's statics are destroyed, since it was registered after
+   // they were constructed.
+   AsyncLogWriter::stop();
+}
+
+AsyncLogWriter::Ring::Ring(unsigned int size)
+   : mLines(new Line[size]),
+     mSize(size),
+     mOrphaned(false),
+     mTail(0),
+     mPosting(false),
+     mHead(0)
+{
+}
+
+AsyncLogWriter::Ring::~Ring()
+{
+   delete [] mLines;
+}
+
+AsyncLogWriter::AsyncLogWriter()
+{
+}
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+}
+
+void
+AsyncLogWriter::start(unsigned int queueSize)
+{
+   Lock lock(mControlMutex);
+   mQueueSize = queueSize ? queueSize : 1;
+   if (mWriter)
+   {
+      return;
+   }
+
+   if (mRingKey == 0)
+   {
+      mRingKey = new ThreadIf::TlsKey;
+      ThreadIf::tlsKeyCreate(*mRingKey, freeAsyncLogRing);
+      atexit(stopAsyncLogWriterAtExit);
+   }
+
+   mWriter = new AsyncLogWriter;
+   mWriter->run();
+   mRunning.store(true);
+}
+
+void
+AsyncLogWriter::stop()
+{
+   Lock lock(mControlMutex);
+   if (mWriter == 0)
+   {
+      return;
+   }
+
+   // From here on new lines are written by the threads that log them. A
+   // thread that saw mRunning set just before this may still be publishing
+   // into its ring; wait for it so that the final drain below picks the
+   // line up.
+   mRunning.store(false);
+   {
+      Lock ringsLock(mRingsMutex);
+      for (std::vector<Ring*>::iterator i = mRings.begin(); i != mRings.end(); ++i)
+      {
+         while ((*i)->mPosting.load())
+         {
+            sleepMs(0);
+         }
+      }
+   }
+
+   mWriter->shutdown();
+   {
+      Lock wakeupLock(mWriter->mWakeupMutex);
+      mWriter->mWakeup.signal();
+   }
+   mWriter->join();
+   delete mWriter;
+   mWriter = 0;
+
+   drain();
+}
+
+bool
+AsyncLogWriter::isRunning()
+{
+   return mRunning.load(std::memory_order_relaxed);
+}
+
+AsyncLogWriter::Ring*
+AsyncLogWriter::localRing()
+{
+   Ring* ring = static_cast<Ring*>(ThreadIf::tlsGetValue(*mRingKey));
+   if (ring == 0)
+   {
+      ring = new Ring(mQueueSize);
+      {
+         Lock lock(mRingsMutex);
+         mRings.push_back(ring);
+      }
+      ThreadIf::tlsSetValue(*mRingKey, ring);
+   }
+   return ring;
+}
+
+bool
+AsyncLogWriter::post(Log::ThreadData& logger,
+                     Log::Level level,
+                     const Subsystem& subsystem,
+                     const char* file,
+                     int line,
+                     const Data& text,
+                     Data::size_type headerLength)
+{
+   return enqueue(logger, level, subsystem, file, line, text, headerLength, 0);
+}
+
+bool
+AsyncLogWriter::post(Log::ThreadData& logger,
+                     Log::Level level,
+                     const Subsystem& subsystem,
+                     const DeferredLog::Context& context,
+                     const Data& args)
+{
+   return enqueue(logger, level, subsystem, context.mSite->mFile, context.mSite->mLine,
+                  args, 0, &context);
+}
+
+bool
+AsyncLogWriter::enqueue(Log::ThreadData& logger,
+                        Log::Level level,
+                        const Subsystem& subsystem,
+                        const char* file,
+                        int line,
+                        const Data& text,
+                        Data::size_type headerLength,
+                        const DeferredLog::Context* context)
+{
+   if (!mRunning.load(std::memory_order_acquire))
+   {
+      return false;
+   }
+
+   Ring* ring = localRing();
+   ring->mPosting.store(true);
+   if (!mRunning.load())
+   {
+      // lost a race with stop()
+      ring->mPosting.store(false);
+      return false;
+   }
+
+   const UInt64 tail = ring->mTail.load(std::memory_order_relaxed);
+   const UInt64 used = tail - ring->mHead.load(std::memory_order_acquire);
+   if (used >= ring->mSize)
+   {
+      mDropped.fetch_add(1, std::memory_order_relaxed);
+   }
+   else
+   {
+      Ring::Line& slot = ring->mLines[tail % ring->mSize];
+      slot.mLogger = &logger;
+      slot.mLevel = level;
+      slot.mSubsystem = &subsystem;
+      slot.mFile = file;
+      slot.mLine = line;
+      slot.mHeaderLength = headerLength;
+      if (context)
+      {
+         slot.mContext = *context;
+      }
+      else
+      {
+         slot.mContext.mSite = 0;
+      }
+      slot.mText = text;
+      ring->mTail.store(tail + 1, std::memory_order_release);
+   }
+
+   // Don't leave a filling ring to the writer's idle timeout. mWriter
+   // cannot go away while mPosting is set.
+   if (used + 1 >= ring->mSize / 2 && !mWakeupPending.exchange(true))
+   {
+      Lock lock(mWriter->mWakeupMutex);
+      mWriter->mWakeup.signal();
+   }
+   ring->mPosting.store(false);
+   return true;
+}
+
+size_t
+AsyncLogWriter::drain()
+{
+   Lock drainLock(mDrainMutex);
+   {
+      // Only the drainer removes rings, so the copy stays valid after the
+      // lock is released.
+      Lock lock(mRingsMutex);
+      mDraining = mRings;
+   }
+
+   size_t count = 0;
+   for (std::vector<Ring*>::iterator i = mDraining.begin(); i != mDraining.end(); ++i)
+   {
+      Ring* ring = *i;
+      // Checked first: once orphaned the owner publishes nothing more, so
+      // this drain sees all of its lines.
+      const bool orphaned = ring->mOrphaned.load();
+      UInt64 head = ring->mHead.load(std::memory_order_relaxed);
+      const UInt64 tail = ring->mTail.load(std::memory_order_acquire);
+      for (; head != tail; ++head)
+      {
+         Ring::Line& slot = ring->mLines[head % ring->mSize];
+         if (slot.mContext.mSite)
+         {
+            DeferredLog::output(*slot.mLogger, slot.mLevel, *slot.mSubsystem,
+                                slot.mContext, slot.mText, mFormatted);
+         }
+         else
+         {
+            Log::output(*slot.mLogger, slot.mLevel, *slot.mSubsystem,
+                        slot.mFile, slot.mLine, slot.mText, slot.mHeaderLength);
+         }
+         ring->mHead.store(head + 1, std::memory_order_release);
+         ++count;
+      }
+
+      if (orphaned)
+      {
+         {
+            Lock lock(mRingsMutex);
+            for (std::vector<Ring*>::iterator r = mRings.begin(); r != mRings.end(); ++r)
+            {
+               if (*r == ring)
+               {
+                  mRings.erase(r);
+                  break;
+               }
+            }
+         }
+         delete ring;
+      }
+   }
+
+   reportDropped();
+   return count;
+}
+
+void
+AsyncLogWriter::reportDropped()
+{
+   // mDrainMutex held
+   const UInt64 dropped = mDropped.load(std::memory_order_relaxed);
+   if (dropped != mDroppedReported)
+   {
+      const UInt64 since = dropped - mDroppedReported;
+      mDroppedReported = dropped;
+      // Goes through the drainer's own ring (or straight out once stopped).
+      WarningLog(<< "Dropped " << since << " log lines because a logging thread's queue was full ("
+                 << dropped << " in total)");
+   }
+}
+
+void
+AsyncLogWriter::flush()
+{
+   if (mRingKey)
+   {
+      // A second pass writes the drop report the first one may have queued.
+      drain();
+      drain();
+   }
+}
+
+UInt64
+AsyncLogWriter::getDroppedLines()
+{
+   return mDropped.load(std::memory_order_relaxed);
+}
+
+void
+AsyncLogWriter::thread()
+{
+   while (!isShutdown())
+   {
+      mWakeupPending.store(false);
+      if (drain() == 0)
+      {
+         Lock lock(mWakeupMutex);
+         if (!mWakeupPending.load() && !isShutdown())
+         {
+            mWakeup.wait(mWakeupMutex, IdleWaitMs);
+         }
+      }
+   }
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -0,0 +1,216 @@
+#ifndef RESIP_AsyncLogWriter_hxx
+#define RESIP_AsyncLogWriter_hxx
+
+#include <atomic>
+#include <vector>
+
+#include "rutil/Condition.hxx"
+#include "rutil/DeferredLog.hxx"
+#include "rutil/Log.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ThreadIf.hxx"
+
+extern "C"
+{
+   void freeAsyncLogRing(void* ring);
+};
+
+namespace resip
+{
+
+/**
+   @brief Writes log lines on a dedicated thread; see Log::setAsynchronous().
+
+   Log::Guard still formats each line on the thread that logs it, but
+   rather than taking Log::_mutex and writing the stream itself it copies
+   the line into a ring owned by that thread. A ring has exactly one
+   producer (its thread) and one consumer (whoever holds mDrainMutex,
+   normally the writer thread), so publishing a line is a store-release of
+   the ring's tail and logging threads share no lock. Slots keep their Data
+   buffers between uses, so once a ring has warmed up logging allocates
+   nothing.
+
+   A line that finds its ring full is dropped and counted instead of
+   blocking the caller. The writer logs a warning with the number dropped
+   since its last report; Log::getDroppedLines() returns the total.
+
+   Each line remembers the logger its thread was using (the default or a
+   thread local logger), and the writer hands it to that logger's external
+   logger and stream exactly as the logging thread would have. External
+   loggers therefore run on the writer thread while this is enabled.
+
+   Lines logged with the DeferredLog macros are queued as their encoded
+   arguments and only formatted here, by the drainer.
+
+   All of this is driven through static functions called by Log; there is
+   at most one writer at a time.
+*/
+class AsyncLogWriter : public ThreadIf
+{
+   public:
+      /// Starts the writer (or resizes rings created from now on).
+      static void start(unsigned int queueSize);
+      /// Stops the writer once every line already queued is written.
+      static void stop();
+      static bool isRunning();
+
+      /** Queues a formatted line for the writer.
+          @return false if the writer is not running, in which case the
+          caller should write the line itself. */
+      static bool post(Log::ThreadData& logger,
+                       Log::Level level,
+                       const Subsystem& subsystem,
+                       const char* file,
+                       int line,
+                       const Data& text,
+                       Data::size_type headerLength);
+
+      /// Queues a DeferredLog line; the writer formats it.
+      static bool post(Log::ThreadData& logger,
+                       Log::Level level,
+                       const Subsystem& subsystem,
+                       const DeferredLog::Context& context,
+                       const Data& args);
+
+      /// Writes out everything queued so far, on the calling thread.
+      static void flush();
+      static UInt64 getDroppedLines();
+
+      virtual void thread();
+
+   private:
+      AsyncLogWriter();
+      virtual ~AsyncLogWriter();
+
+      class Ring
+      {
+         public:
+            struct Line
+            {
+               Log::ThreadData* mLogger;
+               Log::Level mLevel;
+               const Subsystem* mSubsystem;
+               const char* mFile;
+               int mLine;
+               Data::size_type mHeaderLength;
+               /// mContext.mSite is set for DeferredLog lines, whose mText
+               /// holds the encoded arguments rather than the line
+               DeferredLog::Context mContext;
+               Data mText;
+            };
+
+            explicit Ring(unsigned int size);
+            ~Ring();
+
+            Line* mLines;
+            const unsigned int mSize;
+            /// set by the owning thread's TLS destructor; the ring is
+            /// deleted the next time it is drained
+            std::atomic<bool> mOrphaned;
+            char mPad0[64];
+            /// written by the producer, read by the consumer
+            std::atomic<UInt64> mTail;
+            /// true while the producer is between checking that the writer
+            /// runs and publishing its line; stop() waits for it to clear
+            std::atomic<bool> mPosting;
+            char mPad1[64];
+            /// written by the consumer, read by the producer; kept on its
+            /// own cache line so the two sides don't contend
+            std::atomic<UInt64> mHead;
+
+         private:
+            Ring(const Ring&);
+            Ring& operator=(const Ring&);
+      };
+
+      static bool enqueue(Log::ThreadData& logger,
+                          Log::Level level,
+                          const Subsystem& subsystem,
+                          const char* file,
+                          int line,
+                          const Data& text,
+                          Data::size_type headerLength,
+                          const DeferredLog::Context* context);
+      static size_t drain();
+      static void reportDropped();
+      static Ring* localRing();
+      friend void ::freeAsyncLogRing(void* ring);
+
+      /// waits for at most this long when there is nothing to write
+      static const unsigned int IdleWaitMs = 10;
+
+      static std::atomic<bool> mRunning;
+      static std::atomic<bool> mWakeupPending;
+      static std::atomic<UInt64> mDropped;
+      static UInt64 mDroppedReported;
+      static unsigned int mQueueSize;
+      static AsyncLogWriter* mWriter;
+      static ThreadIf::TlsKey* mRingKey;
+      /// serializes start() and stop()
+      static Mutex mControlMutex;
+      /// held by whoever is consuming the rings
+      static Mutex mDrainMutex;
+      static Mutex mRingsMutex;
+      static std::vector<Ring*> mRings;
+      static std::vector<Ring*> mDraining;
+      /// where the drainer formats DeferredLog lines
+      static Data mFormatted;
+
+      Mutex mWakeupMutex;
+      Condition mWakeup;
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -94,6 +94,25 @@ class CongestionManager
    */
    virtual EncodeStream& encodeCurrentState(EncodeStream& strm) const=0;
 
+   /**
+      Receives the state of each monitored fifo; see visitFifos().
+   */
+   class FifoVisitor
+   {
+      public:
+         virtual ~FifoVisitor(){}
+         virtual void visit(const FifoStatsInterface& fifo,
+                            RejectionBehavior behavior)=0;
+   };
+
+   /**
+      Calls visitor once for each monitored fifo, along with the fifo's
+      current rejection behavior. Implementations may hold a lock that the
+      fifos' users need while doing so, so visitors should copy what they
+      want and return. Does nothing unless the subclass implements it.
+   */
+   virtual void visitFifos(FifoVisitor& visitor) const {}
+
 };
 
 
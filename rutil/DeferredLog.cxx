@@ -0,0 +1,161 @@
+#include "rutil/AsyncLogWriter.hxx"
+#include "rutil/DeferredLog.hxx"
+
+using namespace resip;
+
+const char*
+DeferredLog::decodeTextArg(EncodeStream& strm, const char* arg)
+{
+   const char* text;
+   UInt32 length;
+   arg = decodeText(arg, text, length);
+   strm.write(text, length);
+   return arg;
+}
+
+static const char*
+decodeArg(EncodeStream& strm, const char* arg)
+{
+   DeferredLog::Decoder decoder;
+   arg = DeferredLog::decodeValue(arg, decoder);
+   return decoder(strm, arg);
+}
+
+void
+DeferredLog::format(EncodeStream& strm, const char* format, const Data& args)
+{
+   const char* arg = args.data();
+   const char* const end = arg + args.size();
+   const char* text = format;
+   for (const char* p = format; *p; ++p)
+   {
+      if (p[0] == '{' && p[1] == '}')
+      {
+         strm.write(text, p - text);
+         if (arg < end)
+         {
+            arg = decodeArg(strm, arg);
+         }
+         else
+         {
+            strm << "{}";
+         }
+         text = ++p + 1;
+      }
+      else if ((p[0] == '{' && p[1] == '{') || (p[0] == '}' && p[1] == '}'))
+      {
+         strm.write(text, p - text + 1);
+         text = ++p + 1;
+      }
+   }
+   strm << text;
+
+   // More arguments than {}: keep them rather than lose what was logged.
+   while (arg < end)
+   {
+      strm << ' ';
+      arg = decodeArg(strm, arg);
+   }
+}
+
+void
+DeferredLog::commit(Log::Level level,
+                    const Subsystem& subsystem,
+                    const Site& site,
+                    const char* format,
+                    const Data& args)
+{
+   Log::ThreadData& logger = Log::getLoggerData();
+   if (AsyncLogWriter::isRunning() && logger.messageStructure() == Log::Unstructured)
+   {
+      Context context;
+      context.mSite = &site;
+      context.mFormat = format;
+      context.mThreadId = ThreadIf::selfId();
+      Log::currentTime(context.mSeconds, context.mMicroSeconds);
+      if (AsyncLogWriter::post(logger, level, subsystem, context, args))
+      {
+         return;
+      }
+   }
+
+   Log::Guard guard(level, subsystem, site.mFile, site.mLine, site.mMethodName);
+   DeferredLog::format(guard.asStream(), format, args);
+}
+
+void
+DeferredLog::output(Log::ThreadData& logger,
+                    Log::Level level,
+                    const Subsystem& subsystem,
+                    const Context& context,
+                    const Data& args,
+                    Data& line)
+{
+   const Site& site = *context.mSite;
+   line.clear();
+   Data::size_type headerLength = 0;
+   {
+      oDataStream strm(line);
+      if (logger.type() != Log::OnlyExternalNoHeaders)
+      {
+         Log::tags(level, subsystem, site.mFile, site.mLine, strm, logger,
+                   context.mSeconds, context.mMicroSeconds, context.mThreadId);
+         strm << Log::delim;
+         strm.flush();
+         headerLength = line.size();
+      }
+      format(strm, context.mFormat, args);
+   }
+   Log::output(logger, level, subsystem, site.mFile, site.mLine, line, headerLength);
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
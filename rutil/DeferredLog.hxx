@@ -0,0 +1,333 @@
+#ifndef RESIP_DeferredLog_hxx
+#define RESIP_DeferredLog_hxx
+
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/Log.hxx"
+#include "rutil/Logger.hxx"
+
+/**
+   @file Logging macros that leave the formatting to the log writer thread.
+
+   The usual macros (see Logger.hxx) stream their arguments into text on the
+   thread that logs. For hot paths where that costs more than the write
+   itself, the Deferred variants record the argument values in a compact
+   binary form instead and format them when the line is written:
+
+<code>
+#include "rutil/DeferredLog.hxx"
+#define RESIPROCATE_SUBSYSTEM resip::Subsystem::TRANSPORT
+   ...
+   DeferredDebugLog("Processing write for {} ({} bytes)", data->destination, data->data.size());
+</code>
+
+   Each {} in the format (which must be a string literal) takes the next
+   argument; {{ and }} stand for literal braces. The output is the same as
+   streaming the arguments with operator<<.
+
+   Formatting is only deferred while Log::setAsynchronous() is enabled and
+   the logger writes Unstructured lines; otherwise the line is formatted
+   on the spot as the usual macros would. Arithmetic types, strings and
+   Data are copied as they are. Other types are streamed to text at the
+   call site (no faster than DebugLog, but still correct) unless they
+   provide a DeferredLogArg specialization, as Tuple does.
+*/
+
+#define DeferredStackLog(...) \
+DeferredGenericLog(RESIPROCATE_SUBSYSTEM, resip::Log::Stack, __VA_ARGS__)
+
+#define DeferredDebugLog(...) \
+DeferredGenericLog(RESIPROCATE_SUBSYSTEM, resip::Log::Debug, __VA_ARGS__)
+
+#define DeferredInfoLog(...) \
+DeferredGenericLog(RESIPROCATE_SUBSYSTEM, resip::Log::Info, __VA_ARGS__)
+
+#define DeferredWarningLog(...) \
+DeferredGenericLog(RESIPROCATE_SUBSYSTEM, resip::Log::Warning, __VA_ARGS__)
+
+#define DeferredErrLog(...) \
+DeferredGenericLog(RESIPROCATE_SUBSYSTEM, resip::Log::Err, __VA_ARGS__)
+
+#define DeferredCritLog(...) \
+DeferredGenericLog(RESIPROCATE_SUBSYSTEM, resip::Log::Crit, __VA_ARGS__)
+
+#define DeferredGenericLog(system_, level_, ...)                        \
+   do                                                                   \
+   {                                                                    \
+      if (genericLogCheckLevel(level_, system_))                        \
+      {                                                                 \
+         static const resip::DeferredLog::Site _resip_log_site = { __FILE__, __LINE__, __func__ }; \
+         resip::DeferredLog::log(level_, system_, _resip_log_site, __VA_ARGS__); \
+      }                                                                 \
+   } while (false)
+
+#ifdef NO_DEBUG
+// Suppress debug logging at compile time
+#undef DeferredDebugLog
+#define DeferredDebugLog(...)
+#undef DeferredStackLog
+#define DeferredStackLog(...)
+#endif
+
+namespace resip
+{
+
+/**
+   How a type is recorded by the Deferred log macros. encode() appends the
+   decoder (DeferredLog::encodeDecoder()) followed by whatever the decoder
+   needs; the decoder streams the value and returns the first byte past it.
+   The primary template formats the value to text straight away.
+*/
+template <typename T, typename Enable = void>
+struct DeferredLogArg;
+
+/**
+   @brief Records log arguments at the call site and formats them later.
+   @see DeferredLog.hxx for usage.
+*/
+class DeferredLog
+{
+   public:
+      /// Where a Deferred macro is; one static instance per call site.
+      struct Site
+      {
+         const char* mFile;
+         int mLine;
+         const char* mMethodName;
+      };
+
+      /// What the call site knew when it logged; the arguments travel separately.
+      struct Context
+      {
+         const Site* mSite;
+         const char* mFormat;
+         ThreadIf::Id mThreadId;
+         time_t mSeconds;
+         long mMicroSeconds;
+      };
+
+      /// Streams one encoded argument; returns the first byte past it.
+      typedef const char* (*Decoder)(EncodeStream& strm, const char* arg);
+
+      template <size_t N, typename... Args>
+      static void log(Log::Level level,
+                      const Subsystem& subsystem,
+                      const Site& site,
+                      const char (&format)[N],
+                      const Args&... args)
+      {
+         char buffer[256];
+         Data encoded(Data::Borrow, buffer, sizeof(buffer));
+         encoded.clear();
+         encodeAll(encoded, args...);
+         commit(level, subsystem, site, format, encoded);
+      }
+
+      /// Streams format with the {} replaced by the encoded arguments.
+      static void format(EncodeStream& strm, const char* format, const Data& args);
+
+      /** Formats a line queued by log() and hands it to logger, as the
+          log writer thread does. line is scratch space. */
+      static void output(Log::ThreadData& logger,
+                         Log::Level level,
+                         const Subsystem& subsystem,
+                         const Context& context,
+                         const Data& args,
+                         Data& line);
+
+      // for DeferredLogArg specializations
+      static void encodeDecoder(Data& buffer, Decoder decoder)
+      {
+         buffer.append(reinterpret_cast<const char*>(&decoder), sizeof(decoder));
+      }
+
+      template <typename T>
+      static void encodeValue(Data& buffer, const T& value)
+      {
+         buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+      }
+
+      template <typename T>
+      static const char* decodeValue(const char* arg, T& value)
+      {
+         memcpy(&value, arg, sizeof(T));
+         return arg + sizeof(T);
+      }
+
+      static void encodeText(Data& buffer, const char* text, size_t length)
+      {
+         const UInt32 size = (UInt32)length;
+         encodeValue(buffer, size);
+         buffer.append(text, size);
+      }
+
+      static const char* decodeText(const char* arg, const char*& text, UInt32& length)
+      {
+         arg = decodeValue(arg, length);
+         text = arg;
+         return arg + length;
+      }
+
+      /// Decoder for arguments written with encodeText().
+      static const char* decodeTextArg(EncodeStream& strm, const char* arg);
+
+   private:
+      static void encodeAll(Data&)
+      {
+      }
+
+      template <typename T, typename... Rest>
+      static void encodeAll(Data& buffer, const T& first, const Rest&... rest)
+      {
+         DeferredLogArg<T>::encode(buffer, first);
+         encodeAll(buffer, rest...);
+      }
+
+      static void commit(Log::Level level,
+                         const Subsystem& subsystem,
+                         const Site& site,
+                         const char* format,
+                         const Data& args);
+};
+
+template <typename T, typename Enable>
+struct DeferredLogArg
+{
+   static void encode(Data& buffer, const T& value)
+   {
+      Data text;
+      {
+         oDataStream strm(text);
+         strm << value;
+      }
+      DeferredLog::encodeDecoder(buffer, &DeferredLog::decodeTextArg);
+      DeferredLog::encodeText(buffer, text.data(), text.size());
+   }
+};
+
+template <typename T>
+struct DeferredLogArg<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+{
+   static void encode(Data& buffer, const T& value)
+   {
+      DeferredLog::encodeDecoder(buffer, &decode);
+      DeferredLog::encodeValue(buffer, value);
+   }
+
+   static const char* decode(EncodeStream& strm, const char* arg)
+   {
+      T value;
+      arg = DeferredLog::decodeValue(arg, value);
+      strm << value;
+      return arg;
+   }
+};
+
+template <size_t N>
+struct DeferredLogArg<char[N]>
+{
+   static void encode(Data& buffer, const char (&value)[N])
+   {
+      const char* end = static_cast<const char*>(memchr(value, 0, N));
+      DeferredLog::encodeDecoder(buffer, &DeferredLog::decodeTextArg);
+      DeferredLog::encodeText(buffer, value, end ? end - value : N);
+   }
+};
+
+template <>
+struct DeferredLogArg<const char*>
+{
+   static void encode(Data& buffer, const char* value)
+   {
+      if (value == 0)
+      {
+         value = "(null)";
+      }
+      DeferredLog::encodeDecoder(buffer, &DeferredLog::decodeTextArg);
+      DeferredLog::encodeText(buffer, value, strlen(value));
+   }
+};
+
+template <>
+struct DeferredLogArg<char*> : public DeferredLogArg<const char*>
+{
+};
+
+template <>
+struct DeferredLogArg<Data>
+{
+   static void encode(Data& buffer, const Data& value)
+   {
+      DeferredLog::encodeDecoder(buffer, &DeferredLog::decodeTextArg);
+      DeferredLog::encodeText(buffer, value.data(), value.size());
+   }
+};
+
+template <>
+struct DeferredLogArg<std::string>
+{
+   static void encode(Data& buffer, const std::string& value)
+   {
+      DeferredLog::encodeDecoder(buffer, &DeferredLog::decodeTextArg);
+      DeferredLog::encodeText(buffer, value.data(), value.size());
+   }
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
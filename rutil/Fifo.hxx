@@ -23,6 +23,8 @@ class Fifo : public AbstractFifo<Msg*>
       using AbstractFifo<Msg*>::mCondition;
       using AbstractFifo<Msg*>::empty;
       using AbstractFifo<Msg*>::size;
+      using AbstractFifo<Msg*>::drainInbox;
+      using AbstractFifo<Msg*>::mSize;
 
       /// Add a message to the fifo.
       size_t add(Msg* msg);
@@ -89,11 +91,13 @@ void
 Fifo<Msg>::clear()
 {
    Lock lock(mMutex); (void)lock;
+   drainInbox();
    while ( ! mFifo.empty() )
    {
       delete mFifo.front();
       mFifo.pop_front();
    }
+   mSize = 0;
    resip_assert(mFifo.empty());
 }
 
@@ -134,6 +134,20 @@ GeneralCongestionManager::encodeCurrentState(EncodeStream& strm) const
    return strm;
 }
 
+void
+GeneralCongestionManager::visitFifos(FifoVisitor& visitor) const
+{
+   Lock lock(mFifosMutex);
+   for(std::vector<FifoInfo>::const_iterator i=mFifos.begin();
+         i!=mFifos.end();++i)
+   {
+      if(i->fifo)
+      {
+         visitor.visit(*(i->fifo), getRejectionBehaviorInternal(i->fifo));
+      }
+   }
+}
+
 UInt16
 GeneralCongestionManager::getCongestionPercent(const FifoStatsInterface* fifo) const
 {
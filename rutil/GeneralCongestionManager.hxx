@@ -136,6 +136,7 @@ class GeneralCongestionManager : public CongestionManager
 
       virtual void logCurrentState() const;
       virtual EncodeStream& encodeCurrentState(EncodeStream& strm) const;
+      virtual void visitFifos(FifoVisitor& visitor) const;
 
    private:
       /**
@@ -2,8 +2,8 @@
 #define RUTIL_GENERICTIMERQUEUE_HXX
 
 #include "rutil/Timer.hxx"
-#include <set>
-#include <vector>
+#include "rutil/TimerWheel.hxx"
+#include <climits>
 
 namespace resip {
 
@@ -28,6 +28,11 @@ class GenericTimerQueue
             {
                return mEvent;
             }
+
+            UInt64 getWhen() const
+            {
+               return mWhen;
+            }
             
             bool operator<(const TimerEntry<E>& rhs) const
             {
@@ -36,62 +41,58 @@ class GenericTimerQueue
             UInt64 mWhen;
             E* mEvent;
       };
+
+      /// Identifies a timer returned by add(); see cancel().
+      typedef typename TimerWheel<TimerEntry<T> >::Handle Handle;
            
       /// deletes the message associated with the timer as well.
       virtual ~GenericTimerQueue()
       {
-         for (typename std::multiset<TimerEntry<T> >::iterator i = mTimers.begin(); i !=  mTimers.end(); ++i)
-         {
-            delete i->mEvent;            
-         }
+         mTimers.clear(DeleteEvent());
       }
       
       virtual void process()
       {
-         if (!mTimers.empty() && msTillNextTimer() == 0)
+         if (!mTimers.empty())
          {
-            TimerEntry<T> now(0, 0);
-
-            // hacky solution, needs work, insertion from processTimer
-            // caused bizarre infinite loop issues in previous revision;
-            // this code is in desperate need of help
-            typedef typename std::multiset<TimerEntry<T> > TimerSet;
-            typedef std::vector<typename TimerSet::iterator> ItVector;
-            ItVector iterators;
-
-            typename TimerSet::iterator end = mTimers.upper_bound(now);
-            typename TimerSet::iterator begin = mTimers.begin();
-
-            for (typename TimerSet::iterator i = begin; i != end; ++i)
-            {
-               iterators.push_back(i);
-            }
-
-            for (typename ItVector::iterator i = iterators.begin(); i != iterators.end(); ++i)
-            {
-               resip_assert((*i)->getEvent());
-               processTimer((*i)->getEvent());               
-            }
-
-            //!dcm! -- erasing the range didn't work...upper bound was prob. end()
-            for (typename ItVector::iterator i = iterators.begin(); i != iterators.end(); ++i)
+            UInt64 now = Timer::getTimeMs();
+            Handle handle;
+            const TimerEntry<T>* entry;
+            while ((entry = mTimers.expired(now, handle)) != 0)
             {
-               mTimers.erase(*i);
+               // processTimer() takes ownership of the event, and may add
+               // new timers; remove this one from the wheel first.
+               T* event = entry->getEvent();
+               mTimers.cancel(handle);
+               resip_assert(event);
+               processTimer(event);
             }
          }
       }
 
       virtual void processTimer(T*)=0;      
 
-	  void add(T* event, unsigned long msOffset)
-	  {
-   	      TimerEntry<T> t(msOffset, event);
-		  mTimers.insert(t);
-	  }
+      Handle add(T* event, unsigned long msOffset)
+      {
+         return mTimers.push(TimerEntry<T>(msOffset, event));
+      }
+
+      /// Removes a timer that has not fired yet, deleting its event. O(1).
+      /// @return false if the timer already fired or was cancelled.
+      bool cancel(Handle handle)
+      {
+         const TimerEntry<T>* entry = mTimers.find(handle);
+         if (!entry)
+         {
+            return false;
+         }
+         delete entry->getEvent();
+         return mTimers.cancel(handle);
+      }
 
       int size() const
       {
-         return mTimers.size();
+         return (int)mTimers.size();
       }
       
       bool empty() const
@@ -103,7 +104,7 @@ class GenericTimerQueue
       {
          if (!mTimers.empty())
          {
-            UInt64 next = mTimers.begin()->mWhen;
+            UInt64 next = mTimers.nextExpiry();
             UInt64 now = Timer::getTimeMs();
             if (now > next) 
             {
@@ -131,8 +132,16 @@ class GenericTimerQueue
 
       
    protected:
+      struct DeleteEvent
+      {
+         void operator()(const TimerEntry<T>& entry) const
+         {
+            delete entry.getEvent();
+         }
+      };
+
 //      friend std::ostream& operator<<(std::ostream&, const GenericTimerQueue&);
-      std::multiset<TimerEntry<T> > mTimers;
+      TimerWheel<TimerEntry<T> > mTimers;
 };
 
 }
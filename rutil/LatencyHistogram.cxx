@@ -0,0 +1,264 @@
+#include "rutil/LatencyHistogram.hxx"
+
+using namespace resip;
+
+const UInt64 LatencyHistogram::MaxValue;
+
+LatencyHistogram::LatencyHistogram()
+{
+   reset();
+}
+
+LatencyHistogram::LatencyHistogram(const LatencyHistogram& rhs)
+{
+   *this = rhs;
+}
+
+LatencyHistogram&
+LatencyHistogram::operator=(const LatencyHistogram& rhs)
+{
+   if (&rhs != this)
+   {
+      for (int i = 0; i < NumBuckets; ++i)
+      {
+         mCounts[i].store(rhs.mCounts[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+      }
+      mCount.store(rhs.count(), std::memory_order_relaxed);
+      mSum.store(rhs.sum(), std::memory_order_relaxed);
+   }
+   return *this;
+}
+
+void
+LatencyHistogram::reset()
+{
+   for (int i = 0; i < NumBuckets; ++i)
+   {
+      mCounts[i].store(0, std::memory_order_relaxed);
+   }
+   mCount.store(0, std::memory_order_relaxed);
+   mSum.store(0, std::memory_order_relaxed);
+}
+
+LatencyHistogram&
+LatencyHistogram::operator+=(const LatencyHistogram& rhs)
+{
+   for (int i = 0; i < NumBuckets; ++i)
+   {
+      increment(mCounts[i], rhs.mCounts[i].load(std::memory_order_relaxed));
+   }
+   increment(mCount, rhs.count());
+   increment(mSum, rhs.sum());
+   return *this;
+}
+
+LatencyHistogram&
+LatencyHistogram::operator-=(const LatencyHistogram& rhs)
+{
+   for (int i = 0; i < NumBuckets; ++i)
+   {
+      increment(mCounts[i], 0 - rhs.mCounts[i].load(std::memory_order_relaxed));
+   }
+   increment(mCount, 0 - rhs.count());
+   increment(mSum, 0 - rhs.sum());
+   return *this;
+}
+
+UInt64
+LatencyHistogram::mean() const
+{
+   UInt64 n = count();
+   return n ? sum() / n : 0;
+}
+
+UInt64
+LatencyHistogram::min() const
+{
+   for (int i = 0; i < NumBuckets; ++i)
+   {
+      if (mCounts[i].load(std::memory_order_relaxed))
+      {
+         return lowestValueIn(i);
+      }
+   }
+   return 0;
+}
+
+UInt64
+LatencyHistogram::max() const
+{
+   for (int i = NumBuckets - 1; i >= 0; --i)
+   {
+      if (mCounts[i].load(std::memory_order_relaxed))
+      {
+         return highestValueIn(i);
+      }
+   }
+   return 0;
+}
+
+UInt64
+LatencyHistogram::valueAtPercentile(double percentile) const
+{
+   // Sum the buckets rather than trusting mCount, which may not agree
+   // with them if the owner is recording while we look.
+   UInt64 total = 0;
+   for (int i = 0; i < NumBuckets; ++i)
+   {
+      total += mCounts[i].load(std::memory_order_relaxed);
+   }
+   if (total == 0)
+   {
+      return 0;
+   }
+
+   if (percentile < 0)
+   {
+      percentile = 0;
+   }
+   else if (percentile > 100)
+   {
+      percentile = 100;
+   }
+   UInt64 rank = (UInt64)(percentile / 100 * total + 0.5);
+   if (rank == 0)
+   {
+      rank = 1;
+   }
+
+   UInt64 seen = 0;
+   for (int i = 0; i < NumBuckets; ++i)
+   {
+      seen += mCounts[i].load(std::memory_order_relaxed);
+      if (seen >= rank)
+      {
+         return highestValueIn(i);
+      }
+   }
+   return highestValueIn(NumBuckets - 1);
+}
+
+UInt64
+LatencyHistogram::countAtOrBelow(UInt64 value) const
+{
+   UInt64 total = 0;
+   for (int i = 0; i < NumBuckets && highestValueIn(i) <= value; ++i)
+   {
+      total += mCounts[i].load(std::memory_order_relaxed);
+   }
+   return total;
+}
+
+unsigned int
+LatencyHistogram::bucketFor(UInt64 value)
+{
+   if (value < 2 * SubBuckets)
+   {
+      return (unsigned int)value;
+   }
+   if (value >= MaxValue)
+   {
+      return NumBuckets - 1;
+   }
+
+#if defined(__GNUC__)
+   unsigned int top = 63 - __builtin_clzll(value);
+#else
+   unsigned int top = 0;
+   for (UInt64 v = value; v >>= 1;)
+   {
+      ++top;
+   }
+#endif
+   // value >> shift is in [SubBuckets, 2*SubBuckets)
+   unsigned int shift = top - SubBucketBits;
+   return (shift + 1) * SubBuckets + (unsigned int)(value >> shift) - SubBuckets;
+}
+
+UInt64
+LatencyHistogram::lowestValueIn(unsigned int bucket)
+{
+   if (bucket < 2 * SubBuckets)
+   {
+      return bucket;
+   }
+   unsigned int shift = bucket / SubBuckets - 1;
+   return (UInt64)(SubBuckets + bucket % SubBuckets) << shift;
+}
+
+UInt64
+LatencyHistogram::highestValueIn(unsigned int bucket)
+{
+   if (bucket < 2 * SubBuckets)
+   {
+      return bucket;
+   }
+   unsigned int shift = bucket / SubBuckets - 1;
+   return lowestValueIn(bucket) + ((UInt64)1 << shift) - 1;
+}
+
+EncodeStream&
+resip::operator<<(EncodeStream& strm, const LatencyHistogram& histogram)
+{
+   strm << "n " << histogram.count();
+   if (histogram.count())
+   {
+      strm << " mean " << histogram.mean()
+           << " p50 " << histogram.valueAtPercentile(50)
+           << " p90 " << histogram.valueAtPercentile(90)
+           << " p99 " << histogram.valueAtPercentile(99)
+           << " max " << histogram.max();
+   }
+   return strm;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -0,0 +1,144 @@
+#ifndef RESIP_LatencyHistogram_hxx
+#define RESIP_LatencyHistogram_hxx
+
+#include <atomic>
+
+#include "rutil/compat.hxx"
+#include "rutil/resipfaststreams.hxx"
+
+namespace resip
+{
+
+/**
+   @brief A fixed size, log-linear histogram of durations (or any other
+      non-negative integer), in the style of HdrHistogram.
+
+   Values below 2*SubBuckets each get a bucket of their own; above that,
+   every power of two is split into SubBuckets equal buckets, so a value
+   is recorded with a relative error of at most 1/SubBuckets (about 6%)
+   whatever its magnitude. Values of MaxValue and above all land in the
+   last bucket. The unit is up to the caller; the stack records
+   microseconds, which gives a range of about 35 minutes.
+
+   record() is cheap and takes no lock, but it is only safe from one
+   thread at a time: each writer should own its histogram. Any thread may
+   read or copy a histogram while its owner is recording, and gets a
+   snapshot that may be a few values behind. Since everything kept is a
+   count, snapshots can be added and subtracted; there is no separate
+   minimum or maximum, which are taken from the buckets instead.
+*/
+class LatencyHistogram
+{
+   public:
+      enum
+      {
+         SubBucketBits = 4,
+         SubBuckets = 1 << SubBucketBits,
+         MaxValueBits = 31,
+         NumBuckets = (MaxValueBits - SubBucketBits + 1) * SubBuckets
+      };
+      static const UInt64 MaxValue = (UInt64)1 << MaxValueBits;
+
+      LatencyHistogram();
+      LatencyHistogram(const LatencyHistogram& rhs);
+      LatencyHistogram& operator=(const LatencyHistogram& rhs);
+
+      void record(UInt64 value)
+      {
+         increment(mCounts[bucketFor(value)], 1);
+         increment(mCount, 1);
+         increment(mSum, value);
+      }
+
+      void reset();
+
+      LatencyHistogram& operator+=(const LatencyHistogram& rhs);
+      /// rhs has to be an earlier snapshot of this histogram.
+      LatencyHistogram& operator-=(const LatencyHistogram& rhs);
+
+      UInt64 count() const { return mCount.load(std::memory_order_relaxed); }
+      UInt64 sum() const { return mSum.load(std::memory_order_relaxed); }
+      UInt64 mean() const;
+      UInt64 min() const;
+      UInt64 max() const;
+      /** @return the highest value that could have been recorded in the
+          bucket holding the given percentile (0-100) of the values, or 0 if
+          nothing was recorded. */
+      UInt64 valueAtPercentile(double percentile) const;
+      /** @return how many values were recorded in buckets that hold
+          nothing above value; a bucket straddling value is left out. */
+      UInt64 countAtOrBelow(UInt64 value) const;
+
+      static unsigned int bucketFor(UInt64 value);
+      static UInt64 lowestValueIn(unsigned int bucket);
+      static UInt64 highestValueIn(unsigned int bucket);
+
+   private:
+      static void increment(std::atomic<UInt64>& counter, UInt64 n)
+      {
+         // single writer, so no need for an atomic read-modify-write
+         counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+      }
+
+      std::atomic<UInt64> mCounts[NumBuckets];
+      std::atomic<UInt64> mCount;
+      std::atomic<UInt64> mSum;
+};
+
+/// count, mean, p50, p90, p99 and max, on one line
+EncodeStream& operator<<(EncodeStream& strm, const LatencyHistogram& histogram);
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -15,6 +15,7 @@
 #include <sys/types.h>
 #include <time.h>
 
+#include "rutil/AsyncLogWriter.hxx"
 #include "rutil/Log.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/ParseBuffer.hxx"
@@ -380,6 +381,9 @@ Log::initialize(const ConfigParse& configParse, const Data& appName, ExternalLog
 
    unsigned int loggingFileMaxLineCount = configParse.getConfigUnsignedLong("LogFileMaxLines", 50000);
    Log::setMaxLineCount(loggingFileMaxLineCount);
+
+   Log::setAsynchronous(configParse.getConfigBool("LogAsynchronous", false),
+                        configParse.getConfigUnsignedLong("LogAsyncQueueSize", 8192));
 }
 
 void
@@ -579,22 +583,10 @@ Log::toType(const Data& arg)
    }
 }
 
-EncodeStream &
-Log::tags(Log::Level level,
-          const Subsystem& subsystem,
-          const char* pfile,
-          int line,
-          const char* methodName,
-          EncodeStream& strm,
-          MessageStructure messageStructure)
+static const char*
+baseFileName(const char* pfile)
 {
-   char buffer[256] = "";
-   Data ts(Data::Borrow, buffer, sizeof(buffer));
-#if defined( __APPLE__ )
-   pthread_t threadId = pthread_self();
-   const char* file = pfile;
-#elif defined( WIN32 )
-   int threadId = (int)GetCurrentThreadId();
+#if defined( WIN32 )
    const char* file = pfile + strlen(pfile);
    while (file != pfile &&
           *file != '\\')
@@ -605,15 +597,27 @@ Log::tags(Log::Level level,
    {
       ++file;
    }
-#else // #if defined( WIN32 ) || defined( __APPLE__ )
-   pthread_t threadId = pthread_self();
-   const char* file = pfile;
+   return file;
+#else
+   return pfile;
 #endif
+}
 
+EncodeStream &
+Log::tags(Log::Level level,
+          const Subsystem& subsystem,
+          const char* pfile,
+          int line,
+          const char* methodName,
+          EncodeStream& strm,
+          MessageStructure messageStructure)
+{
    switch(messageStructure)
    {
    case JSON_CEE:
       {
+         ThreadIf::Id threadId = ThreadIf::selfId();
+         const char* file = baseFileName(pfile);
          auto now = std::chrono::high_resolution_clock::now();
          std::time_t now_t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
          auto now_ns = now.time_since_epoch().count() % 1000000000;
@@ -656,30 +660,53 @@ Log::tags(Log::Level level,
       break;
    case Unstructured:
    default:
-      if(resip::Log::getLoggerData().type() == Syslog)
       {
-         strm // << mDescriptions[level+1] << Log::delim
-      //        << timestamp(ts) << Log::delim
-      //        << mHostname << Log::delim
-      //        << mAppName << Log::delim
-              << subsystem << Log::delim
-              << threadId << Log::delim
-              << file << ":" << line;
+         time_t seconds;
+         long microSeconds;
+         currentTime(seconds, microSeconds);
+         tags(level, subsystem, pfile, line, strm, getLoggerData(), seconds, microSeconds, ThreadIf::selfId());
       }
-      else
+   }
+   return strm;
+}
+
+EncodeStream &
+Log::tags(Log::Level level,
+          const Subsystem& subsystem,
+          const char* pfile,
+          int line,
+          EncodeStream& strm,
+          const ThreadData& logger,
+          time_t seconds,
+          long microSeconds,
+          ThreadIf::Id threadId)
+{
+   const char* file = baseFileName(pfile);
+   if(logger.type() == Syslog)
+   {
+      strm // << mDescriptions[level+1] << Log::delim
+   //        << timestamp(ts) << Log::delim
+   //        << mHostname << Log::delim
+   //        << mAppName << Log::delim
+           << subsystem << Log::delim
+           << threadId << Log::delim
+           << file << ":" << line;
+   }
+   else
+   {
+      char buffer[256] = "";
+      Data ts(Data::Borrow, buffer, sizeof(buffer));
+      strm << mDescriptions[level+1] << Log::delim
+           << timestamp(ts, seconds, microSeconds) << Log::delim
+           << mAppName;
+      if(!mInstanceName.empty())
       {
-         strm << mDescriptions[level+1] << Log::delim
-              << timestamp(ts) << Log::delim
-              << mAppName;
-         if(!mInstanceName.empty())
-         {
-            strm << '[' << mInstanceName << ']';
-         }
-         strm << Log::delim
-              << subsystem << Log::delim
-              << threadId << Log::delim
-              << file << ":" << line;
+         strm << '[' << mInstanceName << ']';
       }
+      strm << Log::delim
+           << subsystem << Log::delim
+           << threadId << Log::delim
+           << file << ":" << line;
    }
    return strm;
 }
@@ -692,27 +719,48 @@ Log::timestamp()
    return timestamp(result);
 }
 
+void
+Log::currentTime(time_t& seconds, long& microSeconds)
+{
+#ifdef WIN32 
+   SYSTEMTIME systemTime;
+   time(&seconds);
+   GetLocalTime(&systemTime);
+   microSeconds = systemTime.wMilliseconds * 1000; 
+#else 
+   struct timeval tv; 
+   if (gettimeofday (&tv, NULL) == -1)
+   {
+      seconds = (time_t)-1;
+      microSeconds = 0;
+      return;
+   }
+   seconds = (time_t) tv.tv_sec;
+   microSeconds = (long) tv.tv_usec;
+#endif   
+}
+
 Data&
 Log::timestamp(Data& res) 
+{
+   time_t seconds;
+   long microSeconds;
+   currentTime(seconds, microSeconds);
+   return timestamp(res, seconds, microSeconds);
+}
+
+Data&
+Log::timestamp(Data& res, time_t timeInSeconds, long microSeconds) 
 {
    char* datebuf = const_cast<char*>(res.data());
    const unsigned int datebufSize = 256;
    res.clear();
    
-#ifdef WIN32 
-   int result = 1; 
-   SYSTEMTIME systemTime;
-   struct { time_t tv_sec; int tv_usec; } tv = {0,0};
-   time(&tv.tv_sec);
-   GetLocalTime(&systemTime);
-   tv.tv_usec = systemTime.wMilliseconds * 1000; 
-#else 
+#ifndef WIN32 
    struct tm localTimeResult;
-   struct timeval tv; 
-   int result = gettimeofday (&tv, NULL);
 #endif   
 
-   if (result == -1)
+   if (timeInSeconds == (time_t)-1)
    {
       /* If we can't get the time of day, don't print a timestamp.
          Under Unix, this will never happen:  gettimeofday can fail only
@@ -722,9 +770,6 @@ Log::timestamp(Data& res)
    }
    else
    {
-      /* The tv_sec field represents the number of seconds passed since
-         the Epoch, which is exactly the argument gettimeofday needs. */
-      const time_t timeInSeconds = (time_t) tv.tv_sec;
       strftime (datebuf,
                 datebufSize,
                 "%Y%m%d-%H%M%S", /* guaranteed to fit in 256 chars,
@@ -739,7 +784,7 @@ Log::timestamp(Data& res)
    char msbuf[5];
    /* Dividing (without remainder) by 1000 rounds the microseconds
       measure to the nearest millisecond. */
-   result = snprintf(msbuf, 5, ".%3.3ld", long(tv.tv_usec / 1000));
+   int result = snprintf(msbuf, 5, ".%3.3ld", microSeconds / 1000);
    if(result < 0)
    {
       // snprint can error (negative return code) and the compiler now generates a warning
@@ -881,11 +926,14 @@ int Log::localLoggerReinitialize(Log::LocalLoggerId loggerId,
                                  ExternalLogger* externalLogger,
                                  MessageStructure messageStructure)
 {
+   flush();
    return mLocalLoggerMap.reinitialize(loggerId, type, level, logFileName, externalLogger, messageStructure);
 }
 
 int Log::localLoggerRemove(Log::LocalLoggerId loggerId)
 {
+   // queued lines point at the logger
+   flush();
    return mLocalLoggerMap.remove(loggerId);
 }
 
@@ -907,6 +955,37 @@ int Log::setThreadLocalLogger(Log::LocalLoggerId loggerId)
    return (loggerId == 0) || (pData != NULL)?0:1;
 }
 
+void
+Log::setAsynchronous(bool enable, unsigned int queueSize)
+{
+   if (enable)
+   {
+      AsyncLogWriter::start(queueSize);
+   }
+   else
+   {
+      AsyncLogWriter::stop();
+   }
+}
+
+bool
+Log::isAsynchronous()
+{
+   return AsyncLogWriter::isRunning();
+}
+
+void
+Log::flush()
+{
+   AsyncLogWriter::flush();
+}
+
+UInt64
+Log::getDroppedLines()
+{
+   return AsyncLogWriter::getDroppedLines();
+}
+
 std::ostream&
 Log::Instance(unsigned int bytesToWrite)
 {
@@ -1113,25 +1192,42 @@ Log::Guard::~Guard()
 
    mStream.flush();
 
-   if (resip::Log::getExternal())
+   ThreadData& logger = resip::Log::getLoggerData();
+   if (AsyncLogWriter::post(logger, mLevel, mSubsystem, mFile, mLine, mData, mHeaderLength))
+   {
+      return;
+   }
+   output(logger, mLevel, mSubsystem, mFile, mLine, mData, mHeaderLength);
+}
+
+void
+Log::output(ThreadData& logger,
+            Level level,
+            const Subsystem& subsystem,
+            const char* file,
+            int line,
+            Data& message,
+            Data::size_type headerLength)
+{
+   if (logger.mExternalLogger)
    {
       const resip::Data rest(resip::Data::Share,
-                             mData.data() + mHeaderLength,
-                             (int)mData.size() - mHeaderLength);
-      if (!(*resip::Log::getExternal())(mLevel, 
-                                        mSubsystem, 
-                                        resip::Log::getAppName(),
-                                        mFile,
-                                        mLine, 
-                                        rest, 
-                                        mData,
-                                        mInstanceName))
+                             message.data() + headerLength,
+                             (int)message.size() - headerLength);
+      if (!(*logger.mExternalLogger)(level, 
+                                     subsystem, 
+                                     resip::Log::getAppName(),
+                                     file,
+                                     line, 
+                                     rest, 
+                                     message,
+                                     mInstanceName))
       {
          return;
       }
    }
     
-   Type logType = resip::Log::getLoggerData().mType;
+   Type logType = logger.type();
 
    if(logType == resip::Log::OnlyExternal ||
       logType == resip::Log::OnlyExternalNoHeaders) 
@@ -1143,18 +1239,18 @@ Log::Guard::~Guard()
    // !dlb! implement VSDebugWindow as an external logger
    if (logType == resip::Log::VSDebugWindow)
    {
-      mData += "\r\n";
-      OutputToWin32DebugWindow(mData);
+      message += "\r\n";
+      OutputToWin32DebugWindow(message);
    }
    else 
    {
       // endl is magic in syslog -- so put it here
-      std::ostream& _instance = Instance((int)mData.size()+2);
+      std::ostream& _instance = logger.Instance((int)message.size()+2);
       if (logType == resip::Log::Syslog)
       {
-         _instance << mLevel;
+         _instance << level;
       }
-      _instance << mData << std::endl;  
+      _instance << message << std::endl;  
    }
 }
 
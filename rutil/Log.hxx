@@ -9,6 +9,7 @@
 #endif
 
 #include <set>
+#include <time.h>
 
 #include "rutil/ConfigParse.hxx"
 #include "rutil/Mutex.hxx"
@@ -164,6 +165,7 @@ class Log
                                 MessageStructure messageStructure);
 
       static Data& timestamp(Data& result);
+      static Data& timestamp(Data& result, time_t seconds, long microSeconds);
       static Data timestamp();
       static ExternalLogger* getExternal()
       {
@@ -281,6 +283,21 @@ class Log
       static int setThreadLocalLogger(LocalLoggerId loggerId);
 
 
+      /** @brief Write log lines from a dedicated writer thread.
+      * Each logging thread formats its line as usual and queues it in a
+      * ring of \p queueSize lines of its own, without taking any lock
+      * shared with other logging threads. A line that finds the ring full
+      * is dropped and counted (see getDroppedLines()) rather than blocking.
+      * While enabled, ExternalLogger callbacks run on the writer thread.
+      * Disabling writes out whatever is still queued first.
+      */
+      static void setAsynchronous(bool enable, unsigned int queueSize = 8192);
+      static bool isAsynchronous();
+      /// Write out every line queued so far (no-op unless asynchronous).
+      static void flush();
+      /// Number of lines dropped because a thread's queue was full.
+      static UInt64 getDroppedLines();
+
       static std::ostream& Instance(unsigned int bytesToWrite);
       static bool isLogging(Log::Level level, const Subsystem&);
       static void OutputToWin32DebugWindow(const Data& result);      
@@ -337,6 +354,7 @@ class Log
             unsigned int maxByteCount() { return mMaxByteCount ? mMaxByteCount : MaxByteCount; }  // return local max, if not set use global max
             bool keepAllLogFiles() { return mKeepAllLogFilesSet ? mKeepAllLogFiles : KeepAllLogFiles; } // return local if set, if not use global setting
             Type type() const {return mType;}
+            MessageStructure messageStructure() const {return mMessageStructure;}
 
             void setKeepAllLogFiles(bool keepAllLogFiles) { mKeepAllLogFiles = keepAllLogFiles; mKeepAllLogFilesSet = true; }
 
@@ -375,6 +393,27 @@ class Log
       static const int mSyslogPriority[];
       static Data mInstanceName;
 
+      /// Unstructured header for a line logged by threadId at the given time.
+      static EncodeStream& tags(Log::Level level,
+                                const Subsystem& subsystem,
+                                const char* file,
+                                int line,
+                                EncodeStream& strm,
+                                const ThreadData& logger,
+                                time_t seconds,
+                                long microSeconds,
+                                ThreadIf::Id threadId);
+      static void currentTime(time_t& seconds, long& microSeconds);
+
+      /// Hand a formatted line to logger's external logger and stream.
+      static void output(ThreadData& logger,
+                         Level level,
+                         const Subsystem& subsystem,
+                         const char* file,
+                         int line,
+                         Data& message,
+                         Data::size_type headerLength);
+
       static ThreadData &getLoggerData()
       {
          ThreadData* pData = static_cast<ThreadData*>(ThreadIf::tlsGetValue(*Log::mLocalLoggerKey));
@@ -433,6 +472,8 @@ class Log
 
       friend void ::freeLocalLogger(void* pThreadData);
       friend class LogStaticInitializer;
+      friend class AsyncLogWriter;
+      friend class DeferredLog;
       static LocalLoggerMap mLocalLoggerMap;
       static ThreadIf::TlsKey* mLocalLoggerKey;
 
@@ -0,0 +1,321 @@
+#ifndef RESIP_MpscQueue_hxx
+#define RESIP_MpscQueue_hxx
+
+#include <atomic>
+#include <cstddef>
+
+namespace resip
+{
+
+/**
+   @brief An unbounded multi-producer/single-consumer queue.
+
+   push() may be called from any number of threads concurrently and never
+   takes a lock: it is a single atomic exchange on the head pointer (the
+   intrusive MPSC node queue described by D. Vyukov). Only one thread may
+   call popAll() at a time; AbstractFifo guarantees this by draining with
+   its mutex held.
+
+   Nodes are recycled through a NodePool rather than allocated per push,
+   so once the queues of a process have reached their working size
+   neither producers nor the consumer go to the allocator (and its lock).
+
+   A producer that is preempted between swinging the head and linking its
+   node leaves a gap that briefly hides the nodes behind it from the
+   consumer. size() still counts them, since it is incremented before the
+   node is published; callers must not infer emptiness from popAll()
+   returning 0 alone.
+
+   @note All atomic operations are sequentially consistent. AbstractFifo
+   relies on this to decide, without a lock, whether a consumer might be
+   waiting for the element just pushed.
+
+   @ingroup message_passing
+*/
+template <typename T>
+class MpscQueue
+{
+   public:
+      MpscQueue() : mHead(&mStub), mTail(&mStub), mSize(0)
+      {
+         mStub.mNext.store(0);
+      }
+
+      ~MpscQueue()
+      {
+         NodeBase* node = mTail;
+         while (node)
+         {
+            NodeBase* next = node->mNext.load();
+            if (node != &mStub)
+            {
+               NodePool::release(static_cast<Node*>(node));
+            }
+            node = next;
+         }
+      }
+
+      /**
+         Appends an element. Safe to call from any thread.
+         @return the number of elements in the queue including this one.
+      */
+      size_t push(const T& item)
+      {
+         size_t count = mSize.fetch_add(1) + 1;
+         Node* node = NodePool::acquire(item);
+         NodeBase* prev = mHead.exchange(node);
+         prev->mNext.store(node);
+         return count;
+      }
+
+      /**
+         Moves every element currently reachable onto the back of out (which
+         must support push_back()). Consumer side only.
+         @return the number of elements moved.
+      */
+      template <typename Container>
+      size_t popAll(Container& out)
+      {
+         size_t count = 0;
+         for (NodeBase* next = mTail->mNext.load(); next; next = mTail->mNext.load())
+         {
+            out.push_back(static_cast<Node*>(next)->mValue);
+            // The node just consumed becomes the new dummy tail; the old
+            // tail can go.
+            if (mTail != &mStub)
+            {
+               NodePool::release(static_cast<Node*>(mTail));
+            }
+            mTail = next;
+            ++count;
+         }
+         if (count)
+         {
+            mSize.fetch_sub(count);
+         }
+         return count;
+      }
+
+      /// Number of elements pushed and not yet popped; safe from any thread.
+      size_t size() const
+      {
+         return mSize.load();
+      }
+
+   private:
+      struct NodeBase
+      {
+         std::atomic<NodeBase*> mNext;
+      };
+
+      struct Node : public NodeBase
+      {
+         explicit Node(const T& value) : mValue(value)
+         {
+            this->mNext.store(0);
+         }
+         T mValue;
+      };
+
+      /**
+         Free nodes, shared by every MpscQueue<T> in the process. Each
+         thread keeps the nodes it releases in a private cache and takes
+         from that first. A thread whose cache is empty takes the whole
+         shared list with one atomic exchange; a thread whose cache grows
+         past CacheMax hands all of it back with one compare-exchange.
+         Nothing ever pops a single node off the shared list, which keeps
+         it free of the ABA problem. The pool keeps as many nodes as were
+         ever in flight at once.
+      */
+      class NodePool
+      {
+         public:
+            static Node* acquire(const T& value)
+            {
+               Cache& cache = localCache();
+               if (!cache.mHead)
+               {
+                  cache.take(sharedList().mHead.exchange(0));
+               }
+               Node* node = cache.pop();
+               if (!node)
+               {
+                  return new Node(value);
+               }
+               node->mValue = value;
+               node->mNext.store(0);
+               return node;
+            }
+
+            static void release(Node* node)
+            {
+               Cache& cache = localCache();
+               cache.push(node);
+               if (cache.mCount > CacheMax)
+               {
+                  cache.giveBack();
+               }
+            }
+
+         private:
+            static const size_t CacheMax = 256;
+
+            struct SharedList
+            {
+               SharedList() : mHead(0) {}
+               ~SharedList()
+               {
+                  NodeBase* node = mHead.exchange(0);
+                  while (node)
+                  {
+                     NodeBase* next = node->mNext.load(std::memory_order_relaxed);
+                     delete static_cast<Node*>(node);
+                     node = next;
+                  }
+               }
+               std::atomic<NodeBase*> mHead;
+            };
+
+            struct Cache
+            {
+               Cache() : mHead(0), mTail(0), mCount(0) {}
+               ~Cache()
+               {
+                  giveBack();
+               }
+
+               void push(Node* node)
+               {
+                  node->mNext.store(mHead, std::memory_order_relaxed);
+                  if (!mHead)
+                  {
+                     mTail = node;
+                  }
+                  mHead = node;
+                  ++mCount;
+               }
+
+               Node* pop()
+               {
+                  Node* node = mHead;
+                  if (node)
+                  {
+                     mHead = static_cast<Node*>(node->mNext.load(std::memory_order_relaxed));
+                     if (!mHead)
+                     {
+                        mTail = 0;
+                     }
+                     --mCount;
+                  }
+                  return node;
+               }
+
+               // Only called with the cache empty.
+               void take(NodeBase* list)
+               {
+                  mHead = static_cast<Node*>(list);
+                  for (NodeBase* node = list; node; node = node->mNext.load(std::memory_order_relaxed))
+                  {
+                     mTail = static_cast<Node*>(node);
+                     ++mCount;
+                  }
+               }
+
+               void giveBack()
+               {
+                  if (!mHead)
+                  {
+                     return;
+                  }
+                  std::atomic<NodeBase*>& shared = sharedList().mHead;
+                  NodeBase* old = shared.load();
+                  do
+                  {
+                     mTail->mNext.store(old, std::memory_order_relaxed);
+                  } while (!shared.compare_exchange_weak(old, mHead));
+                  mHead = mTail = 0;
+                  mCount = 0;
+               }
+
+               Node* mHead;
+               Node* mTail;
+               size_t mCount;
+            };
+
+            static SharedList& sharedList()
+            {
+               static SharedList list;
+               return list;
+            }
+
+            static Cache& localCache()
+            {
+               static thread_local Cache cache;
+               return cache;
+            }
+      };
+
+      NodeBase mStub;
+      std::atomic<NodeBase*> mHead;
+      NodeBase* mTail;
+      std::atomic<size_t> mSize;
+
+      // no value semantics
+      MpscQueue(const MpscQueue&);
+      MpscQueue& operator=(const MpscQueue&);
+};
+
+} // namespace resip
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -4,6 +4,7 @@
 #include <limits>
 #include <memory>
 #include <stddef.h>
+#include <utility>
 
 // .bwc. gcc 4.2 and above support stateful allocators. I don't know about other 
 // compilers; if you do, add them here please.
@@ -130,14 +131,17 @@ class StlPoolAllocator
          return std::numeric_limits<size_type>::max()/_sz;
       }
 
-      void construct(pointer p, const_reference orig)
+      // Forwards, so that containers can move elements when they grow
+      template<typename U, typename... Args>
+      void construct(U* p, Args&&... args)
       {
-         new (p) T(orig);
+         new ((void*)p) U(std::forward<Args>(args)...);
       }
 
-      void destroy(pointer ptr)
+      template<typename U>
+      void destroy(U* ptr)
       {
-         ptr->~T();
+         ptr->~U();
       }
 
       bool operator==(const StlPoolAllocator& rhs) const
@@ -105,6 +105,10 @@ class TimeLimitFifo : public AbstractFifo< Timestamped<Msg*> >
       using AbstractFifo< Timestamped<Msg*> >::empty;
       using AbstractFifo< Timestamped<Msg*> >::size;
       using AbstractFifo< Timestamped<Msg*> >::onMessagePushed;
+      using AbstractFifo< Timestamped<Msg*> >::drainInbox;
+      using AbstractFifo< Timestamped<Msg*> >::mSize;
+      using AbstractFifo< Timestamped<Msg*> >::pendingCount;
+      using AbstractFifo< Timestamped<Msg*> >::isLockFree;
 
       /// @brief Add a message to the fifo.
       /// return true iff succeeds
@@ -125,6 +129,10 @@ class TimeLimitFifo : public AbstractFifo< Timestamped<Msg*> >
       ///    ignore will go past that limit to the extent of the queue (eg. 
       ///    internal will basically not drop anything
       ///
+      ///    In lock-free mode the limits are checked against the count and
+      ///    time-depth as of the consumer's last visit, so a burst may
+      ///    briefly overshoot them.
+      ///
       bool add(Msg* msg, DepthUsage usage);
 
       /** 
@@ -206,8 +214,13 @@ class TimeLimitFifo : public AbstractFifo< Timestamped<Msg*> >
       */
       virtual void setTimeDepthTolerance(unsigned int maxSecs);
 
+   protected:
+      virtual void onMessagePopped(unsigned int num=1);
+      virtual void onMessagePushed(int num);
+
    private:
       time_t timeDepthInternal() const;
+      void publishOldest();
       inline bool wouldAcceptInteral(DepthUsage usage) const;
       TimeLimitFifo(const TimeLimitFifo& rhs);
       TimeLimitFifo& operator=(const TimeLimitFifo& rhs);
@@ -215,6 +228,8 @@ class TimeLimitFifo : public AbstractFifo< Timestamped<Msg*> >
       time_t mMaxDurationSecs;
       unsigned int mMaxSize;
       unsigned int mUnreservedMaxSize;
+      // Timestamp of mFifo.front() (0 if empty), kept for lock-free producers
+      std::atomic<time_t> mOldest;
 };
 
 template <class Msg>
@@ -223,7 +238,8 @@ TimeLimitFifo<Msg>::TimeLimitFifo(unsigned int maxDurationSecs,
    : AbstractFifo< Timestamped<Msg*> >(),
      mMaxDurationSecs(maxDurationSecs),
      mMaxSize(maxSize),
-     mUnreservedMaxSize((int)((maxSize*8)/10)) // !dlb! random guess
+     mUnreservedMaxSize((int)((maxSize*8)/10)), // !dlb! random guess
+     mOldest(0)
 {}
 
 template <class Msg>
@@ -238,6 +254,16 @@ bool
 TimeLimitFifo<Msg>::add(Msg* msg,
                         DepthUsage usage)
 {
+   if (isLockFree())
+   {
+      if (wouldAcceptInteral(usage))
+      {
+         AbstractFifo< Timestamped<Msg*> >::add(Timestamped<Msg*>(msg, time(0)));
+         return true;
+      }
+      return false;
+   }
+
    Lock lock(mMutex); (void)lock;
 
    if (wouldAcceptInteral(usage))
@@ -287,6 +313,13 @@ template <class Msg>
 time_t
 TimeLimitFifo<Msg>::timeDepthInternal() const
 {
+   if (isLockFree())
+   {
+      // Anything still in the inbox is younger than mFifo.front()
+      time_t oldest = mOldest.load();
+      return oldest ? time(0) - oldest : 0;
+   }
+
    if(mFifo.empty())
    {
       return 0;
@@ -295,12 +328,41 @@ TimeLimitFifo<Msg>::timeDepthInternal() const
    return time(0) - mFifo.front().getTime();
 }
 
+template <class Msg>
+void
+TimeLimitFifo<Msg>::publishOldest()
+{
+   if (isLockFree())
+   {
+      mOldest.store(mFifo.empty() ? 0 : mFifo.front().getTime());
+   }
+}
+
+template <class Msg>
+void
+TimeLimitFifo<Msg>::onMessagePopped(unsigned int num)
+{
+   AbstractFifo< Timestamped<Msg*> >::onMessagePopped(num);
+   publishOldest();
+}
+
+template <class Msg>
+void
+TimeLimitFifo<Msg>::onMessagePushed(int num)
+{
+   AbstractFifo< Timestamped<Msg*> >::onMessagePushed(num);
+   publishOldest();
+}
+
 template <class Msg>
 bool
 TimeLimitFifo<Msg>::wouldAcceptInteral(DepthUsage usage) const
 {
+   // Without the lock (lock-free mode) only the counters are safe to read
+   const size_t count = isLockFree() ? pendingCount() : mFifo.size();
+
    if ((mMaxSize != 0 &&
-        mFifo.size() >= mMaxSize))
+        count >= mMaxSize))
    {
       return false;
    }
@@ -311,7 +373,7 @@ TimeLimitFifo<Msg>::wouldAcceptInteral(DepthUsage usage) const
    }
 
    if (mUnreservedMaxSize != 0 &&
-       mFifo.size() >= mUnreservedMaxSize)
+       count >= mUnreservedMaxSize)
    {
       return false;
    }
@@ -323,7 +385,7 @@ TimeLimitFifo<Msg>::wouldAcceptInteral(DepthUsage usage) const
 
    resip_assert(usage == EnforceTimeDepth);
 
-   if (mFifo.size() == 0 ||
+   if (count == 0 ||
        mMaxDurationSecs == 0 ||
        timeDepthInternal() < mMaxDurationSecs)
    {
@@ -346,12 +408,15 @@ void
 TimeLimitFifo<Msg>::clear()
 {
    Lock lock(mMutex); (void)lock;
+   drainInbox();
 
    while (!mFifo.empty())
    {
       delete mFifo.front().getMsg();
       mFifo.pop_front();
    }
+   mSize = 0;
+   publishOldest();
 }
 
 template <class Msg>
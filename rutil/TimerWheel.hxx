@@ -0,0 +1,559 @@
+#ifndef RESIP_TimerWheel_hxx
+#define RESIP_TimerWheel_hxx
+
+#include <deque>
+#include <new>
+#include <type_traits>
+
+#include "rutil/compat.hxx"
+#include "rutil/ResipAssert.h"
+#include "rutil/Timer.hxx"
+
+namespace resip
+{
+
+/**
+   @brief A hierarchical hashed timing wheel with O(1) insert and cancel.
+
+   Elements must provide UInt64 getWhen() const, an absolute expiry in
+   milliseconds on the Timer::getTimeMs() clock. The wheel has a resolution
+   of one millisecond: four levels of 256 slots each cover 2^32 ms (about 50
+   days) ahead of the current tick, and anything further out waits on an
+   overflow list that is only looked at once per 2^32 ms. Entries that are
+   already in the past when pushed go straight onto the due list.
+
+   push() links the element onto the tail of a slot and returns a Handle
+   that cancel() can later use to unlink it, so neither operation depends
+   on the number of pending timers. Handles carry a generation count, so
+   cancelling a timer that has already fired (or been cancelled) is a
+   harmless no-op rather than a use-after-free.
+
+   Expiry is driven by expired(), which advances the wheel up to the time
+   given, cascading higher level slots down as their turn comes round.
+   Elements on different ticks are returned in time order; there is no
+   ordering among elements due on the same tick.
+
+   Storage is a deque of nodes that are recycled through a free list, so a
+   steady state of add/fire/cancel does not touch the heap at all.
+
+   @ingroup timers
+*/
+template <class T>
+class TimerWheel
+{
+   public:
+      /// Identifies a pushed element; 0 is never a valid handle.
+      typedef UInt64 Handle;
+
+      explicit TimerWheel(UInt64 now = Timer::getTimeMs())
+         : mFree(Nil),
+           mCurrent(now),
+           mSize(0)
+      {
+         for (unsigned int i = 0; i < NumLists; ++i)
+         {
+            mHeads[i] = mTails[i] = Nil;
+         }
+         for (unsigned int l = 0; l < Levels; ++l)
+         {
+            for (unsigned int w = 0; w < Words; ++w)
+            {
+               mOccupied[l][w] = 0;
+            }
+         }
+      }
+
+      /// Destroys any elements still pending; payloads they point at are
+      /// the caller's business (see clear()).
+      ~TimerWheel()
+      {
+         for (size_t i = 0; i < mNodes.size(); ++i)
+         {
+            if (mNodes[i].mList != FreeList)
+            {
+               mNodes[i].value().~T();
+            }
+         }
+      }
+
+      /// Adds a copy of timer. O(1).
+      Handle push(const T& timer)
+      {
+         UInt32 index;
+         if (mFree != Nil)
+         {
+            index = mFree;
+            mFree = mNodes[index].mNext;
+         }
+         else
+         {
+            index = (UInt32)mNodes.size();
+            mNodes.push_back(Node());
+         }
+         Node& node = mNodes[index];
+         new (&node.mStorage) T(timer);
+         link(index, listFor(timer.getWhen()));
+         ++mSize;
+         return makeHandle(index);
+      }
+
+      /// Removes the element identified by handle. O(1).
+      /// @return false if it already fired or was cancelled.
+      bool cancel(Handle handle)
+      {
+         if (!pending(handle))
+         {
+            return false;
+         }
+         UInt32 index = UInt32(handle & 0xFFFFFFFF);
+         unlink(index);
+         release(index);
+         return true;
+      }
+
+      /// @return true if handle refers to an element still in the wheel.
+      bool pending(Handle handle) const
+      {
+         UInt32 index = UInt32(handle & 0xFFFFFFFF);
+         return index < mNodes.size() &&
+            mNodes[index].mList != FreeList &&
+            mNodes[index].mGeneration == UInt32(handle >> 32);
+      }
+
+      /**
+         Returns an element whose time is not after now, advancing the wheel
+         as needed, or 0 if there is none. now must not go backwards from
+         one call to the next. The element stays in the wheel
+         until the caller cancels it through handle, which allows the
+         element to be processed in place (and to push new timers while
+         doing so).
+      */
+      const T* expired(UInt64 now, Handle& handle)
+      {
+         for (;;)
+         {
+            UInt32 head = mHeads[DueList];
+            if (head != Nil)
+            {
+               handle = makeHandle(head);
+               return &mNodes[head].value();
+            }
+            if (mCurrent > now)
+            {
+               return 0;
+            }
+            if (mSize == 0)
+            {
+               mCurrent = now + 1;
+               return 0;
+            }
+
+            unsigned int slot = unsigned(mCurrent & SlotMask);
+            if (mHeads[slot] != Nil)
+            {
+               moveAll(slot, DueList);
+            }
+
+            // Skip straight to the next occupied tick of this rotation, or
+            // to the next tick at which anything cascades down. Nothing
+            // happens in between, however long the gap.
+            int next = nextOccupied(0, slot + 1);
+            UInt64 target = next >= 0 ? (mCurrent & ~UInt64(SlotMask)) + unsigned(next)
+                                      : nextCascade();
+            if (target > now + 1)
+            {
+               target = now + 1;
+            }
+            mCurrent = target;
+            if ((mCurrent & SlotMask) == 0)
+            {
+               cascade();
+            }
+         }
+      }
+
+      /// The earliest pending element. Not O(1); intended for diagnostics
+      /// and teardown.
+      const T& top() const
+      {
+         return mNodes[topIndex()].value();
+      }
+
+      /// Removes the earliest pending element.
+      void pop()
+      {
+         UInt32 index = topIndex();
+         unlink(index);
+         release(index);
+      }
+
+      /**
+         The expiry of the earliest pending element if it is due within the
+         next level 1 rotation (65 s), otherwise a lower bound on it: the
+         time at which its slot cascades. Suitable for computing how long a
+         select loop may sleep; waking up early just cascades a slot.
+         @pre !empty()
+      */
+      UInt64 nextExpiry() const
+      {
+         resip_assert(mSize);
+         if (mHeads[DueList] != Nil)
+         {
+            return mNodes[earliestOn(DueList)].value().getWhen();
+         }
+         for (unsigned int level = 0; level < Levels; ++level)
+         {
+            unsigned int shift = level * SlotBits;
+            int slot = nextOccupied(level, unsigned((mCurrent >> shift) & SlotMask));
+            if (slot >= 0)
+            {
+               if (level == 0)
+               {
+                  // a level 0 slot holds a single tick
+                  return mNodes[mHeads[slot]].value().getWhen();
+               }
+               if (level == 1)
+               {
+                  return mNodes[earliestOn(Slots + unsigned(slot))].value().getWhen();
+               }
+               UInt64 base = mCurrent & ~((UInt64(1) << (shift + SlotBits)) - 1);
+               return base + (UInt64(slot) << shift);
+            }
+         }
+         return (mCurrent | ((UInt64(1) << (Levels * SlotBits)) - 1)) + 1;
+      }
+
+      /// @return the element identified by handle, or 0 if it is not pending.
+      const T* find(Handle handle) const
+      {
+         return pending(handle) ? &mNodes[UInt32(handle & 0xFFFFFFFF)].value() : 0;
+      }
+
+      /// Calls func(element) for every pending element, in no particular
+      /// order, and then empties the wheel.
+      template <class Func>
+      void clear(Func func)
+      {
+         for (size_t i = 0; i < mNodes.size(); ++i)
+         {
+            if (mNodes[i].mList != FreeList)
+            {
+               func(mNodes[i].value());
+               unlink(UInt32(i));
+               release(UInt32(i));
+            }
+         }
+      }
+
+      size_t size() const
+      {
+         return mSize;
+      }
+
+      bool empty() const
+      {
+         return mSize == 0;
+      }
+
+   private:
+      enum
+      {
+         SlotBits = 8,
+         Slots = 1 << SlotBits,
+         SlotMask = Slots - 1,
+         Levels = 4,
+         Words = Slots / 64,
+         DueList = Levels * Slots,
+         OverflowList = DueList + 1,
+         NumLists = OverflowList + 1,
+         Replace = NumLists,
+         FreeList = 0xFFFF
+      };
+      static const UInt32 Nil = 0xFFFFFFFF;
+
+      struct Node
+      {
+         Node() : mPrev(Nil), mNext(Nil), mGeneration(1), mList(FreeList) {}
+
+         T& value() { return *reinterpret_cast<T*>(&mStorage); }
+         const T& value() const { return *reinterpret_cast<const T*>(&mStorage); }
+
+         UInt32 mPrev;
+         UInt32 mNext;
+         UInt32 mGeneration;
+         UInt16 mList;
+         typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type mStorage;
+      };
+
+      Handle makeHandle(UInt32 index) const
+      {
+         return (UInt64(mNodes[index].mGeneration) << 32) | index;
+      }
+
+      unsigned int listFor(UInt64 when) const
+      {
+         if (when < mCurrent)
+         {
+            return DueList;
+         }
+         UInt64 diff = when ^ mCurrent;
+         for (unsigned int level = 0; level < Levels; ++level)
+         {
+            unsigned int shift = level * SlotBits;
+            if ((diff >> (shift + SlotBits)) == 0)
+            {
+               return level * Slots + unsigned((when >> shift) & SlotMask);
+            }
+         }
+         return OverflowList;
+      }
+
+      void link(UInt32 index, unsigned int list)
+      {
+         Node& node = mNodes[index];
+         node.mList = UInt16(list);
+         node.mNext = Nil;
+         node.mPrev = mTails[list];
+         if (mTails[list] != Nil)
+         {
+            mNodes[mTails[list]].mNext = index;
+         }
+         else
+         {
+            mHeads[list] = index;
+            if (list < DueList)
+            {
+               mOccupied[list / Slots][(list % Slots) / 64] |= UInt64(1) << (list % 64);
+            }
+         }
+         mTails[list] = index;
+      }
+
+      void unlink(UInt32 index)
+      {
+         Node& node = mNodes[index];
+         unsigned int list = node.mList;
+         if (node.mPrev != Nil)
+         {
+            mNodes[node.mPrev].mNext = node.mNext;
+         }
+         else
+         {
+            mHeads[list] = node.mNext;
+         }
+         if (node.mNext != Nil)
+         {
+            mNodes[node.mNext].mPrev = node.mPrev;
+         }
+         else
+         {
+            mTails[list] = node.mPrev;
+         }
+         if (mHeads[list] == Nil && list < DueList)
+         {
+            mOccupied[list / Slots][(list % Slots) / 64] &= ~(UInt64(1) << (list % 64));
+         }
+      }
+
+      void release(UInt32 index)
+      {
+         Node& node = mNodes[index];
+         node.value().~T();
+         node.mList = FreeList;
+         if (++node.mGeneration == 0)
+         {
+            node.mGeneration = 1;
+         }
+         node.mNext = mFree;
+         mFree = index;
+         --mSize;
+      }
+
+      /// Moves every element of list from onto list to, or back into the
+      /// wheel according to its own time if to is Replace.
+      void moveAll(unsigned int from, unsigned int to)
+      {
+         // Detach the whole list first; re-placing may append to it again.
+         UInt32 index = mHeads[from];
+         mHeads[from] = mTails[from] = Nil;
+         if (from < DueList)
+         {
+            mOccupied[from / Slots][(from % Slots) / 64] &= ~(UInt64(1) << (from % 64));
+         }
+         while (index != Nil)
+         {
+            UInt32 next = mNodes[index].mNext;
+            link(index, to == Replace ? listFor(mNodes[index].value().getWhen()) : to);
+            index = next;
+         }
+      }
+
+      /// Called whenever mCurrent enters a new level 0 rotation: the slot
+      /// of each higher level that now corresponds to the current tick is
+      /// spread out over the levels below it, highest first.
+      void cascade()
+      {
+         unsigned int level = 1;
+         while (level < Levels && ((mCurrent >> (level * SlotBits)) & SlotMask) == 0)
+         {
+            ++level;
+         }
+         if (level == Levels)
+         {
+            moveAll(OverflowList, Replace);
+            --level;
+         }
+         for (; level >= 1; --level)
+         {
+            unsigned int slot = unsigned((mCurrent >> (level * SlotBits)) & SlotMask);
+            moveAll(level * Slots + slot, Replace);
+         }
+      }
+
+      /// @return the first tick after the current level 0 rotation at which
+      /// a higher level slot (or the overflow list) is due to cascade.
+      UInt64 nextCascade() const
+      {
+         for (unsigned int level = 1; level < Levels; ++level)
+         {
+            unsigned int shift = level * SlotBits;
+            int slot = nextOccupied(level, unsigned((mCurrent >> shift) & SlotMask) + 1);
+            if (slot >= 0)
+            {
+               UInt64 base = mCurrent & ~((UInt64(1) << (shift + SlotBits)) - 1);
+               return base + (UInt64(slot) << shift);
+            }
+         }
+         return (mCurrent | ((UInt64(1) << (Levels * SlotBits)) - 1)) + 1;
+      }
+
+      /// @return the first occupied slot >= from on level, or -1.
+      int nextOccupied(unsigned int level, unsigned int from) const
+      {
+         for (unsigned int w = from / 64; w < Words; ++w)
+         {
+            UInt64 bits = mOccupied[level][w];
+            if (w == from / 64)
+            {
+               bits &= ~UInt64(0) << (from % 64);
+            }
+            if (bits)
+            {
+#if defined(__GNUC__)
+               return int(w * 64) + __builtin_ctzll(bits);
+#else
+               int bit = 0;
+               while (!(bits & 1))
+               {
+                  bits >>= 1;
+                  ++bit;
+               }
+               return int(w * 64) + bit;
+#endif
+            }
+         }
+         return -1;
+      }
+
+      UInt32 earliestOn(unsigned int list) const
+      {
+         UInt32 best = mHeads[list];
+         for (UInt32 i = best; i != Nil; i = mNodes[i].mNext)
+         {
+            if (mNodes[i].value().getWhen() < mNodes[best].value().getWhen())
+            {
+               best = i;
+            }
+         }
+         return best;
+      }
+
+      UInt32 topIndex() const
+      {
+         resip_assert(mSize);
+         if (mHeads[DueList] != Nil)
+         {
+            return earliestOn(DueList);
+         }
+         for (unsigned int level = 0; level < Levels; ++level)
+         {
+            int slot = nextOccupied(level, unsigned((mCurrent >> (level * SlotBits)) & SlotMask));
+            if (slot >= 0)
+            {
+               return earliestOn(level * Slots + unsigned(slot));
+            }
+         }
+         return earliestOn(OverflowList);
+      }
+
+      std::deque<Node> mNodes;
+      UInt32 mFree;
+      UInt32 mHeads[NumLists];
+      UInt32 mTails[NumLists];
+      UInt64 mOccupied[Levels][Words];
+      // The next tick that has not yet been swept onto the due list.
+      UInt64 mCurrent;
+      size_t mSize;
+
+      // no value semantics
+      TimerWheel(const TimerWheel&);
+      TimerWheel& operator=(const TimerWheel&);
+};
+
+template <class T>
+const UInt32 TimerWheel<T>::Nil;
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -23,6 +23,7 @@ class DnsAAAARecord : public DnsResourceRecord
       virtual ~DnsAAAARecord() {}
 
 #ifdef IPPROTO_IPV6
+      DnsAAAARecord(const Data& name, const struct in6_addr& addr) : mAddr(addr), mName(name) {}
       const struct in6_addr& v6Address() const { return mAddr; }
 #endif
 
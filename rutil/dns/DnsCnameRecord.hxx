@@ -26,6 +26,7 @@ class DnsCnameRecord : public DnsResourceRecord
       };
 
       DnsCnameRecord(const RROverlay&);
+      DnsCnameRecord(const Data& name, const Data& cname) : mCname(cname), mName(name) {}
       ~DnsCnameRecord() {}
 
       // accessors.
@@ -35,6 +35,9 @@ class DnsNaptrRecord : public DnsResourceRecord
             // Substitution Expression Grammar) The delimiter is whatever
             // appears in the first character. This can be empty. 
             RegExp(const Data& data);
+            // from an already parsed expression
+            RegExp(const Data& regexp, const Data& replacement)
+               : mRegexp(regexp), mReplacement(replacement) {}
             RegExp();
             ~RegExp();
             
@@ -63,6 +66,10 @@ class DnsNaptrRecord : public DnsResourceRecord
          
       DnsNaptrRecord() : mOrder(-1), mPreference(-1) {}
       DnsNaptrRecord(const RROverlay&);
+      DnsNaptrRecord(const Data& name, int order, int preference, const Data& flags,
+                     const Data& service, const RegExp& regexp, const Data& replacement)
+         : mOrder(order), mPreference(preference), mFlags(flags), mService(service),
+           mRegexp(regexp), mReplacement(replacement), mName(name) {}
       ~DnsNaptrRecord() {}
 
       // accessors.
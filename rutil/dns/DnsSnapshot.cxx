@@ -0,0 +1,254 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <cstdio>
+#include <ctime>
+
+#include "rutil/Socket.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/DataException.hxx"
+#include "rutil/dns/DnsSnapshot.hxx"
+#include "rutil/WinLeakCheck.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM resip::Subsystem::DNS
+
+DnsSnapshotWriter::DnsSnapshotWriter()
+{
+   putUInt32(DnsSnapshotReader::Magic);
+   putUInt32(DnsSnapshotReader::Version);
+   putUInt64((UInt64)time(0));
+}
+
+void
+DnsSnapshotWriter::putUInt8(UInt8 value)
+{
+   mBuffer.append((const char*)&value, 1);
+}
+
+void
+DnsSnapshotWriter::putUInt16(UInt16 value)
+{
+   value = htons(value);
+   mBuffer.append((const char*)&value, sizeof(value));
+}
+
+void
+DnsSnapshotWriter::putUInt32(UInt32 value)
+{
+   value = htonl(value);
+   mBuffer.append((const char*)&value, sizeof(value));
+}
+
+void
+DnsSnapshotWriter::putUInt64(UInt64 value)
+{
+   putUInt32((UInt32)(value >> 32));
+   putUInt32((UInt32)value);
+}
+
+void
+DnsSnapshotWriter::putData(const Data& value)
+{
+   putUInt32((UInt32)value.size());
+   mBuffer.append(value.data(), value.size());
+}
+
+void
+DnsSnapshotWriter::putBytes(const void* bytes, size_t length)
+{
+   mBuffer.append((const char*)bytes, (Data::size_type)length);
+}
+
+bool
+DnsSnapshotWriter::save(const Data& filename) const
+{
+   Data tmpName(filename + ".tmp");
+   FILE* file = fopen(tmpName.c_str(), "wb");
+   if (!file)
+   {
+      WarningLog(<< "Could not open " << tmpName << " to save the DNS snapshot");
+      return false;
+   }
+   bool written = fwrite(mBuffer.data(), 1, mBuffer.size(), file) == mBuffer.size();
+   written = (fclose(file) == 0) && written;
+#ifdef WIN32
+   // rename() will not replace an existing file here
+   remove(filename.c_str());
+#endif
+   if (!written || rename(tmpName.c_str(), filename.c_str()) != 0)
+   {
+      WarningLog(<< "Could not write the DNS snapshot to " << filename);
+      remove(tmpName.c_str());
+      return false;
+   }
+   return true;
+}
+
+DnsSnapshotReader::DnsSnapshotReader()
+   : mPos(0),
+     mAge(0),
+     mFailed(true)
+{
+}
+
+bool
+DnsSnapshotReader::load(const Data& filename)
+{
+   try
+   {
+      return parse(Data::fromFile(filename));
+   }
+   catch (DataException&)
+   {
+      InfoLog(<< "No DNS snapshot to load from " << filename);
+      mFailed = true;
+      return false;
+   }
+}
+
+bool
+DnsSnapshotReader::parse(const Data& snapshot)
+{
+   mBuffer = snapshot;
+   mPos = 0;
+   mFailed = false;
+
+   UInt32 magic = 0;
+   UInt32 version = 0;
+   UInt64 savedAt = 0;
+   if (!getUInt32(magic) || !getUInt32(version) || !getUInt64(savedAt) ||
+       magic != Magic || version != Version)
+   {
+      WarningLog(<< "Ignoring DNS snapshot with a bad header");
+      mFailed = true;
+      return false;
+   }
+
+   // a clock that went backwards makes the snapshot look new, not negative
+   UInt64 now = (UInt64)time(0);
+   mAge = now > savedAt ? now - savedAt : 0;
+   return true;
+}
+
+bool
+DnsSnapshotReader::getUInt8(UInt8& value)
+{
+   return getBytes(&value, 1);
+}
+
+bool
+DnsSnapshotReader::getUInt16(UInt16& value)
+{
+   if (!getBytes(&value, sizeof(value)))
+   {
+      return false;
+   }
+   value = ntohs(value);
+   return true;
+}
+
+bool
+DnsSnapshotReader::getUInt32(UInt32& value)
+{
+   if (!getBytes(&value, sizeof(value)))
+   {
+      return false;
+   }
+   value = ntohl(value);
+   return true;
+}
+
+bool
+DnsSnapshotReader::getUInt64(UInt64& value)
+{
+   UInt32 high = 0;
+   UInt32 low = 0;
+   if (!getUInt32(high) || !getUInt32(low))
+   {
+      return false;
+   }
+   value = ((UInt64)high << 32) | low;
+   return true;
+}
+
+bool
+DnsSnapshotReader::getData(Data& value)
+{
+   UInt32 length = 0;
+   if (!getUInt32(length) || length > mBuffer.size() - mPos)
+   {
+      mFailed = true;
+      return false;
+   }
+   value = Data(mBuffer.data() + mPos, length);
+   mPos += length;
+   return true;
+}
+
+bool
+DnsSnapshotReader::getBytes(void* bytes, size_t length)
+{
+   if (mFailed || length > mBuffer.size() - mPos)
+   {
+      mFailed = true;
+      return false;
+   }
+   memcpy(bytes, mBuffer.data() + mPos, length);
+   mPos += (Data::size_type)length;
+   return true;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
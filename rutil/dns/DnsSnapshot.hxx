@@ -0,0 +1,128 @@
+#ifndef RESIP_DNS_SNAPSHOT_HXX
+#define RESIP_DNS_SNAPSHOT_HXX
+
+#include "rutil/Data.hxx"
+
+namespace resip
+{
+
+/**
+   Builds the compact binary snapshot a restarted stack loads to start with
+   a warm DNS cache. Integers are stored in network byte order and strings
+   with a length prefix. The header holds the wall clock time of the save,
+   so the reader can tell how much of each saved TTL ran out while the
+   process was down.
+*/
+class DnsSnapshotWriter
+{
+   public:
+      DnsSnapshotWriter();
+
+      void putUInt8(UInt8 value);
+      void putUInt16(UInt16 value);
+      void putUInt32(UInt32 value);
+      void putUInt64(UInt64 value);
+      void putData(const Data& value);
+      void putBytes(const void* bytes, size_t length);
+
+      const Data& snapshot() const { return mBuffer; }
+      // writes a temporary file next to filename and renames it into place,
+      // so a crash during the save never leaves a truncated snapshot
+      bool save(const Data& filename) const;
+
+   private:
+      Data mBuffer;
+};
+
+/**
+   Reads a snapshot made by DnsSnapshotWriter. Reading past the end fails
+   and leaves the reader failed, so a caller can read a whole entry and
+   check ok() once.
+*/
+class DnsSnapshotReader
+{
+   public:
+      DnsSnapshotReader();
+
+      // both check the header, and fail if it is not a snapshot of this version
+      bool load(const Data& filename);
+      bool parse(const Data& snapshot);
+
+      // seconds between the save and the load
+      UInt64 age() const { return mAge; }
+
+      bool getUInt8(UInt8& value);
+      bool getUInt16(UInt16& value);
+      bool getUInt32(UInt32& value);
+      bool getUInt64(UInt64& value);
+      bool getData(Data& value);
+      bool getBytes(void* bytes, size_t length);
+
+      bool ok() const { return !mFailed; }
+      bool atEnd() const { return mPos == mBuffer.size(); }
+
+   private:
+      static const UInt32 Magic = 0x52444e53; // "RDNS"
+      static const UInt32 Version = 1;
+      friend class DnsSnapshotWriter;
+
+      Data mBuffer;
+      Data::size_type mPos;
+      UInt64 mAge;
+      bool mFailed;
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
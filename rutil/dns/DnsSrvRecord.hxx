@@ -28,6 +28,8 @@ class DnsSrvRecord : public DnsResourceRecord
       };
 
       DnsSrvRecord(const RROverlay&);
+      DnsSrvRecord(const Data& name, int priority, int weight, int port, const Data& target)
+         : mPriority(priority), mWeight(weight), mPort(port), mTarget(target), mName(name) {}
       ~DnsSrvRecord() {}
 
       // accessors.
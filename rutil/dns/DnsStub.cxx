@@ -25,6 +25,7 @@
 #include "rutil/BaseException.hxx"
 #include "rutil/Data.hxx"
 #include "rutil/Inserter.hxx"
+#include "rutil/Lock.hxx"
 #include "rutil/dns/DnsStub.hxx"
 #include "rutil/dns/ExternalDns.hxx"
 #include "rutil/dns/ExternalDnsFactory.hxx"
@@ -82,13 +83,19 @@ DnsResultSink::onLogDnsResult(const DNSResult<DnsCnameRecord>& rr)
 DnsStub::DnsStub(const NameserverList& additional,
                  AfterSocketCreationFuncPtr socketFunc,
                  AsyncProcessHandler* asyncProcessHandler,
-                 FdPollGrp *pollGrp) :
+                 FdPollGrp *pollGrp,
+                 DnsStub* shareCacheWith) :
    mInterruptorHandle(0),
    mCommandFifo(&mSelectInterruptor),
    mTransform(0),
    mDnsProvider(ExternalDnsFactory::createExternalDns()),
    mPollGrp(0),
-   mAsyncProcessHandler(asyncProcessHandler)
+   mAsyncProcessHandler(asyncProcessHandler),
+   mRRCache(shareCacheWith ? shareCacheWith->mRRCache : std::make_shared<RRCache>()),
+   mCacheHits(0),
+   mCacheMisses(0),
+   mCacheStaleHits(0),
+   mPrefetches(0)
 {
    setPollGrp(pollGrp);
 
@@ -178,7 +185,8 @@ DnsStub::cache(const Data& key,
                in_addr addr)
 {
    DnsHostRecord record(key, addr);
-   mRRCache.updateCacheFromHostFile(record);
+   Lock lock(mRRCache->getMutex());
+   mRRCache->updateCacheFromHostFile(record);
 }
 
 void
@@ -224,9 +232,10 @@ DnsStub::cache(const Data& key,
 
    vector<RROverlay>::iterator itLow = lower_bound(overlays.begin(), overlays.end(), *overlays.begin());
    vector<RROverlay>::iterator itHigh = upper_bound(overlays.begin(), overlays.end(), *overlays.begin());
+   Lock lock(mRRCache->getMutex());
    while (itLow != overlays.end())
    {
-      mRRCache.updateCache(key, (*itLow).type(), itLow, itHigh);
+      mRRCache->updateCache(key, (*itLow).type(), itLow, itHigh);
       itLow = itHigh;
       if (itHigh != overlays.end())
       {
@@ -267,7 +276,8 @@ DnsStub::cacheTTL(const Data& key,
       return;
    }
 
-   mRRCache.cacheTTL(key, rrType, status, soa[0]);
+   Lock lock(mRRCache->getMutex());
+   mRRCache->cacheTTL(key, rrType, status, soa[0]);
 }
 
 const unsigned char*
@@ -420,7 +430,8 @@ DnsStub::Query::Query(DnsStub& stub, ResultTransform* transform, ResultConverter
      mSink(s),
      mFollowCname(followCname)
 {
-   resip_assert(s);
+   // refresh queries have no sink
+   resip_assert(s || dynamic_cast<RefreshResultConverter*>(resultConv));
 }
 
 DnsStub::Query::~Query()
@@ -460,6 +471,17 @@ typeToData(int rr)
    }
 }
 
+void
+DnsStub::refresh(const Data& target, int rrType, bool followCname, int proto)
+{
+   StackLog(<< "Refreshing cached " << typeToData(rrType) << " records of " << target);
+   ++mPrefetches;
+   Query* query = new Query(*this, 0, new RefreshResultConverter(),
+                            target, rrType, followCname, proto, 0);
+   mQueries.insert(query);
+   query->refresh();
+}
+
 void
 DnsStub::Query::go()
 {
@@ -468,33 +490,50 @@ DnsStub::Query::go()
    DnsResourceRecordsByPtr records;
    int status = 0;
    bool cached = false;
+   bool refresh = false;
    Data targetToQuery = mTarget;
-   cached = mStub.mRRCache.lookup(mTarget, mRRType, mProto, records, status);
-
-   if (!cached)
+   RRCache::Freshness freshness;
    {
-      if (mRRType != T_CNAME)
+      Lock lock(mStub.mRRCache->getMutex());
+      freshness = mStub.mRRCache->lookup(mTarget, mRRType, mProto, records, status, refresh);
+      cached = (freshness != RRCache::Missing);
+
+      if (!cached)
       {
-         do
+         if (mRRType != T_CNAME)
          {
-            DnsResourceRecordsByPtr cnames;
-            cached = mStub.mRRCache.lookup(targetToQuery, T_CNAME, mProto, cnames, status);
-            if (cached)
+            do
             {
-               targetToQuery = (dynamic_cast<DnsCnameRecord*>(cnames[0]))->cname();
-            }
-         } while(cached);
+               DnsResourceRecordsByPtr cnames;
+               cached = mStub.mRRCache->lookup(targetToQuery, T_CNAME, mProto, cnames, status);
+               if (cached)
+               {
+                  targetToQuery = (dynamic_cast<DnsCnameRecord*>(cnames[0]))->cname();
+               }
+            } while(cached);
+         }
       }
-   }
 
-   if (targetToQuery != mTarget)
-   {
-      StackLog(<< mTarget << " mapped to CNAME " << targetToQuery);
-      cached = mStub.mRRCache.lookup(targetToQuery, mRRType, mProto, records, status);
+      if (targetToQuery != mTarget)
+      {
+         StackLog(<< mTarget << " mapped to CNAME " << targetToQuery);
+         freshness = mStub.mRRCache->lookup(targetToQuery, mRRType, mProto, records, status, refresh);
+         cached = (freshness != RRCache::Missing);
+      }
+
+      if (cached)
+      {
+         if (mTransform && !records.empty())
+         {
+            mTransform->transform(mTarget, mRRType, records);
+         }
+         mResultConverter->convert(mTarget, status, mStub.errorMessage(status), records);
+      }
    }
 
    if (!cached)
    {
+      ++mStub.mCacheMisses;
       if(mStub.mDnsProvider && mStub.mDnsProvider->hostFileLookupLookupOnlyMode())
       {
          resip_assert(mRRType == T_A);
@@ -503,15 +542,19 @@ DnsStub::Query::go()
          if (mStub.mDnsProvider->hostFileLookup(targetToQuery.c_str(), address))
          {
             mStub.cache(mTarget, address);
-            DnsResourceRecordsByPtr result;
-            int queryStatus = 0;
-
-            mStub.mRRCache.lookup(mTarget, mRRType, mProto, result, queryStatus);
-            if (mTransform)
             {
-                mTransform->transform(mTarget, mRRType, result);
+               DnsResourceRecordsByPtr result;
+               int queryStatus = 0;
+
+               Lock lock(mStub.mRRCache->getMutex());
+               mStub.mRRCache->lookup(mTarget, mRRType, mProto, result, queryStatus);
+               if (mTransform)
+               {
+                   mTransform->transform(mTarget, mRRType, result);
+               }
+               mResultConverter->convert(mTarget, queryStatus, mStub.errorMessage(queryStatus), result);
             }
-            mResultConverter->notifyUser(mTarget, queryStatus, mStub.errorMessage(queryStatus), result, mSink);
+            mResultConverter->notify(mSink);
          }
          else
          {
@@ -531,17 +574,32 @@ DnsStub::Query::go()
    }
    else // is cached
    {
-      if (mTransform && !records.empty())
+      if (freshness == RRCache::Stale)
       {
-         mTransform->transform(mTarget, mRRType, records);
+         ++mStub.mCacheStaleHits;
+      }
+      else
+      {
+         ++mStub.mCacheHits;
+      }
+      if (refresh && !(mStub.mDnsProvider && mStub.mDnsProvider->hostFileLookupLookupOnlyMode()))
+      {
+         mStub.refresh(targetToQuery, mRRType, mFollowCname, mProto);
       }
-      mResultConverter->notifyUser(mTarget, status, mStub.errorMessage(status), records, mSink);
+
+      mResultConverter->notify(mSink);
 
       mStub.removeQuery(this);
       delete this;
    }
 }
 
+void
+DnsStub::Query::refresh()
+{
+   mStub.lookupRecords(mTarget, mRRType, this);
+}
+
 void
 DnsStub::Query::process(int status, const unsigned char* abuf, const int alen)
 {
@@ -562,15 +620,19 @@ DnsStub::Query::process(int status, const unsigned char* abuf, const int alen)
                {
                   mStub.cache(mTarget, address);
                   mReQuery = 0;
-                  DnsResourceRecordsByPtr result;
-                  int queryStatus = 0;
-
-                  mStub.mRRCache.lookup(mTarget, mRRType, mProto, result, queryStatus);
-                  if (mTransform)
                   {
-                     mTransform->transform(mTarget, mRRType, result);
+                     DnsResourceRecordsByPtr result;
+                     int queryStatus = 0;
+
+                     Lock lock(mStub.mRRCache->getMutex());
+                     mStub.mRRCache->lookup(mTarget, mRRType, mProto, result, queryStatus);
+                     if (mTransform)
+                     {
+                        mTransform->transform(mTarget, mRRType, result);
+                     }
+                     mResultConverter->convert(mTarget, queryStatus, mStub.errorMessage(queryStatus), result);
                   }
-                  mResultConverter->notifyUser(mTarget, queryStatus, mStub.errorMessage(queryStatus), result, mSink);
+                  mResultConverter->notify(mSink);
                   mStub.removeQuery(this);
                   delete this;
                   return;
@@ -666,16 +728,20 @@ DnsStub::Query::process(int status, const unsigned char* abuf, const int alen)
       if (bGotAnswers)
       {
          mReQuery = 0;
-         DnsResourceRecordsByPtr result;
-         int queryStatus = 0;
-
          if (mTarget != targetToQuery) DebugLog (<< mTarget << " mapped to " << targetToQuery << " and returned result");
-         mStub.mRRCache.lookup(targetToQuery, mRRType, mProto, result, queryStatus);
-         if (mTransform)
          {
-            mTransform->transform(mTarget, mRRType, result);
+            DnsResourceRecordsByPtr result;
+            int queryStatus = 0;
+
+            Lock lock(mStub.mRRCache->getMutex());
+            mStub.mRRCache->lookup(targetToQuery, mRRType, mProto, result, queryStatus);
+            if (mTransform)
+            {
+               mTransform->transform(mTarget, mRRType, result);
+            }
+            mResultConverter->convert(mTarget, queryStatus, mStub.errorMessage(queryStatus), result);
          }
-         mResultConverter->notifyUser(mTarget, queryStatus, mStub.errorMessage(queryStatus), result, mSink);
+         mResultConverter->notify(mSink);
       }
    }
 
@@ -733,20 +799,26 @@ DnsStub::Query::followCname(const unsigned char* aptr, const unsigned char*abuf,
             ++mReQuery;
             int status = 0;
             bool cached = false;
+            bool answered = false;
 
-            do
             {
-               DnsResourceRecordsByPtr cnames;
-               cached = mStub.mRRCache.lookup(targetToQuery, T_CNAME, mProto, cnames, status);
-               if (cached)
+               Lock lock(mStub.mRRCache->getMutex());
+               do
                {
-                  ++mReQuery;
-                  targetToQuery = (dynamic_cast<DnsCnameRecord*>(cnames[0]))->cname();
-               }
-            } while(mReQuery < MAX_REQUERIES && cached);
+                  DnsResourceRecordsByPtr cnames;
+                  cached = mStub.mRRCache->lookup(targetToQuery, T_CNAME, mProto, cnames, status);
+                  if (cached)
+                  {
+                     ++mReQuery;
+                     targetToQuery = (dynamic_cast<DnsCnameRecord*>(cnames[0]))->cname();
+                  }
+               } while(mReQuery < MAX_REQUERIES && cached);
 
-            DnsResourceRecordsByPtr result;
-            if (!mStub.mRRCache.lookup(targetToQuery, mRRType, mProto, result, status))
+               DnsResourceRecordsByPtr result;
+               answered = mStub.mRRCache->lookup(targetToQuery, mRRType, mProto, result, status);
+            }
+
+            if (!answered)
             {
                mStub.lookupRecords(targetToQuery, mRRType, this);
                bDeleteThis = false;
@@ -832,7 +904,8 @@ DnsStub::clearDnsCache()
 void
 DnsStub::doClearDnsCache()
 {
-   mRRCache.clearCache();
+   Lock lock(mRRCache->getMutex());
+   mRRCache->clearCache();
 }
 
 void
@@ -845,7 +918,8 @@ DnsStub::logDnsCache()
 void
 DnsStub::doLogDnsCache()
 {
-   mRRCache.logCache();
+   Lock lock(mRRCache->getMutex());
+   mRRCache->logCache();
 }
 
 void 
@@ -860,7 +934,10 @@ DnsStub::doGetDnsCacheDump(std::pair<unsigned long, unsigned long> key, GetDnsCa
 {
    resip_assert(handler != 0);
    Data dnsCacheDump;
-   mRRCache.getCacheDump(dnsCacheDump);
+   {
+      Lock lock(mRRCache->getMutex());
+      mRRCache->getCacheDump(dnsCacheDump);
+   }
    handler->onDnsCacheDumpRetrieved(key, dnsCacheDump);
 }
 
@@ -886,13 +963,52 @@ DnsStub::doReloadDnsServers()
 void
 DnsStub::setDnsCacheTTL(int ttl)
 {
-   mRRCache.setTTL(ttl);
+   Lock lock(mRRCache->getMutex());
+   mRRCache->setTTL(ttl);
 }
 
 void
 DnsStub::setDnsCacheSize(int size)
 {
-   mRRCache.setSize(size);
+   Lock lock(mRRCache->getMutex());
+   mRRCache->setSize(size);
+}
+
+void
+DnsStub::setDnsCachePrefetch(int prefetchWindowSecs, int staleGracePeriodSecs)
+{
+   SetDnsCachePrefetchCommand* command = new SetDnsCachePrefetchCommand(*this, prefetchWindowSecs, staleGracePeriodSecs);
+   queueCommand(command);
+}
+
+void
+DnsStub::doSetDnsCachePrefetch(int prefetchWindowSecs, int staleGracePeriodSecs)
+{
+   Lock lock(mRRCache->getMutex());
+   mRRCache->setPrefetch(prefetchWindowSecs, staleGracePeriodSecs);
+}
+
+void
+DnsStub::getCacheStatistics(CacheStatistics& stats) const
+{
+   stats.hits = mCacheHits;
+   stats.misses = mCacheMisses;
+   stats.staleHits = mCacheStaleHits;
+   stats.prefetches = mPrefetches;
+}
+
+void
+DnsStub::encodeCacheSnapshot(DnsSnapshotWriter& writer)
+{
+   Lock lock(mRRCache->getMutex());
+   mRRCache->encodeSnapshot(writer);
+}
+
+int
+DnsStub::decodeCacheSnapshot(DnsSnapshotReader& reader)
+{
+   Lock lock(mRRCache->getMutex());
+   return mRRCache->decodeSnapshot(reader);
 }
 
 /* ====================================================================
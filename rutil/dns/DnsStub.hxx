@@ -6,9 +6,11 @@
 #endif
 
 
+#include <atomic>
 #include <vector>
 #include <list>
 #include <map>
+#include <memory>
 #include <set>
 
 #include "rutil/FdPoll.hxx"
@@ -31,6 +33,8 @@
 namespace resip
 {
 class FdPollGrp;
+class DnsSnapshotWriter;
+class DnsSnapshotReader;
 
 class GetDnsCacheDumpHandler
 {
@@ -141,10 +145,18 @@ class DnsStub : public ExternalDnsHandler
             const char* name() const noexcept override { return "DnsStubException"; }
       };
 
+      /*!
+         @param shareCacheWith If set, this stub uses the DNS cache of that
+                  stub (and so its TTL, size and prefetch settings) instead of
+                  one of its own. Each stub still has its own resolver channel
+                  and command fifo, so stubs sharing a cache can be driven by
+                  different threads to spread resolution across cores.
+      */
       DnsStub(const NameserverList& additional = EmptyNameserverList,
               AfterSocketCreationFuncPtr socketFunc = 0,
               AsyncProcessHandler* asyncProcessHandler = 0,
-              FdPollGrp *pollGrp = 0);
+              FdPollGrp *pollGrp = 0,
+              DnsStub* shareCacheWith = 0);
       ~DnsStub();
 
       // call this method before you create SipStack if you'd like to change the
@@ -179,6 +191,48 @@ class DnsStub : public ExternalDnsHandler
       void getDnsCacheDump(std::pair<unsigned long, unsigned long> key, GetDnsCacheDumpHandler* handler);
       void setDnsCacheTTL(int ttl);
       void setDnsCacheSize(int size);
+
+      /*!
+         @param prefetchWindowSecs A lookup that finds an entry expiring within
+                  this many seconds is answered from the cache and also
+                  re-queried in the background, so the entry is refreshed
+                  before anyone has to wait for it.
+         @param staleGracePeriodSecs Expired entries are kept for this many
+                  seconds and, while a background refresh is in flight, served
+                  as they are instead of blocking the lookup on a query.
+         Both default to 0, which disables the feature.
+      */
+      void setDnsCachePrefetch(int prefetchWindowSecs, int staleGracePeriodSecs);
+
+      /*!
+         Writes the unexpired cache entries to a snapshot, or adds those of a
+         snapshot that are still unexpired to the cache (entries resolved
+         since startup win), returning how many were added. Together they let
+         a restarted process start with a warm cache. Safe to call from any
+         thread.
+      */
+      void encodeCacheSnapshot(DnsSnapshotWriter& writer);
+      int decodeCacheSnapshot(DnsSnapshotReader& reader);
+
+      class CacheStatistics
+      {
+         public:
+            CacheStatistics() : hits(0), misses(0), staleHits(0), prefetches(0) {}
+            CacheStatistics& operator+=(const CacheStatistics& rhs)
+            {
+               hits += rhs.hits;
+               misses += rhs.misses;
+               staleHits += rhs.staleHits;
+               prefetches += rhs.prefetches;
+               return *this;
+            }
+            unsigned int hits; // answered from the cache
+            unsigned int misses; // had to wait for a query
+            unsigned int staleHits; // answered with an expired entry
+            unsigned int prefetches; // background refresh queries sent
+      };
+      // safe to call from any thread
+      void getCacheStatistics(CacheStatistics& stats) const;
       void reloadDnsServers();
       bool checkDnsChange();
       bool supportedType(int);
@@ -223,36 +277,69 @@ class DnsStub : public ExternalDnsHandler
       class ResultConverter //.dcm. -- flyweight?
       {
          public:
-            virtual void notifyUser(const Data& target, 
-                                    int status, 
-                                    const Data& msg,
-                                    const DnsResourceRecordsByPtr& src,
-                                    DnsResultSink* sink) = 0;
+            // Copies src, which may point into the cache; call with the
+            // cache locked.
+            virtual void convert(const Data& target, 
+                                 int status, 
+                                 const Data& msg,
+                                 const DnsResourceRecordsByPtr& src) = 0;
+            // Hands the converted result to the sink; call with the cache
+            // unlocked, the sink may take its time.
+            virtual void notify(DnsResultSink* sink) = 0;
             virtual ~ResultConverter() {}
+
+            void notifyUser(const Data& target, 
+                            int status, 
+                            const Data& msg,
+                            const DnsResourceRecordsByPtr& src,
+                            DnsResultSink* sink)
+            {
+               convert(target, status, msg, src);
+               notify(sink);
+            }
       };
       
       template<class QueryType>  
       class ResultConverterImpl : public ResultConverter
       {
          public:
-            virtual void notifyUser(const Data& target, 
-                                    int status, 
-                                    const Data& msg,
-                                    const DnsResourceRecordsByPtr& src,
-                                    DnsResultSink* sink)
+            virtual void convert(const Data& target, 
+                                 int status, 
+                                 const Data& msg,
+                                 const DnsResourceRecordsByPtr& src)
             {
-               resip_assert(sink);
-               DNSResult<typename QueryType::Type>  result;
+               mResult.records.clear();
                for (unsigned int i = 0; i < src.size(); ++i)
                {
-                  result.records.push_back(*(dynamic_cast<typename QueryType::Type*>(src[i])));
+                  mResult.records.push_back(*(dynamic_cast<typename QueryType::Type*>(src[i])));
                }
-               result.domain = target;
-               result.status = status;
-               result.msg = msg;
-               sink->onLogDnsResult(result);
-               sink->onDnsResult(result);
+               mResult.domain = target;
+               mResult.status = status;
+               mResult.msg = msg;
+            }
+
+            virtual void notify(DnsResultSink* sink)
+            {
+               resip_assert(sink);
+               sink->onLogDnsResult(mResult);
+               sink->onDnsResult(mResult);
             }
+
+         private:
+            DNSResult<typename QueryType::Type> mResult;
+      };
+
+      // a refresh query only updates the cache, there is nobody to notify
+      class RefreshResultConverter : public ResultConverter
+      {
+         public:
+            virtual void convert(const Data& target, 
+                                 int status, 
+                                 const Data& msg,
+                                 const DnsResourceRecordsByPtr& src)
+            {}
+            virtual void notify(DnsResultSink* sink)
+            {}
       };
 
       class Query : public DnsRawSink
@@ -265,6 +352,8 @@ class DnsStub : public ExternalDnsHandler
             enum {MAX_REQUERIES = 5};
 
             void go();
+            // skips the cache and sends the query straight to the resolver
+            void refresh();
             void process(int status, const unsigned char* abuf, const int alen);
             void onDnsRaw(int status, const unsigned char* abuf, int alen);
             void followCname(const unsigned char* aptr, const unsigned char*abuf, const int alen, bool& bGotAnswers, bool& bDeleteThis, Data& targetToQuery);
@@ -430,6 +519,28 @@ class DnsStub : public ExternalDnsHandler
 
       void doReloadDnsServers();
 
+      void doSetDnsCachePrefetch(int prefetchWindowSecs, int staleGracePeriodSecs);
+
+      class SetDnsCachePrefetchCommand : public Command
+      {
+         public:
+            SetDnsCachePrefetchCommand(DnsStub& stub, int prefetchWindowSecs, int staleGracePeriodSecs)
+               : mStub(stub),
+                 mPrefetchWindowSecs(prefetchWindowSecs),
+                 mStaleGracePeriodSecs(staleGracePeriodSecs)
+            {}
+            ~SetDnsCachePrefetchCommand() {}
+            void execute()
+            {
+               mStub.doSetDnsCachePrefetch(mPrefetchWindowSecs, mStaleGracePeriodSecs);
+            }
+
+         private:
+            DnsStub& mStub;
+            int mPrefetchWindowSecs;
+            int mStaleGracePeriodSecs;
+      };
+
       class ReloadDnsServersCommand : public Command
       {
       public:
@@ -460,6 +571,7 @@ class DnsStub : public ExternalDnsHandler
                                          std::vector<RROverlay>&,
                                          bool discard=false);
       void removeQuery(Query*);
+      void refresh(const Data& target, int rrType, bool followCname, int proto);
       void lookupRecords(const Data& target, unsigned short type, DnsRawSink* sink);
       Data errorMessage(int status);
 
@@ -478,8 +590,15 @@ class DnsStub : public ExternalDnsHandler
       /// if this object exists, it gets notified when ApplicationMessage's get posted
       AsyncProcessHandler* mAsyncProcessHandler;
 
-      /// Dns Cache
-      RRCache mRRCache;
+      /// Dns Cache, possibly shared with other stubs. Lock its mutex around
+      /// every use, and keep the lock until records from it have been copied.
+      std::shared_ptr<RRCache> mRRCache;
+
+      // written by the thread running the stub, read by getCacheStatistics()
+      std::atomic<unsigned int> mCacheHits;
+      std::atomic<unsigned int> mCacheMisses;
+      std::atomic<unsigned int> mCacheStaleHits;
+      std::atomic<unsigned int> mPrefetches;
 };
 
 typedef DnsStub::Protocol Protocol;
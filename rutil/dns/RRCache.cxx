@@ -23,7 +23,6 @@
 #endif
 #endif
 
-#include <set>
 #include <vector>
 #include <list>
 #include <map>
@@ -40,17 +39,37 @@
 #include "rutil/dns/DnsNaptrRecord.hxx"
 #include "rutil/dns/DnsSrvRecord.hxx"
 #include "rutil/dns/DnsCnameRecord.hxx"
+#include "rutil/dns/DnsSnapshot.hxx"
 #include "rutil/dns/RRCache.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
 using namespace resip;
 using namespace std;
 
+HashValueImp(resip::RRCacheKey, data.hash());
+
+RRCacheKey::RRCacheKey(const Data& name, int rrType)
+   : mName(name),
+     mRRType(rrType)
+{
+   mName.lowercase();
+   mHash = Data::rawCaseInsensitiveTokenHash((const unsigned char*)mName.data(), mName.size()) * 31 + rrType;
+}
+
+RRCacheKey::RRCacheKey(Data::ShareEnum, const Data& name, int rrType)
+   : mName(Data::Share, name.data(), name.size()),
+     mRRType(rrType)
+{
+   mHash = Data::rawCaseInsensitiveTokenHash((const unsigned char*)mName.data(), mName.size()) * 31 + rrType;
+}
+
 RRCache::RRCache() 
    : mHead(),
      mLruHead(LruListType::makeList(&mHead)),
      mUserDefinedTTL(DEFAULT_USER_DEFINED_TTL),
-     mSize(DEFAULT_SIZE)
+     mSize(DEFAULT_SIZE),
+     mPrefetchWindow(0),
+     mStaleGracePeriod(0)
 {
    mFactoryMap[T_CNAME] = &mCnameRecordFactory;
    mFactoryMap[T_NAPTR] = &mNaptrRecordFacotry;
@@ -70,22 +89,19 @@ void
 RRCache::updateCacheFromHostFile(const DnsHostRecord &record)
 {
    //FactoryMap::iterator it = mFactoryMap.find(T_A);
-   RRList* key = new RRList(record, 3600);         
-   RRSet::iterator lb = mRRSet.lower_bound(key);
-   if (lb != mRRSet.end() &&
-       !(mRRSet.key_comp()(key, *lb)))
+   RRSet::iterator it = mRRSet.find(RRCacheKey(Data::Share, record.name(), T_A));
+   if (it != mRRSet.end())
    {
-      (*lb)->update(record, 3600);
-      touch(*lb);
+      it->second->update(record, 3600);
+      touch(it->second);
    }
    else
    {
       RRList* val = new RRList(record, 3600);
-      mRRSet.insert(val);
+      mRRSet.insert(RRSet::value_type(RRCacheKey(val->key(), T_A), val));
       mLruHead->push_back(val);
       purge();
    }
-   delete key;
 }
 
 void 
@@ -97,22 +113,19 @@ RRCache::updateCache(const Data& target,
    Data domain = (*begin).domain();
    FactoryMap::iterator it = mFactoryMap.find(rrType);
    resip_assert(it != mFactoryMap.end());
-   RRList* key = new RRList(domain, rrType);         
-   RRSet::iterator lb = mRRSet.lower_bound(key);
-   if (lb != mRRSet.end() &&
-       !(mRRSet.key_comp()(key, *lb)))
+   RRSet::iterator lb = mRRSet.find(RRCacheKey(Data::Share, domain, rrType));
+   if (lb != mRRSet.end())
    {
-      (*lb)->update(it->second, begin, end, mUserDefinedTTL);
-      touch(*lb);
+      lb->second->update(it->second, begin, end, mUserDefinedTTL);
+      touch(lb->second);
    }
    else
    {
       RRList* val = new RRList(it->second, domain, rrType, begin, end, mUserDefinedTTL);
-      mRRSet.insert(val);
+      mRRSet.insert(RRSet::value_type(RRCacheKey(domain, rrType), val));
       mLruHead->push_back(val);
       purge();
    }
-   delete key;
 }
 
 void 
@@ -134,16 +147,27 @@ RRCache::cacheTTL(const Data& target,
    }
 
    RRList* val = new RRList(target, rrType, ttl, status);
-   RRSet::iterator it = mRRSet.find(val);
+   RRSet::iterator it = mRRSet.find(RRCacheKey(Data::Share, target, rrType));
    if (it != mRRSet.end())
    {
-      (*it)->remove();
-      delete *it;
-      mRRSet.erase(it);
+      // the list element unlinks itself from the LRU list
+      delete it->second;
+      it->second = val;
+      mLruHead->push_back(val);
+   }
+   else
+   {
+      mRRSet.insert(RRSet::value_type(RRCacheKey(target, rrType), val));
+      mLruHead->push_back(val);
+      purge();
    }
-   mRRSet.insert(val);
-   mLruHead->push_back(val);
-   purge();
+}
+
+void
+RRCache::setPrefetch(int prefetchWindow, int staleGracePeriod)
+{
+   mPrefetchWindow = prefetchWindow > 0 ? prefetchWindow : 0;
+   mStaleGracePeriod = staleGracePeriod > 0 ? staleGracePeriod : 0;
 }
 
 bool 
@@ -152,32 +176,69 @@ RRCache::lookup(const Data& target,
                 const int protocol,
                 Result& records, 
                 int& status)
+{
+   bool refresh;
+   return lookup(target, type, protocol, records, status, refresh) != Missing;
+}
+
+RRCache::Freshness
+RRCache::lookup(const Data& target, 
+                const int type, 
+                const int protocol,
+                Result& records, 
+                int& status,
+                bool& refresh)
 {
    records.clear();
    status = 0;
-   RRList* key = new RRList(target, type);
-   RRSet::iterator it = mRRSet.find(key);
-   delete key;
+   refresh = false;
+   RRSet::iterator it = mRRSet.find(RRCacheKey(Data::Share, target, type));
    if (it == mRRSet.end())
    {
-      return false;
+      return Missing;
+   }
+
+   RRList* node = it->second;
+   UInt64 now = Timer::getTimeSecs();
+   if (isDead(node, now))
+   {
+      delete node;
+      mRRSet.erase(it);
+      return Missing;
+   }
+
+   node->records(protocol, records);
+   status = node->status();
+   touch(node);
+
+   Freshness freshness;
+   if (now >= node->absoluteExpiry())
+   {
+      freshness = Stale;
+   }
+   else if (node->absoluteExpiry() - now <= (UInt64)mPrefetchWindow)
+   {
+      freshness = Expiring;
    }
    else
    {
-      if (Timer::getTimeSecs() >= (*it)->absoluteExpiry())
-      {
-         delete *it;
-         mRRSet.erase(it);
-         return false;
-      }
-      else
-      {
-         records = (*it)->records(protocol);
-         status = (*it)->status();
-         touch(*it);
-         return true;
-      }
+      return Fresh;
+   }
+
+   if (now >= node->refreshAfter())
+   {
+      node->setRefreshAfter(now + REFRESH_RETRY_SECS);
+      refresh = true;
    }
+   return freshness;
+}
+
+bool
+RRCache::isDead(const RRList* node, UInt64 now) const
+{
+   // absoluteExpiry() may be ULONG_MAX, so don't add the grace period to it
+   return now >= node->absoluteExpiry() &&
+      now - node->absoluteExpiry() >= (UInt64)mStaleGracePeriod;
 }
 
 void 
@@ -196,10 +257,10 @@ RRCache::touch(RRList* node)
 void 
 RRCache::cleanup()
 {
-   for (std::set<RRList*, CompareT>::iterator it = mRRSet.begin(); it != mRRSet.end(); it++)
+   for (RRSet::iterator it = mRRSet.begin(); it != mRRSet.end(); it++)
    {
-      (*it)->remove();
-      delete *it;
+      it->second->remove();
+      delete it->second;
    }
    mRRSet.clear();
 }
@@ -227,28 +288,33 @@ void
 RRCache::purge()
 {
    if (mRRSet.size() < mSize) return;
-   RRList* lst = *(mLruHead->begin());
-   RRSet::iterator it = mRRSet.find(lst);
-   resip_assert(it != mRRSet.end());
-   lst->remove();
-   delete *it;
+   erase(*(mLruHead->begin()));
+}
+
+void
+RRCache::erase(RRList* node)
+{
+   RRSet::iterator it = mRRSet.find(RRCacheKey(Data::Share, node->key(), node->rrType()));
+   resip_assert(it != mRRSet.end() && it->second == node);
    mRRSet.erase(it);
+   node->remove();
+   delete node;
 }
 
 void 
 RRCache::logCache()
 {
    UInt64 now = Timer::getTimeSecs();
-   for (std::set<RRList*, CompareT>::iterator it = mRRSet.begin(); it != mRRSet.end(); )
+   for (RRSet::iterator it = mRRSet.begin(); it != mRRSet.end(); )
    {
-      if (now >= (*it)->absoluteExpiry())
+      if (isDead(it->second, now))
       {
-         delete *it;
+         delete it->second;
          mRRSet.erase(it++);
       }
       else
       {
-         (*it)->log();
+         it->second->log();
          ++it;
       }
    }
@@ -259,22 +325,90 @@ RRCache::getCacheDump(Data& dnsCacheDump)
 {
    UInt64 now = Timer::getTimeSecs();
    DataStream strm(dnsCacheDump);
-   for (std::set<RRList*, CompareT>::iterator it = mRRSet.begin(); it != mRRSet.end(); )
+   for (RRSet::iterator it = mRRSet.begin(); it != mRRSet.end(); )
    {
-      if (now >= (*it)->absoluteExpiry())
+      if (isDead(it->second, now))
       {
-         delete *it;
+         delete it->second;
          mRRSet.erase(it++);
       }
       else
       {
-         (*it)->encodeRRList(strm);
+         it->second->encodeRRList(strm);
          ++it;
       }
    }
    strm.flush();
 }
 
+void
+RRCache::encodeSnapshot(DnsSnapshotWriter& writer)
+{
+   UInt64 now = Timer::getTimeSecs();
+   std::vector<RRList*> live;
+   // least recently used first, so loading the snapshot keeps the LRU order
+   for (LruListType::iterator it = mLruHead->begin(); it != mLruHead->end(); ++it)
+   {
+      if ((*it)->absoluteExpiry() > now)
+      {
+         live.push_back(*it);
+      }
+   }
+
+   writer.putUInt32((UInt32)live.size());
+   for (std::vector<RRList*>::const_iterator it = live.begin(); it != live.end(); ++it)
+   {
+      UInt64 ttl = (*it)->absoluteExpiry() - now;
+      writer.putData((*it)->key());
+      writer.putUInt16((UInt16)(*it)->rrType());
+      writer.putUInt32((UInt32)(*it)->status());
+      writer.putUInt32(ttl > 0xffffffff ? 0xffffffff : (UInt32)ttl);
+      (*it)->encodeSnapshot(writer);
+   }
+}
+
+int
+RRCache::decodeSnapshot(DnsSnapshotReader& reader)
+{
+   int loaded = 0;
+   UInt32 count = 0;
+   reader.getUInt32(count);
+   for (UInt32 i = 0; i < count && reader.ok(); ++i)
+   {
+      Data key;
+      UInt16 rrType = 0;
+      UInt32 status = 0;
+      UInt32 ttl = 0;
+      reader.getData(key);
+      reader.getUInt16(rrType);
+      reader.getUInt32(status);
+      reader.getUInt32(ttl);
+
+      RRList* val = new RRList(key, rrType, ttl > reader.age() ? (int)(ttl - reader.age()) : 0, (int)status);
+      if (!val->decodeSnapshot(reader))
+      {
+         delete val;
+         break;
+      }
+
+      if (ttl <= reader.age() ||
+          mFactoryMap.find(rrType) == mFactoryMap.end() ||
+          mRRSet.find(RRCacheKey(Data::Share, key, rrType)) != mRRSet.end())
+      {
+         // expired while we were down, or not something this cache holds, or
+         // already resolved again since startup
+         delete val;
+         continue;
+      }
+
+      mRRSet.insert(RRSet::value_type(RRCacheKey(key, rrType), val));
+      mLruHead->push_back(val);
+      purge();
+      ++loaded;
+   }
+   return loaded;
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
  * 
@@ -2,9 +2,10 @@
 #define RESIP_RRCACHE_HXX
 
 #include <map>
-#include <set>
 #include <memory>
 
+#include "rutil/HashMap.hxx"
+#include "rutil/Mutex.hxx"
 #include "rutil/dns/RRFactory.hxx"
 #include "rutil/dns/DnsResourceRecord.hxx"
 #include "rutil/dns/DnsAAAARecord.hxx"
@@ -17,7 +18,50 @@
 namespace resip
 {
 class RROverlay;
+class DnsSnapshotWriter;
+class DnsSnapshotReader;
+
+/**
+   Key of an RRCache entry: the record type plus the domain name, compared
+   case-insensitively. Keys stored in the cache own a lowercased copy of the
+   name that is folded and hashed once at insert time; lookup keys share the
+   caller's buffer, so probing the cache allocates nothing.
+*/
+class RRCacheKey
+{
+   public:
+      // owning key, folds the name to lowercase
+      RRCacheKey(const Data& name, int rrType);
+      // lookup key, shares the caller's buffer (which must outlive it)
+      RRCacheKey(Data::ShareEnum, const Data& name, int rrType);
+
+      bool operator==(const RRCacheKey& rhs) const
+      {
+         return mHash == rhs.mHash &&
+            mRRType == rhs.mRRType &&
+            isEqualNoCase(mName, rhs.mName);
+      }
+
+      size_t hash() const { return mHash; }
 
+   private:
+      Data mName;
+      int mRRType;
+      size_t mHash;
+};
+
+}
+
+HashValue(resip::RRCacheKey);
+
+namespace resip
+{
+
+/**
+   The cache itself is not thread-safe. DnsStubs that share one hold
+   getMutex() around every call, and for as long as they use the records a
+   lookup returned, since those belong to the cache.
+*/
 class RRCache
 {
    public:
@@ -27,10 +71,23 @@ class RRCache
       typedef std::vector<RROverlay>::const_iterator Itr;
       typedef std::vector<Data> DataArr;
 
+      // how close a cached entry is to its expiry; see lookup() below
+      typedef enum
+      {
+         Missing,  // not cached, or past its stale grace period
+         Fresh,
+         Expiring, // expires within the prefetch window
+         Stale     // expired, but within the stale grace period
+      } Freshness;
+
       RRCache();
       ~RRCache();
       void setTTL(int ttl) { if (ttl > 0) mUserDefinedTTL = ttl * MIN_TO_SEC; }
       void setSize(int size) { mSize = size; }
+      // Entries expiring within prefetchWindow secs are reported as Expiring,
+      // and expired entries are kept and served as Stale for up to
+      // staleGracePeriod secs. Both are 0 (disabled) by default.
+      void setPrefetch(int prefetchWindow, int staleGracePeriod);
       // Update existing cache record, or add a new one
       void updateCache(const Data& target,
                        const int rrType,
@@ -43,45 +100,41 @@ class RRCache
                     const int status,
                     RROverlay overlay);
       bool lookup(const Data& target, const int type, const int proto, Result& records, int& status);
+      // As above, but also reports how fresh the entry is. refresh is set when
+      // an Expiring or Stale entry should be re-queried; it is set at most once
+      // every REFRESH_RETRY_SECS per entry, so only one refresh is in flight.
+      Freshness lookup(const Data& target, const int type, const int proto, Result& records, int& status, bool& refresh);
       void clearCache();
       void logCache();
       void getCacheDump(Data& dnsCacheDump);
+      // Writes the unexpired entries and their remaining TTLs to a snapshot.
+      void encodeSnapshot(DnsSnapshotWriter& writer);
+      // Adds the snapshot's entries that are still unexpired, given the age of
+      // the snapshot; entries already in the cache win. Returns how many
+      // entries were added.
+      int decodeSnapshot(DnsSnapshotReader& reader);
+      Mutex& getMutex() { return mMutex; }
 
    private:
       static const int MIN_TO_SEC = 60;
       static const int DEFAULT_USER_DEFINED_TTL = 10; // in seconds.
 
       static const int DEFAULT_SIZE = 512;
-      class CompareT
-      {
-         public:
-            bool operator()(const RRList* lhs, const RRList* rhs) const
-            {
-               if (lhs->rrType() < rhs->rrType())
-               {
-                  return true;
-               }
-               else if (lhs->rrType() > rhs->rrType())
-               {
-                  return false;
-               }
-               else
-               {
-                  return (Data(lhs->key())).lowercase() < (Data(rhs->key())).lowercase();
-               }
-            }
-      };
+      // a refresh that has not updated its entry by then may be retried
+      static const int REFRESH_RETRY_SECS = 5;
 
       void touch(RRList* node);
       void cleanup();
       int getTTL(const RROverlay& overlay);
       void purge();
+      void erase(RRList* node);
+      bool isDead(const RRList* node, UInt64 now) const;
 
       RRList mHead;
       LruListType* mLruHead;                     
       Result Empty;
 
-      typedef std::set<RRList*, CompareT> RRSet;
+      typedef HashMap<RRCacheKey, RRList*> RRSet;
       RRSet mRRSet;
 
       RRFactory<DnsHostRecord> mHostRecordFactory;
@@ -95,6 +148,9 @@ class RRCache
       
       int mUserDefinedTTL; // used when the ttl in RR is 0 or less than default(60). in seconds.
       unsigned int mSize;
+      int mPrefetchWindow; // in seconds.
+      int mStaleGracePeriod; // in seconds.
+      Mutex mMutex;
 };
 
 }
@@ -30,25 +30,26 @@
 #include "rutil/dns/DnsNaptrRecord.hxx"
 #include "rutil/dns/DnsSrvRecord.hxx"
 #include "rutil/dns/DnsCnameRecord.hxx"
+#include "rutil/dns/DnsSnapshot.hxx"
 
 using namespace resip;
 using namespace std;
 
 #define RESIPROCATE_SUBSYSTEM resip::Subsystem::DNS
 
-RRList::RRList() : mRRType(0), mStatus(0), mAbsoluteExpiry(ULONG_MAX) {}
+RRList::RRList() : mRRType(0), mStatus(0), mAbsoluteExpiry(ULONG_MAX), mRefreshAfter(0) {}
 
 RRList::RRList(const Data& key, 
                const int rrtype, 
                int ttl, 
                int status)
-   : mKey(key), mRRType(rrtype), mStatus(status)
+   : mKey(key), mRRType(rrtype), mStatus(status), mRefreshAfter(0)
 {
    mAbsoluteExpiry = ttl + Timer::getTimeSecs();
 }
 
 RRList::RRList(const DnsHostRecord &record, int ttl)
-   : mKey(record.name()), mRRType(T_A), mStatus(0), mAbsoluteExpiry(ULONG_MAX)
+   : mKey(record.name()), mRRType(T_A), mStatus(0), mAbsoluteExpiry(ULONG_MAX), mRefreshAfter(0)
 {
    update(record, ttl);
 }
@@ -60,11 +61,13 @@ void RRList::update(const DnsHostRecord &record, int ttl)
    RecordItem item;
    item.record = new DnsHostRecord(record);
    mRecords.push_back(item);
+   mStatus = 0;
    mAbsoluteExpiry = Timer::getTimeSecs() + ttl;
+   mRefreshAfter = 0;
 }
       
 RRList::RRList(const Data& key, int rrtype)
-   : mKey(key), mRRType(rrtype), mStatus(0), mAbsoluteExpiry(ULONG_MAX)
+   : mKey(key), mRRType(rrtype), mStatus(0), mAbsoluteExpiry(ULONG_MAX), mRefreshAfter(0)
 {}
 
 RRList::~RRList()
@@ -78,7 +81,7 @@ RRList::RRList(const RRFactoryBase* factory,
                Itr begin,
                Itr end, 
                int ttl)
-   : mKey(key), mRRType(rrType), mStatus(0)
+   : mKey(key), mRRType(rrType), mStatus(0), mRefreshAfter(0)
 {
    update(factory, begin, end, ttl);
 }
@@ -86,6 +89,9 @@ RRList::RRList(const RRFactoryBase* factory,
 void RRList::update(const RRFactoryBase* factory, Itr begin, Itr end, int ttl)
 {
    this->clear();
+   // a refresh may replace a cached failure with an answer
+   mStatus = 0;
+   mRefreshAfter = 0;
    mAbsoluteExpiry = ULONG_MAX;
    
    for (Itr it = begin; it != end; it++)
@@ -117,13 +123,17 @@ void RRList::update(const RRFactoryBase* factory, Itr begin, Itr end, int ttl)
 RRList::Records RRList::records(const int protocol)
 {
    Records records;
-   if (mRecords.empty()) return records;
+   this->records(protocol, records);
+   return records;
+}
 
+void RRList::records(const int protocol, Records& result)
+{
+   result.clear();
    for (std::vector<RecordItem>::iterator it = mRecords.begin(); it != mRecords.end(); ++it)
    {
-      records.push_back((*it).record);
+      result.push_back((*it).record);
    }
-   return records;
 }
 
 RRList::RecordItr RRList::find(const Data& value)
@@ -231,6 +241,173 @@ RRList:: encodeRRList(EncodeStream& strm)
    return strm;
 }
 
+void
+RRList::encodeSnapshot(DnsSnapshotWriter& writer) const
+{
+   writer.putUInt32((UInt32)mRecords.size());
+   for (RecordArr::const_iterator it = mRecords.begin(); it != mRecords.end(); ++it)
+   {
+      writer.putData(it->record->name());
+      switch(mRRType)
+      {
+      case T_CNAME:
+         {
+            DnsCnameRecord* record = dynamic_cast<DnsCnameRecord*>(it->record);
+            resip_assert(record);
+            writer.putData(record->cname());
+            break;
+         }
+
+      case T_NAPTR:
+         {
+            DnsNaptrRecord* record = dynamic_cast<DnsNaptrRecord*>(it->record);
+            resip_assert(record);
+            writer.putUInt16((UInt16)record->order());
+            writer.putUInt16((UInt16)record->preference());
+            writer.putData(record->flags());
+            writer.putData(record->service());
+            writer.putData(record->regexp().regexp());
+            writer.putData(record->regexp().replacement());
+            writer.putData(record->replacement());
+            break;
+         }
+
+      case T_SRV:
+         {
+            DnsSrvRecord* record = dynamic_cast<DnsSrvRecord*>(it->record);
+            resip_assert(record);
+            writer.putUInt16((UInt16)record->priority());
+            writer.putUInt16((UInt16)record->weight());
+            writer.putUInt16((UInt16)record->port());
+            writer.putData(record->target());
+            break;
+         }
+
+#ifdef USE_IPV6
+      case T_AAAA:
+         {
+            DnsAAAARecord* record = dynamic_cast<DnsAAAARecord*>(it->record);
+            resip_assert(record);
+            writer.putBytes(&record->v6Address(), sizeof(in6_addr));
+            break;
+         }
+#endif
+
+      case T_A:
+         {
+            DnsHostRecord* record = dynamic_cast<DnsHostRecord*>(it->record);
+            resip_assert(record);
+            in_addr addr = record->addr();
+            writer.putBytes(&addr, sizeof(addr));
+            break;
+         }
+
+      default:
+         resip_assert(0);
+         break;
+      }
+   }
+}
+
+bool
+RRList::decodeSnapshot(DnsSnapshotReader& reader)
+{
+   clear();
+   UInt32 count = 0;
+   reader.getUInt32(count);
+   for (UInt32 i = 0; i < count && reader.ok(); ++i)
+   {
+      Data name;
+      reader.getData(name);
+      RecordItem item;
+      item.record = 0;
+      switch(mRRType)
+      {
+      case T_CNAME:
+         {
+            Data cname;
+            if (reader.getData(cname))
+            {
+               item.record = new DnsCnameRecord(name, cname);
+            }
+            break;
+         }
+
+      case T_NAPTR:
+         {
+            UInt16 order = 0;
+            UInt16 preference = 0;
+            Data flags;
+            Data service;
+            Data regexp;
+            Data regexpReplacement;
+            Data replacement;
+            reader.getUInt16(order);
+            reader.getUInt16(preference);
+            reader.getData(flags);
+            reader.getData(service);
+            reader.getData(regexp);
+            reader.getData(regexpReplacement);
+            if (reader.getData(replacement))
+            {
+               item.record = new DnsNaptrRecord(name, order, preference, flags, service,
+                                                DnsNaptrRecord::RegExp(regexp, regexpReplacement),
+                                                replacement);
+            }
+            break;
+         }
+
+      case T_SRV:
+         {
+            UInt16 priority = 0;
+            UInt16 weight = 0;
+            UInt16 port = 0;
+            Data target;
+            reader.getUInt16(priority);
+            reader.getUInt16(weight);
+            reader.getUInt16(port);
+            if (reader.getData(target))
+            {
+               item.record = new DnsSrvRecord(name, priority, weight, port, target);
+            }
+            break;
+         }
+
+#ifdef USE_IPV6
+      case T_AAAA:
+         {
+            in6_addr addr;
+            if (reader.getBytes(&addr, sizeof(addr)))
+            {
+               item.record = new DnsAAAARecord(name, addr);
+            }
+            break;
+         }
+#endif
+
+      case T_A:
+         {
+            in_addr addr;
+            if (reader.getBytes(&addr, sizeof(addr)))
+            {
+               item.record = new DnsHostRecord(name, addr);
+            }
+            break;
+         }
+
+      default:
+         // written by a build that knows more record types than this one
+         return false;
+      }
+
+      if (item.record)
+      {
+         mRecords.push_back(item);
+      }
+   }
+   return reader.ok();
+}
+
 
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
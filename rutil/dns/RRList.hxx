@@ -10,6 +10,8 @@ namespace resip
 {
 class DnsResourceRecord;
 class DnsHostRecord;
+class DnsSnapshotWriter;
+class DnsSnapshotReader;
 
 class RRList : public IntrusiveListElement<RRList*>
 {
@@ -46,14 +48,24 @@ class RRList : public IntrusiveListElement<RRList*>
 
       void update(const RRFactoryBase* factory, Itr begin, Itr end, int ttl);
       Records records(const int protocol);
+      // replaces the contents of result, reusing its storage
+      void records(const int protocol, Records& result);
 
       const Data& key() const { return mKey; }
       int status() const { return mStatus; }
       int rrType() const { return mRRType; }
       UInt64 absoluteExpiry() const { return mAbsoluteExpiry; }
       UInt64& absoluteExpiry() { return mAbsoluteExpiry; }
+      // time (in secs) before which no refresh of this list is due, set while
+      // a prefetch or stale refresh is in flight
+      UInt64 refreshAfter() const { return mRefreshAfter; }
+      void setRefreshAfter(UInt64 secs) { mRefreshAfter = secs; }
       void log();
       EncodeStream& encodeRRList(EncodeStream& strm);
+      // the records, for the DnsStub cache snapshot; decodeSnapshot() replaces
+      // the current records and returns false if the snapshot is malformed
+      void encodeSnapshot(DnsSnapshotWriter& writer) const;
+      bool decodeSnapshot(DnsSnapshotReader& reader);
 
    private:
 
@@ -73,6 +85,7 @@ class RRList : public IntrusiveListElement<RRList*>
 
       int mStatus; // dns query status.
       UInt64 mAbsoluteExpiry;
+      UInt64 mRefreshAfter;
 
       RecordItr find(const Data&);
       void clear();
@@ -30,11 +30,13 @@
 #include "rutil/Log.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/BaseException.hxx"
+#include "rutil/Lock.hxx"
 #include "rutil/dns/DnsResourceRecord.hxx"
 #include "rutil/dns/DnsAAAARecord.hxx"
 #include "rutil/dns/DnsHostRecord.hxx"
 #include "rutil/dns/DnsNaptrRecord.hxx"
 #include "rutil/dns/DnsSrvRecord.hxx"
+#include "rutil/dns/DnsSnapshot.hxx"
 #include "rutil/dns/RRVip.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
@@ -68,6 +70,7 @@ void RRVip::vip(const Data& target,
                 int rrType,
                 const Data& vip)
 {
+   Lock lock(mMutex);
    RRVip::MapKey key(target, rrType);
    TransformMap::iterator it = mTransforms.find(key);
    if (it != mTransforms.end())
@@ -86,6 +89,7 @@ void RRVip::vip(const Data& target,
 void RRVip::removeVip(const Data& target,
                       int rrType)
 {
+   Lock lock(mMutex);
    RRVip::MapKey key(target, rrType);
    TransformMap::iterator it = mTransforms.find(key);
    if (it != mTransforms.end())
@@ -101,6 +105,7 @@ void RRVip::transform(const Data& target,
                       int rrType,
                       std::vector<DnsResourceRecord*>& src)
 {
+   Lock lock(mMutex);
    RRVip::MapKey key(target, rrType);
    TransformMap::iterator it = mTransforms.find(key);
    if (it != mTransforms.end())
@@ -109,11 +114,44 @@ void RRVip::transform(const Data& target,
       it->second->transform(src, invalidVip);
       if (invalidVip) 
       {
-         removeVip(target, rrType);
+         DebugLog(<< "removed vip " << target << "(" << rrType << "): " << it->second->vip());
+         delete it->second;
+         mTransforms.erase(it);
       }
    }
 }
 
+void RRVip::encodeSnapshot(DnsSnapshotWriter& writer)
+{
+   Lock lock(mMutex);
+   writer.putUInt32((UInt32)mTransforms.size());
+   for (TransformMap::iterator it = mTransforms.begin(); it != mTransforms.end(); ++it)
+   {
+      writer.putData(it->first.target());
+      writer.putUInt16((UInt16)it->first.rrType());
+      writer.putData(it->second->vip());
+   }
+}
+
+bool RRVip::decodeSnapshot(DnsSnapshotReader& reader)
+{
+   UInt32 count = 0;
+   reader.getUInt32(count);
+   for (UInt32 i = 0; i < count && reader.ok(); ++i)
+   {
+      Data target;
+      UInt16 rrType = 0;
+      Data vip;
+      reader.getData(target);
+      reader.getUInt16(rrType);
+      if (reader.getData(vip) && mFactories.find(rrType) != mFactories.end())
+      {
+         this->vip(target, rrType, vip);
+      }
+   }
+   return reader.ok();
+}
+
 RRVip::Transform::Transform(const Data& vip) 
    : mVip(vip)
 {
@@ -1,10 +1,13 @@
 #ifndef RESIP_RRVIP_HXX
 #define RESIP_RRVIP_HXX
 
+#include "rutil/Mutex.hxx"
 #include "rutil/dns/DnsStub.hxx"
 
 namespace resip
 {
+class DnsSnapshotWriter;
+class DnsSnapshotReader;
 
 class RRVip : public DnsStub::ResultTransform
 {
@@ -15,6 +18,9 @@ class RRVip : public DnsStub::ResultTransform
       void vip(const Data& target, int rrType, const Data& vip);
       void removeVip(const Data& target, int rrType);
       void transform(const Data& target, int rrType, std::vector<DnsResourceRecord*>&);
+      // the vips, for the DNS cache snapshot
+      void encodeSnapshot(DnsSnapshotWriter& writer);
+      bool decodeSnapshot(DnsSnapshotReader& reader);
 
    private:
 
@@ -55,6 +61,8 @@ class RRVip : public DnsStub::ResultTransform
             MapKey();
             MapKey(const Data& target, int rrType);
             bool operator<(const MapKey&) const;
+            const Data& target() const { return mTarget; }
+            int rrType() const { return mRRType; }
          private:
             Data mTarget;
             int mRRType;
@@ -90,6 +98,8 @@ class RRVip : public DnsStub::ResultTransform
 
       typedef std::map<MapKey, Transform*> TransformMap;
       TransformMap mTransforms;  
+      // DnsStubs sharing a cache may transform results from several threads
+      Mutex mMutex;
 };
 
 }
@@ -8,16 +8,37 @@
 #include "rutil/hep/HepAgent.hxx"
 #include "rutil/DnsUtil.hxx"
 #include "rutil/DataStream.hxx"
+#include "rutil/Lock.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/ResipAssert.h"
+#include "rutil/Timer.hxx"
+
+#if defined(HAVE_SENDMMSG)
+#define RESIP_HEP_BATCH_IO
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
 
 using namespace resip;
 using namespace std;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
 
-HepAgent::HepAgent(const Data &captureHost, int capturePort, int captureAgentID)
-   : mCaptureHost(captureHost), mCapturePort(capturePort), mCaptureAgentID(captureAgentID)
+HepAgent::HepAgent(const Data &captureHost, int capturePort, int captureAgentID,
+                   unsigned int maxQueued)
+   : mCaptureHost(captureHost), mCapturePort(capturePort), mCaptureAgentID(captureAgentID),
+     mMaxQueued(maxQueued),
+     mInUse(0),
+     mOverloaded(false),
+     mSampling(1),
+     mSampleCount(0),
+     mRateLimit(0),
+     mRateWindowStart(0),
+     mRateWindowCount(0),
+     mSender(0)
 {
+   memset(&mStats, 0, sizeof(mStats));
+
    bool initV4Socket = true;
    struct sockaddr myaddr;
    memset(&myaddr, 0, sizeof(myaddr));
@@ -65,10 +86,10 @@ HepAgent::HepAgent(const Data &captureHost, int capturePort, int captureAgentID)
       throw std::runtime_error("Failed to create socket");
    }
 
-   // make it non-blocking
-   // FIXME - HEP messages are lost if the transmit buffer fills up
-   // Messages should be queued and sent as part of the main loop
-   if(!makeSocketNonBlocking(mSocket))
+   // When sending inline, never hold up the thread handling the SIP
+   // message: a packet that doesn't fit in the transmit buffer is lost.
+   // The sender thread may block instead; its queue absorbs the wait.
+   if(mMaxQueued == 0 && !makeSocketNonBlocking(mSocket))
    {
       ErrLog(<<"Failed to set O_NONBLOCK");
       throw std::runtime_error("Failed to set O_NONBLOCK");
@@ -111,10 +132,255 @@ HepAgent::HepAgent(const Data &captureHost, int capturePort, int captureAgentID)
    }
    freeaddrinfo(rset);
    InfoLog(<<"HEP capture agent ready to send to " << mDestination);
+
+   if(mMaxQueued > 0)
+   {
+      mSender = new Sender(*this);
+      mSender->run();
+   }
 }
 
 HepAgent::~HepAgent()
 {
+   if(mSender)
+   {
+      // the sender sends what is queued before it exits
+      mSender->shutdown();
+      {
+         Lock lock(mMutex);
+         mPacketsReady.signal();
+      }
+      mSender->join();
+      delete mSender;
+   }
+   for(std::vector<Data*>::iterator i = mFree.begin(); i != mFree.end(); ++i)
+   {
+      delete *i;
+   }
+   closeSocket(mSocket);
+   InfoLog(<< "HEP capture agent for " << mDestination << " sent " << mStats.mSent
+           << " packets (" << mStats.mSendErrors << " send errors, "
+           << mStats.mQueueFull << " dropped on overload, "
+           << mStats.mRateLimited << " rate limited, "
+           << mStats.mSampledOut << " sampled out)");
+}
+
+void
+HepAgent::setSampling(unsigned int oneIn)
+{
+   Lock lock(mMutex);
+   mSampling = oneIn ? oneIn : 1;
+}
+
+void
+HepAgent::setRateLimit(unsigned int packetsPerSecond)
+{
+   Lock lock(mMutex);
+   mRateLimit = packetsPerSecond;
+}
+
+HepAgent::Stats
+HepAgent::getStats() const
+{
+   Lock lock(mMutex);
+   return mStats;
+}
+
+Data*
+HepAgent::acquireBuffer(const Data& correlationId)
+{
+   Lock lock(mMutex);
+   if(mSampling > 1)
+   {
+      const size_t sample = correlationId.empty() ? (size_t)mSampleCount++ : correlationId.hash();
+      if(sample % mSampling != 0)
+      {
+         ++mStats.mSampledOut;
+         return 0;
+      }
+   }
+
+   if(mRateLimit > 0)
+   {
+      const UInt64 now = Timer::getTimeMs();
+      if(now - mRateWindowStart >= 1000)
+      {
+         mRateWindowStart = now;
+         mRateWindowCount = 0;
+      }
+      if(mRateWindowCount >= mRateLimit)
+      {
+         ++mStats.mRateLimited;
+         return 0;
+      }
+      ++mRateWindowCount;
+   }
+
+   if(mMaxQueued > 0 && mInUse >= mMaxQueued)
+   {
+      ++mStats.mQueueFull;
+      if(!mOverloaded)
+      {
+         mOverloaded = true;
+         WarningLog(<< "HEP capture queue to " << mDestination << " is full, dropping packets");
+      }
+      return 0;
+   }
+
+   ++mInUse;
+   if(mFree.empty())
+   {
+      return new Data(InitialBufferSize, Data::Preallocate);
+   }
+   Data* buf = mFree.back();
+   mFree.pop_back();
+   return buf;
+}
+
+void
+HepAgent::releaseBuffer(Data* buf)
+{
+   Lock lock(mMutex);
+   releaseBufferLocked(buf);
+}
+
+void
+HepAgent::releaseBufferLocked(Data* buf)
+{
+   --mInUse;
+   if(mFree.size() < MaxFreeBuffers)
+   {
+      mFree.push_back(buf);
+   }
+   else
+   {
+      delete buf;
+   }
+}
+
+void
+HepAgent::submit(Data* buf)
+{
+   if(mSender == 0)
+   {
+      const unsigned int failed = send(&buf, 1);
+      Lock lock(mMutex);
+      ++(failed ? mStats.mSendErrors : mStats.mSent);
+      releaseBufferLocked(buf);
+      return;
+   }
+
+   Lock lock(mMutex);
+   mQueue.push_back(buf);
+   if(mQueue.size() == 1)
+   {
+      // the sender only waits when there was nothing to send
+      mPacketsReady.signal();
+   }
+}
+
+void
+HepAgent::runSender()
+{
+   std::vector<Data*> batch;
+   batch.reserve(BatchSize);
+   for(;;)
+   {
+      {
+         Lock lock(mMutex);
+         while(mQueue.empty() && !mSender->isShutdown())
+         {
+            mPacketsReady.wait(mMutex);
+         }
+         if(mQueue.empty())
+         {
+            return;
+         }
+         while(!mQueue.empty() && batch.size() < BatchSize)
+         {
+            batch.push_back(mQueue.front());
+            mQueue.pop_front();
+         }
+      }
+
+      const unsigned int failed = send(&batch[0], (unsigned int)batch.size());
+
+      Lock lock(mMutex);
+      mStats.mSent += batch.size() - failed;
+      mStats.mSendErrors += failed;
+      ++mStats.mBatches;
+      for(std::vector<Data*>::iterator i = batch.begin(); i != batch.end(); ++i)
+      {
+         releaseBufferLocked(*i);
+      }
+      batch.clear();
+      if(mQueue.empty())
+      {
+         mOverloaded = false;
+      }
+   }
+}
+
+unsigned int
+HepAgent::send(Data* const* packets, unsigned int count)
+{
+   unsigned int failed = 0;
+#ifdef RESIP_HEP_BATCH_IO
+   mmsghdr hdrs[BatchSize];
+   iovec iovs[BatchSize];
+   resip_assert(count <= BatchSize);
+   memset(hdrs, 0, sizeof(hdrs[0]) * count);
+   for(unsigned int i = 0; i < count; ++i)
+   {
+      iovs[i].iov_base = (void*)packets[i]->data();
+      iovs[i].iov_len = packets[i]->size();
+      hdrs[i].msg_hdr.msg_name = (void*)&mDestination.address;
+      hdrs[i].msg_hdr.msg_namelen = mDestination.length();
+      hdrs[i].msg_hdr.msg_iov = &iovs[i];
+      hdrs[i].msg_hdr.msg_iovlen = 1;
+   }
+   unsigned int done = 0;
+   while(done < count)
+   {
+      int sent = sendmmsg(mSocket, &hdrs[done], count - done, 0);
+      if(sent <= 0)
+      {
+         int e = getErrno();
+         if(e == EINTR)
+         {
+            // interrupted before anything went out; nothing failed yet
+            continue;
+         }
+         // the first datagram not taken is the one that failed; skip it
+         ErrLog(<< "sending to HOMER " << mDestination << " failed (" << e << "): " << strerror(e));
+         ++failed;
+         ++done;
+         continue;
+      }
+      done += sent;
+   }
+#else
+   for(unsigned int i = 0; i < count; ++i)
+   {
+      int rc;
+      do
+      {
+         rc = sendto(mSocket, packets[i]->data(), packets[i]->size(), 0, &mDestination.address, mDestination.length());
+      }
+      while(rc < 0 && getErrno() == EINTR);
+      if(rc < 0)
+      {
+         int e = getErrno();
+#if defined(WIN32)
+         ErrLog(<< "sending to HOMER " << mDestination << " failed (" << e << ")");
+#else
+         ErrLog(<< "sending to HOMER " << mDestination << " failed (" << e << "): " << strerror(e));
+#endif
+         ++failed;
+      }
+   }
+#endif
+   return failed;
 }
 
 /* ====================================================================
@@ -8,12 +8,32 @@
 #include "rutil/hep/ResipHep.hxx"
 #include "rutil/DataStream.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/Condition.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ThreadIf.hxx"
+
+#include <deque>
+#include <vector>
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
 
 namespace resip
 {
 
+/**
+   @brief Sends HEP3 capture packets to a HOMER server.
+
+   sendToHOMER() encodes the packet on the calling thread, into a buffer
+   taken from a pool so that steady-state capture does not allocate. By
+   default the packet is then queued for a sender thread owned by the
+   agent, which hands whatever has accumulated to the kernel in one
+   sendmmsg() (sendto() per packet where that is unavailable). With
+   maxQueued 0 the packet is sent inline instead, as older versions did.
+
+   Capture can be thinned with setSampling() and setRateLimit(). Packets
+   skipped that way, and packets dropped because maxQueued were already
+   waiting, are counted in getStats() rather than slowing the caller.
+*/
 class HepAgent
 {
    public:
@@ -23,10 +43,52 @@ class HepAgent
          RTCP_JSON = 5
       } HEPEventType;
 
-      HepAgent(const Data &captureHost, int capturePort, int captureAgentID);
+      /// Counters since the agent was created.
+      struct Stats
+      {
+         UInt64 mSent;
+         UInt64 mSendErrors;
+         UInt64 mSampledOut;   ///< skipped by setSampling()
+         UInt64 mRateLimited;  ///< dropped by setRateLimit()
+         UInt64 mQueueFull;    ///< dropped because maxQueued packets were waiting
+         UInt64 mBatches;      ///< send calls made by the sender thread
+      };
+
+      static const unsigned int DefaultMaxQueued = 8192;
+
+      HepAgent(const Data &captureHost, int capturePort, int captureAgentID,
+               unsigned int maxQueued = DefaultMaxQueued);
       virtual ~HepAgent();
+
+      /** Capture one packet in oneIn (1, the default, captures all).
+          Packets with a correlation ID are sampled by its hash, so a call
+          is either captured completely or not at all. */
+      void setSampling(unsigned int oneIn);
+      /// At most packetsPerSecond packets are captured; 0 means no limit.
+      void setRateLimit(unsigned int packetsPerSecond);
+      Stats getStats() const;
+
       template <class T>
       void sendToHOMER(const TransportType type, const GenericIPAddress& source, const GenericIPAddress& destination, const HEPEventType eventType, const T& msg, const Data& correlationId)
+      {
+         Data* buf = acquireBuffer(correlationId);
+         if (buf == 0)
+         {
+            return;
+         }
+         if (encode(*buf, type, source, destination, eventType, msg, correlationId))
+         {
+            submit(buf);
+         }
+         else
+         {
+            releaseBuffer(buf);
+         }
+      }
+
+   private:
+      template <class T>
+      bool encode(Data& buf, const TransportType type, const GenericIPAddress& source, const GenericIPAddress& destination, const HEPEventType eventType, const T& msg, const Data& correlationId)
       {
          struct hep_generic *hg;
          hep_chunk_ip4_t src_ip4, dst_ip4;
@@ -36,10 +98,9 @@ class HepAgent
          hep_chunk_ip6_t src_ip6, dst_ip6;
 #endif
 
-         char *data = new char[sizeof(struct hep_generic)];
-         Data buf(Data::Take, data, sizeof(struct hep_generic));
-         hg = (struct hep_generic *)buf.data();
-         DebugLog(<< "buf.size() == " << buf.size());
+         buf.clear();
+         hg = (struct hep_generic *)buf.getBuf(sizeof(struct hep_generic));
+         StackLog(<< "buf.size() == " << buf.size());
          DataStream stream(buf);
 
          memset(hg, 0, sizeof(struct hep_generic));
@@ -107,11 +168,11 @@ class HepAgent
             {
             default:
                ErrLog(<<"unhandled address family");
-               return;
+               return false;
             }
          }
          stream.flush();
-         DebugLog(<< "buf.size() == " << buf.size());
+         StackLog(<< "buf.size() == " << buf.size());
          hg = (struct hep_generic *)buf.data();
 
          /* PROTOCOL */
@@ -137,7 +198,7 @@ class HepAgent
                break;
             default:
                ErrLog(<<"unhandled TransportType");
-               return;
+               return false;
          }
          /* Proto ID */
          hg->ip_proto.chunk.vendor_id = htons(0x0000);
@@ -205,37 +266,65 @@ class HepAgent
          stream << chunk;
          stream.flush();
          Data::size_type beforePayload = buf.size();
-         DebugLog(<< "buf.size() == " << buf.size());
+         StackLog(<< "buf.size() == " << buf.size());
          stream << msg;
          stream.flush();
          Data::size_type afterPayload = buf.size();
-         DebugLog(<< "Final buf.size() == " << buf.size());
+         StackLog(<< "Final buf.size() == " << buf.size());
          hep_chunk_t *_payload_chunk = (hep_chunk_t *)(buf.data() + payloadChunkOffset);
          _payload_chunk->length = htons(sizeof(payload_chunk) + afterPayload - beforePayload);
          hg = (struct hep_generic *)buf.data();
          hg->header.length = htons(afterPayload);
 
-         if(sendto(mSocket, buf.data(), buf.size(), 0, &mDestination.address, mDestination.length()) < 0)
-         {
-            int e = getErrno();
-#if defined(WIN32)
-            ErrLog(<< "sending to HOMER " << mDestination << " failed (" << e << ")");
-#else
-            ErrLog(<< "sending to HOMER " << mDestination << " failed (" << e << "): " << strerror(e));
-#endif
-         }
-         else
-         {
-            DebugLog(<< "packet sent to HOMER " << mDestination);
-         }
+         return true;
       }
 
-   private:
+      Data* acquireBuffer(const Data& correlationId);
+      void releaseBuffer(Data* buf);
+      void releaseBufferLocked(Data* buf);
+      void submit(Data* buf);
+      /// @return the number of packets that could not be sent
+      unsigned int send(Data* const* packets, unsigned int count);
+      void runSender();
+
+      class Sender : public ThreadIf
+      {
+         public:
+            explicit Sender(HepAgent& agent) : mAgent(agent) {}
+            virtual void thread() { mAgent.runSender(); }
+         private:
+            HepAgent& mAgent;
+      };
+
+      /// packets handed to the kernel per send call
+      static const unsigned int BatchSize = 32;
+      /// capacity of a new pooled buffer; most SIP messages fit
+      static const Data::size_type InitialBufferSize = 4096;
+      /// buffers kept in the pool when idle
+      static const unsigned int MaxFreeBuffers = 256;
+
       Data mCaptureHost;
       int mCapturePort;
       int mCaptureAgentID;
       GenericIPAddress mDestination;
       Socket mSocket;
+
+      const unsigned int mMaxQueued;
+      mutable Mutex mMutex;
+      Condition mPacketsReady;
+      /// packets waiting for the sender thread
+      std::deque<Data*> mQueue;
+      std::vector<Data*> mFree;
+      /// buffers handed out and not yet released
+      unsigned int mInUse;
+      bool mOverloaded;
+      unsigned int mSampling;
+      UInt64 mSampleCount;
+      unsigned int mRateLimit;
+      UInt64 mRateWindowStart;
+      unsigned int mRateWindowCount;
+      Stats mStats;
+      Sender* mSender;
 };
 
 
@@ -0,0 +1,348 @@
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "rutil/Logger.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Timer.hxx"
+#include "rutil/Time.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+namespace
+{
+
+const int MaxThreads = 16;
+
+// Counts "T<thread> <seq>" lines per thread and checks each thread's lines
+// arrive in order. Anything else (the writer's drop report) is counted as
+// other.
+class CountingLogger : public ExternalLogger
+{
+   public:
+      CountingLogger() : mOther(0), mOutOfOrder(0), mGate(0), mEntered(false)
+      {
+         reset();
+      }
+
+      void reset()
+      {
+         Lock lock(mMutex);
+         for (int i = 0; i < MaxThreads; ++i)
+         {
+            mCount[i] = 0;
+         }
+         mOther = 0;
+         mOutOfOrder = 0;
+         mCallers.clear();
+      }
+
+      virtual bool operator()(Log::Level level,
+                              const Subsystem& subsystem,
+                              const Data& appName,
+                              const char* file,
+                              int line,
+                              const Data& message,
+                              const Data& messageWithHeaders,
+                              const Data& instanceName)
+      {
+         if (mGate)
+         {
+            mEntered = true;
+            Lock gate(*mGate);
+         }
+
+         Lock lock(mMutex);
+         mCallers.push_back(ThreadIf::selfId());
+         const Data text(message);
+         int thread = 0;
+         int seq = 0;
+         if (sscanf(text.c_str(), "T%d %d", &thread, &seq) == 2 &&
+             thread >= 0 && thread < MaxThreads)
+         {
+            if (seq != mCount[thread])
+            {
+               ++mOutOfOrder;
+            }
+            ++mCount[thread];
+         }
+         else
+         {
+            ++mOther;
+         }
+         return false;
+      }
+
+      int count(int thread)
+      {
+         Lock lock(mMutex);
+         return mCount[thread];
+      }
+
+      Mutex mMutex;
+      int mCount[MaxThreads];
+      int mOther;
+      int mOutOfOrder;
+      vector<ThreadIf::Id> mCallers;
+      Mutex* volatile mGate;
+      volatile bool mEntered;
+};
+
+class LogThread : public ThreadIf
+{
+   public:
+      LogThread(int index, int lines, Log::LocalLoggerId loggerId = 0)
+         : mIndex(index), mLines(lines), mLoggerId(loggerId)
+      {}
+
+      virtual void thread()
+      {
+         if (mLoggerId)
+         {
+            Log::setThreadLocalLogger(mLoggerId);
+         }
+         for (int i = 0; i < mLines; ++i)
+         {
+            InfoLog(<< "T" << mIndex << " " << i << " some text to make the line a typical length");
+         }
+         if (mLoggerId)
+         {
+            Log::setThreadLocalLogger(0);
+         }
+      }
+
+   private:
+      int mIndex;
+      int mLines;
+      Log::LocalLoggerId mLoggerId;
+};
+
+void
+runThreads(int count, int lines, Log::LocalLoggerId loggerId = 0)
+{
+   vector<LogThread*> threads;
+   for (int i = 0; i < count; ++i)
+   {
+      threads.push_back(new LogThread(i, lines, loggerId));
+   }
+   for (int i = 0; i < count; ++i)
+   {
+      threads[i]->run();
+   }
+   for (int i = 0; i < count; ++i)
+   {
+      threads[i]->join();
+      delete threads[i];
+   }
+}
+
+void
+testDelivery(CountingLogger& logger)
+{
+   cerr << "testDelivery" << endl;
+   logger.reset();
+   Log::setAsynchronous(true, 1 << 14);
+   assert(Log::isAsynchronous());
+   const UInt64 dropped = Log::getDroppedLines();
+
+   runThreads(4, 10000);
+   Log::flush();
+
+   assert(Log::getDroppedLines() == dropped);
+   for (int i = 0; i < 4; ++i)
+   {
+      assert(logger.count(i) == 10000);
+   }
+   assert(logger.mOutOfOrder == 0);
+}
+
+void
+testLocalLogger()
+{
+   cerr << "testLocalLogger" << endl;
+   CountingLogger local;
+   Log::LocalLoggerId id = Log::localLoggerCreate(Log::OnlyExternal, Log::Info, 0, &local);
+   runThreads(2, 1000, id);
+   // removing the logger writes out the lines that still refer to it
+   assert(Log::localLoggerRemove(id) == 0);
+   assert(local.count(0) == 1000);
+   assert(local.count(1) == 1000);
+   assert(local.mOutOfOrder == 0);
+}
+
+class GatedThread : public ThreadIf
+{
+   public:
+      GatedThread(CountingLogger& logger, int lines) : mLogger(logger), mLines(lines) {}
+
+      virtual void thread()
+      {
+         InfoLog(<< "T0 0");
+         while (!mLogger.mEntered)
+         {
+            sleepMs(1);
+         }
+         // the writer is stuck inside the first line, which still holds
+         // its slot
+         for (int i = 1; i < mLines; ++i)
+         {
+            InfoLog(<< "T0 " << i);
+         }
+      }
+
+   private:
+      CountingLogger& mLogger;
+      int mLines;
+};
+
+void
+testOverflow(CountingLogger& logger)
+{
+   cerr << "testOverflow" << endl;
+   logger.reset();
+   // only rings created from now on get the new size
+   Log::setAsynchronous(true, 4);
+   const UInt64 dropped = Log::getDroppedLines();
+
+   Mutex gate;
+   gate.lock();
+   logger.mEntered = false;
+   logger.mGate = &gate;
+   GatedThread thread(logger, 100);
+   thread.run();
+   thread.join();
+   assert(Log::getDroppedLines() - dropped == 96);
+   logger.mGate = 0;
+   gate.unlock();
+
+   Log::flush();
+   assert(logger.count(0) == 4);
+   assert(logger.mOutOfOrder == 0);
+   // the drop report
+   assert(logger.mOther == 1);
+   Log::setAsynchronous(true, 1 << 14);
+}
+
+void
+testStop(CountingLogger& logger)
+{
+   cerr << "testStop" << endl;
+   logger.reset();
+   runThreads(4, 1000);
+   Log::setAsynchronous(false);
+   assert(!Log::isAsynchronous());
+   for (int i = 0; i < 4; ++i)
+   {
+      assert(logger.count(i) == 1000);
+   }
+
+   // written by the logging thread itself again
+   logger.reset();
+   InfoLog(<< "T0 0");
+   assert(logger.count(0) == 1);
+   assert(logger.mCallers.size() == 1 && logger.mCallers[0] == ThreadIf::selfId());
+}
+
+void
+benchmark(const char* appName, bool async, int threadCount, int lines)
+{
+   Log::initialize(Log::File, Log::Info, appName, "testAsyncLog-bench.log");
+   Log::setAsynchronous(async, 1 << 14);
+   const UInt64 dropped = Log::getDroppedLines();
+
+   UInt64 start = Timer::getTimeMicroSec();
+   runThreads(threadCount, lines);
+   UInt64 logged = Timer::getTimeMicroSec();
+   Log::setAsynchronous(false);
+   UInt64 written = Timer::getTimeMicroSec();
+
+   const double calls = double(threadCount) * lines;
+   cerr << (async ? "async" : "sync ") << " " << threadCount << " threads: "
+        << UInt64(calls * 1000000 / (logged - start + 1)) << " calls/s, "
+        << (written - start) / 1000 << " ms until written, "
+        << Log::getDroppedLines() - dropped << " dropped" << endl;
+   remove("testAsyncLog-bench.log");
+}
+
+}
+
+int
+main(int argc, char* argv[])
+{
+   CountingLogger logger;
+   Log::initialize(Log::OnlyExternal, Log::Info, argv[0], logger);
+
+   testDelivery(logger);
+   testLocalLogger();
+   testOverflow(logger);
+   testStop(logger);
+
+   if (argc > 1)
+   {
+      const int lines = atoi(argv[1]);
+      benchmark(argv[0], false, MaxThreads, lines);
+      benchmark(argv[0], true, MaxThreads, lines);
+   }
+
+   Log::initialize(Log::Cout, Log::Info, argv[0]);
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
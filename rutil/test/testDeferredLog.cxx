@@ -0,0 +1,229 @@
+#include <cassert>
+#include <iostream>
+#include <string>
+
+#include "rutil/DeferredLog.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+namespace
+{
+
+class CapturingLogger : public ExternalLogger
+{
+   public:
+      CapturingLogger() : mCount(0) {}
+
+      virtual bool operator()(Log::Level level,
+                              const Subsystem& subsystem,
+                              const Data& appName,
+                              const char* file,
+                              int line,
+                              const Data& message,
+                              const Data& messageWithHeaders,
+                              const Data& instanceName)
+      {
+         Lock lock(mMutex);
+         ++mCount;
+         mMessage = message;
+         mWithHeaders = messageWithHeaders;
+         mFile = file;
+         return false;
+      }
+
+      Mutex mMutex;
+      int mCount;
+      Data mMessage;
+      Data mWithHeaders;
+      Data mFile;
+};
+
+// no DeferredLogArg specialization, so it is streamed at the call site
+class Opaque
+{
+   public:
+      explicit Opaque(int value) : mValue(value) {}
+      int mValue;
+};
+
+EncodeStream&
+operator<<(EncodeStream& strm, const Opaque& opaque)
+{
+   return strm << "<opaque " << opaque.mValue << ">";
+}
+
+void
+checkFormatting(CapturingLogger& logger)
+{
+   const char* cstr = "cstr";
+   const Data data("data");
+   const string str("string");
+
+   DeferredInfoLog("plain");
+   Log::flush();
+   assert(logger.mMessage == "plain");
+
+   DeferredInfoLog("int={} neg={} big={} char={} bool={}",
+                   42, -7, UInt64(1) << 40, 'x', true);
+   Log::flush();
+   assert(logger.mMessage == "int=42 neg=-7 big=1099511627776 char=x bool=1");
+
+   DeferredInfoLog("{} {} {} {} {}", cstr, data, str, "literal", 1.5);
+   Log::flush();
+   assert(logger.mMessage == "cstr data string literal 1.5");
+
+   DeferredInfoLog("{{braces}} {}", Opaque(3));
+   Log::flush();
+   assert(logger.mMessage == "{braces} <opaque 3>");
+
+   // missing arguments are left as {}, extra ones are appended
+   DeferredInfoLog("a={} b={}", 1);
+   Log::flush();
+   assert(logger.mMessage == "a=1 b={}");
+   DeferredInfoLog("a={}", 1, 2, data);
+   Log::flush();
+   assert(logger.mMessage == "a=1 2 data");
+
+   // long arguments outgrow the call site's buffer
+   Data longData(1000, Data::Preallocate);
+   for (int i = 0; i < 1000; ++i)
+   {
+      longData += char('a' + i % 26);
+   }
+   DeferredInfoLog("[{}] {}", longData, 5);
+   Log::flush();
+   assert(logger.mMessage == "[" + longData + "] 5");
+
+   // the header is that of an ordinary line from the same place
+   assert(logger.mWithHeaders.size() > logger.mMessage.size());
+   assert(logger.mWithHeaders.postfix(logger.mMessage));
+   assert(logger.mWithHeaders.find("testDeferredLog.cxx:") != Data::npos);
+   assert(logger.mWithHeaders.find("TEST") != Data::npos);
+   assert(logger.mFile.find("testDeferredLog.cxx") != Data::npos);
+
+   // below the level nothing is recorded
+   const int count = logger.mCount;
+   DeferredDebugLog("not logged {}", 1);
+   Log::flush();
+   assert(logger.mCount == count);
+}
+
+void
+benchmark(CapturingLogger& logger, bool deferred, int lines)
+{
+   const Data who("sip:alice@example.com");
+   const Data transport("TLS");
+
+   logger.mCount = 0;
+   UInt64 start = Timer::getTimeMicroSec();
+   for (int i = 0; i < lines; ++i)
+   {
+      if (deferred)
+      {
+         DeferredInfoLog("Processing write for {} via {} seq={} size={} retry={}",
+                         who, transport, i, 1234 + i, 0.25);
+      }
+      else
+      {
+         InfoLog(<< "Processing write for " << who << " via " << transport << " seq=" << i
+                 << " size=" << 1234 + i << " retry=" << 0.25);
+      }
+   }
+   UInt64 logged = Timer::getTimeMicroSec();
+   Log::flush();
+   UInt64 written = Timer::getTimeMicroSec();
+   assert(logger.mCount == lines);
+
+   cerr << (deferred ? "DeferredInfoLog" : "InfoLog        ") << ": "
+        << (logged - start) * 1000 / lines << " ns per call at the call site, "
+        << (written - start) * 1000 / lines << " ns per line including formatting"
+        << endl;
+}
+
+}
+
+int
+main(int argc, char* argv[])
+{
+   CapturingLogger logger;
+   Log::initialize(Log::OnlyExternal, Log::Info, argv[0], logger);
+
+   cerr << "synchronous" << endl;
+   checkFormatting(logger);
+
+   cerr << "asynchronous" << endl;
+   // the benchmark queues all of its lines at once
+   const int lines = argc > 1 ? atoi(argv[1]) : 0;
+   Log::setAsynchronous(true, lines > 8192 ? lines : 8192);
+   checkFormatting(logger);
+
+   if (lines > 0)
+   {
+      benchmark(logger, false, lines);
+      benchmark(logger, true, lines);
+   }
+   assert(Log::getDroppedLines() == 0);
+
+   Log::setAsynchronous(false);
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -4,6 +4,7 @@
 #include "rutil/FiniteFifo.hxx"
 #include "rutil/TimeLimitFifo.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/ParseBuffer.hxx"
 #include "rutil/ThreadIf.hxx"
 #include "rutil/Timer.hxx"
 #ifndef WIN32
@@ -146,6 +147,40 @@ void Producer::thread()
    }
 }
 
+class FifoProducer: public ThreadIf
+{
+   public:
+      FifoProducer(Fifo<Foo>& fifo, int id, int count, int delayMs=0) :
+         mFifo(fifo),
+         mId(id),
+         mCount(count),
+         mDelayMs(delayMs)
+      {}
+      virtual ~FifoProducer()
+      {
+         shutdown();
+         join();
+      }
+
+      void thread()
+      {
+         if (mDelayMs)
+         {
+            sleepMS(mDelayMs);
+         }
+         for (int n = 0; n < mCount; ++n)
+         {
+            mFifo.add(new Foo(Data(mId) + ":" + Data(n)));
+         }
+      }
+
+   private:
+      Fifo<Foo>& mFifo;
+      int mId;
+      int mCount;
+      int mDelayMs;
+};
+
 bool
 isNear(int value, int reference, int epsilon=250)
 {
@@ -355,6 +390,135 @@ main()
       }
    }
    
+   {
+      cerr << "!! Test lock-free multiple producers" << endl;
+
+      const int numProducers = 4;
+      const int perProducer = 20000;
+      Fifo<Foo> fifo;
+      fifo.setLockFree(true);
+      assert(fifo.isLockFree());
+
+      FifoProducer* producers[numProducers];
+      for (int i = 0; i < numProducers; ++i)
+      {
+         producers[i] = new FifoProducer(fifo, i, perProducer);
+         producers[i]->run();
+      }
+
+      // Each producer's elements must come out in the order they went in
+      int next[numProducers] = {0};
+      for (int received = 0; received < numProducers*perProducer; ++received)
+      {
+         Foo* fp = fifo.getNext(5000);
+         assert(fp);
+         ParseBuffer pb(fp->mVal);
+         int id = pb.integer();
+         pb.skipChar(':');
+         int n = pb.integer();
+         assert(id >= 0 && id < numProducers);
+         assert(n == next[id]);
+         ++next[id];
+         delete fp;
+      }
+
+      for (int i = 0; i < numProducers; ++i)
+      {
+         delete producers[i];
+      }
+      assert(fifo.empty());
+      assert(fifo.size() == 0);
+      assert(fifo.getCountDepth() == 0);
+      assert(fifo.getNext(-1) == 0);
+   }
+
+   {
+      cerr << "!! Test lock-free wakeup" << endl;
+
+      Fifo<Foo> fifo;
+      fifo.setLockFree(true);
+      FifoProducer producer(fifo, 0, 1, 200);
+      UInt64 begin = Timer::getTimeMs();
+      producer.run();
+      Foo* fp = fifo.getNext(5000);
+      assert(fp);
+      assert(fp->mVal == "0:0");
+      delete fp;
+      assert(Timer::getTimeMs() - begin < 2000);
+
+      fifo.add(new Foo("left behind"));
+      assert(fifo.size() == 1);
+      assert(fifo.messageAvailable());
+      fifo.clear();
+      assert(fifo.empty());
+      assert(fifo.getCountDepth() == 0);
+   }
+
+   {
+      cerr << "!! Test lock-free reserved" << endl;
+
+      TimeLimitFifo<Foo> tlfNS(5, 10); // 5 seconds, limit 10 (2 reserved)
+      tlfNS.setLockFree(true);
+      bool c;
+
+      for (int i = 0; i < 8; ++i)
+      {
+         c = tlfNS.add(new Foo(Data("element") + Data(i)), TimeLimitFifo<Foo>::EnforceTimeDepth);
+         assert(c);
+      }
+
+      c = tlfNS.add(new Foo("nope"), TimeLimitFifo<Foo>::IgnoreTimeDepth);
+      assert(!c);
+      assert(tlfNS.size() == 8);
+      assert(tlfNS.getCountDepth() == 8);
+
+      c = tlfNS.add(new Foo("yep"), TimeLimitFifo<Foo>::InternalElement);
+      assert(c);
+      c = tlfNS.add(new Foo("yepAgain"), TimeLimitFifo<Foo>::InternalElement);
+      assert(c);
+      c = tlfNS.add(new Foo("hard nope!"), TimeLimitFifo<Foo>::InternalElement);
+      assert(!c);
+
+      Foo* fp = tlfNS.getNext();
+      assert(fp->mVal == "element0");
+      delete fp;
+      assert(tlfNS.size() == 9);
+
+      while (!tlfNS.empty())
+      {
+         delete tlfNS.getNext();
+      }
+      assert(tlfNS.getCountDepth() == 0);
+      assert(tlfNS.timeDepth() == 0);
+   }
+
+   {
+      cerr << "!! Test lock-free time depth" << endl;
+
+      TimeLimitFifo<Foo> tlfNS(2, 0); // 2 seconds, no count limit
+      tlfNS.setLockFree(true);
+      bool c;
+
+      c = tlfNS.add(new Foo("first"), TimeLimitFifo<Foo>::EnforceTimeDepth);
+      assert(c);
+      c = tlfNS.add(new Foo("second"), TimeLimitFifo<Foo>::EnforceTimeDepth);
+      assert(c);
+      // Time depth is tracked from what the consumer has seen
+      Foo* fp = tlfNS.getNext();
+      assert(fp->mVal == "first");
+      delete fp;
+      sleepMS(3000);
+      assert(tlfNS.timeDepth() >= 2);
+      c = tlfNS.add(new Foo("nope"), TimeLimitFifo<Foo>::EnforceTimeDepth);
+      assert(!c);
+      c = tlfNS.add(new Foo("yep"), TimeLimitFifo<Foo>::IgnoreTimeDepth);
+      assert(c);
+      tlfNS.clear();
+      assert(tlfNS.timeDepth() == 0);
+      c = tlfNS.add(new Foo("third"), TimeLimitFifo<Foo>::EnforceTimeDepth);
+      assert(c);
+   }
+
    {
       cerr << "!! Test produce consumer" << endl;
 
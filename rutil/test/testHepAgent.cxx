@@ -0,0 +1,309 @@
+#include <cassert>
+#include <cstring>
+#include <time.h>
+#include <iostream>
+
+#include "rutil/Data.hxx"
+#include "rutil/GenericIPAddress.hxx"
+#include "rutil/Socket.hxx"
+#include "rutil/Timer.hxx"
+#include "rutil/hep/HepAgent.hxx"
+
+#ifndef WIN32
+#include <arpa/inet.h>
+#endif
+
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+// A local "HOMER" that counts the HEP3 packets it gets.
+class Collector
+{
+   public:
+      Collector()
+      {
+         mSocket = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+         assert(mSocket >= 0);
+         int size = 4 * 1024 * 1024;
+         ::setsockopt(mSocket, SOL_SOCKET, SO_RCVBUF, (const char*)&size, sizeof(size));
+         sockaddr_in addr;
+         memset(&addr, 0, sizeof(addr));
+         addr.sin_family = AF_INET;
+         addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+         addr.sin_port = 0;
+         int rc = ::bind(mSocket, (sockaddr*)&addr, sizeof(addr));
+         assert(rc == 0);
+         socklen_t len = sizeof(addr);
+         rc = ::getsockname(mSocket, (sockaddr*)&addr, &len);
+         assert(rc == 0);
+         mPort = ntohs(addr.sin_port);
+         makeSocketNonBlocking(mSocket);
+      }
+
+      ~Collector()
+      {
+         closeSocket(mSocket);
+      }
+
+      /// Counts what arrives within ms; returns early once expected arrived.
+      int receive(int expected, int ms = 1000)
+      {
+         int count = 0;
+         char buffer[65536];
+         UInt64 end = Timer::getTimeMs() + ms;
+         while (Timer::getTimeMs() < end)
+         {
+            int len = ::recv(mSocket, buffer, sizeof(buffer), 0);
+            if (len <= 0)
+            {
+               if (count >= expected)
+               {
+                  break;
+               }
+               sleepMs(1);
+               continue;
+            }
+            assert(len > 6);
+            assert(memcmp(buffer, "HEP3", 4) == 0);
+            assert(ntohs(*(u_int16_t*)(buffer + 4)) == len);
+            mLast = Data(buffer, len);
+            ++count;
+         }
+         return count;
+      }
+
+      Socket mSocket;
+      int mPort;
+      Data mLast;
+};
+
+GenericIPAddress
+address(const char* ip, int port)
+{
+   sockaddr_in addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = inet_addr(ip);
+   addr.sin_port = htons(port);
+   return GenericIPAddress(addr);
+}
+
+const GenericIPAddress Source(address("192.0.2.1", 5060));
+const GenericIPAddress Destination(address("192.0.2.2", 5061));
+
+void
+capture(HepAgent& agent, int count, const Data& payload, bool withCallId = true)
+{
+   for (int i = 0; i < count; ++i)
+   {
+      agent.sendToHOMER<Data>(UDP, Source, Destination, HepAgent::SIP, payload,
+                              withCallId ? Data("call-") + Data(i) : Data::Empty);
+   }
+}
+
+void
+testDelivery(unsigned int maxQueued)
+{
+   cerr << "testDelivery maxQueued=" << maxQueued << endl;
+   Collector collector;
+   {
+      HepAgent agent("127.0.0.1", collector.mPort, 2001, maxQueued);
+      capture(agent, 100, "INVITE sip:bob@example.com SIP/2.0\r\n\r\n");
+      assert(collector.receive(100) == 100);
+      assert(collector.mLast.find("INVITE sip:bob@example.com") != Data::npos);
+      assert(collector.mLast.find("call-99") != Data::npos);
+      HepAgent::Stats stats = agent.getStats();
+      assert(stats.mSent == 100);
+      assert(stats.mSendErrors == 0);
+      assert(stats.mQueueFull == 0);
+      if (maxQueued)
+      {
+         assert(stats.mBatches > 0 && stats.mBatches <= 100);
+      }
+   }
+}
+
+void
+testSampling()
+{
+   cerr << "testSampling" << endl;
+   Collector collector;
+   HepAgent agent("127.0.0.1", collector.mPort, 2001);
+   agent.setSampling(4);
+
+   // by Call-ID: every packet of a call gets the same decision
+   int expected = 0;
+   for (int i = 0; i < 100; ++i)
+   {
+      const Data callId = Data("call-") + Data(i);
+      if (callId.hash() % 4 == 0)
+      {
+         expected += 3;
+      }
+      for (int j = 0; j < 3; ++j)
+      {
+         agent.sendToHOMER<Data>(UDP, Source, Destination, HepAgent::SIP, Data("msg"), callId);
+      }
+   }
+   assert(expected > 0 && expected < 300);
+   assert(collector.receive(expected) == expected);
+   assert(agent.getStats().mSampledOut == (UInt64)(300 - expected));
+
+   // without one, one packet in four
+   capture(agent, 100, "RTCP", false);
+   assert(collector.receive(25) == 25);
+}
+
+void
+testRateLimit()
+{
+   cerr << "testRateLimit" << endl;
+   Collector collector;
+   HepAgent agent("127.0.0.1", collector.mPort, 2001);
+   agent.setRateLimit(10);
+   capture(agent, 100, "OPTIONS");
+   HepAgent::Stats stats = agent.getStats();
+   // a window boundary may fall inside the burst
+   assert(stats.mRateLimited >= 80);
+   assert(collector.receive(100 - (int)stats.mRateLimited) == 100 - (int)stats.mRateLimited);
+}
+
+void
+testOverload()
+{
+   cerr << "testOverload" << endl;
+   Collector collector;
+   HepAgent agent("127.0.0.1", collector.mPort, 2001, 4);
+   capture(agent, 2000, "x");
+   HepAgent::Stats stats = agent.getStats();
+   while (stats.mSent + stats.mSendErrors + stats.mQueueFull < 2000)
+   {
+      sleepMs(1);
+      stats = agent.getStats();
+   }
+   assert(stats.mSent + stats.mQueueFull == 2000);
+   cerr << "   " << stats.mQueueFull << " of 2000 dropped with 4 queued" << endl;
+}
+
+#ifndef WIN32
+// CPU time of the calling thread; wall time would also count the sender
+// thread whenever both share a core.
+UInt64
+threadCpuMicroSec()
+{
+   timespec ts;
+   clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+   return (UInt64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+#else
+#define threadCpuMicroSec Timer::getTimeMicroSec
+#endif
+
+void
+benchmark(unsigned int maxQueued, int count)
+{
+   Collector collector;
+   Data payload;
+   for (int i = 0; i < 20; ++i)
+   {
+      payload += "Via: SIP/2.0/UDP 192.0.2.1:5060;branch=z9hG4bK-benchmark\r\n";
+   }
+
+   HepAgent agent("127.0.0.1", collector.mPort, 2001, maxQueued ? count : 0);
+   UInt64 start = Timer::getTimeMicroSec();
+   UInt64 cpuStart = threadCpuMicroSec();
+   capture(agent, count, payload);
+   UInt64 cpu = threadCpuMicroSec() - cpuStart;
+   HepAgent::Stats stats = agent.getStats();
+   while (stats.mSent + stats.mSendErrors < (UInt64)count)
+   {
+      sleepMs(1);
+      stats = agent.getStats();
+   }
+   UInt64 sent = Timer::getTimeMicroSec();
+   cerr << (maxQueued ? "queued" : "inline") << ": "
+        << cpu * 1000 / count << " ns of caller CPU per packet, "
+        << (sent - start) * 1000 / count << " ns per packet until sent, "
+        << stats.mBatches << " send calls" << endl;
+}
+
+}
+
+int
+main(int argc, char* argv[])
+{
+#ifdef WIN32
+   initNetwork();
+#endif
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   testDelivery(0);
+   testDelivery(HepAgent::DefaultMaxQueued);
+   testSampling();
+   testRateLimit();
+   testOverload();
+
+   if (argc > 1)
+   {
+      const int count = atoi(argv[1]);
+      benchmark(0, count);
+      benchmark(1, count);
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -31,6 +31,19 @@ class FooFoo : public FooRead, public FooWrite
       int va2;
 };
 
+class FooFooFoo;
+
+typedef IntrusiveListElement1<FooFooFoo*> FooFooWrite;
+typedef IntrusiveListElement2<FooFooFoo*> FooFooWrite2;
+
+class FooFooFoo : public FooFooWrite, public FooFooWrite2
+{
+   public:
+      FooFooFoo(int v) : va1(v) {}
+
+      int va1;
+};
+
 int
 main(int argc, char* argv[])
 {
@@ -255,6 +268,55 @@ main(int argc, char* argv[])
       }
    }
 
+   //=============================================================================
+   // Second write version
+   //=============================================================================
+   cerr << endl << "WRITE2 VERSION" << endl;
+   {
+      FooFooFoo* head = new FooFooFoo(-1);
+      FooFooFoo* foo1 = new FooFooFoo(1);
+      FooFooFoo* foo2 = new FooFooFoo(2);
+      FooFooFoo* foo3 = new FooFooFoo(3);
+
+      FooFooWrite::makeList(head);
+      FooFooWrite2::makeList(head);
+      assert(head->FooFooWrite2::empty());
+      assert(head->FooFooWrite2::begin() == head->FooFooWrite2::end());
+
+      head->FooFooWrite2::push_back(foo1);
+      head->FooFooWrite2::push_back(foo2);
+      head->FooFooWrite2::push_back(foo3);
+      assert(head->FooFooWrite::empty());
+      assert(!(head->FooFooWrite2::begin() == head->FooFooWrite2::end()));
+
+      // the iterators have to tell elements apart for the loop to run
+      int sum = 0;
+      int count = 0;
+      for (FooFooWrite2::iterator f = head->FooFooWrite2::begin(); f != head->FooFooWrite2::end(); ++f)
+      {
+         cerr << (*f)->va1 << endl;
+         sum = sum * 10 + (*f)->va1;
+         ++count;
+      }
+      assert(count == 3);
+      assert(sum == 123);
+
+      cerr << endl << "deleted second" << endl;
+      delete foo2;
+      count = 0;
+      for (FooFooWrite2::iterator f = head->FooFooWrite2::begin(); f != head->FooFooWrite2::end(); ++f)
+      {
+         cerr << (*f)->va1 << endl;
+         ++count;
+      }
+      assert(count == 2);
+
+      delete foo1;
+      delete foo3;
+      assert(head->FooFooWrite2::empty());
+      delete head;
+   }
+
    cerr << "All OK" << endl;
 
    return 0;
@@ -0,0 +1,211 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/LatencyHistogram.hxx"
+#include "rutil/ThreadIf.hxx"
+
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+void
+testBuckets()
+{
+   // every value maps to a bucket whose range holds it, and the buckets
+   // tile the range without gaps
+   for (unsigned int b = 1; b < LatencyHistogram::NumBuckets; ++b)
+   {
+      assert(LatencyHistogram::lowestValueIn(b) == LatencyHistogram::highestValueIn(b - 1) + 1);
+   }
+   assert(LatencyHistogram::highestValueIn(LatencyHistogram::NumBuckets - 1) == LatencyHistogram::MaxValue - 1);
+
+   for (UInt64 v = 0; v < LatencyHistogram::MaxValue; v = v * 5 / 4 + 1)
+   {
+      unsigned int b = LatencyHistogram::bucketFor(v);
+      assert(b < LatencyHistogram::NumBuckets);
+      assert(LatencyHistogram::lowestValueIn(b) <= v);
+      assert(LatencyHistogram::highestValueIn(b) >= v);
+      // relative error bounded by the sub-bucket resolution
+      assert((LatencyHistogram::highestValueIn(b) - LatencyHistogram::lowestValueIn(b)) * LatencyHistogram::SubBuckets <= v);
+   }
+   for (UInt64 v = 0; v < 4 * LatencyHistogram::SubBuckets; ++v)
+   {
+      unsigned int b = LatencyHistogram::bucketFor(v);
+      assert(LatencyHistogram::lowestValueIn(b) <= v && v <= LatencyHistogram::highestValueIn(b));
+   }
+   assert(LatencyHistogram::bucketFor(LatencyHistogram::MaxValue) == LatencyHistogram::NumBuckets - 1);
+   assert(LatencyHistogram::bucketFor(~(UInt64)0) == LatencyHistogram::NumBuckets - 1);
+}
+
+void
+testPercentiles()
+{
+   LatencyHistogram h;
+   assert(h.count() == 0);
+   assert(h.valueAtPercentile(50) == 0);
+   assert(h.max() == 0);
+
+   for (UInt64 v = 1; v <= 10000; ++v)
+   {
+      h.record(v);
+   }
+   assert(h.count() == 10000);
+   assert(h.sum() == 10000 * 10001 / 2);
+   assert(h.mean() == 5000);
+   assert(h.min() == 1);
+   assert(h.max() >= 10000 && h.max() < 10000 * 17 / 16);
+
+   UInt64 p50 = h.valueAtPercentile(50);
+   UInt64 p99 = h.valueAtPercentile(99);
+   assert(p50 >= 5000 && p50 < 5000 * 17 / 16);
+   assert(p99 >= 9900 && p99 < 9900 * 17 / 16);
+   assert(h.valueAtPercentile(100) == h.max());
+   assert(h.valueAtPercentile(0) == h.min());
+
+   assert(h.countAtOrBelow(0) == 0);
+   assert(h.countAtOrBelow(31) == 31);
+   assert(h.countAtOrBelow(LatencyHistogram::MaxValue) == 10000);
+   UInt64 below = h.countAtOrBelow(5000);
+   assert(below <= 5000 && below >= 5000 * 15 / 16);
+
+   Data text;
+   {
+      DataStream strm(text);
+      strm << h;
+   }
+   assert(text.prefix("n 10000 mean 5000 p50 "));
+}
+
+void
+testArithmetic()
+{
+   LatencyHistogram a;
+   LatencyHistogram b;
+   for (int i = 0; i < 100; ++i)
+   {
+      a.record(100);
+      b.record(100000);
+   }
+
+   LatencyHistogram snapshot(a);
+   a += b;
+   assert(a.count() == 200);
+   assert(a.valueAtPercentile(50) == LatencyHistogram::highestValueIn(LatencyHistogram::bucketFor(100)));
+   assert(a.valueAtPercentile(51) == LatencyHistogram::highestValueIn(LatencyHistogram::bucketFor(100000)));
+
+   a -= snapshot;
+   assert(a.count() == 100);
+   assert(a.sum() == 100 * 100000);
+   assert(a.min() == LatencyHistogram::lowestValueIn(LatencyHistogram::bucketFor(100000)));
+
+   a.reset();
+   assert(a.count() == 0 && a.sum() == 0 && a.max() == 0);
+}
+
+class Recorder : public ThreadIf
+{
+   public:
+      Recorder(LatencyHistogram& histogram, int count) : mHistogram(histogram), mCount(count) {}
+      virtual void thread()
+      {
+         for (int i = 0; i < mCount; ++i)
+         {
+            mHistogram.record(i % 1000);
+         }
+      }
+
+   private:
+      LatencyHistogram& mHistogram;
+      const int mCount;
+};
+
+void
+testConcurrentSnapshots()
+{
+   // one writer, one reader copying snapshots while it writes
+   const int count = 2000000;
+   LatencyHistogram h;
+   Recorder recorder(h, count);
+   recorder.run();
+
+   UInt64 last = 0;
+   while (last < (UInt64)count)
+   {
+      LatencyHistogram snapshot(h);
+      assert(snapshot.count() >= last);
+      last = snapshot.count();
+   }
+   recorder.join();
+   assert(h.count() == (UInt64)count);
+   assert(h.max() == LatencyHistogram::highestValueIn(LatencyHistogram::bucketFor(999)));
+}
+
+}
+
+int
+main()
+{
+   testBuckets();
+   testPercentiles();
+   testArithmetic();
+   testConcurrentSnapshots();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ * vi: set shiftwidth=3 expandtab:
+ */
@@ -0,0 +1,402 @@
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <set>
+#include <vector>
+
+#include "rutil/TimerWheel.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+class TestTimer
+{
+   public:
+      TestTimer(UInt64 when, unsigned int id) : mWhen(when), mId(id) {}
+      UInt64 getWhen() const { return mWhen; }
+      bool operator>(const TestTimer& rhs) const { return mWhen > rhs.mWhen; }
+      bool operator<(const TestTimer& rhs) const { return mWhen < rhs.mWhen; }
+
+      UInt64 mWhen;
+      unsigned int mId;
+};
+
+typedef TimerWheel<TestTimer> Wheel;
+
+// A small deterministic generator so failures are reproducible.
+UInt32 seed = 12345;
+UInt32
+rnd()
+{
+   seed = seed * 1103515245 + 12345;
+   return (seed >> 8) & 0xFFFFFF;
+}
+
+UInt64
+rnd64()
+{
+   return (UInt64(rnd()) << 24) | rnd();
+}
+
+void
+testOrdering()
+{
+   Wheel wheel(1000);
+   Wheel::Handle h;
+   assert(wheel.empty());
+   assert(wheel.expired(1000000, h) == 0);
+
+   // pushed out of order, spread over several levels
+   const UInt64 times[] = { 1000000 + 70000, 1000000 + 5, 1000000 + 300,
+                            1000000 + 20000000, 1000000 + 5, 1000000 };
+   const unsigned int count = sizeof(times)/sizeof(times[0]);
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      wheel.push(TestTimer(times[i], i));
+   }
+   assert(wheel.size() == count);
+   assert(wheel.top().mWhen == 1000000);
+
+   UInt64 last = 0;
+   unsigned int fired = 0;
+   for (UInt64 now = 1000000; fired < count; now += 997)
+   {
+      const TestTimer* t;
+      while ((t = wheel.expired(now, h)) != 0)
+      {
+         assert(t->mWhen <= now);
+         assert(t->mWhen >= last);
+         last = t->mWhen;
+         assert(wheel.cancel(h));
+         assert(!wheel.cancel(h));
+         ++fired;
+      }
+      if (!wheel.empty())
+      {
+         assert(wheel.nextExpiry() > now);
+         assert(wheel.nextExpiry() <= wheel.top().mWhen);
+      }
+   }
+   assert(wheel.empty());
+}
+
+void
+testCancel()
+{
+   Wheel wheel(0);
+   Wheel::Handle a = wheel.push(TestTimer(100, 1));
+   Wheel::Handle b = wheel.push(TestTimer(100, 2));
+   Wheel::Handle c = wheel.push(TestTimer(60000, 3));
+   assert(a != 0 && b != 0 && c != 0);
+   assert(wheel.pending(a) && wheel.pending(b) && wheel.pending(c));
+   assert(wheel.find(b)->mId == 2);
+
+   assert(wheel.cancel(b));
+   assert(!wheel.pending(b));
+   assert(wheel.find(b) == 0);
+   assert(wheel.size() == 2);
+
+   // the node freed by b is reused; b must not alias the new timer
+   Wheel::Handle d = wheel.push(TestTimer(50, 4));
+   assert(d != b);
+   assert(!wheel.cancel(b));
+   assert(wheel.size() == 3);
+
+   Wheel::Handle h;
+   const TestTimer* t = wheel.expired(100, h);
+   assert(t && t->mId == 4 && h == d);
+   wheel.cancel(h);
+   t = wheel.expired(100, h);
+   assert(t && t->mId == 1 && h == a);
+   wheel.cancel(h);
+   assert(wheel.expired(100, h) == 0);
+
+   // within a level 1 rotation the next expiry is exact
+   assert(wheel.nextExpiry() == 60000);
+   Wheel::Handle e = wheel.push(TestTimer(20000, 5));
+   assert(wheel.nextExpiry() == 20000);
+   assert(wheel.cancel(e));
+   assert(wheel.nextExpiry() == 60000);
+
+   assert(wheel.cancel(c));
+   assert(wheel.empty());
+   assert(wheel.expired(1000000, h) == 0);
+}
+
+void
+testPushWhileProcessing()
+{
+   Wheel wheel(0);
+   wheel.push(TestTimer(10, 0));
+   Wheel::Handle h;
+   unsigned int fired = 0;
+   const TestTimer* t;
+   while ((t = wheel.expired(1000, h)) != 0)
+   {
+      // re-arm in the past, in the future, and right now
+      if (t->mId < 3)
+      {
+         wheel.push(TestTimer(t->mWhen + 100, t->mId + 1));
+         wheel.push(TestTimer(5, 100));
+      }
+      assert(t->mWhen <= 1000);
+      wheel.cancel(h);
+      ++fired;
+   }
+   assert(fired == 7);
+   assert(wheel.empty());
+}
+
+void
+testOverdueAndFarFuture()
+{
+   Wheel wheel(UInt64(1) << 40);
+   UInt64 base = UInt64(1) << 40;
+   wheel.push(TestTimer(base - 5000, 1));
+   wheel.push(TestTimer(base + (UInt64(3) << 32), 2));
+   Wheel::Handle h;
+   const TestTimer* t = wheel.expired(base, h);
+   assert(t && t->mId == 1);
+   wheel.cancel(h);
+   assert(wheel.expired(base + (UInt64(3) << 32) - 1, h) == 0);
+   assert(wheel.nextExpiry() <= base + (UInt64(3) << 32));
+   t = wheel.expired(base + (UInt64(3) << 32), h);
+   assert(t && t->mId == 2);
+   wheel.cancel(h);
+   assert(wheel.empty());
+}
+
+void
+testPop()
+{
+   Wheel wheel(0);
+   for (unsigned int i = 0; i < 1000; ++i)
+   {
+      wheel.push(TestTimer(rnd() % 10000000, i));
+   }
+   UInt64 last = 0;
+   while (!wheel.empty())
+   {
+      assert(wheel.top().mWhen >= last);
+      last = wheel.top().mWhen;
+      wheel.pop();
+   }
+}
+
+// Drives the wheel and a multimap side by side with random pushes, cancels
+// and clock jumps, and checks they agree on what fires when.
+void
+testRandom()
+{
+   UInt64 now = rnd64();
+   Wheel wheel(now);
+   typedef multimap<UInt64, Wheel::Handle> Reference;
+   Reference reference;
+   map<Wheel::Handle, Reference::iterator> byHandle;
+   unsigned int id = 0;
+
+   for (unsigned int round = 0; round < 20000; ++round)
+   {
+      unsigned int op = rnd() % 10;
+      if (op < 6)
+      {
+         UInt64 when;
+         switch (rnd() % 4)
+         {
+            case 0: when = now + rnd() % 300; break;
+            case 1: when = now + rnd() % 100000; break;
+            case 2: when = now + rnd64() % (UInt64(1) << 34); break;
+            default: when = now - rnd() % 1000; break;
+         }
+         Wheel::Handle h = wheel.push(TestTimer(when, id++));
+         byHandle[h] = reference.insert(make_pair(when, h));
+      }
+      else if (op < 8 && !byHandle.empty())
+      {
+         map<Wheel::Handle, Reference::iterator>::iterator i = byHandle.lower_bound((UInt64(rnd() % 4 + 1) << 32) | rnd() % 20000);
+         if (i == byHandle.end())
+         {
+            i = byHandle.begin();
+         }
+         assert(wheel.cancel(i->first));
+         reference.erase(i->second);
+         byHandle.erase(i);
+      }
+      else
+      {
+         switch (rnd() % 3)
+         {
+            case 0: now += rnd() % 300; break;
+            case 1: now += rnd() % 100000; break;
+            default: now += rnd64() % (UInt64(1) << 33); break;
+         }
+         Wheel::Handle h;
+         const TestTimer* t;
+         while ((t = wheel.expired(now, h)) != 0)
+         {
+            assert(t->mWhen <= now);
+            map<Wheel::Handle, Reference::iterator>::iterator i = byHandle.find(h);
+            assert(i != byHandle.end());
+            assert(i->second->first == t->mWhen);
+            reference.erase(i->second);
+            byHandle.erase(i);
+            wheel.cancel(h);
+         }
+         assert(reference.empty() || reference.begin()->first > now);
+      }
+
+      assert(wheel.size() == reference.size());
+      if (!reference.empty())
+      {
+         UInt64 earliest = reference.begin()->first;
+         assert(wheel.top().mWhen == earliest);
+         assert(wheel.nextExpiry() <= earliest);
+      }
+   }
+}
+
+// Rough cost comparison against the containers the timer queues used to be
+// built on. The workload mimics a transaction layer: most timers are
+// cancelled (or would be, had the queue supported it) before they fire.
+void
+benchmark(unsigned int count)
+{
+   vector<UInt64> offsets(count);
+   for (unsigned int i = 0; i < count; ++i)
+   {
+      offsets[i] = 500 + rnd() % 64000;
+   }
+
+   {
+      UInt64 start = Timer::getTimeMicroSec();
+      Wheel wheel(0);
+      vector<Wheel::Handle> handles(count);
+      for (unsigned int i = 0; i < count; ++i)
+      {
+         handles[i] = wheel.push(TestTimer(offsets[i], i));
+      }
+      UInt64 inserted = Timer::getTimeMicroSec();
+      for (unsigned int i = 0; i < count; i += 4)
+      {
+         for (unsigned int j = i; j < i + 3 && j < count; ++j)
+         {
+            wheel.cancel(handles[j]);
+         }
+      }
+      UInt64 cancelled = Timer::getTimeMicroSec();
+      Wheel::Handle h;
+      unsigned int fired = 0;
+      for (UInt64 now = 0; now <= 65000; now += 10)
+      {
+         while (wheel.expired(now, h))
+         {
+            wheel.cancel(h);
+            ++fired;
+         }
+      }
+      UInt64 end = Timer::getTimeMicroSec();
+      assert(wheel.empty());
+      cerr << "TimerWheel:     insert " << (inserted - start) / 1000 << "ms"
+           << " cancel " << (cancelled - inserted) / 1000 << "ms"
+           << " expire " << (end - cancelled) / 1000 << "ms (" << fired << " fired)" << endl;
+   }
+
+   {
+      // A heap cannot remove from the middle; cancelled timers stay in it
+      // and are discarded when they reach the top.
+      UInt64 start = Timer::getTimeMicroSec();
+      priority_queue<TestTimer, vector<TestTimer>, greater<TestTimer> > heap;
+      vector<bool> dead(count, false);
+      for (unsigned int i = 0; i < count; ++i)
+      {
+         heap.push(TestTimer(offsets[i], i));
+      }
+      UInt64 inserted = Timer::getTimeMicroSec();
+      for (unsigned int i = 0; i < count; i += 4)
+      {
+         for (unsigned int j = i; j < i + 3 && j < count; ++j)
+         {
+            dead[j] = true;
+         }
+      }
+      UInt64 cancelled = Timer::getTimeMicroSec();
+      unsigned int fired = 0;
+      for (UInt64 now = 0; now <= 65000; now += 10)
+      {
+         while (!heap.empty() && heap.top().mWhen <= now)
+         {
+            if (!dead[heap.top().mId])
+            {
+               ++fired;
+            }
+            heap.pop();
+         }
+      }
+      UInt64 end = Timer::getTimeMicroSec();
+      cerr << "priority_queue: insert " << (inserted - start) / 1000 << "ms"
+           << " cancel " << (cancelled - inserted) / 1000 << "ms"
+           << " expire " << (end - cancelled) / 1000 << "ms (" << fired << " fired)" << endl;
+   }
+
+   {
+      UInt64 start = Timer::getTimeMicroSec();
+      typedef multiset<TestTimer> Set;
+      Set timers;
+      vector<Set::iterator> iters(count);
+      for (unsigned int i = 0; i < count; ++i)
+      {
+         iters[i] = timers.insert(TestTimer(offsets[i], i));
+      }
+      UInt64 inserted = Timer::getTimeMicroSec();
+      for (unsigned int i = 0; i < count; i += 4)
+      {
+         for (unsigned int j = i; j < i + 3 && j < count; ++j)
+         {
+            timers.erase(iters[j]);
+         }
+      }
+      UInt64 cancelled = Timer::getTimeMicroSec();
+      unsigned int fired = 0;
+      for (UInt64 now = 0; now <= 65000; now += 10)
+      {
+         while (!timers.empty() && timers.begin()->mWhen <= now)
+         {
+            timers.erase(timers.begin());
+            ++fired;
+         }
+      }
+      UInt64 end = Timer::getTimeMicroSec();
+      cerr << "multiset:       insert " << (inserted - start) / 1000 << "ms"
+           << " cancel " << (cancelled - inserted) / 1000 << "ms"
+           << " expire " << (end - cancelled) / 1000 << "ms (" << fired << " fired)" << endl;
+   }
+}
+
+}
+
+int
+main(int argc, char* argv[])
+{
+   testOrdering();
+   testCancel();
+   testPushWhileProcessing();
+   testOverdueAndFarFuture();
+   testPop();
+   testRandom();
+
+   if (argc > 1)
+   {
+      benchmark((unsigned int)atoi(argv[1]));
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+